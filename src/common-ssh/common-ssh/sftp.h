@@ -21,12 +21,15 @@
 #define GUAC_COMMON_SSH_SFTP_H
 
 #include "common/json.h"
+#include "common/transfer.h"
+#include "common/upload.h"
 #include "ssh.h"
 
 #include <guacamole/object.h>
 #include <guacamole/user.h>
 #include <libssh2.h>
 #include <libssh2_sftp.h>
+#include <pthread.h>
 
 /**
  * Maximum number of bytes per path.
@@ -38,6 +41,20 @@
  */
 #define GUAC_COMMON_SSH_SFTP_MAX_DEPTH 1024
 
+/**
+ * The size of the buffer into which each download reads ahead of the data
+ * actually sent to the user, in bytes.
+ */
+#define GUAC_COMMON_SSH_SFTP_READ_AHEAD_SIZE 1048576
+
+/**
+ * The maximum number of bytes to request from libssh2 in a single read.
+ * libssh2 splits larger reads into several SFTP read requests which are all
+ * sent before any reply is awaited, so larger reads keep more requests
+ * outstanding over high-latency connections.
+ */
+#define GUAC_COMMON_SSH_SFTP_READ_SIZE 262144
+
 /**
  * Representation of an SFTP-driven filesystem object. Unlike guac_object, this
  * structure is not tied to any particular user.
@@ -59,6 +76,14 @@ typedef struct guac_common_ssh_sftp_filesystem {
      */
     LIBSSH2_SFTP* sftp_session;
 
+    /**
+     * Lock which must be held while using the SFTP session. The SFTP session
+     * may be used concurrently by the input threads of any number of users,
+     * as well as by the writer threads of uploads, while libssh2 sessions
+     * are not threadsafe.
+     */
+    pthread_mutex_t lock;
+
     /**
      * The path to the directory to expose to the user as a filesystem object.
      */
@@ -69,6 +94,17 @@ typedef struct guac_common_ssh_sftp_filesystem {
      * instruction.
      */
     char upload_path[GUAC_COMMON_SSH_SFTP_MAX_PATH];
+
+    /**
+     * All uploads currently writing to files within this filesystem.
+     */
+    guac_common_upload_list* uploads;
+
+    /**
+     * All downloads currently reading files from this filesystem. This list
+     * is guarded by lock.
+     */
+    struct guac_common_ssh_sftp_download_state* downloads;
     
     /**
      * If downloads from SFTP to the local browser should be disabled.
@@ -108,8 +144,120 @@ typedef struct guac_common_ssh_sftp_ls_state {
      */
     guac_common_json_state json_state;
 
+    /**
+     * The sliding window of blobs of JSON currently being sent to the user.
+     */
+    guac_common_transfer transfer;
+
 } guac_common_ssh_sftp_ls_state;
 
+/**
+ * The current state of a file upload operation.
+ */
+typedef struct guac_common_ssh_sftp_upload_state {
+
+    /**
+     * The SFTP filesystem receiving the file.
+     */
+    guac_common_ssh_sftp_filesystem* filesystem;
+
+    /**
+     * Reference to the file being uploaded over SFTP. This file must already
+     * be open from a call to libssh2_sftp_open().
+     */
+    LIBSSH2_SFTP_HANDLE* file;
+
+    /**
+     * The upload writing received data to the file in the background.
+     */
+    guac_common_upload* upload;
+
+} guac_common_ssh_sftp_upload_state;
+
+/**
+ * The current state of a file download operation.
+ */
+typedef struct guac_common_ssh_sftp_download_state {
+
+    /**
+     * The SFTP filesystem containing the file.
+     */
+    guac_common_ssh_sftp_filesystem* filesystem;
+
+    /**
+     * The user receiving the download.
+     */
+    guac_user* user;
+
+    /**
+     * Reference to the file being downloaded over SFTP. This file must
+     * already be open from a call to libssh2_sftp_open().
+     */
+    LIBSSH2_SFTP_HANDLE* file;
+
+    /**
+     * The sliding window of blobs currently being sent to the user.
+     */
+    guac_common_transfer transfer;
+
+    /**
+     * The thread reading the file ahead of the data sent to the user.
+     */
+    pthread_t reader_thread;
+
+    /**
+     * Lock which guards the read-ahead buffer and associated flags, shared
+     * between the reader thread and the user receiving the download.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition which is signalled whenever data is added to or removed from
+     * the read-ahead buffer, or when the reader thread should stop.
+     */
+    pthread_cond_t modified;
+
+    /**
+     * Ring buffer of data read from the file but not yet sent to the user,
+     * GUAC_COMMON_SSH_SFTP_READ_AHEAD_SIZE bytes in size.
+     */
+    char* buffer;
+
+    /**
+     * The offset within buffer of the first byte not yet sent to the user.
+     */
+    int start;
+
+    /**
+     * The number of bytes within buffer not yet sent to the user.
+     */
+    int length;
+
+    /**
+     * Non-zero if the reader thread has stopped reading because the end of
+     * the file has been reached or an error occurred.
+     */
+    int eof;
+
+    /**
+     * Non-zero if the reader thread stopped due to an error.
+     */
+    int error;
+
+    /**
+     * Non-zero if the reader thread should stop reading because the download
+     * is being freed.
+     */
+    int stopping;
+
+    /**
+     * The next download within the list of downloads of the filesystem, or
+     * NULL if this is the last download in that list.
+     */
+    struct guac_common_ssh_sftp_download_state* next;
+
+} guac_common_ssh_sftp_download_state;
+
 /**
  * Creates a new Guacamole filesystem object which provides access to files
  * and directories via SFTP using the given SSH session. When the filesystem
@@ -149,8 +297,9 @@ guac_common_ssh_sftp_filesystem* guac_common_ssh_create_sftp_filesystem(
 
 /**
  * Destroys the given filesystem object, disconnecting from SFTP and freeing
- * and associated resources. Any associated session or user objects must be
- * explicitly destroyed.
+ * and associated resources. Any uploads or downloads still in progress are
+ * cancelled, and their files closed, before the SFTP session is shut down. Any associated
+ * session or user objects must be explicitly destroyed.
  *
  * @param filesystem
  *     The filesystem object to destroy.
@@ -226,6 +375,24 @@ guac_stream* guac_common_ssh_sftp_download_file(
         guac_common_ssh_sftp_filesystem* filesystem, guac_user* user,
         char* filename);
 
+/**
+ * Aborts all downloads from the given filesystem to the given user which are
+ * still in progress, stopping the threads reading their files, closing those
+ * files, and freeing all associated data. As the streams of those downloads
+ * are not freed or ended, this function must be invoked only when the user
+ * is leaving the connection, such that no further "ack" instructions will be
+ * handled for those streams.
+ *
+ * @param filesystem
+ *     The filesystem that the downloads are reading from.
+ *
+ * @param user
+ *     The user receiving the downloads to abort, or NULL to abort the
+ *     downloads of all users.
+ */
+void guac_common_ssh_sftp_abort_downloads(
+        guac_common_ssh_sftp_filesystem* filesystem, guac_user* user);
+
 /**
  * Handles an incoming stream from a Guacamole "file" instruction, saving the
  * contents of that stream to the file having the given name within the
@@ -284,11 +284,97 @@ static int guac_ssh_append_path(char* fullpath, const char* path_a,
 
 }
 
+/**
+ * Writes a block of received data to the file being uploaded, as required by
+ * guac_common_upload_write_handler. This handler is invoked by the upload's
+ * writer thread, not by the user's input thread.
+ *
+ * @param upload
+ *     The upload receiving the data.
+ *
+ * @param buffer
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes of data to write.
+ *
+ * @return
+ *     Zero if all data was written successfully, non-zero otherwise.
+ */
+static int guac_common_ssh_sftp_upload_write(guac_common_upload* upload,
+        const char* buffer, int length) {
+
+    guac_common_ssh_sftp_upload_state* upload_state =
+        (guac_common_ssh_sftp_upload_state*) upload->data;
+    guac_common_ssh_sftp_filesystem* filesystem = upload_state->filesystem;
+
+    pthread_mutex_lock(&filesystem->lock);
+
+    /* Write entire block */
+    while (length > 0) {
+
+        ssize_t bytes_written = libssh2_sftp_write(upload_state->file,
+                buffer, length);
+
+        /* Inform of any errors */
+        if (bytes_written <= 0) {
+            upload->message = "SFTP: Write failed";
+            upload->status = GUAC_PROTOCOL_STATUS_SERVER_ERROR;
+            pthread_mutex_unlock(&filesystem->lock);
+            return 1;
+        }
+
+        buffer += bytes_written;
+        length -= bytes_written;
+
+    }
+
+    pthread_mutex_unlock(&filesystem->lock);
+    return 0;
+
+}
+
+/**
+ * Closes the file being uploaded and frees the associated
+ * guac_common_ssh_sftp_upload_state, as required by
+ * guac_common_upload_close_handler.
+ *
+ * @param upload
+ *     The upload which has finished.
+ *
+ * @return
+ *     Zero if the file was closed successfully, non-zero otherwise.
+ */
+static int guac_common_ssh_sftp_upload_close(guac_common_upload* upload) {
+
+    guac_common_ssh_sftp_upload_state* upload_state =
+        (guac_common_ssh_sftp_upload_state*) upload->data;
+    guac_common_ssh_sftp_filesystem* filesystem = upload_state->filesystem;
+    guac_client* client = upload->client;
+    int result = 0;
+
+    /* Attempt to close file */
+    pthread_mutex_lock(&filesystem->lock);
+    if (libssh2_sftp_close(upload_state->file) == 0)
+        guac_client_log(client, GUAC_LOG_DEBUG, "File closed");
+    else {
+        guac_client_log(client, GUAC_LOG_INFO, "Unable to close file");
+        upload->message = "SFTP: Close failed";
+        upload->status = GUAC_PROTOCOL_STATUS_SERVER_ERROR;
+        result = 1;
+    }
+    pthread_mutex_unlock(&filesystem->lock);
+
+    guac_mem_free(upload_state);
+    return result;
+
+}
+
 /**
  * Handler for blob messages which continue an inbound SFTP data transfer
  * (upload). The data associated with the given stream is expected to be a
- * pointer to an open LIBSSH2_SFTP_HANDLE for the file to which the data
- * should be written.
+ * pointer to the guac_common_ssh_sftp_upload_state of the upload. Received
+ * data is written to the file in the background.
  *
  * @param user
  *     The user receiving the blob message.
@@ -308,25 +394,11 @@ static int guac_ssh_append_path(char* fullpath, const char* path_a,
 static int guac_common_ssh_sftp_blob_handler(guac_user* user,
         guac_stream* stream, void* data, int length) {
 
-    /* Pull file from stream */
-    LIBSSH2_SFTP_HANDLE* file = (LIBSSH2_SFTP_HANDLE*) stream->data;
-
-    /* Attempt write */
-    if (libssh2_sftp_write(file, data, length) == length) {
-        guac_user_log(user, GUAC_LOG_DEBUG, "%i bytes written", length);
-        guac_protocol_send_ack(user->socket, stream, "SFTP: OK",
-                GUAC_PROTOCOL_STATUS_SUCCESS);
-        guac_socket_flush(user->socket);
-    }
-
-    /* Inform of any errors */
-    else {
-        guac_user_log(user, GUAC_LOG_INFO, "Unable to write to file");
-        guac_protocol_send_ack(user->socket, stream, "SFTP: Write failed",
-                GUAC_PROTOCOL_STATUS_SERVER_ERROR);
-        guac_socket_flush(user->socket);
-    }
+    guac_common_ssh_sftp_upload_state* upload_state =
+        (guac_common_ssh_sftp_upload_state*) stream->data;
 
+    /* Buffer block for writing, acknowledging as space allows */
+    guac_common_upload_write(upload_state->upload, data, length);
     return 0;
 
 }
@@ -334,8 +406,8 @@ static int guac_common_ssh_sftp_blob_handler(guac_user* user,
 /**
  * Handler for end messages which terminate an inbound SFTP data transfer
  * (upload). The data associated with the given stream is expected to be a
- * pointer to an open LIBSSH2_SFTP_HANDLE for the file to which the data
- * has been written and which should now be closed.
+ * pointer to the guac_common_ssh_sftp_upload_state of the upload, whose file
+ * is closed once all received data has been written.
  *
  * @param user
  *     The user receiving the end message.
@@ -349,24 +421,67 @@ static int guac_common_ssh_sftp_blob_handler(guac_user* user,
 static int guac_common_ssh_sftp_end_handler(guac_user* user,
         guac_stream* stream) {
 
-    /* Pull file from stream */
-    LIBSSH2_SFTP_HANDLE* file = (LIBSSH2_SFTP_HANDLE*) stream->data;
+    guac_common_ssh_sftp_upload_state* upload_state =
+        (guac_common_ssh_sftp_upload_state*) stream->data;
 
-    /* Attempt to close file */
-    if (libssh2_sftp_close(file) == 0) {
-        guac_user_log(user, GUAC_LOG_DEBUG, "File closed");
-        guac_protocol_send_ack(user->socket, stream, "SFTP: OK",
-                GUAC_PROTOCOL_STATUS_SUCCESS);
-        guac_socket_flush(user->socket);
-    }
-    else {
-        guac_user_log(user, GUAC_LOG_INFO, "Unable to close file");
-        guac_protocol_send_ack(user->socket, stream, "SFTP: Close failed",
+    /* Finish writing, close file, and acknowledge end of stream (this also
+     * frees upload_state) */
+    guac_common_upload_end(upload_state->upload);
+    return 0;
+
+}
+
+/**
+ * Begins receiving data for the given upload stream, writing that data to the
+ * given open file in the background, and acknowledges the stream.
+ *
+ * @param filesystem
+ *     The SFTP filesystem receiving the file.
+ *
+ * @param user
+ *     The user sending the upload.
+ *
+ * @param stream
+ *     The stream along which the upload will be received.
+ *
+ * @param file
+ *     The open destination file.
+ */
+static void guac_common_ssh_sftp_upload_begin(
+        guac_common_ssh_sftp_filesystem* filesystem, guac_user* user,
+        guac_stream* stream, LIBSSH2_SFTP_HANDLE* file) {
+
+    guac_common_ssh_sftp_upload_state* upload_state =
+        guac_mem_alloc(sizeof(guac_common_ssh_sftp_upload_state));
+
+    upload_state->filesystem = filesystem;
+    upload_state->file = file;
+
+    /* Start writing received data in the background */
+    upload_state->upload = guac_common_upload_alloc(filesystem->uploads,
+            user, stream,
+            guac_common_ssh_sftp_upload_write,
+            guac_common_ssh_sftp_upload_close, upload_state);
+
+    if (upload_state->upload == NULL) {
+        pthread_mutex_lock(&filesystem->lock);
+        libssh2_sftp_close(file);
+        pthread_mutex_unlock(&filesystem->lock);
+        guac_mem_free(upload_state);
+        guac_protocol_send_ack(user->socket, stream, "SFTP: Open failed",
                 GUAC_PROTOCOL_STATUS_SERVER_ERROR);
         guac_socket_flush(user->socket);
+        return;
     }
 
-    return 0;
+    /* Set handlers for file stream */
+    stream->blob_handler = guac_common_ssh_sftp_blob_handler;
+    stream->end_handler = guac_common_ssh_sftp_end_handler;
+    stream->data = upload_state;
+
+    guac_protocol_send_ack(user->socket, stream, "SFTP: File opened",
+            GUAC_PROTOCOL_STATUS_SUCCESS);
+    guac_socket_flush(user->socket);
 
 }
 
@@ -407,44 +522,250 @@ int guac_common_ssh_sftp_handle_file_stream(
     }
 
     /* Open file via SFTP */
+    pthread_mutex_lock(&filesystem->lock);
     file = libssh2_sftp_open(filesystem->sftp_session, fullpath,
             LIBSSH2_FXF_WRITE | LIBSSH2_FXF_CREAT | LIBSSH2_FXF_TRUNC,
             S_IRUSR | S_IWUSR);
 
-    /* Inform of status */
-    if (file != NULL) {
-
-        guac_user_log(user, GUAC_LOG_DEBUG,
-                "File \"%s\" opened",
-                fullpath);
-
-        guac_protocol_send_ack(user->socket, stream, "SFTP: File opened",
-                GUAC_PROTOCOL_STATUS_SUCCESS);
-        guac_socket_flush(user->socket);
-    }
-    else {
+    /* Inform of failure */
+    if (file == NULL) {
+        guac_protocol_status status = guac_sftp_get_status(filesystem);
+        pthread_mutex_unlock(&filesystem->lock);
         guac_user_log(user, GUAC_LOG_INFO,
                 "Unable to open file \"%s\"", fullpath);
         guac_protocol_send_ack(user->socket, stream, "SFTP: Open failed",
-                guac_sftp_get_status(filesystem));
+                status);
         guac_socket_flush(user->socket);
+        return 0;
     }
 
-    /* Set handlers for file stream */
-    stream->blob_handler = guac_common_ssh_sftp_blob_handler;
-    stream->end_handler = guac_common_ssh_sftp_end_handler;
+    pthread_mutex_unlock(&filesystem->lock);
+
+    guac_user_log(user, GUAC_LOG_DEBUG,
+            "File \"%s\" opened",
+            fullpath);
 
-    /* Store file within stream */
-    stream->data = file;
+    /* Begin writing received data to file */
+    guac_common_ssh_sftp_upload_begin(filesystem, user, stream, file);
     return 0;
 
 }
 
+/**
+ * Reads the file of the given download into its read-ahead buffer until the
+ * end of the file is reached, an error occurs, or the download is freed.
+ * Reads are issued as soon as buffer space allows, independent of the pace
+ * at which blobs are acknowledged, such that several SFTP read requests are
+ * typically outstanding at any one time.
+ *
+ * @param data
+ *     The guac_common_ssh_sftp_download_state of the download.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_common_ssh_sftp_download_reader(void* data) {
+
+    guac_common_ssh_sftp_download_state* download_state =
+        (guac_common_ssh_sftp_download_state*) data;
+    guac_common_ssh_sftp_filesystem* filesystem = download_state->filesystem;
+
+    pthread_mutex_lock(&download_state->lock);
+    while (!download_state->stopping) {
+
+        int available = GUAC_COMMON_SSH_SFTP_READ_AHEAD_SIZE
+                      - download_state->length;
+
+        /* Wait until a reasonably-sized read can be issued */
+        if (available < GUAC_COMMON_SSH_SFTP_READ_SIZE / 4) {
+            pthread_cond_wait(&download_state->modified, &download_state->lock);
+            continue;
+        }
+
+        /* Read into contiguous free space following buffered data, which
+         * the user will not touch until that data is added */
+        int end = (download_state->start + download_state->length)
+                % GUAC_COMMON_SSH_SFTP_READ_AHEAD_SIZE;
+
+        int length = GUAC_COMMON_SSH_SFTP_READ_AHEAD_SIZE - end;
+        if (length > available)
+            length = available;
+        if (length > GUAC_COMMON_SSH_SFTP_READ_SIZE)
+            length = GUAC_COMMON_SSH_SFTP_READ_SIZE;
+
+        pthread_mutex_unlock(&download_state->lock);
+
+        pthread_mutex_lock(&filesystem->lock);
+        ssize_t bytes_read = libssh2_sftp_read(download_state->file,
+                download_state->buffer + end, length);
+        pthread_mutex_unlock(&filesystem->lock);
+
+        pthread_mutex_lock(&download_state->lock);
+
+        /* Stop reading upon EOF or error */
+        if (bytes_read <= 0) {
+            download_state->eof = 1;
+            download_state->error = (bytes_read < 0);
+            pthread_cond_broadcast(&download_state->modified);
+            break;
+        }
+
+        download_state->length += bytes_read;
+        pthread_cond_broadcast(&download_state->modified);
+
+    }
+    pthread_mutex_unlock(&download_state->lock);
+
+    return NULL;
+
+}
+
+/**
+ * Allocates a new guac_common_ssh_sftp_download_state for the download of
+ * the given open file, starting the thread which reads that file ahead of
+ * the data sent to the user.
+ *
+ * The new download is added to the list of downloads of the filesystem, such
+ * that it can be aborted if the user leaves.
+ *
+ * @param filesystem
+ *     The SFTP filesystem containing the file.
+ *
+ * @param user
+ *     The user receiving the download.
+ *
+ * @param file
+ *     The open file being downloaded.
+ *
+ * @return
+ *     A newly-allocated guac_common_ssh_sftp_download_state, which must
+ *     eventually be freed with guac_common_ssh_sftp_download_state_free().
+ */
+static guac_common_ssh_sftp_download_state* guac_common_ssh_sftp_download_state_alloc(
+        guac_common_ssh_sftp_filesystem* filesystem, guac_user* user,
+        LIBSSH2_SFTP_HANDLE* file) {
+
+    guac_common_ssh_sftp_download_state* download_state =
+        guac_mem_zalloc(sizeof(guac_common_ssh_sftp_download_state));
+
+    download_state->filesystem = filesystem;
+    download_state->user = user;
+    download_state->file = file;
+    download_state->buffer = guac_mem_alloc(GUAC_COMMON_SSH_SFTP_READ_AHEAD_SIZE);
+    guac_common_transfer_init(&download_state->transfer, 0, 0);
+
+    pthread_mutex_init(&download_state->lock, NULL);
+    pthread_cond_init(&download_state->modified, NULL);
+
+    /* Fail the download as a read error if no reader can be started */
+    if (pthread_create(&download_state->reader_thread, NULL,
+                guac_common_ssh_sftp_download_reader, download_state)) {
+        download_state->eof = 1;
+        download_state->error = 1;
+        download_state->stopping = 1;
+    }
+
+    /* Track download such that it can be aborted if never completed */
+    pthread_mutex_lock(&filesystem->lock);
+    download_state->next = filesystem->downloads;
+    filesystem->downloads = download_state;
+    pthread_mutex_unlock(&filesystem->lock);
+
+    return download_state;
+
+}
+
+/**
+ * Stops the reader thread of the given download, closes the file associated
+ * with the download, removes the download from the list of downloads of its
+ * filesystem (if still present), and frees the download state.
+ *
+ * @param download_state
+ *     The state of the download to free.
+ */
+static void guac_common_ssh_sftp_download_state_free(
+        guac_common_ssh_sftp_download_state* download_state) {
+
+    guac_common_ssh_sftp_filesystem* filesystem = download_state->filesystem;
+    guac_client* client = filesystem->ssh_session->client;
+
+    /* Stop tracking download */
+    pthread_mutex_lock(&filesystem->lock);
+    guac_common_ssh_sftp_download_state** current = &filesystem->downloads;
+    while (*current != NULL) {
+        if (*current == download_state) {
+            *current = download_state->next;
+            break;
+        }
+        current = &(*current)->next;
+    }
+    pthread_mutex_unlock(&filesystem->lock);
+
+    /* Stop reader thread, if it was started */
+    pthread_mutex_lock(&download_state->lock);
+    int started = !download_state->stopping;
+    download_state->stopping = 1;
+    pthread_cond_broadcast(&download_state->modified);
+    pthread_mutex_unlock(&download_state->lock);
+
+    if (started)
+        pthread_join(download_state->reader_thread, NULL);
+
+    /* Close file */
+    pthread_mutex_lock(&filesystem->lock);
+    if (libssh2_sftp_close(download_state->file) == 0)
+        guac_client_log(client, GUAC_LOG_DEBUG, "File closed");
+    else
+        guac_client_log(client, GUAC_LOG_INFO, "Unable to close file");
+    pthread_mutex_unlock(&filesystem->lock);
+
+    pthread_cond_destroy(&download_state->modified);
+    pthread_mutex_destroy(&download_state->lock);
+    guac_mem_free(download_state->buffer);
+    guac_mem_free(download_state);
+
+}
+
+void guac_common_ssh_sftp_abort_downloads(
+        guac_common_ssh_sftp_filesystem* filesystem, guac_user* user) {
+
+    guac_common_ssh_sftp_download_state* aborted = NULL;
+
+    /* Take all matching downloads from the list */
+    pthread_mutex_lock(&filesystem->lock);
+    guac_common_ssh_sftp_download_state** current = &filesystem->downloads;
+    while (*current != NULL) {
+
+        guac_common_ssh_sftp_download_state* download_state = *current;
+
+        if (user == NULL || download_state->user == user) {
+            *current = download_state->next;
+            download_state->next = aborted;
+            aborted = download_state;
+        }
+        else
+            current = &download_state->next;
+
+    }
+    pthread_mutex_unlock(&filesystem->lock);
+
+    /* Stop reading and close each file */
+    while (aborted != NULL) {
+        guac_common_ssh_sftp_download_state* next = aborted->next;
+        guac_common_ssh_sftp_download_state_free(aborted);
+        aborted = next;
+    }
+
+}
+
 /**
  * Handler for ack messages which continue an outbound SFTP data transfer
  * (download), signaling the current status and requesting additional data.
- * The data associated with the given stream is expected to be a pointer to an
- * open LIBSSH2_SFTP_HANDLE for the file from which the data is to be read.
+ * The data associated with the given stream is expected to be a pointer to a
+ * guac_common_ssh_sftp_download_state for the file from which the data is to
+ * be read. As many blobs of already-read data are sent as the transfer window
+ * allows. This handler waits for the reader thread only if no blobs would
+ * otherwise remain in flight.
  *
  * @param user
  *     The user receiving the ack message.
@@ -466,58 +787,93 @@ int guac_common_ssh_sftp_handle_file_stream(
 static int guac_common_ssh_sftp_ack_handler(guac_user* user,
         guac_stream* stream, char* message, guac_protocol_status status) {
 
-    /* Pull file from stream */
-    LIBSSH2_SFTP_HANDLE* file = (LIBSSH2_SFTP_HANDLE*) stream->data;
+    /* Pull download state from stream */
+    guac_common_ssh_sftp_download_state* download_state =
+        (guac_common_ssh_sftp_download_state*) stream->data;
+    guac_common_transfer* transfer = &download_state->transfer;
 
-    /* If successful, read data */
+    /* If successful, send data */
     if (status == GUAC_PROTOCOL_STATUS_SUCCESS) {
 
-        /* Attempt read into buffer */
-        char buffer[4096];
-        int bytes_read = libssh2_sftp_read(file, buffer, sizeof(buffer)); 
+        guac_common_transfer_acked(transfer);
 
-        /* If bytes read, send as blob */
-        if (bytes_read > 0) {
-            guac_protocol_send_blob(user->socket, stream,
-                    buffer, bytes_read);
+        /* Keep as many blobs in flight as the transfer window allows */
+        char buffer[GUAC_PROTOCOL_BLOB_MAX_LENGTH];
+        while (guac_common_transfer_available(transfer) > 0) {
 
-            guac_user_log(user, GUAC_LOG_DEBUG, "%i bytes sent to user",
-                    bytes_read);
+            pthread_mutex_lock(&download_state->lock);
 
-        }
+            /* Wait for data only if the stream would otherwise stall */
+            while (download_state->length == 0 && !download_state->eof
+                    && transfer->in_flight == 0)
+                pthread_cond_wait(&download_state->modified,
+                        &download_state->lock);
+
+            /* Take as much buffered data as fits in a blob */
+            int length = download_state->length;
+            if (length > transfer->chunk_size)
+                length = transfer->chunk_size;
+            if (length > GUAC_COMMON_SSH_SFTP_READ_AHEAD_SIZE
+                    - download_state->start)
+                length = GUAC_COMMON_SSH_SFTP_READ_AHEAD_SIZE
+                    - download_state->start;
+
+            memcpy(buffer, download_state->buffer + download_state->start,
+                    length);
+
+            download_state->start = (download_state->start + length)
+                    % GUAC_COMMON_SSH_SFTP_READ_AHEAD_SIZE;
+            download_state->length -= length;
 
-        /* If bytes could not be read, handle EOF or error condition */
-        else {
+            int eof = download_state->eof && download_state->length == 0;
+            int error = download_state->error;
 
-            /* If EOF, send end */
-            if (bytes_read == 0) {
-                guac_user_log(user, GUAC_LOG_DEBUG, "File sent");
-                guac_protocol_send_end(user->socket, stream);
-                guac_user_free_stream(user, stream);
+            if (length > 0)
+                pthread_cond_broadcast(&download_state->modified);
+
+            pthread_mutex_unlock(&download_state->lock);
+
+            /* If bytes read, send as blob */
+            if (length > 0) {
+                guac_protocol_send_blob(user->socket, stream,
+                        buffer, length);
+                guac_common_transfer_sent(transfer);
             }
 
-            /* Otherwise, fail stream */
-            else {
-                guac_user_log(user, GUAC_LOG_INFO, "Error reading file");
-                guac_protocol_send_end(user->socket, stream);
-                guac_user_free_stream(user, stream);
+            /* Stop sending upon EOF or error */
+            else if (eof) {
+
+                if (!error)
+                    guac_user_log(user, GUAC_LOG_DEBUG, "File sent");
+                else
+                    guac_user_log(user, GUAC_LOG_INFO, "Error reading file");
+
+                transfer->eof = 1;
+
             }
 
-            /* Close file */
-            if (libssh2_sftp_close(file) == 0)
-                guac_user_log(user, GUAC_LOG_DEBUG, "File closed");
+            /* Otherwise, await further acks (more data is being read) */
             else
-                guac_user_log(user, GUAC_LOG_INFO, "Unable to close file");
+                break;
+
+        }
 
+        /* Send end once all blobs have been acknowledged */
+        if (guac_common_transfer_complete(transfer)) {
+            guac_protocol_send_end(user->socket, stream);
+            guac_user_free_stream(user, stream);
+            guac_common_ssh_sftp_download_state_free(download_state);
         }
 
         guac_socket_flush(user->socket);
 
     }
 
-    /* Otherwise, return stream to user */
-    else
+    /* Otherwise, abort transfer and return stream to user */
+    else {
+        guac_common_ssh_sftp_download_state_free(download_state);
         guac_user_free_stream(user, stream);
+    }
 
     return 0;
 }
@@ -539,8 +895,10 @@ guac_stream* guac_common_ssh_sftp_download_file(
     }
 
     /* Attempt to open file for reading */
+    pthread_mutex_lock(&filesystem->lock);
     file = libssh2_sftp_open(filesystem->sftp_session, filename,
             LIBSSH2_FXF_READ, 0);
+    pthread_mutex_unlock(&filesystem->lock);
     if (file == NULL) {
         guac_user_log(user, GUAC_LOG_INFO, 
                 "Unable to read file \"%s\"", filename);
@@ -550,7 +908,8 @@ guac_stream* guac_common_ssh_sftp_download_file(
     /* Allocate stream */
     stream = guac_user_alloc_stream(user);
     stream->ack_handler = guac_common_ssh_sftp_ack_handler;
-    stream->data = file;
+    stream->data = guac_common_ssh_sftp_download_state_alloc(filesystem,
+        user, file);
 
     /* Send stream start, strip name */
     filename = basename(filename);
@@ -585,7 +944,9 @@ void guac_common_ssh_sftp_set_upload_path(
 
 /**
  * Handler for ack messages received due to receipt of a "body" or "blob"
- * instruction associated with a SFTP directory list operation.
+ * instruction associated with a SFTP directory list operation. As many blobs
+ * of JSON are sent as the transfer window of the listing allows, with the
+ * filesystem lock held only for the duration of each SFTP request.
  *
  * @param user
  *     The user receiving the ack message.
@@ -614,6 +975,7 @@ static int guac_common_ssh_sftp_ls_ack_handler(guac_user* user,
 
     guac_common_ssh_sftp_ls_state* list_state =
         (guac_common_ssh_sftp_ls_state*) stream->data;
+    guac_common_transfer* transfer = &list_state->transfer;
 
     guac_common_ssh_sftp_filesystem* filesystem = list_state->filesystem;
 
@@ -621,26 +983,58 @@ static int guac_common_ssh_sftp_ls_ack_handler(guac_user* user,
 
     /* If unsuccessful, free stream and abort */
     if (status != GUAC_PROTOCOL_STATUS_SUCCESS) {
-        libssh2_sftp_closedir(list_state->directory);
+        if (list_state->directory != NULL) {
+            pthread_mutex_lock(&filesystem->lock);
+            libssh2_sftp_closedir(list_state->directory);
+            pthread_mutex_unlock(&filesystem->lock);
+        }
         guac_user_free_stream(user, stream);
         guac_mem_free(list_state);
         return 0;
     }
 
-    /* While directory entries remain */
-    while ((bytes_read = libssh2_sftp_readdir(list_state->directory,
-                filename, sizeof(filename), &attributes)) > 0) {
+    guac_common_transfer_acked(transfer);
+
+    /* Write entries while the transfer window allows */
+    while (guac_common_transfer_available(transfer) > 0) {
+
+        pthread_mutex_lock(&filesystem->lock);
+        bytes_read = libssh2_sftp_readdir(list_state->directory,
+                filename, sizeof(filename), &attributes);
+
+        /* Close directory once all entries have been read */
+        if (bytes_read <= 0) {
+            libssh2_sftp_closedir(list_state->directory);
+            pthread_mutex_unlock(&filesystem->lock);
+            list_state->directory = NULL;
+
+            /* Complete JSON object */
+            int blobs_written = guac_common_json_end_object(user, stream,
+                    &list_state->json_state);
+            blobs_written += guac_common_json_flush(user, stream,
+                    &list_state->json_state);
+
+            while (blobs_written-- > 0)
+                guac_common_transfer_sent(transfer);
+
+            transfer->eof = 1;
+            break;
+        }
 
         char absolute_path[GUAC_COMMON_SSH_SFTP_MAX_PATH];
 
         /* Skip current and parent directory entries */
-        if (strcmp(filename, ".") == 0 || strcmp(filename, "..") == 0)
+        if (strcmp(filename, ".") == 0 || strcmp(filename, "..") == 0) {
+            pthread_mutex_unlock(&filesystem->lock);
             continue;
+        }
 
         /* Concatenate into absolute path - skip if invalid */
         if (!guac_ssh_append_filename(absolute_path, 
                     list_state->directory_name, filename)) {
 
+            pthread_mutex_unlock(&filesystem->lock);
+
             guac_user_log(user, GUAC_LOG_DEBUG,
                     "Skipping filename \"%s\" - filename is invalid or "
                     "resulting path is too long", filename);
@@ -652,6 +1046,8 @@ static int guac_common_ssh_sftp_ls_ack_handler(guac_user* user,
         if (LIBSSH2_SFTP_S_ISLNK(attributes.permissions))
             libssh2_sftp_stat(sftp, absolute_path, &attributes);
 
+        pthread_mutex_unlock(&filesystem->lock);
+
         /* Determine mimetype */
         const char* mimetype;
         if (LIBSSH2_SFTP_S_ISDIR(attributes.permissions))
@@ -659,28 +1055,20 @@ static int guac_common_ssh_sftp_ls_ack_handler(guac_user* user,
         else
             mimetype = "application/octet-stream";
 
-        /* Write entry, waiting for next ack if a blob is written */
-        if (guac_common_json_write_property(user, stream,
-                    &list_state->json_state, absolute_path, mimetype))
-            break;
-
-    }
-
-    /* Complete JSON and cleanup at end of directory */
-    if (bytes_read <= 0) {
+        /* Write entry, counting any blobs written against the window */
+        int blobs_written = guac_common_json_write_property(user, stream,
+                &list_state->json_state, absolute_path, mimetype);
 
-        /* Complete JSON object */
-        guac_common_json_end_object(user, stream, &list_state->json_state);
-        guac_common_json_flush(user, stream, &list_state->json_state);
+        while (blobs_written-- > 0)
+            guac_common_transfer_sent(transfer);
 
-        /* Clean up resources */
-        libssh2_sftp_closedir(list_state->directory);
-        guac_mem_free(list_state);
+    }
 
-        /* Signal of stream */
+    /* Signal end of stream once all blobs have been acknowledged */
+    if (guac_common_transfer_complete(transfer)) {
         guac_protocol_send_end(user->socket, stream);
         guac_user_free_stream(user, stream);
-
+        guac_mem_free(list_state);
     }
 
     guac_socket_flush(user->socket);
@@ -756,7 +1144,11 @@ static int guac_common_ssh_sftp_get_handler(guac_user* user,
     }
 
     /* Attempt to read file information */
-    if (libssh2_sftp_stat(sftp, fullpath, &attributes)) {
+    pthread_mutex_lock(&filesystem->lock);
+    int stat_failed = libssh2_sftp_stat(sftp, fullpath, &attributes);
+    pthread_mutex_unlock(&filesystem->lock);
+
+    if (stat_failed) {
         guac_user_log(user, GUAC_LOG_INFO, "Unable to read file \"%s\"",
                 fullpath);
         return 0;
@@ -766,7 +1158,9 @@ static int guac_common_ssh_sftp_get_handler(guac_user* user,
     if (LIBSSH2_SFTP_S_ISDIR(attributes.permissions)) {
 
         /* Open as directory */
+        pthread_mutex_lock(&filesystem->lock);
         LIBSSH2_SFTP_HANDLE* dir = libssh2_sftp_opendir(sftp, fullpath);
+        pthread_mutex_unlock(&filesystem->lock);
         if (dir == NULL) {
             guac_user_log(user, GUAC_LOG_INFO,
                     "Unable to read directory \"%s\"", fullpath);
@@ -779,6 +1173,7 @@ static int guac_common_ssh_sftp_get_handler(guac_user* user,
 
         list_state->directory = dir;
         list_state->filesystem = filesystem;
+        guac_common_transfer_init(&list_state->transfer, 0, 0);
 
         int length = guac_strlcpy(list_state->directory_name, name,
                 sizeof(list_state->directory_name));
@@ -817,8 +1212,10 @@ static int guac_common_ssh_sftp_get_handler(guac_user* user,
         }
         
         /* Open as normal file */
+        pthread_mutex_lock(&filesystem->lock);
         LIBSSH2_SFTP_HANDLE* file = libssh2_sftp_open(sftp, fullpath,
             LIBSSH2_FXF_READ, 0);
+        pthread_mutex_unlock(&filesystem->lock);
         if (file == NULL) {
             guac_user_log(user, GUAC_LOG_INFO,
                     "Unable to read file \"%s\"", fullpath);
@@ -828,7 +1225,8 @@ static int guac_common_ssh_sftp_get_handler(guac_user* user,
         /* Allocate stream for body */
         guac_stream* stream = guac_user_alloc_stream(user);
         stream->ack_handler = guac_common_ssh_sftp_ack_handler;
-        stream->data = file;
+        stream->data = guac_common_ssh_sftp_download_state_alloc(filesystem,
+            user, file);
 
         /* Associate new stream with get request */
         guac_protocol_send_body(user->socket, object, stream,
@@ -894,33 +1292,28 @@ static int guac_common_ssh_sftp_put_handler(guac_user* user,
     }
 
     /* Open file via SFTP */
+    pthread_mutex_lock(&filesystem->lock);
     LIBSSH2_SFTP_HANDLE* file = libssh2_sftp_open(sftp, fullpath,
             LIBSSH2_FXF_WRITE | LIBSSH2_FXF_CREAT | LIBSSH2_FXF_TRUNC,
             S_IRUSR | S_IWUSR);
 
-    /* Acknowledge stream if successful */
-    if (file != NULL) {
-        guac_user_log(user, GUAC_LOG_DEBUG, "File \"%s\" opened", fullpath);
-        guac_protocol_send_ack(user->socket, stream, "SFTP: File opened",
-                GUAC_PROTOCOL_STATUS_SUCCESS);
-    }
-
     /* Abort on failure */
-    else {
+    if (file == NULL) {
+        guac_protocol_status status = guac_sftp_get_status(filesystem);
+        pthread_mutex_unlock(&filesystem->lock);
         guac_user_log(user, GUAC_LOG_INFO,
                 "Unable to open file \"%s\"", fullpath);
         guac_protocol_send_ack(user->socket, stream, "SFTP: Open failed",
-                guac_sftp_get_status(filesystem));
+                status);
+        guac_socket_flush(user->socket);
+        return 0;
     }
 
-    /* Set handlers for file stream */
-    stream->blob_handler = guac_common_ssh_sftp_blob_handler;
-    stream->end_handler = guac_common_ssh_sftp_end_handler;
-
-    /* Store file within stream */
-    stream->data = file;
+    pthread_mutex_unlock(&filesystem->lock);
+    guac_user_log(user, GUAC_LOG_DEBUG, "File \"%s\" opened", fullpath);
 
-    guac_socket_flush(user->socket);
+    /* Begin writing received data to file */
+    guac_common_ssh_sftp_upload_begin(filesystem, user, stream, file);
     return 0;
 }
 
@@ -998,6 +1391,11 @@ guac_common_ssh_sftp_filesystem* guac_common_ssh_create_sftp_filesystem(
     /* Initially upload files to current directory */
     strcpy(filesystem->upload_path, ".");
 
+    /* Uploads write from their own threads, so access must be serialized */
+    pthread_mutex_init(&filesystem->lock, NULL);
+    filesystem->uploads = guac_common_upload_list_alloc();
+    filesystem->downloads = NULL;
+
     /* Return allocated filesystem */
     return filesystem;
 
@@ -1006,10 +1404,16 @@ guac_common_ssh_sftp_filesystem* guac_common_ssh_create_sftp_filesystem(
 void guac_common_ssh_destroy_sftp_filesystem(
         guac_common_ssh_sftp_filesystem* filesystem) {
 
+    /* Close any transfers still in progress while the session remains
+     * usable */
+    guac_common_upload_list_free(filesystem->uploads);
+    guac_common_ssh_sftp_abort_downloads(filesystem, NULL);
+
     /* Shutdown SFTP session */
     libssh2_sftp_shutdown(filesystem->sftp_session);
 
     /* Free associated memory */
+    pthread_mutex_destroy(&filesystem->lock);
     guac_mem_free(filesystem->name);
     guac_mem_free(filesystem);
 
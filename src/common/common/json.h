@@ -22,9 +22,24 @@
 
 #include "config.h"
 
+#include <guacamole/protocol-constants.h>
 #include <guacamole/stream.h>
 #include <guacamole/user.h>
 
+/**
+ * The number of bytes of JSON which may be batched within a
+ * guac_common_json_state before being flushed as blobs. Batching many blobs
+ * worth of JSON allows entire listings of large directories to be sent
+ * across a single round trip.
+ */
+#define GUAC_COMMON_JSON_BUFFER_SIZE 65536
+
+/**
+ * The size of each blob sent by a flush of a guac_common_json_state, in
+ * bytes, unless overridden through the blob_size member of that state.
+ */
+#define GUAC_COMMON_JSON_DEFAULT_BLOB_SIZE GUAC_PROTOCOL_BLOB_MAX_LENGTH
+
 /**
  * The current streaming state of an arbitrary JSON object, consisting of
  * any number of property name/value pairs.
@@ -34,9 +49,18 @@ typedef struct guac_common_json_state {
     /**
      * Buffer of partial JSON data. The individual blobs which make up the JSON
      * body of the object being sent over the Guacamole protocol will be
-     * built here.
+     * built here, and are sent together when the buffer fills or is
+     * explicitly flushed.
      */
-    char buffer[4096];
+    char buffer[GUAC_COMMON_JSON_BUFFER_SIZE];
+
+    /**
+     * The maximum number of bytes sent within each blob when the buffer is
+     * flushed. This is set to GUAC_COMMON_JSON_DEFAULT_BLOB_SIZE by
+     * guac_common_json_begin_object() and may be lowered afterwards, but may
+     * not exceed GUAC_PROTOCOL_BLOB_MAX_LENGTH.
+     */
+    int blob_size;
 
     /**
      * The number of bytes currently used within the JSON buffer.
@@ -53,20 +77,25 @@ typedef struct guac_common_json_state {
 
 /**
  * Given a stream, the user to which it belongs, and the current stream state
- * of a JSON object, flushes the contents of the JSON buffer to a blob
- * instruction. Note that this will flush the JSON buffer only, and will not
- * necessarily flush the underlying guac_socket of the user.
+ * of a JSON object, flushes the contents of the JSON buffer as one or more
+ * blob instructions of at most blob_size bytes each. Note that this will
+ * flush the JSON buffer only, and will not necessarily flush the underlying
+ * guac_socket of the user.
  *
  * @param user
  *     The user to which the data will be flushed.
  *
  * @param stream
- *     The stream through which the flushed data should be sent as a blob.
+ *     The stream through which the flushed data should be sent as blobs.
  *
  * @param json_state
  *     The state object whose buffer should be flushed.
+ *
+ * @return
+ *     The number of blobs written, which will be zero if the buffer was
+ *     empty.
  */
-void guac_common_json_flush(guac_user* user, guac_stream* stream,
+int guac_common_json_flush(guac_user* user, guac_stream* stream,
         guac_common_json_state* json_state);
 
 /**
@@ -92,7 +121,7 @@ void guac_common_json_flush(guac_user* user, guac_stream* stream,
  *     The number of bytes in the buffer.
  *
  * @return
- *     Non-zero if at least one blob was written, zero otherwise.
+ *     The number of blobs written, zero if no blobs were written.
  */
 int guac_common_json_write(guac_user* user, guac_stream* stream,
         guac_common_json_state* json_state, const char* buffer, int length);
@@ -101,7 +130,8 @@ int guac_common_json_write(guac_user* user, guac_stream* stream,
  * Given a stream, the user to which it belongs, and the current stream state
  * of a JSON object state, writes the given string as a proper JSON string,
  * including starting and ending quotes. The contents of the string will be
- * escaped as necessary.
+ * escaped as necessary, with runs of characters requiring no escaping
+ * copied in bulk.
  *
  * @param user
  *     The user to which the data will be flushed as necessary.
@@ -118,7 +148,7 @@ int guac_common_json_write(guac_user* user, guac_stream* stream,
  *     The string to write.
  *
  * @return
- *     Non-zero if at least one blob was written, zero otherwise.
+ *     The number of blobs written, zero if no blobs were written.
  */
 int guac_common_json_write_string(guac_user* user,
         guac_stream* stream, guac_common_json_state* json_state,
@@ -147,7 +177,7 @@ int guac_common_json_write_string(guac_user* user,
  *     The value of the property to write.
  *
  * @return
- *     Non-zero if at least one blob was written, zero otherwise.
+ *     The number of blobs written, zero if no blobs were written.
  */
 int guac_common_json_write_property(guac_user* user, guac_stream* stream,
         guac_common_json_state* json_state, const char* name,
@@ -187,7 +217,7 @@ void guac_common_json_begin_object(guac_user* user, guac_stream* stream,
  *     The state object whose in-progress JSON object should be terminated.
  *
  * @return
- *     Non-zero if at least one blob was written, zero otherwise.
+ *     The number of blobs written, zero if no blobs were written.
  */
 int guac_common_json_end_object(guac_user* user, guac_stream* stream,
         guac_common_json_state* json_state);
@@ -28,9 +28,88 @@
 #include <guacamole/layer.h>
 #include <guacamole/protocol.h>
 #include <guacamole/socket.h>
+#include <guacamole/timestamp.h>
 
 #include <pthread.h>
 
+/**
+ * The functions through which a surface streams rapidly-changing regions as
+ * video. Video encoding is provided separately from the rest of
+ * libguac_common, such that only protocols which stream video depend on the
+ * libraries required to encode it. The only such encoder is
+ * guac_common_video_encoder, declared within common/video.h.
+ */
+typedef struct guac_common_surface_video_encoder {
+
+    /**
+     * Returns whether all users of the given client can play video produced
+     * by this encoder.
+     *
+     * @param client
+     *     The client to check.
+     *
+     * @return
+     *     Non-zero if every connected user can play the video, zero
+     *     otherwise.
+     */
+    int (*supported)(guac_client* client);
+
+    /**
+     * Begins streaming the given region of a surface as video. The width and
+     * height of the region will always be even.
+     *
+     * @param client
+     *     The client associated with the surface being streamed.
+     *
+     * @param socket
+     *     The socket over which the video should be sent.
+     *
+     * @param parent
+     *     The layer of the surface being streamed.
+     *
+     * @param rect
+     *     The region of the surface to stream.
+     *
+     * @return
+     *     A newly-allocated video, or NULL if the video could not be started.
+     */
+    struct guac_common_video* (*alloc)(guac_client* client,
+            guac_socket* socket, const guac_layer* parent,
+            const guac_common_rect* rect);
+
+    /**
+     * Encodes and sends a new frame of the given video.
+     *
+     * @param video
+     *     The video to which the frame should be written.
+     *
+     * @param buffer
+     *     The 32-bit RGB image data of the frame, pointing to the upper-left
+     *     corner of the streamed region.
+     *
+     * @param stride
+     *     The number of bytes in each row of the image data.
+     *
+     * @param timestamp
+     *     The time at which the frame should be presented.
+     *
+     * @return
+     *     Zero if the frame was encoded successfully, non-zero otherwise.
+     */
+    int (*write_frame)(struct guac_common_video* video,
+            const unsigned char* buffer, int stride,
+            guac_timestamp timestamp);
+
+    /**
+     * Ends the given video, freeing all associated resources.
+     *
+     * @param video
+     *     The video to free.
+     */
+    void (*free)(struct guac_common_video* video);
+
+} guac_common_surface_video_encoder;
+
 /**
  * The maximum number of updates to allow within the bitmap queue.
  */
@@ -133,6 +212,43 @@ typedef struct guac_common_surface {
      */
     int lossless;
 
+    /**
+     * The encoder used to stream rapidly-changing regions of this surface as
+     * video, or NULL if this surface should never be streamed as video.
+     * Video is only streamed to users which can play the resulting video.
+     */
+    const guac_common_surface_video_encoder* video_encoder;
+
+    /**
+     * The video streaming a region of this surface, if any, as returned by
+     * the alloc function of video_encoder. If no region is being streamed,
+     * this will be NULL.
+     */
+    struct guac_common_video* video;
+
+    /**
+     * The region of this surface currently being streamed as video. This
+     * value is meaningful only if video is non-NULL.
+     */
+    guac_common_rect video_rect;
+
+    /**
+     * The timestamp of the last frame written to the video, if any.
+     */
+    guac_timestamp video_last_frame;
+
+    /**
+     * The region of this surface which has been repeatedly updated at a
+     * high framerate and may soon be streamed as video.
+     */
+    guac_common_rect video_candidate;
+
+    /**
+     * The number of consecutive flushes which have updated the video
+     * candidate region at a high framerate.
+     */
+    int video_candidate_frames;
+
     /**
      * The X coordinate of the upper-left corner of this layer, in pixels,
      * relative to its parent layer. This is only applicable to visible
@@ -535,5 +651,21 @@ void guac_common_surface_set_multitouch(guac_common_surface* surface,
 void guac_common_surface_set_lossless(guac_common_surface* surface,
         int lossless);
 
+/**
+ * Sets whether rapidly-changing regions of the given surface may be streamed
+ * to connected users as video rather than as a series of images, and the
+ * encoder used to produce that video. By default, video streaming is
+ * disabled.
+ *
+ * @param surface
+ *     The surface to modify.
+ *
+ * @param encoder
+ *     The encoder to use to stream rapidly-changing regions of this surface
+ *     as video, or NULL if video streaming should be disabled.
+ */
+void guac_common_surface_set_video(guac_common_surface* surface,
+        const guac_common_surface_video_encoder* encoder);
+
 #endif
 
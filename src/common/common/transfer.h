@@ -0,0 +1,188 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef GUAC_COMMON_TRANSFER_H
+#define GUAC_COMMON_TRANSFER_H
+
+#include "config.h"
+
+#include <guacamole/protocol-constants.h>
+#include <guacamole/timestamp.h>
+
+/**
+ * The number of blobs which may be in flight (sent but not yet acknowledged)
+ * when a file transfer begins.
+ */
+#define GUAC_COMMON_TRANSFER_INITIAL_WINDOW 4
+
+/**
+ * The default maximum number of blobs which may be in flight at any one time.
+ * At the default chunk size, this is a little under 384 KB.
+ */
+#define GUAC_COMMON_TRANSFER_DEFAULT_MAX_WINDOW 64
+
+/**
+ * The largest maximum window that may be requested via
+ * guac_common_transfer_init(), in blobs.
+ */
+#define GUAC_COMMON_TRANSFER_MAX_WINDOW 256
+
+/**
+ * The default number of bytes of file data to send in each blob. This is the
+ * largest blob that may be sent within a single Guacamole instruction.
+ */
+#define GUAC_COMMON_TRANSFER_DEFAULT_CHUNK_SIZE GUAC_PROTOCOL_BLOB_MAX_LENGTH
+
+/**
+ * The amount of additional delay, in milliseconds, that acknowledgements may
+ * experience beyond the lowest round trip time observed before the transfer
+ * window stops growing and begins to shrink. Delay beyond the lowest observed
+ * round trip time is an indication that blobs are queueing somewhere between
+ * guacd and the client, and that sending more blobs at once would only add
+ * latency to the connection.
+ */
+#define GUAC_COMMON_TRANSFER_TARGET_DELAY 100
+
+/**
+ * The state of the sliding window of an outbound file transfer. Rather than
+ * sending exactly one blob per "ack" received, which limits throughput to a
+ * single blob per round trip, several blobs are kept in flight. The number of
+ * blobs in flight grows while acknowledgements arrive promptly and shrinks
+ * when acknowledgements are delayed.
+ *
+ * The first "ack" received for an outbound stream acknowledges the stream
+ * itself, not a blob, and is recognized as such because no blobs are yet in
+ * flight.
+ */
+typedef struct guac_common_transfer {
+
+    /**
+     * The number of bytes of file data to send in each blob.
+     */
+    int chunk_size;
+
+    /**
+     * The maximum number of blobs which may be in flight at any one time.
+     */
+    int max_window;
+
+    /**
+     * The number of blobs which may currently be in flight.
+     */
+    int window;
+
+    /**
+     * The number of blobs which have been sent but not yet acknowledged.
+     */
+    int in_flight;
+
+    /**
+     * The times that each blob currently in flight was sent, as a ring
+     * buffer in the order the blobs were sent.
+     */
+    guac_timestamp sent[GUAC_COMMON_TRANSFER_MAX_WINDOW];
+
+    /**
+     * The index within the sent ring of the oldest blob in flight.
+     */
+    int oldest;
+
+    /**
+     * The lowest round trip time observed for any blob, in milliseconds, or
+     * -1 if no blob has yet been acknowledged.
+     */
+    int min_rtt;
+
+    /**
+     * Whether the end of the file has been reached, such that no further
+     * blobs will be sent.
+     */
+    int eof;
+
+} guac_common_transfer;
+
+/**
+ * Initializes the given transfer window for a new outbound file transfer.
+ *
+ * @param transfer
+ *     The transfer window to initialize.
+ *
+ * @param max_window
+ *     The maximum number of blobs which may be in flight at any one time, or
+ *     zero to use GUAC_COMMON_TRANSFER_DEFAULT_MAX_WINDOW. Values greater
+ *     than GUAC_COMMON_TRANSFER_MAX_WINDOW are reduced to that value.
+ *
+ * @param chunk_size
+ *     The number of bytes of file data to send in each blob, or zero to use
+ *     GUAC_COMMON_TRANSFER_DEFAULT_CHUNK_SIZE. Values greater than
+ *     GUAC_PROTOCOL_BLOB_MAX_LENGTH are reduced to that value.
+ */
+void guac_common_transfer_init(guac_common_transfer* transfer,
+        int max_window, int chunk_size);
+
+/**
+ * Returns the number of blobs which may be sent immediately without
+ * exceeding the current transfer window. If the end of the file has been
+ * reached, this is always zero.
+ *
+ * @param transfer
+ *     The transfer window to test.
+ *
+ * @return
+ *     The number of blobs which may be sent immediately.
+ */
+int guac_common_transfer_available(guac_common_transfer* transfer);
+
+/**
+ * Records that a blob has just been sent.
+ *
+ * @param transfer
+ *     The transfer window to update.
+ */
+void guac_common_transfer_sent(guac_common_transfer* transfer);
+
+/**
+ * Records that a successful "ack" has just been received, adjusting the
+ * transfer window according to how long that blob was in flight. If no blobs
+ * are in flight, the "ack" is assumed to acknowledge the stream itself and
+ * the window is left untouched.
+ *
+ * @param transfer
+ *     The transfer window to update.
+ */
+void guac_common_transfer_acked(guac_common_transfer* transfer);
+
+/**
+ * Returns whether the transfer is complete, such that the end of the file
+ * has been reached and every blob sent has been acknowledged. The stream may
+ * only be safely ended and freed once this is the case, as any "ack" still
+ * in flight would otherwise be received for a stream which no longer exists
+ * (or which has since been reused).
+ *
+ * @param transfer
+ *     The transfer window to test.
+ *
+ * @return
+ *     Non-zero if the transfer is complete, zero otherwise.
+ */
+int guac_common_transfer_complete(guac_common_transfer* transfer);
+
+#endif
+
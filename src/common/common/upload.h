@@ -0,0 +1,337 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef GUAC_COMMON_UPLOAD_H
+#define GUAC_COMMON_UPLOAD_H
+
+#include "config.h"
+
+#include <guacamole/client.h>
+#include <guacamole/protocol-types.h>
+#include <guacamole/stream.h>
+#include <guacamole/user.h>
+
+#include <pthread.h>
+#include <stdint.h>
+
+/**
+ * The number of bytes of received file data which may be buffered for each
+ * upload while awaiting writing.
+ */
+#define GUAC_COMMON_UPLOAD_BUFFER_SIZE 1048576
+
+/**
+ * The maximum number of bytes of buffered file data passed to the write
+ * handler of an upload at once.
+ */
+#define GUAC_COMMON_UPLOAD_MAX_WRITE 65536
+
+/**
+ * The number of milliseconds that the writer thread of an upload should wait
+ * for further data before checking whether the uploading user is still
+ * connected.
+ */
+#define GUAC_COMMON_UPLOAD_IDLE_INTERVAL 1000
+
+/**
+ * An inbound file transfer (upload) whose received data is written by a
+ * dedicated writer thread, such that the user's input thread (and thus that
+ * user's mouse and keyboard events) are never blocked by file I/O.
+ *
+ * Each received blob is copied into a bounded buffer and acknowledged
+ * immediately for as long as space remains for another blob. Once the buffer
+ * is full, the "ack" is deferred and sent by the writer thread as soon as it
+ * has written enough data to make room, providing flow control.
+ */
+typedef struct guac_common_upload guac_common_upload;
+
+/**
+ * The set of all uploads which write to the same destination (such as a
+ * single filesystem), such that those uploads can be cancelled and their
+ * writer threads joined before the destination is freed.
+ */
+typedef struct guac_common_upload_list guac_common_upload_list;
+
+/**
+ * Handler which is invoked by the writer thread of an upload to write a
+ * block of received data to the destination file, in the order received.
+ *
+ * @param upload
+ *     The upload receiving the data.
+ *
+ * @param buffer
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes of data to write.
+ *
+ * @return
+ *     Zero if all data was written successfully, non-zero otherwise. On
+ *     failure, the handler may set the status and message of the upload to
+ *     describe the error.
+ */
+typedef int guac_common_upload_write_handler(guac_common_upload* upload,
+        const char* buffer, int length);
+
+/**
+ * Handler which is invoked exactly once when an upload has finished, whether
+ * due to the end of the stream, due to the uploading user leaving, or due to
+ * the upload being cancelled, to close the destination file and free any
+ * associated data.
+ *
+ * @param upload
+ *     The upload which has finished.
+ *
+ * @return
+ *     Zero if the file was closed successfully, non-zero otherwise. On
+ *     failure, the handler may set the status and message of the upload to
+ *     describe the error.
+ */
+typedef int guac_common_upload_close_handler(guac_common_upload* upload);
+
+struct guac_common_upload {
+
+    /**
+     * The client associated with the connection receiving the upload.
+     */
+    guac_client* client;
+
+    /**
+     * The user sending the upload.
+     */
+    guac_user* user;
+
+    /**
+     * The stream along which the upload is being received.
+     */
+    guac_stream* stream;
+
+    /**
+     * Handler which writes received data to the destination file.
+     */
+    guac_common_upload_write_handler* write_handler;
+
+    /**
+     * Handler which closes the destination file once the upload has
+     * finished.
+     */
+    guac_common_upload_close_handler* close_handler;
+
+    /**
+     * Arbitrary data associated with the destination file, for use by the
+     * write and close handlers.
+     */
+    void* data;
+
+    /**
+     * The status code to send within the "ack" of any blob received after a
+     * write has failed, as well as the final "ack" of the stream.
+     */
+    guac_protocol_status status;
+
+    /**
+     * The human-readable message to send along with the status code of any
+     * failure "ack".
+     */
+    const char* message;
+
+    /**
+     * Lock which is acquired/released to ensure accesses to the state of the
+     * upload are atomic. This lock is bound to the modified condition.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition which is signalled whenever the state of the upload has
+     * changed.
+     */
+    pthread_cond_t modified;
+
+    /**
+     * The thread writing buffered data to the destination file.
+     */
+    pthread_t writer_thread;
+
+    /**
+     * Ring buffer of received data awaiting writing, exactly
+     * GUAC_COMMON_UPLOAD_BUFFER_SIZE bytes in size.
+     */
+    char* buffer;
+
+    /**
+     * The total number of bytes ever received. The byte at this position
+     * modulo GUAC_COMMON_UPLOAD_BUFFER_SIZE is the next to be received.
+     */
+    uint64_t head;
+
+    /**
+     * The total number of bytes ever written (or discarded due to an earlier
+     * failure). The byte at this position modulo
+     * GUAC_COMMON_UPLOAD_BUFFER_SIZE is the next to be written.
+     */
+    uint64_t tail;
+
+    /**
+     * The number of received blobs whose "ack" has not yet been sent because
+     * the buffer was full.
+     */
+    int acks_pending;
+
+    /**
+     * Whether a write has failed. Once a write has failed, all further
+     * received data is discarded and acknowledged with an error.
+     */
+    int failed;
+
+    /**
+     * Whether the stream has ended, such that no further data will be
+     * received.
+     */
+    int ended;
+
+    /**
+     * Whether the upload has been cancelled via guac_common_upload_list_free(),
+     * such that any data not yet written should be discarded.
+     */
+    int cancelled;
+
+    /**
+     * Whether the writer thread has stopped and closed the destination file
+     * without the stream having ended, due to the uploading user leaving or
+     * the upload being cancelled. An abandoned upload remains within its list
+     * until it is freed.
+     */
+    int abandoned;
+
+    /**
+     * The list containing this upload.
+     */
+    guac_common_upload_list* list;
+
+    /**
+     * The next upload within the same list, or NULL if this is the last
+     * upload in the list.
+     */
+    guac_common_upload* next;
+
+};
+
+struct guac_common_upload_list {
+
+    /**
+     * Lock which is acquired/released to ensure accesses to the list are
+     * atomic.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * The first upload within the list, or NULL if the list is empty.
+     */
+    guac_common_upload* head;
+
+};
+
+/**
+ * Allocates a new, empty list of uploads.
+ *
+ * @return
+ *     A newly-allocated, empty list of uploads.
+ */
+guac_common_upload_list* guac_common_upload_list_alloc();
+
+/**
+ * Cancels all uploads remaining within the given list, waits for their writer
+ * threads to close their destination files, and frees those uploads along
+ * with the list itself. Data which has not yet been written is discarded.
+ * This function must be invoked before freeing anything used by the write
+ * or close handlers of those uploads, and only once no user can send further
+ * blobs or end any of those uploads.
+ *
+ * @param list
+ *     The list of uploads to free.
+ */
+void guac_common_upload_list_free(guac_common_upload_list* list);
+
+/**
+ * Allocates a new upload for the given stream and starts its writer thread.
+ * The blob and end handlers of the stream must invoke
+ * guac_common_upload_write() and guac_common_upload_end() respectively. The
+ * caller is responsible for acknowledging the stream itself. Any uploads
+ * within the given list which were abandoned by their users are freed.
+ *
+ * @param list
+ *     The list to which the new upload should be added.
+ *
+ * @param user
+ *     The user sending the upload.
+ *
+ * @param stream
+ *     The stream along which the upload will be received.
+ *
+ * @param write_handler
+ *     The handler to invoke to write received data to the destination file.
+ *
+ * @param close_handler
+ *     The handler to invoke to close the destination file once the upload
+ *     has finished.
+ *
+ * @param data
+ *     Arbitrary data associated with the destination file, for use by the
+ *     write and close handlers.
+ *
+ * @return
+ *     A newly-allocated upload, or NULL if the writer thread could not be
+ *     started.
+ */
+guac_common_upload* guac_common_upload_alloc(guac_common_upload_list* list,
+        guac_user* user, guac_stream* stream,
+        guac_common_upload_write_handler* write_handler,
+        guac_common_upload_close_handler* close_handler, void* data);
+
+/**
+ * Buffers the given received blob for writing, acknowledging that blob
+ * immediately if space remains within the buffer for another blob. This
+ * function must be invoked by the blob handler of the upload's stream.
+ *
+ * @param upload
+ *     The upload receiving the blob.
+ *
+ * @param data
+ *     The data received within the blob.
+ *
+ * @param length
+ *     The number of bytes of data received.
+ */
+void guac_common_upload_write(guac_common_upload* upload, const void* data,
+        int length);
+
+/**
+ * Waits for all buffered data of the given upload to be written, closes the
+ * destination file, acknowledges the end of the stream, and removes the
+ * upload from its list and frees it. This function must be invoked by the end handler of the upload's
+ * stream. The upload MUST NOT be used after this function returns.
+ *
+ * @param upload
+ *     The upload whose stream has ended.
+ */
+void guac_common_upload_end(guac_common_upload* upload);
+
+#endif
+
@@ -0,0 +1,216 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_COMMON_VIDEO_H
+#define GUAC_COMMON_VIDEO_H
+
+#include "config.h"
+#include "common/rect.h"
+#include "common/surface.h"
+
+#include <guacamole/client.h>
+#include <guacamole/layer.h>
+#include <guacamole/socket.h>
+#include <guacamole/stream.h>
+#include <guacamole/timestamp.h>
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+
+#include <stdint.h>
+
+/**
+ * The mimetype of video streamed by guac_common_video. Video will only be
+ * streamed to users which declare support for this mimetype.
+ */
+#define GUAC_COMMON_VIDEO_MIMETYPE "video/webm"
+
+/**
+ * The number of bits per pixel per second targeted when encoding video. The
+ * overall bitrate of each video stream is this value multiplied by the area
+ * of the streamed region.
+ */
+#define GUAC_COMMON_VIDEO_BITS_PER_PIXEL 2
+
+/**
+ * The maximum number of frames between keyframes.
+ */
+#define GUAC_COMMON_VIDEO_KEYFRAME_INTERVAL 120
+
+/**
+ * The size of the buffer receiving encoded container data prior to that data
+ * being sent as blobs, in bytes.
+ */
+#define GUAC_COMMON_VIDEO_IO_BUFFER_SIZE 65536
+
+/**
+ * A region of a surface which is being streamed to all connected users as
+ * VP8 video within a WebM container. The video is played within its own
+ * layer, which is positioned over the streamed region of the surface.
+ */
+typedef struct guac_common_video {
+
+    /**
+     * The client associated with the surface being streamed.
+     */
+    guac_client* client;
+
+    /**
+     * The socket over which the video stream and its layer are sent.
+     */
+    guac_socket* socket;
+
+    /**
+     * The layer within which the video is played.
+     */
+    guac_layer* layer;
+
+    /**
+     * The stream carrying encoded video data.
+     */
+    guac_stream* stream;
+
+    /**
+     * The region of the parent surface being streamed.
+     */
+    guac_common_rect rect;
+
+    /**
+     * The VP8 encoder.
+     */
+    AVCodecContext* context;
+
+    /**
+     * The WebM muxer, which writes its output through a custom AVIOContext
+     * to the video stream.
+     */
+    AVFormatContext* format_context;
+
+    /**
+     * The sole stream within the WebM container.
+     */
+    AVStream* output_stream;
+
+    /**
+     * The YUV frame which receives each converted image prior to encoding.
+     */
+    AVFrame* frame;
+
+    /**
+     * Packet which receives each encoded frame.
+     */
+    AVPacket* packet;
+
+    /**
+     * Context for converting 32-bit RGB surface data to YUV.
+     */
+    struct SwsContext* sws;
+
+    /**
+     * The timestamp of the first frame of the video.
+     */
+    guac_timestamp start;
+
+    /**
+     * The presentation timestamp of the most recently encoded frame, in
+     * milliseconds relative to start, or -1 if no frames have been encoded.
+     */
+    int64_t last_pts;
+
+} guac_common_video;
+
+/**
+ * Returns whether all users of the given client can play video streamed by
+ * guac_common_video.
+ *
+ * @param client
+ *     The client to check.
+ *
+ * @return
+ *     Non-zero if every connected user supports GUAC_COMMON_VIDEO_MIMETYPE,
+ *     zero otherwise.
+ */
+int guac_common_video_supported(guac_client* client);
+
+/**
+ * Begins streaming the given region of a surface as video, allocating a new
+ * layer over that region and a new stream carrying the encoded video. The
+ * width and height of the region must be even.
+ *
+ * @param client
+ *     The client associated with the surface being streamed.
+ *
+ * @param socket
+ *     The socket over which the video stream and its layer should be sent.
+ *
+ * @param parent
+ *     The layer of the surface being streamed.
+ *
+ * @param rect
+ *     The region of the surface to stream.
+ *
+ * @return
+ *     A newly-allocated guac_common_video, or NULL if the video encoder could
+ *     not be initialized.
+ */
+guac_common_video* guac_common_video_alloc(guac_client* client,
+        guac_socket* socket, const guac_layer* parent,
+        const guac_common_rect* rect);
+
+/**
+ * Encodes and sends a new frame of the given video.
+ *
+ * @param video
+ *     The video to which the frame should be written.
+ *
+ * @param buffer
+ *     The 32-bit RGB image data of the frame, pointing to the upper-left
+ *     corner of the streamed region.
+ *
+ * @param stride
+ *     The number of bytes in each row of the image data.
+ *
+ * @param timestamp
+ *     The time at which the frame should be presented.
+ *
+ * @return
+ *     Zero if the frame was encoded successfully, non-zero otherwise.
+ */
+int guac_common_video_write_frame(guac_common_video* video,
+        const unsigned char* buffer, int stride, guac_timestamp timestamp);
+
+/**
+ * Ends the given video, disposing of its layer and stream, and freeing all
+ * associated resources.
+ *
+ * @param video
+ *     The video to free.
+ */
+void guac_common_video_free(guac_common_video* video);
+
+/**
+ * Encoder which allows a guac_common_surface to stream rapidly-changing
+ * regions as VP8 video using the functions above. Video streaming is enabled
+ * for a surface by passing this encoder to guac_common_surface_set_video().
+ */
+extern const guac_common_surface_video_encoder guac_common_video_encoder;
+
+#endif
+
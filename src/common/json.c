@@ -22,6 +22,7 @@
 #include "common/json.h"
 
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -30,25 +31,39 @@
 #include <guacamole/stream.h>
 #include <guacamole/user.h>
 
-void guac_common_json_flush(guac_user* user, guac_stream* stream,
+int guac_common_json_flush(guac_user* user, guac_stream* stream,
         guac_common_json_state* json_state) {
 
-    /* If JSON buffer is non-empty, write contents to blob and reset */
-    if (json_state->size > 0) {
-        guac_protocol_send_blob(user->socket, stream,
-                json_state->buffer, json_state->size);
+    int blobs_written = 0;
 
-        /* Reset JSON buffer size */
-        json_state->size = 0;
+    /* Send contents of JSON buffer as blobs of at most blob_size bytes */
+    const char* current = json_state->buffer;
+    int remaining = json_state->size;
+    while (remaining > 0) {
+
+        int blob_length = remaining;
+        if (blob_length > json_state->blob_size)
+            blob_length = json_state->blob_size;
+
+        guac_protocol_send_blob(user->socket, stream, current, blob_length);
+        blobs_written++;
+
+        current += blob_length;
+        remaining -= blob_length;
 
     }
 
+    /* Reset JSON buffer size */
+    json_state->size = 0;
+
+    return blobs_written;
+
 }
 
 int guac_common_json_write(guac_user* user, guac_stream* stream,
         guac_common_json_state* json_state, const char* buffer, int length) {
 
-    int blob_written = 0;
+    int blobs_written = 0;
 
     /*
      * Append to and flush the JSON buffer as necessary to write the given
@@ -56,30 +71,95 @@ int guac_common_json_write(guac_user* user, guac_stream* stream,
      */
     while (length > 0) {
 
-        /* Ensure provided data does not exceed size of buffer */
-        int blob_length = length;
-        if (blob_length > sizeof(json_state->buffer))
-            blob_length = sizeof(json_state->buffer);
+        /* Flush if no room remains */
+        if (json_state->size == sizeof(json_state->buffer))
+            blobs_written += guac_common_json_flush(user, stream, json_state);
 
-        /* Flush if more room is needed */
-        if (json_state->size + blob_length > sizeof(json_state->buffer)) {
-            guac_common_json_flush(user, stream, json_state);
-            blob_written = 1;
-        }
+        /* Copy as much data as fits within the remaining space */
+        int available = sizeof(json_state->buffer) - json_state->size;
+        int chunk_length = length;
+        if (chunk_length > available)
+            chunk_length = available;
+
+        memcpy(json_state->buffer + json_state->size, buffer, chunk_length);
+        json_state->size += chunk_length;
+
+        /* Advance to remaining data */
+        buffer += chunk_length;
+        length -= chunk_length;
+
+    }
+
+    return blobs_written;
+
+}
+
+/**
+ * Returns whether the given character must be escaped within a JSON string.
+ * Only quotes, backslashes, and control characters require escaping. All
+ * other characters, including multibyte UTF-8 sequences, may be copied
+ * verbatim.
+ *
+ * @param c
+ *     The character to test.
+ *
+ * @return
+ *     Non-zero if the character must be escaped, zero otherwise.
+ */
+static int guac_common_json_needs_escape(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+/**
+ * Writes the JSON escape sequence representing the given character, which
+ * must be a character for which guac_common_json_needs_escape() returns
+ * non-zero.
+ *
+ * @param user
+ *     The user to which the data will be flushed as necessary.
+ *
+ * @param stream
+ *     The stream through which the flushed data should be sent as blobs, if
+ *     data must be flushed at all.
+ *
+ * @param json_state
+ *     The state object containing the JSON buffer to which the escape
+ *     sequence should be written.
+ *
+ * @param c
+ *     The character to escape.
+ *
+ * @return
+ *     The number of blobs written, zero if no blobs were written.
+ */
+static int guac_common_json_write_escaped(guac_user* user,
+        guac_stream* stream, guac_common_json_state* json_state,
+        unsigned char c) {
+
+    char escaped[7];
+
+    switch (c) {
+
+        case '"':
+            return guac_common_json_write(user, stream, json_state, "\\\"", 2);
+
+        case '\\':
+            return guac_common_json_write(user, stream, json_state, "\\\\", 2);
 
-        /* Append data to JSON buffer */
-        memcpy(json_state->buffer + json_state->size,
-                buffer, blob_length);
+        case '\n':
+            return guac_common_json_write(user, stream, json_state, "\\n", 2);
 
-        json_state->size += blob_length;
+        case '\r':
+            return guac_common_json_write(user, stream, json_state, "\\r", 2);
 
-        /* Advance to next blob of data */
-        buffer += blob_length;
-        length -= blob_length;
+        case '\t':
+            return guac_common_json_write(user, stream, json_state, "\\t", 2);
 
     }
 
-    return blob_written;
+    /* Any other control character must be written as a Unicode escape */
+    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+    return guac_common_json_write(user, stream, json_state, escaped, 6);
 
 }
 
@@ -87,30 +167,29 @@ int guac_common_json_write_string(guac_user* user,
         guac_stream* stream, guac_common_json_state* json_state,
         const char* str) {
 
-    int blob_written = 0;
+    int blobs_written = 0;
 
     /* Write starting quote */
-    blob_written |= guac_common_json_write(user, stream,
+    blobs_written += guac_common_json_write(user, stream,
             json_state, "\"", 1);
 
     /* Write given string, escaping as necessary */
     const char* current = str;
     for (; *current != '\0'; current++) {
 
-        /* Escape all quotes and back-slashes */
-        if (*current == '"' || *current == '\\') {
+        if (guac_common_json_needs_escape(*current)) {
 
-            /* Write any string content up to current character */
+            /* Write any string content up to current character in bulk */
             if (current != str)
-                blob_written |= guac_common_json_write(user, stream,
+                blobs_written += guac_common_json_write(user, stream,
                         json_state, str, current - str);
 
             /* Escape the character that was just read */
-            blob_written |= guac_common_json_write(user, stream,
-                    json_state, "\\", 1);
+            blobs_written += guac_common_json_write_escaped(user, stream,
+                    json_state, *current);
 
-            /* Reset string */
-            str = current;
+            /* Resume string following escaped character */
+            str = current + 1;
 
         }
 
@@ -118,14 +197,14 @@ int guac_common_json_write_string(guac_user* user,
 
     /* Write any remaining string content */
     if (current != str)
-        blob_written |= guac_common_json_write(user, stream,
+        blobs_written += guac_common_json_write(user, stream,
                 json_state, str, current - str);
 
     /* Write ending quote */
-    blob_written |= guac_common_json_write(user, stream,
+    blobs_written += guac_common_json_write(user, stream,
             json_state, "\"", 1);
 
-    return blob_written;
+    return blobs_written;
 
 }
 
@@ -133,28 +212,28 @@ int guac_common_json_write_property(guac_user* user, guac_stream* stream,
         guac_common_json_state* json_state, const char* name,
         const char* value) {
 
-    int blob_written = 0;
+    int blobs_written = 0;
 
     /* Write leading comma if not first property */
     if (json_state->properties_written != 0)
-        blob_written |= guac_common_json_write(user, stream,
+        blobs_written += guac_common_json_write(user, stream,
                 json_state, ",", 1);
 
     /* Write property name */
-    blob_written |= guac_common_json_write_string(user, stream,
+    blobs_written += guac_common_json_write_string(user, stream,
             json_state, name);
 
     /* Separate name from value with colon */
-    blob_written |= guac_common_json_write(user, stream,
+    blobs_written += guac_common_json_write(user, stream,
             json_state, ":", 1);
 
     /* Write property value */
-    blob_written |= guac_common_json_write_string(user, stream,
+    blobs_written += guac_common_json_write_string(user, stream,
             json_state, value);
 
     json_state->properties_written++;
 
-    return blob_written;
+    return blobs_written;
 
 }
 
@@ -163,6 +242,7 @@ void guac_common_json_begin_object(guac_user* user, guac_stream* stream,
 
     /* Init JSON state */
     json_state->size = 0;
+    json_state->blob_size = GUAC_COMMON_JSON_DEFAULT_BLOB_SIZE;
     json_state->properties_written = 0;
 
     /* Write leading brace - no blob can possibly be written by this */
@@ -47,6 +47,31 @@
  */
 #define GUAC_SURFACE_NEGLIGIBLE_HEIGHT 64
 
+/**
+ * The minimum width and height of a drawn image, in pixels, for that image to
+ * be checked for content scrolled from elsewhere within the surface.
+ */
+#define GUAC_SURFACE_SCROLL_MIN_SIZE 64
+
+/**
+ * The minimum number of rows or columns of a drawn image which must match
+ * scrolled content for that content to be copied rather than redrawn.
+ */
+#define GUAC_SURFACE_SCROLL_MIN_LINES 16
+
+/**
+ * The number of evenly-spaced rows or columns of a drawn image which are
+ * sampled when cheaply probing for scrolled content before hashing every row
+ * or column of that image.
+ */
+#define GUAC_SURFACE_SCROLL_PROBE_LINES 4
+
+/**
+ * The number of evenly-spaced pixels of each sampled row or column which are
+ * compared when cheaply probing for scrolled content.
+ */
+#define GUAC_SURFACE_SCROLL_PROBE_PIXELS 16
+
 /**
  * The proportional increase in cost contributed by transfer and processing of
  * image data, compared to processing an equivalent amount of client-side
@@ -84,6 +109,21 @@
  */
 #define GUAC_COMMON_SURFACE_JPEG_FRAMERATE 3
 
+/**
+ * The framerate which, if exceeded while the connection is congested,
+ * indicates that JPEG is preferred. Sending lossy updates more eagerly reduces
+ * the amount of data queued behind a congested connection.
+ */
+#define GUAC_COMMON_SURFACE_CONGESTED_JPEG_FRAMERATE 1
+
+/**
+ * The total lag, in milliseconds, including both processing lag and the time
+ * required to deliver data already queued for sending, at or beyond which the
+ * connection is considered congested. This is also the lag at which lossy
+ * quality reaches its minimum.
+ */
+#define GUAC_SURFACE_CONGESTED_LAG 80
+
 /**
  * Minimum JPEG bitmap size (area). If the bitmap is smaller than this threshold,
  * it should be compressed as a PNG image to avoid the JPEG compression tax.
@@ -104,6 +144,62 @@
  */
 #define GUAC_SURFACE_WEBP_BLOCK_SIZE 8
 
+/**
+ * The width and height of each tile classified as either lossless or lossy
+ * content when flushing, in pixels. This is a multiple of both the JPEG and
+ * WebP block sizes, such that lossy tiles remain aligned to those blocks.
+ */
+#define GUAC_SURFACE_TILE_SIZE GUAC_COMMON_SURFACE_HEAT_CELL_SIZE
+
+/**
+ * The minimum number of color buckets (out of 64) which must be present
+ * within a tile for that tile to be considered photographic.
+ */
+#define GUAC_SURFACE_TILE_PHOTO_COLORS 32
+
+/**
+ * The minimum number of color buckets (out of 64) which must be present
+ * within a tile for that tile to be considered photographic while the
+ * connection is congested.
+ */
+#define GUAC_SURFACE_TILE_CONGESTED_PHOTO_COLORS 16
+
+/**
+ * The smallest difference between a color component of adjacent pixels that
+ * is considered a sharp edge.
+ */
+#define GUAC_SURFACE_TILE_EDGE_DIFFERENCE 64
+
+/**
+ * The largest difference between a color component of adjacent pixels that
+ * is considered part of a smooth gradient.
+ */
+#define GUAC_SURFACE_TILE_GRADIENT_DIFFERENCE 24
+
+/**
+ * The framerate which, if sustained, indicates that a region of the surface
+ * should be streamed as video.
+ */
+#define GUAC_SURFACE_VIDEO_FRAMERATE 15
+
+/**
+ * The number of consecutive flushes which must update a region at a high
+ * framerate before that region is streamed as video.
+ */
+#define GUAC_SURFACE_VIDEO_MIN_FRAMES 45
+
+/**
+ * The minimum area of a region streamed as video, in pixels. Smaller regions
+ * are cheaper to send as images than to maintain as a separate video stream.
+ */
+#define GUAC_SURFACE_VIDEO_MIN_SIZE 65536
+
+/**
+ * The number of milliseconds which may elapse without any update to a region
+ * streamed as video before that video is stopped.
+ */
+#define GUAC_SURFACE_VIDEO_TIMEOUT 1000
+
 void guac_common_surface_set_multitouch(guac_common_surface* surface,
         int touches) {
 
@@ -126,6 +222,24 @@ void guac_common_surface_set_lossless(guac_common_surface* surface,
 
 }
 
+static void __guac_common_surface_stop_video(guac_common_surface* surface);
+
+void guac_common_surface_set_video(guac_common_surface* surface,
+        const guac_common_surface_video_encoder* encoder) {
+
+    pthread_mutex_lock(&surface->_lock);
+
+    /* Revert to images for any region streamed using the previous encoder */
+    if (encoder != surface->video_encoder)
+        __guac_common_surface_stop_video(surface);
+
+    surface->video_encoder = encoder;
+    surface->video_candidate_frames = 0;
+
+    pthread_mutex_unlock(&surface->_lock);
+
+}
+
 void guac_common_surface_move(guac_common_surface* surface, int x, int y) {
 
     pthread_mutex_lock(&surface->_lock);
@@ -377,6 +491,90 @@ static void __guac_common_mark_dirty(guac_common_surface* surface, const guac_co
 
 }
 
+/**
+ * Stops streaming any region of the given surface as video, marking that
+ * region dirty such that its current contents are sent as images during the
+ * next flush. If no region is being streamed, this function has no effect.
+ * The surface must already be locked.
+ *
+ * @param surface
+ *     The surface whose video should be stopped.
+ */
+static void __guac_common_surface_stop_video(guac_common_surface* surface) {
+
+    if (surface->video == NULL)
+        return;
+
+    surface->video_encoder->free(surface->video);
+    surface->video = NULL;
+    surface->video_candidate_frames = 0;
+
+    /* The video layer no longer covers the region */
+    __guac_common_mark_dirty(surface, &surface->video_rect);
+
+}
+
+/**
+ * Returns whether the given rectangle intersects the region of the given
+ * surface currently being streamed as video. Updates to that region are
+ * hidden beneath the video layer, and thus must always be deferred and
+ * flushed as either video frames or images.
+ *
+ * @param surface
+ *     The surface to check.
+ *
+ * @param rect
+ *     The rectangle to test.
+ *
+ * @return
+ *     Non-zero if the rectangle intersects the region being streamed as
+ *     video, zero otherwise.
+ */
+static int __guac_common_surface_video_intersects(
+        guac_common_surface* surface, const guac_common_rect* rect) {
+
+    if (surface->video != NULL)
+        return guac_common_rect_intersects(rect, &surface->video_rect) != 0;
+
+    return 0;
+
+}
+
+/**
+ * Returns whether the source rectangle of a copy or transfer from the given
+ * surface intersects the region of that surface currently being streamed as
+ * video. The layer beneath the video does not contain the current contents
+ * of that region, so such operations cannot be performed by the client and
+ * must instead be deferred and flushed as images. As with the operations
+ * themselves, only the X/Y coordinates of the source rectangle are used; its
+ * width and height are taken from the already-clipped destination rectangle.
+ *
+ * @param src
+ *     The surface being copied from.
+ *
+ * @param srect
+ *     The source rectangle, of which only the X/Y coordinates are used.
+ *
+ * @param drect
+ *     The destination rectangle, of which only the width and height are
+ *     used.
+ *
+ * @return
+ *     Non-zero if the source rectangle intersects the region of the source
+ *     surface being streamed as video, zero otherwise.
+ */
+static int __guac_common_surface_video_source_intersects(
+        guac_common_surface* src, const guac_common_rect* srect,
+        const guac_common_rect* drect) {
+
+    guac_common_rect rect;
+    guac_common_rect_init(&rect, srect->x, srect->y,
+            drect->width, drect->height);
+
+    return __guac_common_surface_video_intersects(src, &rect);
+
+}
+
 /**
  * Calculate the current average framerate for a given area on the surface.
  *
@@ -457,140 +655,278 @@ static unsigned int __guac_common_surface_calculate_framerate(
 
 }
 
- /**
- * Guesses whether a rectangle within a particular surface would be better
- * compressed as PNG or using a lossy format like JPEG. Positive values
- * indicate PNG is likely to be superior, while negative values indicate the
- * opposite.
- *
- * @param surface
- *     The surface containing the image data to check.
- *
- * @param rect
- *     The rect to check within the given surface.
- *
- * @return
- *     Positive values if PNG compression is likely to perform better than
- *     lossy alternatives, or negative values if PNG is likely to perform
- *     worse.
+/**
+ * Statistics gathered for a single tile of a rectangle by
+ * __guac_common_surface_classify(), along with the resulting classification
+ * of that tile.
  */
-static int __guac_common_surface_png_optimality(guac_common_surface* surface,
-        const guac_common_rect* rect) {
+typedef struct __guac_common_surface_tile {
+
+    /**
+     * The number of pixels compared with their left neighbor.
+     */
+    int compared;
+
+    /**
+     * The number of pixels identical to their left neighbor.
+     */
+    int same;
+
+    /**
+     * The number of pixels differing sharply from their left neighbor, as is
+     * typical of the edges of text and other rendered shapes.
+     */
+    int edges;
+
+    /**
+     * The number of pixels differing only slightly from their left neighbor,
+     * as is typical of gradients within photographic content.
+     */
+    int gradients;
+
+    /**
+     * Bitmap of the buckets of all colors encountered within the tile, as
+     * determined by __guac_common_surface_color_bucket(). The number of set
+     * bits approximates the number of distinct colors, saturating at 64.
+     */
+    uint64_t colors;
+
+    /**
+     * The bitwise AND of all pixels within the tile. The tile is opaque if
+     * the alpha component of this value is 0xFF.
+     */
+    uint32_t alpha;
+
+    /**
+     * Non-zero if the tile appears to contain photographic content which
+     * would be better encoded using a lossy format, zero if the tile should
+     * be encoded losslessly.
+     */
+    int lossy;
+
+} __guac_common_surface_tile;
 
-    int x, y;
-
-    int num_same = 0;
-    int num_different = 1;
+/**
+ * A run of horizontally-adjacent tiles sharing the same classification,
+ * flushed as a single image by __guac_common_surface_flush_to_tiles().
+ */
+typedef struct __guac_common_surface_tile_run {
 
-    /* Get image/buffer metrics */
-    int width = rect->width;
-    int height = rect->height;
-    int stride = surface->stride;
+    /**
+     * The region covered by the run, clipped to the rectangle being flushed.
+     */
+    guac_common_rect rect;
 
-    /* Get buffer from surface */
-    unsigned char* buffer = surface->buffer + rect->y * stride + rect->x * 4;
+    /**
+     * Non-zero if the run consists of lossy tiles, zero otherwise.
+     */
+    int lossy;
 
-    /* Image must be at least 1x1 */
-    if (width < 1 || height < 1)
-        return 0;
+    /**
+     * Non-zero if every pixel within the run is fully opaque, zero otherwise.
+     */
+    int opaque;
 
-    /* For each row */
-    for (y = 0; y < height; y++) {
+} __guac_common_surface_tile_run;
 
-        uint32_t* row = (uint32_t*) buffer;
-        uint32_t last_pixel = *(row++) | 0xFF000000;
+/**
+ * Returns which of 64 buckets the given color falls within, such that the
+ * number of distinct buckets encountered approximates the number of distinct
+ * colors.
+ *
+ * @param color
+ *     The 32-bit ARGB color to hash.
+ *
+ * @return
+ *     The bucket of the given color, from 0 through 63 inclusive.
+ */
+static int __guac_common_surface_color_bucket(uint32_t color) {
+    return ((color | 0xFF000000) * 0x9E3779B1u) >> 26;
+}
 
-        /* For each pixel in current row */
-        for (x = 1; x < width; x++) {
+/**
+ * Returns the largest difference between any corresponding color component
+ * of the given pixels, ignoring alpha.
+ *
+ * @param a
+ *     The first 32-bit ARGB pixel.
+ *
+ * @param b
+ *     The second 32-bit ARGB pixel.
+ *
+ * @return
+ *     The largest absolute difference between the red, green, or blue
+ *     components of the given pixels.
+ */
+static int __guac_common_surface_pixel_difference(uint32_t a, uint32_t b) {
 
-            /* Get next pixel */
-            uint32_t current_pixel = *(row++) | 0xFF000000;
+    int red   = abs((int) ((a >> 16) & 0xFF) - (int) ((b >> 16) & 0xFF));
+    int green = abs((int) ((a >> 8)  & 0xFF) - (int) ((b >> 8)  & 0xFF));
+    int blue  = abs((int) ( a        & 0xFF) - (int) ( b        & 0xFF));
 
-            /* Update same/different counts according to pixel value */
-            if (current_pixel == last_pixel)
-                num_same++;
-            else
-                num_different++;
+    int difference = red > green ? red : green;
+    return difference > blue ? difference : blue;
 
-            last_pixel = current_pixel;
+}
 
-        }
+/**
+ * Returns the number of bits set within the given value.
+ *
+ * @param value
+ *     The value whose set bits should be counted.
+ *
+ * @return
+ *     The number of bits set within the given value.
+ */
+static int __guac_common_surface_count_bits(uint64_t value) {
 
-        /* Advance to next row */
-        buffer += stride;
+    int count = 0;
 
+    while (value) {
+        value &= value - 1;
+        count++;
     }
 
-    /* Return rough approximation of optimality for PNG compression */
-    return 0x100 * num_same / num_different - 0x400;
+    return count;
 
 }
 
 /**
- * Returns whether the given rectangle would be optimally encoded as JPEG
- * rather than PNG.
+ * Classifies each tile of the given rectangle as either photographic content
+ * better encoded with a lossy format, or text-like content (few colors, flat
+ * areas, and sharp edges) better encoded losslessly. Tiles are aligned to a
+ * grid of GUAC_SURFACE_TILE_SIZE cells relative to the surface origin, and
+ * are clipped to the rectangle. All statistics, including opacity, are
+ * gathered in a single pass over the image data.
  *
  * @param surface
- *     The surface to be queried.
+ *     The surface containing the rectangle.
  *
  * @param rect
- *     The rectangle to check.
+ *     The rectangle to classify.
  *
- * @return
- *     Non-zero if the rectangle would be optimally encoded as JPEG, zero
- *     otherwise.
+ * @param tiles
+ *     An array of at least columns * rows tiles, where columns and rows are
+ *     the number of tile columns and rows intersecting the rectangle. Tiles
+ *     are stored in row-major order.
+ *
+ * @param columns
+ *     The number of tile columns intersecting the rectangle.
+ *
+ * @param congested
+ *     Non-zero if the connection is congested, in which case tiles with
+ *     fewer colors are also considered photographic, zero otherwise.
  */
-static int __guac_common_surface_should_use_jpeg(guac_common_surface* surface,
-        const guac_common_rect* rect) {
+static void __guac_common_surface_classify(guac_common_surface* surface,
+        const guac_common_rect* rect, __guac_common_surface_tile* tiles,
+        int columns, int congested) {
 
-    /* Do not use JPEG if lossless quality is required */
-    if (surface->lossless)
-        return 0;
+    int x, y;
 
-    /* Calculate the average framerate for the given rect */
-    int framerate = __guac_common_surface_calculate_framerate(surface, rect);
+    int stride = surface->stride;
+    unsigned char* buffer = surface->buffer + rect->y * stride + rect->x * 4;
 
-    int rect_size = rect->width * rect->height;
+    int first_column = rect->x / GUAC_SURFACE_TILE_SIZE;
+    int first_row = rect->y / GUAC_SURFACE_TILE_SIZE;
+    __guac_common_surface_tile* tile_row = tiles;
 
-    /* JPEG is preferred if:
-     * - frame rate is high enough
-     * - image size is large enough
-     * - PNG is not more optimal based on image contents */
-    return framerate >= GUAC_COMMON_SURFACE_JPEG_FRAMERATE
-        && rect_size > GUAC_SURFACE_JPEG_MIN_BITMAP_SIZE
-        && __guac_common_surface_png_optimality(surface, rect) < 0;
+    for (y = 0; y < rect->height; y++) {
 
-}
+        int row_index = (rect->y + y) / GUAC_SURFACE_TILE_SIZE - first_row;
+        tile_row = tiles + row_index * columns;
+
+        /* Reset statistics at the start of each row of tiles */
+        if (y == 0 || (rect->y + y) % GUAC_SURFACE_TILE_SIZE == 0) {
+            for (x = 0; x < columns; x++) {
+                __guac_common_surface_tile* tile = &tile_row[x];
+                tile->compared = tile->same = 0;
+                tile->edges = tile->gradients = 0;
+                tile->colors = 0;
+                tile->alpha = 0xFFFFFFFF;
+            }
+        }
 
-/**
- * Returns whether the given rectangle would be optimally encoded as WebP
- * rather than PNG.
- *
- * @param surface
- *     The surface to be queried.
- *
- * @param rect
- *     The rectangle to check.
- *
- * @return
- *     Non-zero if the rectangle would be optimally encoded as WebP, zero
- *     otherwise.
- */
-static int __guac_common_surface_should_use_webp(guac_common_surface* surface,
-        const guac_common_rect* rect) {
+        uint32_t* row = (uint32_t*) buffer;
+        uint32_t last = row[0];
+        x = 0;
 
-    /* Do not use WebP if not supported */
-    if (!guac_client_supports_webp(surface->client))
-        return 0;
+        /* Scan each tile-wide segment of the current row */
+        while (x < rect->width) {
+
+            int tile_end = ((rect->x + x) / GUAC_SURFACE_TILE_SIZE + 1)
+                * GUAC_SURFACE_TILE_SIZE - rect->x;
+            if (tile_end > rect->width)
+                tile_end = rect->width;
+
+            __guac_common_surface_tile* tile = &tile_row[
+                (rect->x + x) / GUAC_SURFACE_TILE_SIZE - first_column];
+
+            int same = 0;
+            int edges = 0;
+            int gradients = 0;
+            uint64_t colors = tile->colors;
+            uint32_t alpha = tile->alpha;
+
+            /* The first pixel of each row has no left neighbor to be
+             * compared with */
+            tile->compared += tile_end - x - (x == 0);
+
+            for (; x < tile_end; x++) {
+
+                uint32_t current = row[x];
+                alpha &= current;
+
+                /* A pixel identical to its left neighbor adds no color */
+                if (current == last && x > 0) {
+                    same++;
+                    continue;
+                }
+
+                colors |= (uint64_t) 1
+                    << __guac_common_surface_color_bucket(current);
+
+                if (x == 0)
+                    continue;
+
+                int difference =
+                    __guac_common_surface_pixel_difference(current, last);
+
+                edges += difference >= GUAC_SURFACE_TILE_EDGE_DIFFERENCE;
+                gradients += difference <= GUAC_SURFACE_TILE_GRADIENT_DIFFERENCE;
+
+                last = current;
+
+            }
+
+            tile->same += same;
+            tile->edges += edges;
+            tile->gradients += gradients;
+            tile->colors = colors;
+            tile->alpha = alpha;
+
+        }
+
+        buffer += stride;
+
+    }
 
-    /* Calculate the average framerate for the given rect */
-    int framerate = __guac_common_surface_calculate_framerate(surface, rect);
+    int photo_colors = congested ? GUAC_SURFACE_TILE_CONGESTED_PHOTO_COLORS
+                                 : GUAC_SURFACE_TILE_PHOTO_COLORS;
 
-    /* WebP is preferred if:
-     * - frame rate is high enough
-     * - PNG is not more optimal based on image contents */
-    return framerate >= GUAC_COMMON_SURFACE_JPEG_FRAMERATE
-        && __guac_common_surface_png_optimality(surface, rect) < 0;
+    /* Classify each tile based on its statistics */
+    int tile_count = (tile_row - tiles) + columns;
+    for (x = 0; x < tile_count; x++) {
+
+        __guac_common_surface_tile* tile = &tiles[x];
+
+        /* Photographic content has many colors, few flat areas, and
+         * gradients rather than sharp edges */
+        tile->lossy = __guac_common_surface_count_bits(tile->colors)
+                        >= photo_colors
+            && tile->same * 2 < tile->compared
+            && tile->gradients > tile->edges;
+
+    }
 
 }
 
@@ -1268,6 +1604,10 @@ guac_common_surface* guac_common_surface_alloc(guac_client* client,
 
 void guac_common_surface_free(guac_common_surface* surface) {
 
+    /* End any video streamed from this surface */
+    if (surface->video != NULL)
+        surface->video_encoder->free(surface->video);
+
     /* Only dispose of surface if it exists */
     if (surface->realized)
         guac_protocol_send_dispose(surface->socket, surface->layer);
@@ -1302,6 +1642,9 @@ void guac_common_surface_resize(guac_common_surface* surface, int w, int h) {
     size_t heat_width = GUAC_COMMON_SURFACE_HEAT_DIMENSION(w);
     size_t heat_height = GUAC_COMMON_SURFACE_HEAT_DIMENSION(h);
 
+    /* Any streamed region may no longer exist at the new size */
+    __guac_common_surface_stop_video(surface);
+
     /* Copy old surface data */
     old_buffer = surface->buffer;
     old_stride = surface->stride;
@@ -1342,54 +1685,490 @@ complete:
 
 }
 
-void guac_common_surface_draw(guac_common_surface* surface, int x, int y, cairo_surface_t* src) {
+/**
+ * Copies a rectangle of image data between two surfaces, both of which must
+ * already be locked. This is the implementation of
+ * guac_common_surface_copy(), and is also used to replay scrolls detected
+ * within drawn images.
+ *
+ * @param src
+ *     The source surface.
+ *
+ * @param sx
+ *     The X coordinate of the upper-left corner of the source rect.
+ *
+ * @param sy
+ *     The Y coordinate of the upper-left corner of the source rect.
+ *
+ * @param w
+ *     The width of the source rect.
+ *
+ * @param h
+ *     The height of the source rect.
+ *
+ * @param dst
+ *     The destination surface.
+ *
+ * @param dx
+ *     The X coordinate of the upper-left corner of the destination rect.
+ *
+ * @param dy
+ *     The Y coordinate of the upper-left corner of the destination rect.
+ */
+static void __guac_common_surface_copy(guac_common_surface* src, int sx, int sy,
+        int w, int h, guac_common_surface* dst, int dx, int dy) {
 
-    pthread_mutex_lock(&surface->_lock);
+    guac_socket* socket = dst->socket;
+    const guac_layer* src_layer = src->layer;
+    const guac_layer* dst_layer = dst->layer;
 
-    unsigned char* buffer = cairo_image_surface_get_data(src);
-    cairo_format_t format = cairo_image_surface_get_format(src);
-    int stride = cairo_image_surface_get_stride(src);
-    int w = cairo_image_surface_get_width(src);
-    int h = cairo_image_surface_get_height(src);
+    guac_common_rect srect;
+    guac_common_rect_init(&srect, sx, sy, w, h);
 
-    int sx = 0;
-    int sy = 0;
+    /* Clip operation source rect to bounds */
+    __guac_common_bound_rect(src, &srect, &dx, &dy);
+    if (srect.width <= 0 || srect.height <= 0)
+        return;
 
-    guac_common_rect rect;
-    guac_common_rect_init(&rect, x, y, w, h);
+    guac_common_rect drect;
+    guac_common_rect_init(&drect, dx, dy,
+            srect.width, srect.height);
 
-    /* Clip operation */
-    __guac_common_clip_rect(surface, &rect, &sx, &sy);
-    if (rect.width <= 0 || rect.height <= 0)
-        goto complete;
+    /* Clip operation destination rect */
+    __guac_common_clip_rect(dst, &drect, &srect.x, &srect.y);
+    if (drect.width <= 0 || drect.height <= 0)
+        return;
 
-    /* Update backing surface */
-    __guac_common_surface_put(buffer, stride, &sx, &sy, surface, &rect, format != CAIRO_FORMAT_ARGB32);
-    if (rect.width <= 0 || rect.height <= 0)
-        goto complete;
+    /* NOTE: Being the last rectangle to be adjusted, only the width/height of
+     * drect is now correct! */
 
-    /* Update the heat map for the update rectangle. */
-    guac_timestamp time = guac_timestamp_current();
-    __guac_common_surface_touch_rect(surface, &rect, time);
+    /* Update backing surface first only if drect cannot intersect srect */
+    if (src != dst) {
+        __guac_common_surface_transfer(src, &srect.x, &srect.y,
+                GUAC_TRANSFER_BINARY_SRC, dst, &drect);
+        if (drect.width <= 0 || drect.height <= 0)
+            return;
+    }
 
-    /* Flush if not combining */
-    if (!__guac_common_should_combine(surface, &rect, 0))
-        __guac_common_surface_flush_deferred(surface);
+    /* Defer if combining, drawing beneath video, or reading from beneath
+     * video (where the source layer does not contain the current frame) */
+    if (__guac_common_should_combine(dst, &drect, 1)
+            || __guac_common_surface_video_intersects(dst, &drect)
+            || __guac_common_surface_video_source_intersects(src, &srect,
+                &drect))
+        __guac_common_mark_dirty(dst, &drect);
 
-    /* Always defer draws */
-    __guac_common_mark_dirty(surface, &rect);
+    /* Otherwise, flush and draw immediately */
+    else {
+        __guac_common_surface_flush(dst);
+        __guac_common_surface_flush(src);
+        guac_protocol_send_copy(socket, src_layer, srect.x, srect.y,
+                drect.width, drect.height, GUAC_COMP_OVER, dst_layer,
+                drect.x, drect.y);
+        dst->realized = 1;
+    }
 
-complete:
-    pthread_mutex_unlock(&surface->_lock);
+    /* Update backing surface last if drect can intersect srect */
+    if (src == dst)
+        __guac_common_surface_transfer(src, &srect.x, &srect.y,
+                GUAC_TRANSFER_BINARY_SRC, dst, &drect);
 
 }
 
-void guac_common_surface_paint(guac_common_surface* surface, int x, int y,
-        cairo_surface_t* src, int red, int green, int blue) {
+/**
+ * Computes a hash of each row or column of the given rectangle within a
+ * buffer of 32-bit pixels. If the buffer is the contents of an opaque image,
+ * the alpha channel of each pixel is forced to 0xFF, matching the pixels that
+ * __guac_common_surface_put() would store when drawing that image.
+ *
+ * @param buffer
+ *     The buffer containing the pixels to hash, pointing to the upper-left
+ *     corner of the rectangle.
+ *
+ * @param stride
+ *     The number of bytes in each row of the buffer.
+ *
+ * @param width
+ *     The width of the rectangle, in pixels.
+ *
+ * @param height
+ *     The height of the rectangle, in pixels.
+ *
+ * @param columns
+ *     Non-zero if each column should be hashed, zero if each row should be
+ *     hashed.
+ *
+ * @param opaque
+ *     Non-zero if the alpha channel of each pixel should be ignored.
+ *
+ * @param hashes
+ *     The array to populate with one hash per row (height entries) or per
+ *     column (width entries).
+ */
+static void __guac_common_surface_hash_lines(const unsigned char* buffer,
+        int stride, int width, int height, int columns, int opaque,
+        uint32_t* hashes) {
+
+    uint32_t alpha = opaque ? 0xFF000000 : 0;
+    int lines = columns ? width : height;
+
+    for (int i = 0; i < lines; i++)
+        hashes[i] = 2166136261u;
+
+    /* FNV-1a over each pixel of each row or column */
+    for (int y = 0; y < height; y++) {
+
+        const uint32_t* current = (const uint32_t*) (buffer + y * stride);
+
+        for (int x = 0; x < width; x++) {
+            uint32_t* hash = &hashes[columns ? x : y];
+            *hash = (*hash ^ (*(current++) | alpha)) * 16777619u;
+        }
+
+    }
+
+}
+
+/**
+ * A single line hash, paired with the index of the row or column that
+ * produced it, as sorted by __guac_common_surface_find_scroll().
+ */
+typedef struct __guac_common_surface_line {
+
+    /**
+     * The hash of the row or column.
+     */
+    uint32_t hash;
+
+    /**
+     * The index of the row or column.
+     */
+    int index;
+
+} __guac_common_surface_line;
+
+/**
+ * Comparator for qsort() and bsearch() which orders
+ * __guac_common_surface_line structures by hash.
+ */
+static int __guac_common_surface_line_compare(const void* a, const void* b) {
+
+    uint32_t hash_a = ((const __guac_common_surface_line*) a)->hash;
+    uint32_t hash_b = ((const __guac_common_surface_line*) b)->hash;
+
+    return (hash_a > hash_b) - (hash_a < hash_b);
+
+}
+
+/**
+ * Searches for a scroll between two sets of line hashes, the first
+ * describing the rows or columns of a newly-drawn image and the second
+ * describing the same rows or columns of the surface prior to the draw. Lines
+ * which occur exactly once in the surface vote for the offset at which they
+ * now appear, and the most popular nonzero offset is accepted if it explains
+ * a long enough contiguous run of lines.
+ *
+ * @param new_hashes
+ *     The hashes of the lines of the newly-drawn image.
+ *
+ * @param old_hashes
+ *     The hashes of the same lines of the surface prior to the draw.
+ *
+ * @param length
+ *     The number of lines described by each array of hashes.
+ *
+ * @param start
+ *     Pointer to an int which will receive the index of the first line of
+ *     the image that can be copied from elsewhere within the surface.
+ *
+ * @param count
+ *     Pointer to an int which will receive the number of lines that can be
+ *     copied.
+ *
+ * @return
+ *     The offset, in lines, of the location in the surface that the lines
+ *     starting at start can be copied from, or zero if no scroll was found.
+ */
+static int __guac_common_surface_find_scroll(const uint32_t* new_hashes,
+        const uint32_t* old_hashes, int length, int* start, int* count) {
+
+    int offset = 0;
+    int votes = 0;
+
+    /* Sort old lines by hash */
+    __guac_common_surface_line* lines = guac_mem_alloc(length,
+            sizeof(__guac_common_surface_line));
+
+    for (int i = 0; i < length; i++) {
+        lines[i].hash = old_hashes[i];
+        lines[i].index = i;
+    }
+
+    qsort(lines, length, sizeof(__guac_common_surface_line),
+            __guac_common_surface_line_compare);
+
+    /* Vote for offsets of lines which are unique within the old contents */
+    int* offset_votes = guac_mem_zalloc(length * 2, sizeof(int));
+    for (int i = 0; i < length; i++) {
+
+        __guac_common_surface_line key = { .hash = new_hashes[i] };
+        __guac_common_surface_line* match = bsearch(&key, lines, length,
+                sizeof(__guac_common_surface_line),
+                __guac_common_surface_line_compare);
+
+        if (match == NULL)
+            continue;
+
+        /* Ignore lines which are ambiguous (such as blank lines) */
+        if ((match > lines && (match - 1)->hash == key.hash)
+                || (match < lines + length - 1 && (match + 1)->hash == key.hash))
+            continue;
+
+        int candidate = match->index - i;
+        if (candidate != 0 && ++offset_votes[candidate + length] > votes) {
+            votes = offset_votes[candidate + length];
+            offset = candidate;
+        }
+
+    }
+
+    guac_mem_free(offset_votes);
+    guac_mem_free(lines);
+
+    if (offset == 0)
+        return 0;
+
+    /* Find longest run of lines explained by the winning offset */
+    int best_start = 0;
+    int best_count = 0;
+    int run_start = 0;
+    int run_count = 0;
+
+    int first = offset < 0 ? -offset : 0;
+    int last = offset > 0 ? length - offset : length;
+
+    for (int i = first; i < last; i++) {
+
+        if (new_hashes[i] == old_hashes[i + offset]) {
+            if (run_count++ == 0)
+                run_start = i;
+            if (run_count > best_count) {
+                best_start = run_start;
+                best_count = run_count;
+            }
+        }
+        else
+            run_count = 0;
+
+    }
+
+    /* Accept only scrolls covering a substantial part of the image */
+    if (best_count < GUAC_SURFACE_SCROLL_MIN_LINES
+            || best_count < length / 4)
+        return 0;
+
+    *start = best_start;
+    *count = best_count;
+    return offset;
+
+}
+
+/**
+ * Cheaply tests whether the given opaque image may contain rows or columns
+ * scrolled from elsewhere within the same area of the surface, such that
+ * hashing every row or column is worthwhile. A few sampled lines of the image
+ * are compared, at a few sampled pixels, against every other line of the
+ * surface. Content which cannot possibly have scrolled, such as video or
+ * entirely new content, is typically rejected after comparing only the first
+ * pixel of each pair of lines.
+ *
+ * @param new_buffer
+ *     The image data being drawn, pointing to the upper-left corner of the
+ *     rectangle.
+ *
+ * @param new_stride
+ *     The number of bytes in each row of the image data.
+ *
+ * @param old_buffer
+ *     The buffer of the surface, pointing to the upper-left corner of the
+ *     rectangle.
+ *
+ * @param old_stride
+ *     The number of bytes in each row of the buffer of the surface.
+ *
+ * @param width
+ *     The width of the rectangle, in pixels.
+ *
+ * @param height
+ *     The height of the rectangle, in pixels.
+ *
+ * @param columns
+ *     Non-zero if columns should be probed for a horizontal scroll, zero if
+ *     rows should be probed for a vertical scroll.
+ *
+ * @return
+ *     Non-zero if any sampled line of the image may match a different line of
+ *     the surface, zero if the image cannot be a scroll in the given
+ *     direction.
+ */
+static int __guac_common_surface_probe_scroll(const unsigned char* new_buffer,
+        int new_stride, const unsigned char* old_buffer, int old_stride,
+        int width, int height, int columns) {
+
+    int lines = columns ? width : height;
+    int length = columns ? height : width;
+
+    /* Distance in bytes between adjacent lines and between adjacent pixels
+     * within a line */
+    int new_line_step  = columns ? 4 : new_stride;
+    int old_line_step  = columns ? 4 : old_stride;
+    int new_pixel_step = columns ? new_stride : 4;
+    int old_pixel_step = columns ? old_stride : 4;
+
+    for (int sample = 1; sample <= GUAC_SURFACE_SCROLL_PROBE_LINES; sample++) {
+
+        int i = lines * sample / (GUAC_SURFACE_SCROLL_PROBE_LINES + 1);
+        const unsigned char* new_line = new_buffer + i * new_line_step;
+
+        /* Search all other lines of the surface for the sampled line */
+        for (int j = 0; j < lines; j++) {
+
+            if (j == i)
+                continue;
+
+            const unsigned char* old_line = old_buffer + j * old_line_step;
+
+            int k;
+            for (k = 0; k < GUAC_SURFACE_SCROLL_PROBE_PIXELS; k++) {
+
+                int pixel = k * length / GUAC_SURFACE_SCROLL_PROBE_PIXELS;
+
+                uint32_t new_color = *((const uint32_t*)
+                        (new_line + pixel * new_pixel_step)) | 0xFF000000;
+                uint32_t old_color = *((const uint32_t*)
+                        (old_line + pixel * old_pixel_step));
+
+                if (new_color != old_color)
+                    break;
+
+            }
+
+            if (k == GUAC_SURFACE_SCROLL_PROBE_PIXELS)
+                return 1;
+
+        }
+
+    }
+
+    return 0;
+
+}
+
+/**
+ * Detects whether the given opaque image, which is about to be drawn to the
+ * given surface, is largely a scrolled copy of the surface's current
+ * contents. If a vertical or horizontal scroll is found, the scrolled region
+ * is copied within the surface, such that the subsequent draw of the image
+ * need only send the pixels which actually changed. Each direction is
+ * cheaply probed before any rows or columns are hashed. The surface must
+ * already be locked, and the rectangle must already be clipped.
+ *
+ * @param surface
+ *     The surface that the image is about to be drawn to.
+ *
+ * @param buffer
+ *     The image data being drawn.
+ *
+ * @param stride
+ *     The number of bytes in each row of the image data.
+ *
+ * @param sx
+ *     The X coordinate of the upper-left corner of the source rectangle
+ *     within the image data.
+ *
+ * @param sy
+ *     The Y coordinate of the upper-left corner of the source rectangle
+ *     within the image data.
+ *
+ * @param rect
+ *     The destination rectangle of the draw.
+ */
+static void __guac_common_surface_detect_scroll(guac_common_surface* surface,
+        const unsigned char* buffer, int stride, int sx, int sy,
+        const guac_common_rect* rect) {
+
+    /* Scrolls are only worth detecting within large updates */
+    if (rect->width < GUAC_SURFACE_SCROLL_MIN_SIZE
+            || rect->height < GUAC_SURFACE_SCROLL_MIN_SIZE)
+        return;
+
+    const unsigned char* new_buffer = buffer + sy * stride + sx * 4;
+    const unsigned char* old_buffer = surface->buffer
+        + rect->y * surface->stride + rect->x * 4;
+
+    int start, count;
+    int offset = 0;
+
+    /* Vertical scrolls (compare rows) */
+    if (__guac_common_surface_probe_scroll(new_buffer, stride, old_buffer,
+                surface->stride, rect->width, rect->height, 0)) {
+
+        uint32_t* new_hashes = guac_mem_alloc(rect->height, sizeof(uint32_t));
+        uint32_t* old_hashes = guac_mem_alloc(rect->height, sizeof(uint32_t));
+
+        __guac_common_surface_hash_lines(new_buffer, stride,
+                rect->width, rect->height, 0, 1, new_hashes);
+        __guac_common_surface_hash_lines(old_buffer, surface->stride,
+                rect->width, rect->height, 0, 0, old_hashes);
+
+        offset = __guac_common_surface_find_scroll(new_hashes, old_hashes,
+                rect->height, &start, &count);
+
+        guac_mem_free(new_hashes);
+        guac_mem_free(old_hashes);
+
+        if (offset != 0) {
+            __guac_common_surface_copy(surface, rect->x,
+                    rect->y + start + offset, rect->width, count,
+                    surface, rect->x, rect->y + start);
+            return;
+        }
+
+    }
+
+    /* Horizontal scrolls (compare columns) */
+    if (__guac_common_surface_probe_scroll(new_buffer, stride, old_buffer,
+                surface->stride, rect->width, rect->height, 1)) {
+
+        uint32_t* new_hashes = guac_mem_alloc(rect->width, sizeof(uint32_t));
+        uint32_t* old_hashes = guac_mem_alloc(rect->width, sizeof(uint32_t));
+
+        __guac_common_surface_hash_lines(new_buffer, stride,
+                rect->width, rect->height, 1, 1, new_hashes);
+        __guac_common_surface_hash_lines(old_buffer, surface->stride,
+                rect->width, rect->height, 1, 0, old_hashes);
+
+        offset = __guac_common_surface_find_scroll(new_hashes, old_hashes,
+                rect->width, &start, &count);
+
+        guac_mem_free(new_hashes);
+        guac_mem_free(old_hashes);
+
+        if (offset != 0)
+            __guac_common_surface_copy(surface, rect->x + start + offset,
+                    rect->y, count, rect->height, surface,
+                    rect->x + start, rect->y);
+
+    }
+
+}
+
+void guac_common_surface_draw(guac_common_surface* surface, int x, int y, cairo_surface_t* src) {
 
     pthread_mutex_lock(&surface->_lock);
 
     unsigned char* buffer = cairo_image_surface_get_data(src);
+    cairo_format_t format = cairo_image_surface_get_format(src);
     int stride = cairo_image_surface_get_stride(src);
     int w = cairo_image_surface_get_width(src);
     int h = cairo_image_surface_get_height(src);
@@ -1405,8 +2184,23 @@ void guac_common_surface_paint(guac_common_surface* surface, int x, int y,
     if (rect.width <= 0 || rect.height <= 0)
         goto complete;
 
+    /* Replay any scroll of existing content as a copy, leaving only
+     * genuinely new pixels to be drawn. A draw which will be combined with
+     * pending updates is sent as part of one larger image anyway, and a copy
+     * would only force that image to be split. */
+    if (format != CAIRO_FORMAT_ARGB32
+            && !__guac_common_should_combine(surface, &rect, 0))
+        __guac_common_surface_detect_scroll(surface, buffer, stride,
+                sx, sy, &rect);
+
     /* Update backing surface */
-    __guac_common_surface_fill_mask(buffer, stride, sx, sy, surface, &rect, red, green, blue);
+    __guac_common_surface_put(buffer, stride, &sx, &sy, surface, &rect, format != CAIRO_FORMAT_ARGB32);
+    if (rect.width <= 0 || rect.height <= 0)
+        goto complete;
+
+    /* Update the heat map for the update rectangle. */
+    guac_timestamp time = guac_timestamp_current();
+    __guac_common_surface_touch_rect(surface, &rect, time);
 
     /* Flush if not combining */
     if (!__guac_common_should_combine(surface, &rect, 0))
@@ -1420,66 +2214,51 @@ complete:
 
 }
 
-void guac_common_surface_copy(guac_common_surface* src, int sx, int sy,
-        int w, int h, guac_common_surface* dst, int dx, int dy) {
+void guac_common_surface_paint(guac_common_surface* surface, int x, int y,
+        cairo_surface_t* src, int red, int green, int blue) {
 
-    /* Lock both surfaces */
-    pthread_mutex_lock(&dst->_lock);
-    if (src != dst)
-        pthread_mutex_lock(&src->_lock);
+    pthread_mutex_lock(&surface->_lock);
 
-    guac_socket* socket = dst->socket;
-    const guac_layer* src_layer = src->layer;
-    const guac_layer* dst_layer = dst->layer;
+    unsigned char* buffer = cairo_image_surface_get_data(src);
+    int stride = cairo_image_surface_get_stride(src);
+    int w = cairo_image_surface_get_width(src);
+    int h = cairo_image_surface_get_height(src);
 
-    guac_common_rect srect;
-    guac_common_rect_init(&srect, sx, sy, w, h);
+    int sx = 0;
+    int sy = 0;
 
-    /* Clip operation source rect to bounds */
-    __guac_common_bound_rect(src, &srect, &dx, &dy);
-    if (srect.width <= 0 || srect.height <= 0)
+    guac_common_rect rect;
+    guac_common_rect_init(&rect, x, y, w, h);
+
+    /* Clip operation */
+    __guac_common_clip_rect(surface, &rect, &sx, &sy);
+    if (rect.width <= 0 || rect.height <= 0)
         goto complete;
 
-    guac_common_rect drect;
-    guac_common_rect_init(&drect, dx, dy,
-            srect.width, srect.height);
+    /* Update backing surface */
+    __guac_common_surface_fill_mask(buffer, stride, sx, sy, surface, &rect, red, green, blue);
 
-    /* Clip operation destination rect */
-    __guac_common_clip_rect(dst, &drect, &srect.x, &srect.y);
-    if (drect.width <= 0 || drect.height <= 0)
-        goto complete;
+    /* Flush if not combining */
+    if (!__guac_common_should_combine(surface, &rect, 0))
+        __guac_common_surface_flush_deferred(surface);
 
-    /* NOTE: Being the last rectangle to be adjusted, only the width/height of
-     * drect is now correct! */
+    /* Always defer draws */
+    __guac_common_mark_dirty(surface, &rect);
 
-    /* Update backing surface first only if drect cannot intersect srect */
-    if (src != dst) {
-        __guac_common_surface_transfer(src, &srect.x, &srect.y,
-                GUAC_TRANSFER_BINARY_SRC, dst, &drect);
-        if (drect.width <= 0 || drect.height <= 0)
-            goto complete;
-    }
+complete:
+    pthread_mutex_unlock(&surface->_lock);
 
-    /* Defer if combining */
-    if (__guac_common_should_combine(dst, &drect, 1))
-        __guac_common_mark_dirty(dst, &drect);
+}
 
-    /* Otherwise, flush and draw immediately */
-    else {
-        __guac_common_surface_flush(dst);
-        __guac_common_surface_flush(src);
-        guac_protocol_send_copy(socket, src_layer, srect.x, srect.y,
-                drect.width, drect.height, GUAC_COMP_OVER, dst_layer,
-                drect.x, drect.y);
-        dst->realized = 1;
-    }
+void guac_common_surface_copy(guac_common_surface* src, int sx, int sy,
+        int w, int h, guac_common_surface* dst, int dx, int dy) {
 
-    /* Update backing surface last if drect can intersect srect */
-    if (src == dst)
-        __guac_common_surface_transfer(src, &srect.x, &srect.y,
-                GUAC_TRANSFER_BINARY_SRC, dst, &drect);
+    /* Lock both surfaces */
+    pthread_mutex_lock(&dst->_lock);
+    if (src != dst)
+        pthread_mutex_lock(&src->_lock);
 
-complete:
+    __guac_common_surface_copy(src, sx, sy, w, h, dst, dx, dy);
 
     /* Unlock both surfaces */
     pthread_mutex_unlock(&dst->_lock);
@@ -1527,8 +2306,12 @@ void guac_common_surface_transfer(guac_common_surface* src, int sx, int sy, int
             goto complete;
     }
 
-    /* Defer if combining */
-    if (__guac_common_should_combine(dst, &drect, 1))
+    /* Defer if combining, drawing beneath video, or reading from beneath
+     * video (where the source layer does not contain the current frame) */
+    if (__guac_common_should_combine(dst, &drect, 1)
+            || __guac_common_surface_video_intersects(dst, &drect)
+            || __guac_common_surface_video_source_intersects(src, &srect,
+                &drect))
         __guac_common_mark_dirty(dst, &drect);
 
     /* Otherwise, flush and draw immediately */
@@ -1586,8 +2369,9 @@ void guac_common_surface_set(guac_common_surface* surface,
 
     }
 
-    /* Defer if combining */
-    else if (__guac_common_should_combine(surface, &rect, 1))
+    /* Defer if combining or drawing beneath video */
+    else if (__guac_common_should_combine(surface, &rect, 1)
+            || __guac_common_surface_video_intersects(surface, &rect))
         __guac_common_mark_dirty(surface, &rect);
 
     /* Otherwise, flush and draw immediately */
@@ -1693,7 +2477,9 @@ static void __guac_common_surface_flush_to_png(guac_common_surface* surface,
 
 /**
  * Returns an appropriate quality between 0 and 100 for lossy encoding
- * depending on the current processing lag calculated for the given client.
+ * depending on the current display lag calculated for the given client. The
+ * display lag includes the time required to deliver data still queued for
+ * sending, so quality drops as soon as the connection becomes congested.
  *
  * @param client
  *     The client for which the lossy quality is being calculated.
@@ -1704,7 +2490,7 @@ static void __guac_common_surface_flush_to_png(guac_common_surface* surface,
  */
 static int guac_common_surface_suggest_quality(guac_client* client) {
 
-    int lag = guac_client_get_processing_lag(client);
+    int lag = guac_client_get_display_lag(client);
 
     /* Scale quality linearly from 90 to 30 as lag varies from 20ms to 80ms */
     int quality = 90 - (lag - 20);
@@ -1887,6 +2673,394 @@ static void __guac_common_surface_flush_properties(
 
 }
 
+/**
+ * Flushes the bitmap update currently described by the dirty rectangle within
+ * the given surface using a lossy format, if appropriate. WebP is preferred
+ * if supported, followed by JPEG. If neither lossy format can be used, the
+ * update is flushed as PNG.
+ *
+ * @param surface
+ *     The surface to flush.
+ *
+ * @param opaque
+ *     Whether the rectangle being flushed contains only fully-opaque pixels.
+ *
+ * @param webp
+ *     Non-zero if all users of the surface support WebP, zero otherwise.
+ */
+static void __guac_common_surface_flush_to_lossy(guac_common_surface* surface,
+        int opaque, int webp) {
+
+    guac_common_rect* rect = &surface->dirty_rect;
+
+    /* Prefer WebP when available */
+    if (webp)
+        __guac_common_surface_flush_to_webp(surface, opaque);
+
+    /* If not WebP, JPEG is the next best (lossy) choice */
+    else if (opaque && !surface->lossless
+            && rect->width * rect->height > GUAC_SURFACE_JPEG_MIN_BITMAP_SIZE)
+        __guac_common_surface_flush_to_jpeg(surface);
+
+    /* Use PNG if no lossy formats are appropriate */
+    else
+        __guac_common_surface_flush_to_png(surface, opaque);
+
+}
+
+/**
+ * Flushes the given run of tiles as a single image, using a lossy format if
+ * the run consists of lossy tiles and PNG otherwise.
+ *
+ * @param surface
+ *     The surface to flush.
+ *
+ * @param run
+ *     The run of tiles to flush.
+ *
+ * @param webp
+ *     Non-zero if all users of the surface support WebP, zero otherwise.
+ */
+static void __guac_common_surface_flush_tile_run(guac_common_surface* surface,
+        const __guac_common_surface_tile_run* run, int webp) {
+
+    surface->dirty_rect = run->rect;
+    surface->dirty = 1;
+
+    if (run->lossy)
+        __guac_common_surface_flush_to_lossy(surface, run->opaque, webp);
+    else
+        __guac_common_surface_flush_to_png(surface, run->opaque);
+
+}
+
+/**
+ * Flushes the bitmap update currently described by the dirty rectangle within
+ * the given surface, classifying each tile of that rectangle as photographic
+ * or text-like content. If all tiles share the same classification, the
+ * rectangle is flushed as a single image. Otherwise, photographic tiles are
+ * sent using a lossy format while text-like tiles are sent losslessly, with
+ * adjacent tiles of the same classification combined into as few images as
+ * possible.
+ *
+ * @param surface
+ *     The surface to flush.
+ *
+ * @param webp
+ *     Non-zero if all users of the surface support WebP, zero otherwise.
+ *
+ * @param congested
+ *     Non-zero if the connection is congested, zero otherwise.
+ */
+static void __guac_common_surface_flush_to_tiles(guac_common_surface* surface,
+        int webp, int congested) {
+
+    int i, x, y;
+
+    guac_common_rect rect = surface->dirty_rect;
+
+    int first_column = rect.x / GUAC_SURFACE_TILE_SIZE;
+    int first_row = rect.y / GUAC_SURFACE_TILE_SIZE;
+    int columns = (rect.x + rect.width - 1) / GUAC_SURFACE_TILE_SIZE
+        - first_column + 1;
+    int rows = (rect.y + rect.height - 1) / GUAC_SURFACE_TILE_SIZE
+        - first_row + 1;
+
+    __guac_common_surface_tile* tiles = guac_mem_alloc(columns, rows,
+            sizeof(__guac_common_surface_tile));
+
+    __guac_common_surface_classify(surface, &rect, tiles, columns,
+            congested);
+
+    /* Determine whether tiles differ in classification */
+    int lossy = 0;
+    int opaque = 1;
+    for (i = 0; i < columns * rows; i++) {
+        lossy += tiles[i].lossy;
+        opaque &= (tiles[i].alpha & 0xFF000000) == 0xFF000000;
+    }
+
+    /* Flush as a single image if all tiles are alike */
+    if (lossy == 0 || lossy == columns * rows) {
+
+        if (lossy)
+            __guac_common_surface_flush_to_lossy(surface, opaque, webp);
+        else
+            __guac_common_surface_flush_to_png(surface, opaque);
+
+        guac_mem_free(tiles);
+        return;
+
+    }
+
+    /* Runs of each classification, for the previous and current tile rows */
+    __guac_common_surface_tile_run* pending = guac_mem_alloc(columns,
+            sizeof(__guac_common_surface_tile_run));
+    __guac_common_surface_tile_run* current = guac_mem_alloc(columns,
+            sizeof(__guac_common_surface_tile_run));
+    int pending_runs = 0;
+
+    for (y = 0; y < rows; y++) {
+
+        __guac_common_surface_tile* tile_row = tiles + y * columns;
+
+        /* Vertical bounds of current tile row, clipped to dirty rect */
+        int top = (first_row + y) * GUAC_SURFACE_TILE_SIZE;
+        int bottom = top + GUAC_SURFACE_TILE_SIZE;
+        if (top < rect.y) top = rect.y;
+        if (bottom > rect.y + rect.height) bottom = rect.y + rect.height;
+
+        /* Split current tile row into runs of identically-classified tiles */
+        int current_runs = 0;
+        for (x = 0; x < columns; x++) {
+
+            __guac_common_surface_tile* tile = &tile_row[x];
+            int tile_opaque = (tile->alpha & 0xFF000000) == 0xFF000000;
+
+            int left = (first_column + x) * GUAC_SURFACE_TILE_SIZE;
+            int right = left + GUAC_SURFACE_TILE_SIZE;
+            if (left < rect.x) left = rect.x;
+            if (right > rect.x + rect.width) right = rect.x + rect.width;
+
+            /* Extend the current run if the classification is unchanged */
+            if (current_runs > 0 && current[current_runs - 1].lossy
+                    == tile->lossy) {
+                __guac_common_surface_tile_run* run = &current[current_runs - 1];
+                run->rect.width = right - run->rect.x;
+                run->opaque &= tile_opaque;
+                continue;
+            }
+
+            __guac_common_surface_tile_run* run = &current[current_runs++];
+            guac_common_rect_init(&run->rect, left, top, right - left,
+                    bottom - top);
+            run->lossy = tile->lossy;
+            run->opaque = tile_opaque;
+
+        }
+
+        /* Extend pending runs downward if this row has the same layout */
+        int same_layout = (current_runs == pending_runs);
+        for (i = 0; same_layout && i < current_runs; i++) {
+            same_layout = pending[i].lossy == current[i].lossy
+                && pending[i].rect.x == current[i].rect.x
+                && pending[i].rect.width == current[i].rect.width;
+        }
+
+        if (same_layout) {
+            for (i = 0; i < pending_runs; i++) {
+                pending[i].rect.height = bottom - pending[i].rect.y;
+                pending[i].opaque &= current[i].opaque;
+            }
+            continue;
+        }
+
+        /* Otherwise, flush pending runs and begin anew with this row */
+        for (i = 0; i < pending_runs; i++)
+            __guac_common_surface_flush_tile_run(surface, &pending[i], webp);
+
+        __guac_common_surface_tile_run* swap = pending;
+        pending = current;
+        current = swap;
+        pending_runs = current_runs;
+
+    }
+
+    /* Flush any remaining runs */
+    for (i = 0; i < pending_runs; i++)
+        __guac_common_surface_flush_tile_run(surface, &pending[i], webp);
+
+    guac_mem_free(current);
+    guac_mem_free(pending);
+    guac_mem_free(tiles);
+
+    surface->dirty = 0;
+
+}
+
+/**
+ * Expands the given rectangle such that its width and height are even, as
+ * required by the video encoder, keeping the rectangle within the bounds of
+ * the given surface. If a dimension cannot be expanded, it is reduced
+ * instead.
+ *
+ * @param surface
+ *     The surface containing the rectangle.
+ *
+ * @param rect
+ *     The rectangle to align.
+ */
+static void __guac_common_surface_align_video_rect(
+        guac_common_surface* surface, guac_common_rect* rect) {
+
+    if (rect->width % 2) {
+        if (rect->x + rect->width < surface->width)
+            rect->width++;
+        else if (rect->x > 0) {
+            rect->x--;
+            rect->width++;
+        }
+        else
+            rect->width--;
+    }
+
+    if (rect->height % 2) {
+        if (rect->y + rect->height < surface->height)
+            rect->height++;
+        else if (rect->y > 0) {
+            rect->y--;
+            rect->height++;
+        }
+        else
+            rect->height--;
+    }
+
+}
+
+/**
+ * Writes the current contents of the region of the given surface being
+ * streamed as video as a new video frame.
+ *
+ * @param surface
+ *     The surface being streamed.
+ *
+ * @param timestamp
+ *     The time at which the frame should be presented.
+ *
+ * @return
+ *     Zero if the frame was written successfully, non-zero otherwise.
+ */
+static int __guac_common_surface_write_video_frame(
+        guac_common_surface* surface, guac_timestamp timestamp) {
+
+    unsigned char* buffer = surface->buffer
+                          + surface->video_rect.y * surface->stride
+                          + surface->video_rect.x * 4;
+
+    surface->video_last_frame = timestamp;
+    return surface->video_encoder->write_frame(surface->video, buffer,
+            surface->stride, timestamp);
+
+}
+
+/**
+ * Flushes the bitmap update currently described by the dirty rectangle within
+ * the given surface as a frame of video, if that rectangle lies within a
+ * region currently being streamed as video. If the dirty rectangle is not
+ * being streamed but has been repeatedly updated at a high framerate, a new
+ * video stream covering that region is started. If the dirty rectangle
+ * partially overlaps a region being streamed, the video is stopped and that
+ * region is added to the dirty rectangle, to be sent as an image instead.
+ *
+ * @param surface
+ *     The surface to flush.
+ *
+ * @return
+ *     Non-zero if the dirty rectangle was flushed as video, zero if the dirty
+ *     rectangle must still be flushed as an image.
+ */
+static int __guac_common_surface_flush_to_video(
+        guac_common_surface* surface) {
+
+    guac_common_rect* dirty_rect = &surface->dirty_rect;
+    guac_timestamp now = guac_timestamp_current();
+
+    if (surface->video != NULL) {
+
+        /* Send updates within the video region as a new frame */
+        int intersects = guac_common_rect_intersects(dirty_rect,
+                &surface->video_rect);
+
+        if (intersects == 2
+                && __guac_common_surface_write_video_frame(surface, now) == 0) {
+            surface->dirty = 0;
+            return 1;
+        }
+
+        /* Revert to images if the video region can no longer be streamed
+         * independently of the rest of the surface */
+        if (intersects)
+            __guac_common_surface_stop_video(surface);
+
+        return 0;
+
+    }
+
+    /* Video applies only to visible layers, and never if lossless */
+    if (surface->video_encoder == NULL || surface->lossless
+            || surface->layer->index < 0)
+        return 0;
+
+    guac_common_rect* candidate = &surface->video_candidate;
+    int candidate_updated = surface->video_candidate_frames > 0
+        && guac_common_rect_intersects(dirty_rect, candidate);
+
+    /* Only large, opaque regions updated at a high framerate qualify */
+    if (dirty_rect->width * dirty_rect->height < GUAC_SURFACE_VIDEO_MIN_SIZE
+            || __guac_common_surface_calculate_framerate(surface, dirty_rect)
+                < GUAC_SURFACE_VIDEO_FRAMERATE
+            || !__guac_common_surface_is_opaque(surface, dirty_rect)) {
+
+        /* Updates which are not video-like reset any overlapping candidate */
+        if (candidate_updated)
+            surface->video_candidate_frames = 0;
+
+        return 0;
+
+    }
+
+    /* Track the region being updated across consecutive flushes */
+    if (candidate_updated) {
+        guac_common_rect_extend(candidate, dirty_rect);
+        surface->video_candidate_frames++;
+    }
+    else {
+        *candidate = *dirty_rect;
+        surface->video_candidate_frames = 1;
+    }
+
+    if (surface->video_candidate_frames < GUAC_SURFACE_VIDEO_MIN_FRAMES)
+        return 0;
+
+    surface->video_candidate_frames = 0;
+
+    /* Video can be used only if all users can play it */
+    if (!surface->video_encoder->supported(surface->client))
+        return 0;
+
+    guac_common_rect rect = *candidate;
+    __guac_common_surface_align_video_rect(surface, &rect);
+    if (rect.width <= 0 || rect.height <= 0)
+        return 0;
+
+    surface->video = surface->video_encoder->alloc(surface->client,
+            surface->socket, surface->layer, &rect);
+
+    if (surface->video == NULL)
+        return 0;
+
+    surface->video_rect = rect;
+
+    guac_client_log(surface->client, GUAC_LOG_DEBUG, "Streaming %ix%i region "
+            "at (%i, %i) as video.", rect.width, rect.height, rect.x, rect.y);
+
+    /* Send the current contents of the region as the first frame, flushing
+     * as images any part of the dirty rect lying outside the video */
+    if (__guac_common_surface_write_video_frame(surface, now)) {
+        __guac_common_surface_stop_video(surface);
+        return 0;
+    }
+
+    surface->realized = 1;
+    if (guac_common_rect_intersects(dirty_rect, &rect) == 2) {
+        surface->dirty = 0;
+        return 1;
+    }
+
+    return 0;
+
+}
+
 static void __guac_common_surface_flush(guac_common_surface* surface) {
 
     /* Flush final dirty rectangle to queue. */
@@ -1940,27 +3114,40 @@ static void __guac_common_surface_flush(guac_common_surface* surface) {
                     && surface->bitmap_queue_length < GUAC_COMMON_SURFACE_QUEUE_SIZE)
                 __guac_common_surface_flush_to_queue(surface);
 
+            /* Stream as video if within a region updated like video */
+            else if (surface->dirty
+                    && __guac_common_surface_flush_to_video(surface))
+                flushed++;
+
             /* Flush as bitmap otherwise */
             else if (surface->dirty) {
 
                 flushed++;
 
-                int opaque = __guac_common_surface_is_opaque(surface,
-                            &surface->dirty_rect);
+                int webp = guac_client_supports_webp(surface->client);
 
-                /* Prefer WebP when reasonable */
-                if (__guac_common_surface_should_use_webp(surface,
-                            &surface->dirty_rect))
-                    __guac_common_surface_flush_to_webp(surface, opaque);
+                /* Favor lossy formats more heavily if the connection cannot
+                 * keep up with the data already sent */
+                int congested = guac_client_get_display_lag(surface->client)
+                    >= GUAC_SURFACE_CONGESTED_LAG;
 
-                /* If not WebP, JPEG is the next best (lossy) choice */
-                else if (opaque && __guac_common_surface_should_use_jpeg(
-                            surface, &surface->dirty_rect))
-                    __guac_common_surface_flush_to_jpeg(surface);
+                int lossy_framerate = congested
+                    ? GUAC_COMMON_SURFACE_CONGESTED_JPEG_FRAMERATE
+                    : GUAC_COMMON_SURFACE_JPEG_FRAMERATE;
+
+                /* Lossy formats are considered only for frequently-updated
+                 * regions, and only WebP offers a lossless alternative */
+                if ((webp || !surface->lossless)
+                        && __guac_common_surface_calculate_framerate(surface,
+                            &surface->dirty_rect) >= lossy_framerate)
+                    __guac_common_surface_flush_to_tiles(surface, webp,
+                            congested);
 
                 /* Use PNG if no lossy formats are appropriate */
                 else
-                    __guac_common_surface_flush_to_png(surface, opaque);
+                    __guac_common_surface_flush_to_png(surface,
+                            __guac_common_surface_is_opaque(surface,
+                                &surface->dirty_rect));
 
             }
 
@@ -1982,6 +3169,11 @@ void guac_common_surface_flush(guac_common_surface* surface) {
     /* Flush any applicable layer properties */
     __guac_common_surface_flush_properties(surface);
 
+    /* Revert to images if the streamed region has stopped changing */
+    if (surface->video != NULL && guac_timestamp_current()
+            - surface->video_last_frame >= GUAC_SURFACE_VIDEO_TIMEOUT)
+        __guac_common_surface_stop_video(surface);
+
     /* Flush surface contents */
     __guac_common_surface_flush(surface);
 
@@ -1998,6 +3190,10 @@ void guac_common_surface_dup(guac_common_surface* surface,
     if (!surface->realized)
         goto complete;
 
+    /* The new user cannot join a video already in progress, so revert to
+     * images until a new video can be started for all users */
+    __guac_common_surface_stop_video(surface);
+
     /* Synchronize layer-specific properties if applicable */
     if (surface->layer->index > 0) {
 
@@ -0,0 +1,93 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "common/json.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/socket.h>
+#include <guacamole/stream.h>
+#include <guacamole/user.h>
+
+#include <string.h>
+
+/**
+ * Write handler for the test socket which discards all data written.
+ */
+static ssize_t __discard_write(guac_socket* socket, const void* buf,
+        size_t count) {
+    return count;
+}
+
+/**
+ * Test which verifies that guac_common_json_write_string() copies ordinary
+ * characters verbatim while escaping quotes, backslashes, and control
+ * characters.
+ */
+void test_json__write_string() {
+
+    guac_common_json_state json_state;
+    guac_common_json_begin_object(NULL, NULL, &json_state);
+
+    /* Nothing is flushed while the buffer has room */
+    CU_ASSERT_EQUAL(guac_common_json_write_string(NULL, NULL, &json_state,
+                "a\"b\\c\nd\x01" "\xc3\xa9"), 0);
+
+    const char* expected = "{\"a\\\"b\\\\c\\nd\\u0001\xc3\xa9\"";
+    CU_ASSERT_EQUAL(json_state.size, strlen(expected));
+    CU_ASSERT_NSTRING_EQUAL(json_state.buffer, expected, json_state.size);
+
+}
+
+/**
+ * Test which verifies that JSON is batched until the buffer is full, and is
+ * then flushed as blobs no larger than the configured blob size.
+ */
+void test_json__batching() {
+
+    static char data[GUAC_COMMON_JSON_BUFFER_SIZE];
+    memset(data, 'x', sizeof(data));
+
+    guac_socket* socket = guac_socket_alloc();
+    socket->write_handler = __discard_write;
+
+    guac_user user = { .socket = socket };
+    guac_stream stream = { .index = 1 };
+
+    guac_common_json_state json_state;
+    guac_common_json_begin_object(&user, &stream, &json_state);
+    json_state.blob_size = 1000;
+
+    /* Filling the buffer exactly does not flush */
+    CU_ASSERT_EQUAL(guac_common_json_write(&user, &stream, &json_state,
+                data, sizeof(data) - 1), 0);
+    CU_ASSERT_EQUAL(json_state.size, GUAC_COMMON_JSON_BUFFER_SIZE);
+
+    /* Overflowing the buffer flushes it entirely as 1000-byte blobs */
+    CU_ASSERT_EQUAL(guac_common_json_write(&user, &stream, &json_state,
+                "yz", 2), (GUAC_COMMON_JSON_BUFFER_SIZE + 999) / 1000);
+    CU_ASSERT_EQUAL(json_state.size, 2);
+
+    /* Remaining data is sent by an explicit flush */
+    CU_ASSERT_EQUAL(guac_common_json_flush(&user, &stream, &json_state), 1);
+    CU_ASSERT_EQUAL(json_state.size, 0);
+    CU_ASSERT_EQUAL(guac_common_json_flush(&user, &stream, &json_state), 0);
+
+    guac_socket_free(socket);
+
+}
@@ -0,0 +1,214 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "common/surface.h"
+
+#include <CUnit/CUnit.h>
+#include <cairo/cairo.h>
+#include <guacamole/client.h>
+#include <guacamole/mem.h>
+#include <guacamole/socket.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * The width and height of the surface drawn to by each test, in pixels.
+ */
+#define TEST_SURFACE_SIZE 256
+
+/**
+ * Returns the color of the pixel at the given coordinates within an endless
+ * pattern in which every row and every column is distinct.
+ *
+ * @param x
+ *     The X coordinate of the pixel.
+ *
+ * @param y
+ *     The Y coordinate of the pixel.
+ *
+ * @return
+ *     The opaque color of the pixel, in the same format as the pixels of a
+ *     guac_common_surface.
+ */
+static uint32_t test_surface_pattern(int x, int y) {
+    uint32_t hash = (uint32_t) x * 2654435761u ^ (uint32_t) y * 2246822519u;
+    return 0xFF000000 | ((hash ^ (hash >> 15)) & 0xFFFFFF);
+}
+
+/**
+ * Draws the region of the test pattern having the given upper-left corner to
+ * the entirety of the given surface, flushes the surface, and returns whether
+ * a "copy" instruction was sent as a result.
+ *
+ * @param surface
+ *     The surface to draw to.
+ *
+ * @param output
+ *     The file receiving all data written to the socket of the surface.
+ *
+ * @param offset_x
+ *     The X coordinate, within the test pattern, of the upper-left corner of
+ *     the image drawn.
+ *
+ * @param offset_y
+ *     The Y coordinate, within the test pattern, of the upper-left corner of
+ *     the image drawn.
+ *
+ * @return
+ *     Non-zero if drawing the image caused a "copy" instruction to be sent,
+ *     zero otherwise.
+ */
+static int test_surface_draw_pattern(guac_common_surface* surface,
+        FILE* output, int offset_x, int offset_y) {
+
+    cairo_surface_t* image = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
+            TEST_SURFACE_SIZE, TEST_SURFACE_SIZE);
+
+    unsigned char* buffer = cairo_image_surface_get_data(image);
+    int stride = cairo_image_surface_get_stride(image);
+
+    /* Fill image with the requested region of the pattern, leaving the
+     * unused alpha channel of each pixel clear */
+    for (int y = 0; y < TEST_SURFACE_SIZE; y++) {
+        uint32_t* row = (uint32_t*) (buffer + y * stride);
+        for (int x = 0; x < TEST_SURFACE_SIZE; x++)
+            row[x] = test_surface_pattern(x + offset_x, y + offset_y)
+                & 0xFFFFFF;
+    }
+
+    cairo_surface_mark_dirty(image);
+
+    /* Ignore anything sent prior to this draw */
+    guac_socket_flush(surface->socket);
+    off_t start = lseek(fileno(output), 0, SEEK_CUR);
+
+    guac_common_surface_draw(surface, 0, 0, image);
+    guac_common_surface_flush(surface);
+    guac_socket_flush(surface->socket);
+    cairo_surface_destroy(image);
+
+    /* Read everything sent as a result of the draw */
+    off_t length = lseek(fileno(output), 0, SEEK_CUR) - start;
+    char* sent = guac_mem_alloc(length + 1);
+    CU_ASSERT_EQUAL_FATAL(pread(fileno(output), sent, length, start), length);
+    sent[length] = '\0';
+
+    int copied = strstr(sent, "4.copy,") != NULL;
+    guac_mem_free(sent);
+
+    return copied;
+
+}
+
+/**
+ * Draws the region of the test pattern having the given upper-left corner to
+ * a new surface, and then draws the region having the second upper-left
+ * corner, verifying whether the second draw was sent as a copy of the
+ * surface's existing contents and that the surface contains exactly the
+ * second region afterwards.
+ *
+ * @param first_x
+ *     The X coordinate, within the test pattern, of the first image drawn.
+ *
+ * @param first_y
+ *     The Y coordinate, within the test pattern, of the first image drawn.
+ *
+ * @param second_x
+ *     The X coordinate, within the test pattern, of the second image drawn.
+ *
+ * @param second_y
+ *     The Y coordinate, within the test pattern, of the second image drawn.
+ *
+ * @param expect_copy
+ *     Non-zero if the second draw is expected to send a "copy" instruction,
+ *     zero otherwise.
+ */
+static void test_surface_verify_scroll(int first_x, int first_y,
+        int second_x, int second_y, int expect_copy) {
+
+    FILE* output = tmpfile();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(output);
+
+    guac_client* client = guac_client_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+
+    /* The socket closes its file descriptor when freed */
+    guac_socket* socket = guac_socket_open(dup(fileno(output)));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(socket);
+
+    guac_common_surface* surface = guac_common_surface_alloc(client, socket,
+            GUAC_DEFAULT_LAYER, TEST_SURFACE_SIZE, TEST_SURFACE_SIZE);
+
+    /* Nothing can be copied into a blank surface */
+    CU_ASSERT_FALSE(test_surface_draw_pattern(surface, output,
+                first_x, first_y));
+
+    CU_ASSERT_EQUAL(test_surface_draw_pattern(surface, output,
+                second_x, second_y), expect_copy);
+
+    /* Surface must contain exactly the second image, regardless of how it
+     * was sent */
+    for (int y = 0; y < TEST_SURFACE_SIZE; y++) {
+        const uint32_t* row = (const uint32_t*)
+            (surface->buffer + y * surface->stride);
+        for (int x = 0; x < TEST_SURFACE_SIZE; x++) {
+            if (row[x] != test_surface_pattern(x + second_x, y + second_y)) {
+                CU_FAIL("Surface contents differ from the drawn image.");
+                y = TEST_SURFACE_SIZE;
+                break;
+            }
+        }
+    }
+
+    guac_common_surface_free(surface);
+    guac_socket_free(socket);
+    guac_client_free(client);
+    fclose(output);
+
+}
+
+/**
+ * Verifies that drawing an image which is the surface's existing contents
+ * scrolled vertically is sent as a copy of the scrolled rows.
+ */
+void test_surface__scroll_vertical() {
+    test_surface_verify_scroll(0, 0, 0, 32, 1);
+}
+
+/**
+ * Verifies that drawing an image which is the surface's existing contents
+ * scrolled horizontally is sent as a copy of the scrolled columns.
+ */
+void test_surface__scroll_horizontal() {
+    test_surface_verify_scroll(0, 0, 48, 0, 1);
+}
+
+/**
+ * Verifies that drawing an image which shares no rows or columns with the
+ * surface's existing contents is not sent as a copy.
+ */
+void test_surface__scroll_none() {
+    test_surface_verify_scroll(0, 0, 1000, 1000, 0);
+}
+
@@ -0,0 +1,296 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "common/surface.h"
+
+#include <CUnit/CUnit.h>
+#include <cairo/cairo.h>
+#include <guacamole/client.h>
+#include <guacamole/mem.h>
+#include <guacamole/protocol.h>
+#include <guacamole/socket.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * The width and height of the surface used by each test, in pixels.
+ */
+#define TEST_VIDEO_SURFACE_SIZE 512
+
+/**
+ * The width and height of the region of the surface which is repeatedly
+ * redrawn until it is streamed as video, in pixels.
+ */
+#define TEST_VIDEO_REGION_SIZE 256
+
+/**
+ * The maximum number of frames to draw while waiting for the surface to
+ * begin streaming the redrawn region as video.
+ */
+#define TEST_VIDEO_MAX_FRAMES 100
+
+/**
+ * The interval between frames, such that the redrawn region is updated at a
+ * framerate high enough to be streamed as video.
+ */
+static const struct timespec test_video_interval = {
+    .tv_sec = 0,
+    .tv_nsec = 20000000
+};
+
+/**
+ * The number of videos which have been started by the fake encoder and not
+ * yet freed.
+ */
+static int test_video_active = 0;
+
+/**
+ * Placeholder storage whose address serves as the video returned by the fake
+ * encoder.
+ */
+static int test_video_handle;
+
+/**
+ * Fake implementation of the supported function of a
+ * guac_common_surface_video_encoder which claims that all users can play
+ * video.
+ */
+static int test_video_supported(guac_client* client) {
+    return 1;
+}
+
+/**
+ * Fake implementation of the alloc function of a
+ * guac_common_surface_video_encoder which encodes nothing.
+ */
+static struct guac_common_video* test_video_alloc(guac_client* client,
+        guac_socket* socket, const guac_layer* parent,
+        const guac_common_rect* rect) {
+    test_video_active++;
+    return (struct guac_common_video*) &test_video_handle;
+}
+
+/**
+ * Fake implementation of the write_frame function of a
+ * guac_common_surface_video_encoder which discards each frame.
+ */
+static int test_video_write_frame(struct guac_common_video* video,
+        const unsigned char* buffer, int stride, guac_timestamp timestamp) {
+    return 0;
+}
+
+/**
+ * Fake implementation of the free function of a
+ * guac_common_surface_video_encoder.
+ */
+static void test_video_free(struct guac_common_video* video) {
+    test_video_active--;
+}
+
+/**
+ * Encoder which records when video is started and stopped without encoding
+ * anything.
+ */
+static const guac_common_surface_video_encoder test_video_encoder = {
+    .supported   = test_video_supported,
+    .alloc       = test_video_alloc,
+    .write_frame = test_video_write_frame,
+    .free        = test_video_free
+};
+
+/**
+ * Draws a new opaque frame to the upper-left TEST_VIDEO_REGION_SIZE pixels of
+ * the given surface and flushes the surface. Every pixel of each frame
+ * differs from the previous frame, and no frame is a scrolled copy of
+ * another.
+ *
+ * @param surface
+ *     The surface to draw to.
+ *
+ * @param frame
+ *     The number of the frame to draw.
+ */
+static void test_video_draw_frame(guac_common_surface* surface, int frame) {
+
+    cairo_surface_t* image = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
+            TEST_VIDEO_REGION_SIZE, TEST_VIDEO_REGION_SIZE);
+
+    unsigned char* buffer = cairo_image_surface_get_data(image);
+    int stride = cairo_image_surface_get_stride(image);
+
+    for (int y = 0; y < TEST_VIDEO_REGION_SIZE; y++) {
+        uint32_t* row = (uint32_t*) (buffer + y * stride);
+        for (int x = 0; x < TEST_VIDEO_REGION_SIZE; x++) {
+            uint32_t hash = (uint32_t) x * 2654435761u
+                          ^ (uint32_t) y * 2246822519u;
+            row[x] = ((hash ^ (hash >> 15)) ^ (frame * 0x010101)) & 0xFFFFFF;
+        }
+    }
+
+    cairo_surface_mark_dirty(image);
+    guac_common_surface_draw(surface, 0, 0, image);
+    guac_common_surface_flush(surface);
+    cairo_surface_destroy(image);
+
+}
+
+/**
+ * Returns whether the given instruction was sent to the given socket since
+ * the given offset within the file receiving its data.
+ *
+ * @param socket
+ *     The socket writing to the given file.
+ *
+ * @param output
+ *     The file receiving all data written to the given socket.
+ *
+ * @param start
+ *     The offset within the file from which to search.
+ *
+ * @param instruction
+ *     The length-prefixed opcode of the instruction to search for, including
+ *     its trailing comma, such as "4.copy,".
+ *
+ * @return
+ *     Non-zero if the instruction was sent, zero otherwise.
+ */
+static int test_video_sent(guac_socket* socket, FILE* output, off_t start,
+        const char* instruction) {
+
+    guac_socket_flush(socket);
+
+    off_t length = lseek(fileno(output), 0, SEEK_CUR) - start;
+    char* sent = guac_mem_alloc(length + 1);
+    CU_ASSERT_EQUAL_FATAL(pread(fileno(output), sent, length, start), length);
+    sent[length] = '\0';
+
+    int found = strstr(sent, instruction) != NULL;
+    guac_mem_free(sent);
+
+    return found;
+
+}
+
+/**
+ * Streams the upper-left region of a new surface as video using the fake
+ * encoder, then copies or transfers the given rectangle to the lower-right
+ * corner of that surface, verifying whether the operation was sent to the
+ * client as-is or deferred and sent as an image.
+ *
+ * @param sx
+ *     The X coordinate of the upper-left corner of the source rectangle.
+ *
+ * @param sy
+ *     The Y coordinate of the upper-left corner of the source rectangle.
+ *
+ * @param transfer
+ *     Non-zero to perform a transfer, zero to perform a copy.
+ *
+ * @param expect_deferred
+ *     Non-zero if the operation is expected to be deferred, zero if it is
+ *     expected to be sent as-is.
+ */
+static void test_video_verify_source(int sx, int sy, int transfer,
+        int expect_deferred) {
+
+    FILE* output = tmpfile();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(output);
+
+    guac_client* client = guac_client_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+
+    /* The socket closes its file descriptor when freed */
+    guac_socket* socket = guac_socket_open(dup(fileno(output)));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(socket);
+
+    guac_common_surface* surface = guac_common_surface_alloc(client, socket,
+            GUAC_DEFAULT_LAYER, TEST_VIDEO_SURFACE_SIZE,
+            TEST_VIDEO_SURFACE_SIZE);
+
+    guac_common_surface_set_video(surface, &test_video_encoder);
+
+    /* Redraw the region rapidly until it is streamed as video */
+    for (int frame = 0; frame < TEST_VIDEO_MAX_FRAMES
+            && !test_video_active; frame++) {
+        test_video_draw_frame(surface, frame);
+        nanosleep(&test_video_interval, NULL);
+    }
+
+    CU_ASSERT_EQUAL_FATAL(test_video_active, 1);
+
+    /* Ignore anything sent prior to the operation being tested */
+    guac_socket_flush(socket);
+    off_t start = lseek(fileno(output), 0, SEEK_CUR);
+
+    const char* opcode = "4.copy,";
+    if (transfer) {
+        opcode = "8.transfer,";
+        guac_common_surface_transfer(surface, sx, sy, 64, 64,
+                GUAC_TRANSFER_BINARY_SRC, surface, 400, 400);
+    }
+    else
+        guac_common_surface_copy(surface, sx, sy, 64, 64, surface, 400, 400);
+
+    CU_ASSERT_EQUAL(test_video_sent(socket, output, start, opcode),
+            !expect_deferred);
+
+    /* A deferred operation must instead be sent as an image */
+    guac_common_surface_flush(surface);
+    CU_ASSERT_EQUAL(test_video_sent(socket, output, start, "3.img,"),
+            expect_deferred);
+
+    guac_common_surface_free(surface);
+    CU_ASSERT_EQUAL(test_video_active, 0);
+
+    guac_socket_free(socket);
+    guac_client_free(client);
+    fclose(output);
+
+}
+
+/**
+ * Verifies that copies whose source lies within a region streamed as video
+ * are deferred, as the layer beneath the video is stale.
+ */
+void test_surface__video_copy_source() {
+    test_video_verify_source(32, 32, 0, 1);
+}
+
+/**
+ * Verifies that transfers whose source lies within a region streamed as
+ * video are deferred, as the layer beneath the video is stale.
+ */
+void test_surface__video_transfer_source() {
+    test_video_verify_source(32, 32, 1, 1);
+}
+
+/**
+ * Verifies that copies whose source lies entirely outside any region
+ * streamed as video are still sent to the client as-is.
+ */
+void test_surface__video_copy_outside() {
+    test_video_verify_source(300, 300, 0, 0);
+}
+
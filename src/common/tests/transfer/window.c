@@ -0,0 +1,101 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "common/transfer.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/protocol-constants.h>
+
+/**
+ * Test which verifies that guac_common_transfer_init() applies defaults and
+ * limits to the requested window and chunk sizes.
+ */
+void test_transfer__init() {
+
+    guac_common_transfer transfer;
+
+    /* Defaults */
+    guac_common_transfer_init(&transfer, 0, 0);
+    CU_ASSERT_EQUAL(transfer.max_window, GUAC_COMMON_TRANSFER_DEFAULT_MAX_WINDOW);
+    CU_ASSERT_EQUAL(transfer.chunk_size, GUAC_COMMON_TRANSFER_DEFAULT_CHUNK_SIZE);
+    CU_ASSERT_EQUAL(guac_common_transfer_available(&transfer),
+            GUAC_COMMON_TRANSFER_INITIAL_WINDOW);
+
+    /* Limits */
+    guac_common_transfer_init(&transfer, 100000, 100000);
+    CU_ASSERT_EQUAL(transfer.max_window, GUAC_COMMON_TRANSFER_MAX_WINDOW);
+    CU_ASSERT_EQUAL(transfer.chunk_size, GUAC_PROTOCOL_BLOB_MAX_LENGTH);
+
+    /* Initial window never exceeds maximum */
+    guac_common_transfer_init(&transfer, 1, 1024);
+    CU_ASSERT_EQUAL(transfer.chunk_size, 1024);
+    CU_ASSERT_EQUAL(guac_common_transfer_available(&transfer), 1);
+
+}
+
+/**
+ * Test which verifies that the transfer window grows as blobs are promptly
+ * acknowledged, that the initial "ack" of the stream itself is not counted
+ * against any blob, and that the transfer is complete only once every blob
+ * has been acknowledged after the end of the file.
+ */
+void test_transfer__window() {
+
+    guac_common_transfer transfer;
+    guac_common_transfer_init(&transfer, 8, 0);
+
+    /* Ack of stream itself changes nothing */
+    guac_common_transfer_acked(&transfer);
+    CU_ASSERT_EQUAL(guac_common_transfer_available(&transfer),
+            GUAC_COMMON_TRANSFER_INITIAL_WINDOW);
+
+    /* Fill initial window */
+    for (int i = 0; i < GUAC_COMMON_TRANSFER_INITIAL_WINDOW; i++)
+        guac_common_transfer_sent(&transfer);
+
+    CU_ASSERT_EQUAL(guac_common_transfer_available(&transfer), 0);
+
+    /* Each prompt ack frees a slot and grows the window by one */
+    guac_common_transfer_acked(&transfer);
+    CU_ASSERT_EQUAL(guac_common_transfer_available(&transfer), 2);
+
+    /* Window never grows beyond maximum */
+    for (int i = 0; i < 20; i++) {
+        while (guac_common_transfer_available(&transfer) > 0)
+            guac_common_transfer_sent(&transfer);
+        guac_common_transfer_acked(&transfer);
+    }
+
+    CU_ASSERT_EQUAL(transfer.window, 8);
+    CU_ASSERT_EQUAL(transfer.in_flight, 7);
+
+    /* Transfer is complete only once all blobs are acknowledged */
+    transfer.eof = 1;
+    CU_ASSERT_EQUAL(guac_common_transfer_available(&transfer), 0);
+
+    for (int i = 0; i < 7; i++) {
+        CU_ASSERT_FALSE(guac_common_transfer_complete(&transfer));
+        guac_common_transfer_acked(&transfer);
+    }
+
+    CU_ASSERT_TRUE(guac_common_transfer_complete(&transfer));
+
+}
+
@@ -0,0 +1,428 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "common/upload.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/client.h>
+#include <guacamole/mem.h>
+#include <guacamole/protocol-constants.h>
+#include <guacamole/socket.h>
+#include <guacamole/stream.h>
+#include <guacamole/user.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * The total number of bytes uploaded by each test which completes its
+ * upload. This is deliberately larger than the upload buffer, such that the
+ * sending side must wait for the writer thread.
+ */
+#define TEST_UPLOAD_LENGTH (GUAC_COMMON_UPLOAD_BUFFER_SIZE * 3)
+
+/**
+ * The maximum number of 10ms intervals to wait for the writer thread of an
+ * abandoned upload to notice that the uploading user has left.
+ */
+#define TEST_UPLOAD_MAX_ABANDON_WAIT (GUAC_COMMON_UPLOAD_IDLE_INTERVAL / 2)
+
+/**
+ * The interval to wait between each check of a condition that is satisfied
+ * asynchronously.
+ */
+static const struct timespec test_upload_interval = {
+    .tv_sec = 0,
+    .tv_nsec = 10000000
+};
+
+/**
+ * In-memory destination "file" receiving the data of an upload.
+ */
+typedef struct test_upload_file {
+
+    /**
+     * Lock which must be held while accessing the members of this structure.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * All data written to the file, exactly TEST_UPLOAD_LENGTH bytes in size.
+     */
+    char* data;
+
+    /**
+     * The number of bytes written to the file.
+     */
+    size_t length;
+
+    /**
+     * The number of times the file has been closed.
+     */
+    int closed;
+
+} test_upload_file;
+
+/**
+ * Write handler which appends the given data to the test_upload_file
+ * associated with the given upload.
+ *
+ * @param upload
+ *     The upload receiving the data.
+ *
+ * @param buffer
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes of data to write.
+ *
+ * @return
+ *     Zero if the data was written, non-zero if the file is full.
+ */
+static int test_upload_write(guac_common_upload* upload,
+        const char* buffer, int length) {
+
+    test_upload_file* file = (test_upload_file*) upload->data;
+    int result = 0;
+
+    pthread_mutex_lock(&file->lock);
+
+    if (file->length + length > TEST_UPLOAD_LENGTH)
+        result = 1;
+    else {
+        memcpy(file->data + file->length, buffer, length);
+        file->length += length;
+    }
+
+    pthread_mutex_unlock(&file->lock);
+    return result;
+
+}
+
+/**
+ * Close handler which counts the number of times the test_upload_file
+ * associated with the given upload has been closed.
+ *
+ * @param upload
+ *     The upload which has finished.
+ *
+ * @return
+ *     Always zero.
+ */
+static int test_upload_close(guac_common_upload* upload) {
+
+    test_upload_file* file = (test_upload_file*) upload->data;
+
+    pthread_mutex_lock(&file->lock);
+    file->closed++;
+    pthread_mutex_unlock(&file->lock);
+
+    return 0;
+
+}
+
+/**
+ * Returns the number of times the given file has been closed.
+ *
+ * @param file
+ *     The file to test.
+ *
+ * @return
+ *     The number of times the given file has been closed.
+ */
+static int test_upload_get_closed(test_upload_file* file) {
+
+    pthread_mutex_lock(&file->lock);
+    int closed = file->closed;
+    pthread_mutex_unlock(&file->lock);
+
+    return closed;
+
+}
+
+/**
+ * Callback for guac_client_for_user() which returns the given user, such that
+ * the result of guac_client_for_user() is non-NULL only if that user has
+ * fully joined the connection.
+ *
+ * @param user
+ *     The user in question, or NULL if that user is not connected.
+ *
+ * @param data
+ *     Ignored.
+ *
+ * @return
+ *     The given user.
+ */
+static void* test_upload_user_present(guac_user* user, void* data) {
+    return user;
+}
+
+/**
+ * Adds a new user to the given client, waiting for that user to be promoted
+ * from a pending user to a full user. All data sent to the user is
+ * discarded.
+ *
+ * @param client
+ *     The client that the user should join.
+ *
+ * @return
+ *     The newly-joined user.
+ */
+static guac_user* test_upload_join(guac_client* client) {
+
+    guac_user* user = guac_user_alloc();
+    user->client = client;
+    user->socket = guac_socket_open(open("/dev/null", O_WRONLY));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(user->socket);
+
+    CU_ASSERT_FATAL(guac_client_add_user(client, user, 0, NULL) == 0);
+
+    while (guac_client_for_user(client, user,
+                test_upload_user_present, NULL) == NULL)
+        nanosleep(&test_upload_interval, NULL);
+
+    return user;
+
+}
+
+/**
+ * Removes the given user from the given client and frees that user.
+ *
+ * @param client
+ *     The client that the user should leave.
+ *
+ * @param user
+ *     The user to remove and free.
+ */
+static void test_upload_leave(guac_client* client, guac_user* user) {
+    guac_client_remove_user(client, user);
+    guac_socket_free(user->socket);
+    guac_user_free(user);
+}
+
+/**
+ * Initializes the given in-memory destination file.
+ *
+ * @param file
+ *     The file to initialize.
+ */
+static void test_upload_file_init(test_upload_file* file) {
+    pthread_mutex_init(&file->lock, NULL);
+    file->data = guac_mem_alloc(TEST_UPLOAD_LENGTH);
+    file->length = 0;
+    file->closed = 0;
+}
+
+/**
+ * Frees all data associated with the given in-memory destination file.
+ *
+ * @param file
+ *     The file to free.
+ */
+static void test_upload_file_destroy(test_upload_file* file) {
+    pthread_mutex_destroy(&file->lock);
+    guac_mem_free(file->data);
+}
+
+/**
+ * Sends the given number of bytes of test data along the given upload, as
+ * full-size blobs. Each byte of test data is derived from its offset within
+ * the upload.
+ *
+ * @param upload
+ *     The upload to send test data along.
+ *
+ * @param length
+ *     The number of bytes of test data to send.
+ */
+static void test_upload_send(guac_common_upload* upload, size_t length) {
+
+    char blob[GUAC_PROTOCOL_BLOB_MAX_LENGTH];
+    size_t offset = 0;
+
+    while (offset < length) {
+
+        size_t blob_length = length - offset;
+        if (blob_length > sizeof(blob))
+            blob_length = sizeof(blob);
+
+        for (size_t i = 0; i < blob_length; i++)
+            blob[i] = (char) ((offset + i) * 31 / 7);
+
+        guac_common_upload_write(upload, blob, blob_length);
+        offset += blob_length;
+
+    }
+
+}
+
+/**
+ * Verifies that the first length bytes of the given file match the data sent
+ * by test_upload_send().
+ *
+ * @param file
+ *     The file to verify.
+ *
+ * @param length
+ *     The number of bytes to verify.
+ */
+static void test_upload_verify(test_upload_file* file, size_t length) {
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (file->data[i] != (char) (i * 31 / 7))
+            mismatches++;
+    }
+
+    CU_ASSERT_EQUAL(mismatches, 0);
+
+}
+
+/**
+ * Test which verifies that all data sent along an upload which is ended
+ * normally is written in order, that the destination file is closed exactly
+ * once, and that the upload is removed from its list.
+ */
+void test_upload__complete() {
+
+    guac_client* client = guac_client_alloc();
+    guac_user* user = test_upload_join(client);
+    guac_common_upload_list* list = guac_common_upload_list_alloc();
+
+    test_upload_file file;
+    test_upload_file_init(&file);
+
+    guac_stream stream = { .index = 0 };
+    guac_common_upload* upload = guac_common_upload_alloc(list, user,
+            &stream, test_upload_write, test_upload_close, &file);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(upload);
+    CU_ASSERT_PTR_EQUAL(list->head, upload);
+
+    test_upload_send(upload, TEST_UPLOAD_LENGTH);
+    guac_common_upload_end(upload);
+
+    /* All data must have been written before the file was closed */
+    CU_ASSERT_EQUAL(file.length, TEST_UPLOAD_LENGTH);
+    CU_ASSERT_EQUAL(file.closed, 1);
+    test_upload_verify(&file, file.length);
+
+    CU_ASSERT_PTR_NULL(list->head);
+
+    guac_common_upload_list_free(list);
+    CU_ASSERT_EQUAL(file.closed, 1);
+
+    test_upload_file_destroy(&file);
+    test_upload_leave(client, user);
+    guac_client_free(client);
+
+}
+
+/**
+ * Test which verifies that an upload whose user leaves without ending the
+ * stream is closed by its writer thread, and is freed the next time an upload
+ * is allocated within the same list.
+ */
+void test_upload__abandoned() {
+
+    guac_client* client = guac_client_alloc();
+    guac_user* user = test_upload_join(client);
+    guac_common_upload_list* list = guac_common_upload_list_alloc();
+
+    test_upload_file file;
+    test_upload_file_init(&file);
+
+    guac_stream stream = { .index = 0 };
+    guac_common_upload* upload = guac_common_upload_alloc(list, user,
+            &stream, test_upload_write, test_upload_close, &file);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(upload);
+
+    /* Leave without ending the stream */
+    test_upload_send(upload, GUAC_COMMON_UPLOAD_BUFFER_SIZE / 2);
+    test_upload_leave(client, user);
+
+    for (int i = 0; i < TEST_UPLOAD_MAX_ABANDON_WAIT
+            && test_upload_get_closed(&file) == 0; i++)
+        nanosleep(&test_upload_interval, NULL);
+
+    /* The abandoned upload must be closed, yet remain tracked */
+    CU_ASSERT_EQUAL_FATAL(test_upload_get_closed(&file), 1);
+    CU_ASSERT_PTR_EQUAL(list->head, upload);
+
+    /* The next upload must free the remains of the abandoned upload */
+    test_upload_file next_file;
+    test_upload_file_init(&next_file);
+
+    guac_user* next_user = test_upload_join(client);
+    guac_common_upload* next_upload = guac_common_upload_alloc(list,
+            next_user, &stream, test_upload_write, test_upload_close,
+            &next_file);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(next_upload);
+    CU_ASSERT_PTR_EQUAL(list->head, next_upload);
+    CU_ASSERT_PTR_NULL(next_upload->next);
+
+    guac_common_upload_end(next_upload);
+    CU_ASSERT_EQUAL(next_file.closed, 1);
+
+    guac_common_upload_list_free(list);
+    CU_ASSERT_EQUAL(file.closed, 1);
+
+    test_upload_file_destroy(&file);
+    test_upload_file_destroy(&next_file);
+    test_upload_leave(client, next_user);
+    guac_client_free(client);
+
+}
+
+/**
+ * Test which verifies that freeing a list of uploads closes the file of any
+ * upload which has not yet ended, exactly once, before returning.
+ */
+void test_upload__cancelled() {
+
+    guac_client* client = guac_client_alloc();
+    guac_user* user = test_upload_join(client);
+    guac_common_upload_list* list = guac_common_upload_list_alloc();
+
+    test_upload_file file;
+    test_upload_file_init(&file);
+
+    guac_stream stream = { .index = 0 };
+    guac_common_upload* upload = guac_common_upload_alloc(list, user,
+            &stream, test_upload_write, test_upload_close, &file);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(upload);
+
+    test_upload_send(upload, GUAC_COMMON_UPLOAD_BUFFER_SIZE / 2);
+
+    /* The file must be closed by the time the list is freed */
+    guac_common_upload_list_free(list);
+    CU_ASSERT_EQUAL(file.closed, 1);
+
+    /* Any data that was written must be intact */
+    CU_ASSERT(file.length <= GUAC_COMMON_UPLOAD_BUFFER_SIZE / 2);
+    test_upload_verify(&file, file.length);
+
+    test_upload_file_destroy(&file);
+    test_upload_leave(client, user);
+    guac_client_free(client);
+
+}
@@ -0,0 +1,114 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "common/transfer.h"
+
+#include <guacamole/protocol-constants.h>
+#include <guacamole/timestamp.h>
+
+void guac_common_transfer_init(guac_common_transfer* transfer,
+        int max_window, int chunk_size) {
+
+    /* Use defaults for unspecified values */
+    if (max_window <= 0)
+        max_window = GUAC_COMMON_TRANSFER_DEFAULT_MAX_WINDOW;
+
+    if (chunk_size <= 0)
+        chunk_size = GUAC_COMMON_TRANSFER_DEFAULT_CHUNK_SIZE;
+
+    /* Enforce hard limits */
+    if (max_window > GUAC_COMMON_TRANSFER_MAX_WINDOW)
+        max_window = GUAC_COMMON_TRANSFER_MAX_WINDOW;
+
+    if (chunk_size > GUAC_PROTOCOL_BLOB_MAX_LENGTH)
+        chunk_size = GUAC_PROTOCOL_BLOB_MAX_LENGTH;
+
+    transfer->chunk_size = chunk_size;
+    transfer->max_window = max_window;
+
+    /* Begin with a small window, growing as acknowledgements arrive */
+    transfer->window = GUAC_COMMON_TRANSFER_INITIAL_WINDOW;
+    if (transfer->window > max_window)
+        transfer->window = max_window;
+
+    transfer->in_flight = 0;
+    transfer->oldest = 0;
+    transfer->min_rtt = -1;
+    transfer->eof = 0;
+
+}
+
+int guac_common_transfer_available(guac_common_transfer* transfer) {
+
+    /* Nothing further may be sent after the end of the file */
+    if (transfer->eof)
+        return 0;
+
+    int available = transfer->window - transfer->in_flight;
+    return available > 0 ? available : 0;
+
+}
+
+void guac_common_transfer_sent(guac_common_transfer* transfer) {
+
+    /* Record time that the blob was sent, ignoring any blobs beyond the
+     * largest possible window (which should never happen) */
+    if (transfer->in_flight < GUAC_COMMON_TRANSFER_MAX_WINDOW) {
+        int index = (transfer->oldest + transfer->in_flight)
+            % GUAC_COMMON_TRANSFER_MAX_WINDOW;
+        transfer->sent[index] = guac_timestamp_current();
+    }
+
+    transfer->in_flight++;
+
+}
+
+void guac_common_transfer_acked(guac_common_transfer* transfer) {
+
+    /* An ack received while nothing is in flight acknowledges the stream */
+    if (transfer->in_flight == 0)
+        return;
+
+    /* Acknowledgements are received in the order blobs were sent */
+    int rtt = guac_timestamp_current() - transfer->sent[transfer->oldest];
+    transfer->oldest = (transfer->oldest + 1) % GUAC_COMMON_TRANSFER_MAX_WINDOW;
+    transfer->in_flight--;
+
+    if (transfer->min_rtt == -1 || rtt < transfer->min_rtt)
+        transfer->min_rtt = rtt;
+
+    /* Grow window while blobs are not queueing ... */
+    if (rtt <= transfer->min_rtt + GUAC_COMMON_TRANSFER_TARGET_DELAY) {
+        if (transfer->window < transfer->max_window)
+            transfer->window++;
+    }
+
+    /* ... and shrink window once they are */
+    else if (transfer->window > 1)
+        transfer->window--;
+
+}
+
+int guac_common_transfer_complete(guac_common_transfer* transfer) {
+    return transfer->eof && transfer->in_flight == 0;
+}
+
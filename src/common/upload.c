@@ -0,0 +1,523 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "common/upload.h"
+
+#include <guacamole/client.h>
+#include <guacamole/mem.h>
+#include <guacamole/protocol.h>
+#include <guacamole/socket.h>
+#include <guacamole/stream.h>
+#include <guacamole/user.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Returns the number of bytes of free space within the buffer of the given
+ * upload.
+ *
+ * IMPORTANT: The upload's lock MUST already be held when invoking this
+ * function.
+ *
+ * @param upload
+ *     The upload to test.
+ *
+ * @return
+ *     The number of bytes of free space within the upload's buffer.
+ */
+static size_t guac_common_upload_free_space(guac_common_upload* upload) {
+    return GUAC_COMMON_UPLOAD_BUFFER_SIZE - (upload->head - upload->tail);
+}
+
+/**
+ * Sends an "ack" for a single received blob (or for the end of the stream)
+ * to the user sending the given upload, reporting failure if any write has
+ * failed. This function is suitable for use with guac_client_for_user(),
+ * and sends nothing if the user is NULL (has left).
+ *
+ * IMPORTANT: The upload's lock MUST already be held when invoking this
+ * function, unless the writer thread has already been joined.
+ *
+ * @param user
+ *     The user sending the upload, or NULL if that user has left.
+ *
+ * @param data
+ *     The guac_common_upload being acknowledged.
+ *
+ * @return
+ *     The given user.
+ */
+static void* guac_common_upload_ack(guac_user* user, void* data) {
+
+    guac_common_upload* upload = (guac_common_upload*) data;
+
+    if (user == NULL)
+        return NULL;
+
+    if (upload->failed)
+        guac_protocol_send_ack(user->socket, upload->stream,
+                upload->message, upload->status);
+    else
+        guac_protocol_send_ack(user->socket, upload->stream,
+                "OK (DATA RECEIVED)", GUAC_PROTOCOL_STATUS_SUCCESS);
+
+    guac_socket_flush(user->socket);
+    return user;
+
+}
+
+/**
+ * Callback for guac_client_for_user() which simply returns the given user,
+ * such that the return value of guac_client_for_user() is non-NULL only if
+ * that user is still connected.
+ *
+ * @param user
+ *     The user in question, or NULL if that user has left.
+ *
+ * @param data
+ *     Ignored.
+ *
+ * @return
+ *     The given user.
+ */
+static void* guac_common_upload_user_present(guac_user* user, void* data) {
+    return user;
+}
+
+/**
+ * Sends any "ack" instructions that were deferred because the buffer of the
+ * given upload was full, if the buffer now has space for another blob (or if
+ * a write has failed, in which case failure is reported). The "ack"
+ * instructions are sent through guac_client_for_user(), as the uploading
+ * user may have left.
+ *
+ * IMPORTANT: The upload's lock MUST already be held when invoking this
+ * function.
+ *
+ * @param upload
+ *     The upload whose deferred "ack" instructions should be sent.
+ */
+static void guac_common_upload_send_pending_acks(guac_common_upload* upload) {
+
+    if (!upload->failed && guac_common_upload_free_space(upload)
+            < GUAC_PROTOCOL_BLOB_MAX_LENGTH)
+        return;
+
+    while (upload->acks_pending > 0) {
+        guac_client_for_user(upload->client, upload->user,
+                guac_common_upload_ack, upload);
+        upload->acks_pending--;
+    }
+
+}
+
+/**
+ * Frees the given upload and its buffer. The writer thread must already have
+ * been joined, and the upload must no longer be within its list.
+ *
+ * @param upload
+ *     The upload to free.
+ */
+static void guac_common_upload_free(guac_common_upload* upload) {
+    pthread_mutex_destroy(&upload->lock);
+    pthread_cond_destroy(&upload->modified);
+    guac_mem_free(upload->buffer);
+    guac_mem_free(upload);
+}
+
+/**
+ * Removes the given upload from its list, if it is still within that list.
+ *
+ * IMPORTANT: The lock of the upload's list MUST already be held when invoking
+ * this function.
+ *
+ * @param upload
+ *     The upload to remove.
+ */
+static void guac_common_upload_unlink(guac_common_upload* upload) {
+
+    guac_common_upload** current = &upload->list->head;
+    while (*current != NULL) {
+
+        if (*current == upload) {
+            *current = upload->next;
+            upload->next = NULL;
+            return;
+        }
+
+        current = &(*current)->next;
+
+    }
+
+}
+
+/**
+ * Joins the writer threads of and frees all uploads within the given list
+ * which were abandoned by their users.
+ *
+ * @param list
+ *     The list of uploads to search for abandoned uploads.
+ */
+static void guac_common_upload_list_reap(guac_common_upload_list* list) {
+
+    guac_common_upload* abandoned = NULL;
+
+    /* Remove all abandoned uploads from the list */
+    pthread_mutex_lock(&list->lock);
+
+    guac_common_upload** current = &list->head;
+    while (*current != NULL) {
+
+        guac_common_upload* upload = *current;
+
+        pthread_mutex_lock(&upload->lock);
+        int is_abandoned = upload->abandoned;
+        pthread_mutex_unlock(&upload->lock);
+
+        if (is_abandoned) {
+            *current = upload->next;
+            upload->next = abandoned;
+            abandoned = upload;
+        }
+        else
+            current = &upload->next;
+
+    }
+
+    pthread_mutex_unlock(&list->lock);
+
+    /* Each writer thread has already closed its file and is exiting */
+    while (abandoned != NULL) {
+        guac_common_upload* next = abandoned->next;
+        pthread_join(abandoned->writer_thread, NULL);
+        guac_common_upload_free(abandoned);
+        abandoned = next;
+    }
+
+}
+
+guac_common_upload_list* guac_common_upload_list_alloc() {
+
+    guac_common_upload_list* list =
+        guac_mem_zalloc(sizeof(guac_common_upload_list));
+
+    pthread_mutex_init(&list->lock, NULL);
+    return list;
+
+}
+
+void guac_common_upload_list_free(guac_common_upload_list* list) {
+
+    /* Take ownership of all remaining uploads */
+    pthread_mutex_lock(&list->lock);
+    guac_common_upload* current = list->head;
+    list->head = NULL;
+    pthread_mutex_unlock(&list->lock);
+
+    while (current != NULL) {
+
+        guac_common_upload* next = current->next;
+
+        /* Stop writing, waiting for the writer thread to close the file */
+        pthread_mutex_lock(&current->lock);
+        current->cancelled = 1;
+        pthread_cond_broadcast(&current->modified);
+        pthread_mutex_unlock(&current->lock);
+
+        pthread_join(current->writer_thread, NULL);
+        guac_common_upload_free(current);
+
+        current = next;
+
+    }
+
+    pthread_mutex_destroy(&list->lock);
+    guac_mem_free(list);
+
+}
+
+/**
+ * Waits for data to be received for the given upload, for the stream to end,
+ * or for the idle interval to elapse, whichever happens first.
+ *
+ * IMPORTANT: The upload's lock MUST already be held when invoking this
+ * function. The lock is released while waiting and reacquired before this
+ * function returns.
+ *
+ * @param upload
+ *     The upload to wait for.
+ *
+ * @return
+ *     Zero if the wait ended due to a change in state, ETIMEDOUT if the idle
+ *     interval elapsed.
+ */
+static int guac_common_upload_wait(guac_common_upload* upload) {
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+
+    uint64_t nsecs = deadline.tv_nsec
+        + (uint64_t) GUAC_COMMON_UPLOAD_IDLE_INTERVAL * 1000000;
+
+    deadline.tv_sec += nsecs / 1000000000;
+    deadline.tv_nsec = nsecs % 1000000000;
+
+    return pthread_cond_timedwait(&upload->modified, &upload->lock, &deadline);
+
+}
+
+/**
+ * Writes all data received for the given upload to the destination file,
+ * in order, until the stream has ended and all buffered data has been
+ * written. If the uploading user leaves without ending the stream, or if the
+ * upload is cancelled, the destination file is closed by this thread and the
+ * upload is marked as abandoned. Abandoned uploads are freed by whichever of
+ * guac_common_upload_alloc() or guac_common_upload_list_free() next
+ * encounters them.
+ *
+ * @param data
+ *     The guac_common_upload whose data should be written.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_common_upload_writer_thread(void* data) {
+
+    guac_common_upload* upload = (guac_common_upload*) data;
+
+    pthread_mutex_lock(&upload->lock);
+
+    for (;;) {
+
+        /* Wait for data, checking periodically that the user is still
+         * around to send it */
+        while (upload->head == upload->tail && !upload->ended
+                && !upload->cancelled) {
+            if (guac_common_upload_wait(upload) == ETIMEDOUT
+                    && guac_client_for_user(upload->client, upload->user,
+                        guac_common_upload_user_present, NULL) == NULL)
+                goto abandoned;
+        }
+
+        /* Discard any unwritten data if the upload has been cancelled */
+        if (upload->cancelled)
+            goto abandoned;
+
+        /* Stop once stream has ended and everything has been written */
+        if (upload->head == upload->tail)
+            break;
+
+        /* Write as much contiguous data as possible */
+        size_t offset = upload->tail % GUAC_COMMON_UPLOAD_BUFFER_SIZE;
+        size_t length = upload->head - upload->tail;
+
+        if (length > GUAC_COMMON_UPLOAD_BUFFER_SIZE - offset)
+            length = GUAC_COMMON_UPLOAD_BUFFER_SIZE - offset;
+
+        if (length > GUAC_COMMON_UPLOAD_MAX_WRITE)
+            length = GUAC_COMMON_UPLOAD_MAX_WRITE;
+
+        /* The receiving side never touches data that has not yet been
+         * written, so the lock need not be held while writing */
+        if (!upload->failed) {
+
+            pthread_mutex_unlock(&upload->lock);
+            int result = upload->write_handler(upload,
+                    upload->buffer + offset, length);
+            pthread_mutex_lock(&upload->lock);
+
+            if (result) {
+                guac_client_log(upload->client, GUAC_LOG_INFO, "Upload "
+                        "failed: %s", upload->message);
+                upload->failed = 1;
+            }
+
+        }
+
+        /* Discard everything upon failure */
+        upload->tail += length;
+        if (upload->failed)
+            upload->tail = upload->head;
+
+        guac_common_upload_send_pending_acks(upload);
+        pthread_cond_broadcast(&upload->modified);
+
+    }
+
+    pthread_mutex_unlock(&upload->lock);
+    return NULL;
+
+abandoned:
+
+    /* The end handler will never be invoked, as the user has left (or the
+     * connection is being torn down) */
+    pthread_mutex_unlock(&upload->lock);
+
+    guac_client_log(upload->client, GUAC_LOG_DEBUG, "Upload abandoned as "
+            "the uploading user has left.");
+
+    upload->close_handler(upload);
+
+    /* Release buffer immediately, as the upload itself is freed only once
+     * its list is next inspected, failing any further writes */
+    pthread_mutex_lock(&upload->lock);
+    guac_mem_free(upload->buffer);
+    upload->failed = 1;
+    upload->abandoned = 1;
+    pthread_cond_broadcast(&upload->modified);
+    pthread_mutex_unlock(&upload->lock);
+
+    return NULL;
+
+}
+
+guac_common_upload* guac_common_upload_alloc(guac_common_upload_list* list,
+        guac_user* user, guac_stream* stream,
+        guac_common_upload_write_handler* write_handler,
+        guac_common_upload_close_handler* close_handler, void* data) {
+
+    /* Free the remains of any uploads abandoned since the last upload */
+    guac_common_upload_list_reap(list);
+
+    guac_common_upload* upload = guac_mem_zalloc(sizeof(guac_common_upload));
+    upload->client = user->client;
+    upload->user = user;
+    upload->stream = stream;
+    upload->write_handler = write_handler;
+    upload->close_handler = close_handler;
+    upload->data = data;
+    upload->list = list;
+    upload->buffer = guac_mem_alloc(GUAC_COMMON_UPLOAD_BUFFER_SIZE);
+
+    /* Report generic failure unless handlers provide more detail */
+    upload->status = GUAC_PROTOCOL_STATUS_SERVER_ERROR;
+    upload->message = "FAIL (UPLOAD FAILED)";
+
+    pthread_mutex_init(&upload->lock, NULL);
+    pthread_cond_init(&upload->modified, NULL);
+
+    /* Begin writing received data in the background */
+    if (pthread_create(&upload->writer_thread, NULL,
+                guac_common_upload_writer_thread, upload)) {
+        guac_user_log(user, GUAC_LOG_ERROR, "Unable to start writer thread "
+                "for upload.");
+        guac_common_upload_free(upload);
+        return NULL;
+    }
+
+    /* Track upload such that it can be cancelled if never ended */
+    pthread_mutex_lock(&list->lock);
+    upload->next = list->head;
+    list->head = upload;
+    pthread_mutex_unlock(&list->lock);
+
+    return upload;
+
+}
+
+void guac_common_upload_write(guac_common_upload* upload, const void* data,
+        int length) {
+
+    const char* current = (const char*) data;
+
+    pthread_mutex_lock(&upload->lock);
+
+    /* Wait for space, which is necessary only if the user does not wait for
+     * each blob to be acknowledged before sending the next */
+    while (!upload->failed
+            && guac_common_upload_free_space(upload) < (size_t) length)
+        pthread_cond_wait(&upload->modified, &upload->lock);
+
+    /* Report failure immediately if data will not be written */
+    if (upload->failed) {
+        guac_common_upload_ack(upload->user, upload);
+        pthread_mutex_unlock(&upload->lock);
+        return;
+    }
+
+    /* Copy received data into buffer, wrapping around as necessary */
+    size_t offset = upload->head % GUAC_COMMON_UPLOAD_BUFFER_SIZE;
+    size_t contiguous = GUAC_COMMON_UPLOAD_BUFFER_SIZE - offset;
+    if (contiguous > (size_t) length)
+        contiguous = length;
+
+    memcpy(upload->buffer + offset, current, contiguous);
+    memcpy(upload->buffer, current + contiguous, length - contiguous);
+    upload->head += length;
+
+    /* Acknowledge immediately unless the buffer is now full */
+    if (guac_common_upload_free_space(upload) >= GUAC_PROTOCOL_BLOB_MAX_LENGTH)
+        guac_common_upload_ack(upload->user, upload);
+    else
+        upload->acks_pending++;
+
+    pthread_cond_broadcast(&upload->modified);
+    pthread_mutex_unlock(&upload->lock);
+
+}
+
+void guac_common_upload_end(guac_common_upload* upload) {
+
+    guac_user* user = upload->user;
+    guac_common_upload_list* list = upload->list;
+
+    /* Ensure the upload is not freed elsewhere while ending */
+    pthread_mutex_lock(&list->lock);
+    guac_common_upload_unlink(upload);
+    pthread_mutex_unlock(&list->lock);
+
+    /* Signal end of stream, and wait for all buffered data to be written */
+    pthread_mutex_lock(&upload->lock);
+    upload->ended = 1;
+    pthread_cond_broadcast(&upload->modified);
+    pthread_mutex_unlock(&upload->lock);
+
+    pthread_join(upload->writer_thread, NULL);
+
+    /* Send any "ack" still pending (all buffered data is now written) */
+    while (upload->acks_pending > 0) {
+        guac_common_upload_ack(user, upload);
+        upload->acks_pending--;
+    }
+
+    /* Close file, failing the stream if either closing or writing failed
+     * (the file is already closed if the upload was abandoned) */
+    if (!upload->abandoned && upload->close_handler(upload))
+        upload->failed = 1;
+
+    /* Acknowledge stream end */
+    if (upload->failed)
+        guac_protocol_send_ack(user->socket, upload->stream,
+                upload->message, upload->status);
+    else
+        guac_protocol_send_ack(user->socket, upload->stream,
+                "OK (STREAM END)", GUAC_PROTOCOL_STATUS_SUCCESS);
+
+    guac_socket_flush(user->socket);
+    guac_common_upload_free(upload);
+
+}
+
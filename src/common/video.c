@@ -0,0 +1,439 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+#include "common/rect.h"
+#include "common/video.h"
+
+#include <guacamole/client.h>
+#include <guacamole/layer.h>
+#include <guacamole/mem.h>
+#include <guacamole/protocol.h>
+#include <guacamole/socket.h>
+#include <guacamole/stream.h>
+#include <guacamole/timestamp.h>
+#include <guacamole/user.h>
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavformat/avio.h>
+#include <libavutil/dict.h>
+#include <libavutil/frame.h>
+#include <libavutil/mem.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * As of libavformat 61, the buffer passed to AVIOContext write callbacks is
+ * const.
+ */
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+#define GUAC_COMMON_VIDEO_WRITE_BUFFER const uint8_t*
+#else
+#define GUAC_COMMON_VIDEO_WRITE_BUFFER uint8_t*
+#endif
+
+/**
+ * Callback which is invoked by guac_common_video_supported() for each user
+ * associated with the given client, updating an overall support flag
+ * describing whether every user can play streamed video.
+ *
+ * @param user
+ *     The user to check for video support.
+ *
+ * @param data
+ *     Pointer to an int containing the current video support status for the
+ *     client associated with the given user. This flag will be 0 if any user
+ *     already checked has lacked video support, or 1 otherwise.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* __guac_common_video_support_callback(guac_user* user,
+        void* data) {
+
+    int* video_supported = (int*) data;
+
+    /* Skip further checks if support is already ruled out */
+    if (!*video_supported)
+        return NULL;
+
+    /* Search the user's declared video mimetypes for WebM */
+    const char** mimetype = user->info.video_mimetypes;
+    if (mimetype != NULL) {
+        for (; *mimetype != NULL; mimetype++) {
+            if (strcmp(*mimetype, GUAC_COMMON_VIDEO_MIMETYPE) == 0)
+                return NULL;
+        }
+    }
+
+    *video_supported = 0;
+    return NULL;
+
+}
+
+int guac_common_video_supported(guac_client* client) {
+
+    int video_supported = 1;
+
+    /* Video may be used only if each user can play it */
+    guac_client_foreach_user(client, __guac_common_video_support_callback,
+            &video_supported);
+
+    return video_supported;
+
+}
+
+/**
+ * AVIOContext write callback which sends muxed WebM data along the video
+ * stream as blobs.
+ *
+ * @param opaque
+ *     The guac_common_video whose stream should receive the data.
+ *
+ * @param buf
+ *     The muxed data to send.
+ *
+ * @param buf_size
+ *     The number of bytes of muxed data to send.
+ *
+ * @return
+ *     The number of bytes written, or a negative value if the data could not
+ *     be sent.
+ */
+static int __guac_common_video_write_packet(void* opaque,
+        GUAC_COMMON_VIDEO_WRITE_BUFFER buf, int buf_size) {
+
+    guac_common_video* video = (guac_common_video*) opaque;
+
+    int remaining = buf_size;
+    while (remaining > 0) {
+
+        int length = remaining;
+        if (length > GUAC_PROTOCOL_BLOB_MAX_LENGTH)
+            length = GUAC_PROTOCOL_BLOB_MAX_LENGTH;
+
+        if (guac_protocol_send_blob(video->socket, video->stream, buf, length))
+            return AVERROR(EIO);
+
+        buf += length;
+        remaining -= length;
+
+    }
+
+    return buf_size;
+
+}
+
+/**
+ * Frees all libav objects associated with the given video, including the
+ * custom AVIOContext used by its muxer. Objects which were never allocated
+ * are ignored.
+ *
+ * @param video
+ *     The video whose libav objects should be freed.
+ */
+static void __guac_common_video_free_codec(guac_common_video* video) {
+
+    sws_freeContext(video->sws);
+    av_packet_free(&video->packet);
+    av_frame_free(&video->frame);
+    avcodec_free_context(&video->context);
+
+    AVFormatContext* format_context = video->format_context;
+    if (format_context != NULL) {
+
+        /* Free custom I/O context along with its buffer */
+        if (format_context->pb != NULL) {
+            av_freep(&format_context->pb->buffer);
+            avio_context_free(&format_context->pb);
+        }
+
+        avformat_free_context(format_context);
+        video->format_context = NULL;
+
+    }
+
+}
+
+/**
+ * Allocates and configures the VP8 encoder, WebM muxer, frame buffers, and
+ * colorspace conversion required to encode the given video. The video stream
+ * must already be allocated, as the WebM header is sent by this function.
+ *
+ * @param video
+ *     The video to initialize. The dimensions of the video must already be
+ *     stored within its rect.
+ *
+ * @return
+ *     Zero if initialization succeeded, non-zero otherwise.
+ */
+static int __guac_common_video_init_codec(guac_common_video* video) {
+
+    int width = video->rect.width;
+    int height = video->rect.height;
+
+    const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_VP8);
+    if (codec == NULL) {
+        guac_client_log(video->client, GUAC_LOG_DEBUG, "VP8 encoder is not "
+                "available. Video streaming is disabled.");
+        return 1;
+    }
+
+    /* Configure encoder for low-latency live streaming */
+    AVCodecContext* context = video->context = avcodec_alloc_context3(codec);
+    if (context == NULL)
+        return 1;
+
+    context->width = width;
+    context->height = height;
+    context->pix_fmt = AV_PIX_FMT_YUV420P;
+    context->time_base = (AVRational) { 1, 1000 };
+    context->gop_size = GUAC_COMMON_VIDEO_KEYFRAME_INTERVAL;
+    context->max_b_frames = 0;
+    context->bit_rate = (int64_t) width * height
+        * GUAC_COMMON_VIDEO_BITS_PER_PIXEL;
+
+    /* Allocate muxer, writing to the video stream rather than a file */
+    if (avformat_alloc_output_context2(&video->format_context, NULL, "webm",
+                NULL) < 0)
+        return 1;
+
+    AVFormatContext* format_context = video->format_context;
+
+    unsigned char* io_buffer = av_malloc(GUAC_COMMON_VIDEO_IO_BUFFER_SIZE);
+    if (io_buffer == NULL)
+        return 1;
+
+    format_context->pb = avio_alloc_context(io_buffer,
+            GUAC_COMMON_VIDEO_IO_BUFFER_SIZE, 1, video, NULL,
+            __guac_common_video_write_packet, NULL);
+
+    if (format_context->pb == NULL) {
+        av_free(io_buffer);
+        return 1;
+    }
+
+    /* The output is a live stream and cannot be seeked */
+    format_context->pb->seekable = 0;
+    format_context->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+    if (format_context->oformat->flags & AVFMT_GLOBALHEADER)
+        context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    AVDictionary* options = NULL;
+    av_dict_set(&options, "deadline", "realtime", 0);
+    av_dict_set(&options, "cpu-used", "8", 0);
+    av_dict_set(&options, "lag-in-frames", "0", 0);
+
+    int result = avcodec_open2(context, codec, &options);
+    av_dict_free(&options);
+
+    if (result < 0) {
+        guac_client_log(video->client, GUAC_LOG_DEBUG, "VP8 encoder could "
+                "not be opened.");
+        return 1;
+    }
+
+    video->output_stream = avformat_new_stream(format_context, NULL);
+    if (video->output_stream == NULL)
+        return 1;
+
+    video->output_stream->time_base = context->time_base;
+    if (avcodec_parameters_from_context(video->output_stream->codecpar,
+                context) < 0)
+        return 1;
+
+    /* Allocate frame receiving converted image data */
+    AVFrame* frame = video->frame = av_frame_alloc();
+    if (frame == NULL)
+        return 1;
+
+    frame->format = context->pix_fmt;
+    frame->width = width;
+    frame->height = height;
+
+    if (av_frame_get_buffer(frame, 0) < 0)
+        return 1;
+
+    video->packet = av_packet_alloc();
+    if (video->packet == NULL)
+        return 1;
+
+    video->sws = sws_getContext(width, height, AV_PIX_FMT_RGB32,
+            width, height, AV_PIX_FMT_YUV420P, SWS_FAST_BILINEAR,
+            NULL, NULL, NULL);
+
+    if (video->sws == NULL)
+        return 1;
+
+    /* Begin WebM stream, omitting cues and seeking information */
+    AVDictionary* format_options = NULL;
+    av_dict_set(&format_options, "live", "1", 0);
+
+    result = avformat_write_header(format_context, &format_options);
+    av_dict_free(&format_options);
+
+    if (result < 0)
+        return 1;
+
+    avio_flush(format_context->pb);
+    return 0;
+
+}
+
+guac_common_video* guac_common_video_alloc(guac_client* client,
+        guac_socket* socket, const guac_layer* parent,
+        const guac_common_rect* rect) {
+
+    guac_common_video* video = guac_mem_zalloc(sizeof(guac_common_video));
+    video->client = client;
+    video->socket = socket;
+    video->rect = *rect;
+    video->last_pts = -1;
+
+    /* Position new layer over the streamed region of the parent */
+    video->layer = guac_client_alloc_layer(client);
+    guac_protocol_send_size(socket, video->layer, rect->width, rect->height);
+    guac_protocol_send_move(socket, video->layer, parent,
+            rect->x, rect->y, 0);
+
+    /* Begin video stream within new layer */
+    video->stream = guac_client_alloc_stream(client);
+    guac_protocol_send_video(socket, video->stream, video->layer,
+            GUAC_COMMON_VIDEO_MIMETYPE);
+
+    if (__guac_common_video_init_codec(video)) {
+        guac_client_log(client, GUAC_LOG_DEBUG, "Unable to stream %ix%i "
+                "region as video.", rect->width, rect->height);
+        __guac_common_video_free_codec(video);
+        guac_protocol_send_end(socket, video->stream);
+        guac_client_free_stream(client, video->stream);
+        guac_protocol_send_dispose(socket, video->layer);
+        guac_client_free_layer(client, video->layer);
+        guac_mem_free(video);
+        return NULL;
+    }
+
+    return video;
+
+}
+
+/**
+ * Sends the given frame to the encoder, writing all resulting packets to the
+ * WebM muxer. If the given frame is NULL, the encoder is flushed.
+ *
+ * @param video
+ *     The video being encoded.
+ *
+ * @param frame
+ *     The frame to encode, or NULL to flush the encoder.
+ *
+ * @return
+ *     Zero if encoding succeeded, non-zero otherwise.
+ */
+static int __guac_common_video_encode(guac_common_video* video,
+        AVFrame* frame) {
+
+    if (avcodec_send_frame(video->context, frame) < 0)
+        return 1;
+
+    /* Mux all packets available for the frame */
+    AVPacket* packet = video->packet;
+    while (avcodec_receive_packet(video->context, packet) == 0) {
+
+        av_packet_rescale_ts(packet, video->context->time_base,
+                video->output_stream->time_base);
+        packet->stream_index = video->output_stream->index;
+
+        int result = av_interleaved_write_frame(video->format_context, packet);
+        av_packet_unref(packet);
+
+        if (result < 0)
+            return 1;
+
+    }
+
+    return 0;
+
+}
+
+int guac_common_video_write_frame(guac_common_video* video,
+        const unsigned char* buffer, int stride, guac_timestamp timestamp) {
+
+    if (video->last_pts < 0)
+        video->start = timestamp;
+
+    AVFrame* frame = video->frame;
+    if (av_frame_make_writable(frame) < 0)
+        return 1;
+
+    /* Convert surface contents to YUV */
+    const uint8_t* src_data[] = { buffer };
+    const int src_linesize[] = { stride };
+    sws_scale(video->sws, src_data, src_linesize, 0, video->rect.height,
+            frame->data, frame->linesize);
+
+    /* Timestamps must strictly increase, even if frames arrive quickly */
+    int64_t pts = timestamp - video->start;
+    if (pts <= video->last_pts)
+        pts = video->last_pts + 1;
+
+    frame->pts = video->last_pts = pts;
+
+    if (__guac_common_video_encode(video, frame))
+        return 1;
+
+    /* Send the current cluster immediately rather than buffering frames */
+    av_write_frame(video->format_context, NULL);
+    avio_flush(video->format_context->pb);
+
+    return 0;
+
+}
+
+void guac_common_video_free(guac_common_video* video) {
+
+    /* Finish any remaining frames and terminate WebM stream */
+    if (__guac_common_video_encode(video, NULL) == 0)
+        av_write_trailer(video->format_context);
+
+    avio_flush(video->format_context->pb);
+    __guac_common_video_free_codec(video);
+
+    guac_protocol_send_end(video->socket, video->stream);
+    guac_client_free_stream(video->client, video->stream);
+
+    guac_protocol_send_dispose(video->socket, video->layer);
+    guac_client_free_layer(video->client, video->layer);
+
+    guac_mem_free(video);
+
+}
+
+const guac_common_surface_video_encoder guac_common_video_encoder = {
+    .supported   = guac_common_video_supported,
+    .alloc       = guac_common_video_alloc,
+    .write_frame = guac_common_video_write_frame,
+    .free        = guac_common_video_free
+};
+
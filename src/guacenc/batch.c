@@ -0,0 +1,503 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+#include "batch.h"
+#include "encode.h"
+#include "log.h"
+
+#include <guacamole/client.h>
+#include <guacamole/mem.h>
+#include <guacamole/parser.h>
+#include <guacamole/recording.h>
+#include <guacamole/socket.h>
+#include <guacamole/string.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * The number of entries initially allocated for the list of recordings
+ * within a batch.
+ */
+#define GUACENC_BATCH_INITIAL_PATHS 16
+
+/**
+ * Arguments passed to each worker thread of a batch.
+ */
+typedef struct guacenc_batch_worker {
+
+    /**
+     * The batch whose recordings should be encoded.
+     */
+    guacenc_batch* batch;
+
+    /**
+     * The number of threads that the worker should use for decoding images
+     * and encoding video for each recording.
+     */
+    int threads;
+
+    /**
+     * The worker thread.
+     */
+    pthread_t thread;
+
+} guacenc_batch_worker;
+
+guacenc_batch* guacenc_batch_alloc(int width, int height, int bitrate,
+        int threads, guac_timestamp start, guac_timestamp end, bool force) {
+
+    guacenc_batch* batch = guac_mem_zalloc(sizeof(guacenc_batch));
+
+    batch->available = GUACENC_BATCH_INITIAL_PATHS;
+    batch->paths = guac_mem_alloc(sizeof(char*), batch->available);
+
+    batch->width = width;
+    batch->height = height;
+    batch->bitrate = bitrate;
+    batch->threads = threads;
+    batch->start = start;
+    batch->end = end;
+    batch->force = force;
+
+    pthread_mutex_init(&batch->lock, NULL);
+
+    return batch;
+
+}
+
+/**
+ * Adds the given path to the list of recordings within the given batch,
+ * without checking whether that path refers to a directory.
+ *
+ * @param batch
+ *     The batch to add the recording to.
+ *
+ * @param path
+ *     The path of the recording to add.
+ */
+static void guacenc_batch_add_file(guacenc_batch* batch, const char* path) {
+
+    /* Expand list of paths as necessary */
+    if (batch->count == batch->available) {
+        batch->available = guac_mem_ckd_mul_or_die(batch->available, 2);
+        batch->paths = guac_mem_realloc_or_die(batch->paths,
+                sizeof(char*), batch->available);
+    }
+
+    batch->paths[batch->count++] = guac_strdup(path);
+
+}
+
+/**
+ * Returns whether the given filename refers to a video previously written by
+ * guacenc (has the output suffix), and thus should not itself be encoded
+ * when encoding all files within a directory.
+ *
+ * @param filename
+ *     The filename to test.
+ *
+ * @return
+ *     true if the filename ends with GUACENC_BATCH_OUTPUT_SUFFIX, false
+ *     otherwise.
+ */
+static bool guacenc_batch_is_output(const char* filename) {
+
+    size_t length = strlen(filename);
+    size_t suffix_length = strlen(GUACENC_BATCH_OUTPUT_SUFFIX);
+
+    return length >= suffix_length && strcmp(filename + length - suffix_length,
+            GUACENC_BATCH_OUTPUT_SUFFIX) == 0;
+
+}
+
+/**
+ * Returns whether the file at the given path appears to be a Guacamole
+ * session recording, determined by whether its first instruction (after
+ * decompression, if the file is compressed) can be parsed as Guacamole
+ * protocol data.
+ *
+ * @param path
+ *     The path of the file to test.
+ *
+ * @return
+ *     true if the file begins with a valid Guacamole instruction, false if
+ *     the file cannot be read or does not contain Guacamole protocol data.
+ */
+static bool guacenc_batch_is_recording(const char* path) {
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    /* The file descriptor is closed when the socket is freed */
+    guac_socket* socket = guac_recording_reader_open(fd);
+    if (socket == NULL) {
+        close(fd);
+        return false;
+    }
+
+    guac_parser* parser = guac_parser_alloc();
+    bool valid = guac_parser_read(parser, socket, -1) == 0;
+
+    guac_parser_free(parser);
+    guac_socket_free(socket);
+
+    return valid;
+
+}
+
+int guacenc_batch_add(guacenc_batch* batch, const char* path) {
+
+    /* Add anything other than a directory as-is (any errors are reported
+     * when the recording is encoded) */
+    struct stat file_info;
+    if (stat(path, &file_info) || !S_ISDIR(file_info.st_mode)) {
+        guacenc_batch_add_file(batch, path);
+        return 0;
+    }
+
+    /* Otherwise, add all files within the directory */
+    struct dirent** entries;
+    int count = scandir(path, &entries, NULL, alphasort);
+    if (count < 0) {
+        guacenc_log(GUAC_LOG_ERROR, "Cannot read directory \"%s\": %s",
+                path, strerror(errno));
+        return 1;
+    }
+
+    for (int i = 0; i < count; i++) {
+
+        const char* filename = entries[i]->d_name;
+
+        /* Build full path of file within directory */
+        char file_path[GUACENC_BATCH_MAX_PATH_LENGTH];
+        int length = snprintf(file_path, sizeof(file_path), "%s/%s", path,
+                filename);
+
+        /* Add only regular files which are not encoded videos and contain
+         * Guacamole protocol data */
+        if (length < sizeof(file_path) && !guacenc_batch_is_output(filename)
+                && stat(file_path, &file_info) == 0
+                && S_ISREG(file_info.st_mode)) {
+
+            if (guacenc_batch_is_recording(file_path))
+                guacenc_batch_add_file(batch, file_path);
+            else
+                guacenc_log(GUAC_LOG_DEBUG, "Skipping \"%s\", as it is not "
+                        "a Guacamole session recording.", file_path);
+
+        }
+
+        free(entries[i]);
+
+    }
+
+    free(entries);
+    return 0;
+
+}
+
+int guacenc_batch_add_list(guacenc_batch* batch, const char* list_path) {
+
+    /* Read list from STDIN if requested */
+    FILE* list = stdin;
+    if (strcmp(list_path, "-") != 0) {
+        list = fopen(list_path, "r");
+        if (list == NULL) {
+            guacenc_log(GUAC_LOG_ERROR, "Cannot read list of recordings "
+                    "\"%s\": %s", list_path, strerror(errno));
+            return 1;
+        }
+    }
+
+    int retval = 0;
+
+    /* Add each listed path */
+    char* line = NULL;
+    size_t line_size = 0;
+    ssize_t length;
+    while ((length = getline(&line, &line_size, list)) != -1) {
+
+        /* Strip line ending */
+        while (length > 0 && (line[length - 1] == '\n'
+                    || line[length - 1] == '\r'))
+            line[--length] = '\0';
+
+        /* Ignore empty lines */
+        if (length == 0)
+            continue;
+
+        retval |= guacenc_batch_add(batch, line);
+
+    }
+
+    free(line);
+
+    if (list != stdin)
+        fclose(list);
+
+    return retval;
+
+}
+
+/**
+ * Writes the given string to the given file as a JSON string literal,
+ * including surrounding quotes.
+ *
+ * @param output
+ *     The file to write to.
+ *
+ * @param str
+ *     The string to write.
+ */
+static void guacenc_batch_write_json_string(FILE* output, const char* str) {
+
+    fputc('"', output);
+
+    for (; *str != '\0'; str++) {
+
+        unsigned char c = *str;
+
+        /* Escape quotes and backslashes */
+        if (c == '"' || c == '\\')
+            fprintf(output, "\\%c", c);
+
+        /* Escape control characters */
+        else if (c < 0x20)
+            fprintf(output, "\\u%04X", c);
+
+        else
+            fputc(c, output);
+
+    }
+
+    fputc('"', output);
+
+}
+
+/**
+ * Writes a single line of JSON describing the result of encoding a recording
+ * to the report of the given batch. The batch lock must be held.
+ *
+ * @param batch
+ *     The batch whose report should be written to.
+ *
+ * @param path
+ *     The path of the recording.
+ *
+ * @param out_path
+ *     The path of the encoded video, or NULL if no output path could be
+ *     determined.
+ *
+ * @param success
+ *     Whether the recording was encoded successfully.
+ *
+ * @param result
+ *     Statistics describing the encoding process.
+ */
+static void guacenc_batch_report(guacenc_batch* batch, const char* path,
+        const char* out_path, bool success, guacenc_encode_result* result) {
+
+    FILE* report = batch->report;
+    if (report == NULL)
+        return;
+
+    double seconds = result->duration / 1000.0;
+
+    fprintf(report, "{\"recording\":");
+    guacenc_batch_write_json_string(report, path);
+
+    fprintf(report, ",\"video\":");
+    if (out_path != NULL)
+        guacenc_batch_write_json_string(report, out_path);
+    else
+        fprintf(report, "null");
+
+    fprintf(report, ",\"success\":%s,\"frames\":%i,\"bytes\":%" PRId64 ","
+            "\"seconds\":%.3f,\"frames_per_second\":%.1f}\n",
+            success ? "true" : "false", result->frames,
+            (int64_t) result->bytes, seconds,
+            seconds > 0 ? result->frames / seconds : 0);
+
+    fflush(report);
+
+}
+
+/**
+ * Encodes a single recording of the given batch, recording the result.
+ *
+ * @param batch
+ *     The batch containing the recording.
+ *
+ * @param path
+ *     The path of the recording to encode.
+ *
+ * @param threads
+ *     The number of threads to use for decoding images and encoding video.
+ */
+static void guacenc_batch_encode_file(guacenc_batch* batch, const char* path,
+        int threads) {
+
+    guacenc_encode_result result = { 0 };
+    bool success = false;
+
+    /* Generate output filename */
+    char out_path[GUACENC_BATCH_MAX_PATH_LENGTH];
+    int len = snprintf(out_path, sizeof(out_path), "%s"
+            GUACENC_BATCH_OUTPUT_SUFFIX, path);
+
+    /* Do not write if filename exceeds maximum length */
+    if (len >= sizeof(out_path)) {
+        guacenc_log(GUAC_LOG_ERROR, "Cannot write output file for \"%s\": "
+                "Name too long", path);
+    }
+
+    /* Attempt encoding, log granular success/failure at debug level */
+    else if (guacenc_encode(path, out_path, "mpeg4", batch->width,
+                batch->height, batch->bitrate, threads, batch->start,
+                batch->end, batch->force, &result)) {
+        guacenc_log(GUAC_LOG_DEBUG, "%s was NOT successfully encoded.", path);
+    }
+
+    else {
+        guacenc_log(GUAC_LOG_DEBUG, "%s was successfully encoded.", path);
+        success = true;
+    }
+
+    pthread_mutex_lock(&batch->lock);
+
+    if (!success)
+        batch->failures++;
+
+    guacenc_batch_report(batch, path, len < sizeof(out_path) ? out_path : NULL,
+            success, &result);
+
+    pthread_mutex_unlock(&batch->lock);
+
+}
+
+/**
+ * The body of each worker thread of a batch, repeatedly claiming and encoding
+ * the next unclaimed recording until no recordings remain.
+ *
+ * @param data
+ *     The guacenc_batch_worker describing the worker.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guacenc_batch_worker_thread(void* data) {
+
+    guacenc_batch_worker* worker = (guacenc_batch_worker*) data;
+    guacenc_batch* batch = worker->batch;
+
+    for (;;) {
+
+        /* Claim next recording */
+        pthread_mutex_lock(&batch->lock);
+        int index = batch->next;
+        if (index < batch->count)
+            batch->next++;
+        pthread_mutex_unlock(&batch->lock);
+
+        /* Stop once all recordings have been claimed */
+        if (index >= batch->count)
+            break;
+
+        guacenc_batch_encode_file(batch, batch->paths[index],
+                worker->threads);
+
+    }
+
+    return NULL;
+
+}
+
+int guacenc_batch_encode(guacenc_batch* batch, int jobs) {
+
+    /* Never start more workers than there are recordings */
+    if (jobs > batch->count)
+        jobs = batch->count;
+
+    if (jobs < 1)
+        jobs = 1;
+
+    /* Divide available threads between concurrently-encoded recordings */
+    int threads = batch->threads / jobs;
+    if (threads < 1)
+        threads = 1;
+
+    guacenc_batch_worker* workers = guac_mem_zalloc(sizeof(guacenc_batch_worker),
+            jobs);
+
+    /* Start all workers beyond the first */
+    int started;
+    for (started = 1; started < jobs; started++) {
+
+        guacenc_batch_worker* worker = &workers[started];
+        worker->batch = batch;
+        worker->threads = threads;
+
+        if (pthread_create(&worker->thread, NULL,
+                    guacenc_batch_worker_thread, worker)) {
+            guacenc_log(GUAC_LOG_WARNING, "Unable to start worker thread. "
+                    "Only %i recording(s) will be encoded at a time.",
+                    started);
+            break;
+        }
+
+    }
+
+    /* The calling thread acts as the first worker */
+    workers[0].batch = batch;
+    workers[0].threads = threads;
+    guacenc_batch_worker_thread(&workers[0]);
+
+    /* Wait for all other workers to finish */
+    for (int i = 1; i < started; i++)
+        pthread_join(workers[i].thread, NULL);
+
+    guac_mem_free(workers);
+    return batch->failures;
+
+}
+
+void guacenc_batch_free(guacenc_batch* batch) {
+
+    for (int i = 0; i < batch->count; i++)
+        guac_mem_free(batch->paths[i]);
+
+    pthread_mutex_destroy(&batch->lock);
+
+    guac_mem_free(batch->paths);
+    guac_mem_free(batch);
+
+}
@@ -0,0 +1,230 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUACENC_BATCH_H
+#define GUACENC_BATCH_H
+
+#include "config.h"
+#include "encode.h"
+
+#include <guacamole/timestamp.h>
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/**
+ * The suffix appended to the path of each recording to produce the path of
+ * the corresponding encoded video.
+ */
+#define GUACENC_BATCH_OUTPUT_SUFFIX ".m4v"
+
+/**
+ * The maximum length of the path of any encoded video, including null
+ * terminator.
+ */
+#define GUACENC_BATCH_MAX_PATH_LENGTH 4096
+
+/**
+ * A set of recordings which are encoded concurrently by a pool of worker
+ * threads, all using the same encoding options.
+ */
+typedef struct guacenc_batch {
+
+    /**
+     * The paths of all recordings to encode.
+     */
+    char** paths;
+
+    /**
+     * The number of recordings to encode.
+     */
+    int count;
+
+    /**
+     * The number of entries allocated for paths.
+     */
+    int available;
+
+    /**
+     * The width of each encoded video, in pixels.
+     */
+    int width;
+
+    /**
+     * The height of each encoded video, in pixels.
+     */
+    int height;
+
+    /**
+     * The desired overall bitrate of each encoded video, in bits per second.
+     */
+    int bitrate;
+
+    /**
+     * The total number of threads which should be used for decoding images
+     * and encoding video. These threads are divided evenly between the
+     * recordings being encoded concurrently.
+     */
+    int threads;
+
+    /**
+     * The point in each recording at which encoding should begin, in
+     * milliseconds relative to the first frame.
+     */
+    guac_timestamp start;
+
+    /**
+     * The point in each recording at which encoding should end, in
+     * milliseconds relative to the first frame, or GUACENC_DISPLAY_NO_END.
+     */
+    guac_timestamp end;
+
+    /**
+     * Whether recordings should be encoded even if they appear to be
+     * in progress.
+     */
+    bool force;
+
+    /**
+     * The file to which a machine-readable report of the result of encoding
+     * each recording should be written, or NULL if no such report is
+     * desired.
+     */
+    FILE* report;
+
+    /**
+     * Lock which guards next, failures and report while recordings are being
+     * encoded.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * The index of the next recording which has not yet been claimed by a
+     * worker thread.
+     */
+    int next;
+
+    /**
+     * The number of recordings which could not be encoded.
+     */
+    int failures;
+
+} guacenc_batch;
+
+/**
+ * Allocates a new, empty batch which will encode recordings using the given
+ * options.
+ *
+ * @param width
+ *     The width of each encoded video, in pixels.
+ *
+ * @param height
+ *     The height of each encoded video, in pixels.
+ *
+ * @param bitrate
+ *     The desired overall bitrate of each encoded video, in bits per second.
+ *
+ * @param threads
+ *     The total number of threads to use for decoding images and encoding
+ *     video, divided evenly between concurrently-encoded recordings.
+ *
+ * @param start
+ *     The point in each recording at which encoding should begin, in
+ *     milliseconds relative to the first frame.
+ *
+ * @param end
+ *     The point in each recording at which encoding should end, in
+ *     milliseconds relative to the first frame, or GUACENC_DISPLAY_NO_END.
+ *
+ * @param force
+ *     Whether recordings should be encoded even if they appear to be in
+ *     progress.
+ *
+ * @return
+ *     A newly-allocated, empty guacenc_batch.
+ */
+guacenc_batch* guacenc_batch_alloc(int width, int height, int bitrate,
+        int threads, guac_timestamp start, guac_timestamp end, bool force);
+
+/**
+ * Adds the recording at the given path to the given batch. If the path refers
+ * to a directory, all regular files within that directory which contain
+ * Guacamole protocol data (excluding previously-encoded videos and any other
+ * files) are added instead, in alphabetical order.
+ *
+ * @param batch
+ *     The batch to add the recording(s) to.
+ *
+ * @param path
+ *     The path of the recording or directory of recordings to add.
+ *
+ * @return
+ *     Zero if the recording(s) were added successfully, non-zero if the path
+ *     refers to a directory which cannot be read.
+ */
+int guacenc_batch_add(guacenc_batch* batch, const char* path);
+
+/**
+ * Adds each recording listed within the given file to the given batch, as if
+ * by guacenc_batch_add(). The file must contain one path per line. Empty
+ * lines are ignored.
+ *
+ * @param batch
+ *     The batch to add the recordings to.
+ *
+ * @param list_path
+ *     The path of the file listing the recordings to add, or "-" to read the
+ *     list from standard input.
+ *
+ * @return
+ *     Zero if all listed recordings were added successfully, non-zero if the
+ *     list or any listed directory cannot be read.
+ */
+int guacenc_batch_add_list(guacenc_batch* batch, const char* list_path);
+
+/**
+ * Encodes all recordings within the given batch, encoding up to the given
+ * number of recordings concurrently. If a report file has been assigned to
+ * the batch, one line of JSON describing the result of each recording is
+ * written to that file as each recording is completed.
+ *
+ * @param batch
+ *     The batch of recordings to encode.
+ *
+ * @param jobs
+ *     The maximum number of recordings to encode concurrently. If one, all
+ *     recordings are encoded sequentially within the calling thread.
+ *
+ * @return
+ *     The number of recordings which could not be encoded.
+ */
+int guacenc_batch_encode(guacenc_batch* batch, int jobs);
+
+/**
+ * Frees the given batch and all associated paths. Any assigned report file
+ * is not closed.
+ *
+ * @param batch
+ *     The batch to free.
+ */
+void guacenc_batch_free(guacenc_batch* batch);
+
+#endif
+
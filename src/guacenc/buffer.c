@@ -109,6 +109,9 @@ int guacenc_buffer_resize(guacenc_buffer* buffer, int width, int height) {
     buffer->height = height;
     buffer->stride = stride;
 
+    /* The entire buffer must be considered modified if its size changes */
+    guacenc_buffer_damage(buffer, 0, 0, width, height);
+
     /* Replace old image */
     guacenc_buffer_free_image(buffer);
     buffer->image = image;
@@ -170,3 +173,43 @@ int guacenc_buffer_copy(guacenc_buffer* dst, guacenc_buffer* src) {
 
 }
 
+void guacenc_buffer_damage(guacenc_buffer* buffer, int x, int y, int width,
+        int height) {
+
+    /* Clip rectangle to bounds of buffer */
+    int right = x + width;
+    int bottom = y + height;
+
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (right > buffer->width) right = buffer->width;
+    if (bottom > buffer->height) bottom = buffer->height;
+
+    /* Ignore rectangles which do not contain any pixels */
+    if (right <= x || bottom <= y)
+        return;
+
+    /* Expand existing damage rectangle, if any, to contain new rectangle */
+    if (buffer->damage_width > 0 && buffer->damage_height > 0) {
+
+        int damage_right = buffer->damage_x + buffer->damage_width;
+        int damage_bottom = buffer->damage_y + buffer->damage_height;
+
+        if (buffer->damage_x < x) x = buffer->damage_x;
+        if (buffer->damage_y < y) y = buffer->damage_y;
+        if (damage_right > right) right = damage_right;
+        if (damage_bottom > bottom) bottom = damage_bottom;
+
+    }
+
+    buffer->damage_x = x;
+    buffer->damage_y = y;
+    buffer->damage_width = right - x;
+    buffer->damage_height = bottom - y;
+
+}
+
+void guacenc_buffer_clear_damage(guacenc_buffer* buffer) {
+    buffer->damage_width = 0;
+    buffer->damage_height = 0;
+}
@@ -71,6 +71,34 @@ typedef struct guacenc_buffer {
      */
     cairo_t* cairo;
 
+    /**
+     * The X coordinate of the upper-left corner of the rectangle containing
+     * all pixels modified since damage was last cleared with
+     * guacenc_buffer_clear_damage().
+     */
+    int damage_x;
+
+    /**
+     * The Y coordinate of the upper-left corner of the rectangle containing
+     * all pixels modified since damage was last cleared with
+     * guacenc_buffer_clear_damage().
+     */
+    int damage_y;
+
+    /**
+     * The width of the rectangle containing all pixels modified since damage
+     * was last cleared, in pixels. If no pixels have been modified, this will
+     * be 0.
+     */
+    int damage_width;
+
+    /**
+     * The height of the rectangle containing all pixels modified since damage
+     * was last cleared, in pixels. If no pixels have been modified, this will
+     * be 0.
+     */
+    int damage_height;
+
 } guacenc_buffer;
 
 /**
@@ -150,5 +178,37 @@ int guacenc_buffer_fit(guacenc_buffer* buffer, int x, int y);
  */
 int guacenc_buffer_copy(guacenc_buffer* dst, guacenc_buffer* src);
 
+/**
+ * Marks the given rectangle of the given buffer as modified, expanding the
+ * buffer's damage rectangle as necessary to contain it. The rectangle is
+ * clipped to the bounds of the buffer.
+ *
+ * @param buffer
+ *     The buffer that has been modified.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the modified rectangle.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the modified rectangle.
+ *
+ * @param width
+ *     The width of the modified rectangle, in pixels.
+ *
+ * @param height
+ *     The height of the modified rectangle, in pixels.
+ */
+void guacenc_buffer_damage(guacenc_buffer* buffer, int x, int y, int width,
+        int height);
+
+/**
+ * Marks all pixels of the given buffer as unmodified, such that its damage
+ * rectangle is empty.
+ *
+ * @param buffer
+ *     The buffer whose damage rectangle should be cleared.
+ */
+void guacenc_buffer_clear_damage(guacenc_buffer* buffer);
+
 #endif
 
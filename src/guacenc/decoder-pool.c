@@ -0,0 +1,225 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+#include "buffer.h"
+#include "decoder-pool.h"
+#include "image-stream.h"
+#include "log.h"
+
+#include <cairo/cairo.h>
+#include <guacamole/client.h>
+#include <guacamole/mem.h>
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/**
+ * The body of each worker thread of a guacenc_decoder_pool, repeatedly
+ * claiming and decoding the oldest unclaimed job until the pool is freed.
+ *
+ * @param data
+ *     The guacenc_decoder_pool that the thread belongs to.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guacenc_decoder_pool_worker(void* data) {
+
+    guacenc_decoder_pool* pool = (guacenc_decoder_pool*) data;
+
+    pthread_mutex_lock(&pool->lock);
+
+    for (;;) {
+
+        /* Wait for work */
+        while (pool->next_unclaimed == NULL && !pool->stopping)
+            pthread_cond_wait(&pool->job_submitted, &pool->lock);
+
+        if (pool->stopping)
+            break;
+
+        /* Claim oldest unclaimed job */
+        guacenc_decoder_job* job = pool->next_unclaimed;
+        pool->next_unclaimed = job->next;
+
+        /* Decode without holding the lock (the job's stream is not touched
+         * by any other thread until decoding has completed) */
+        pthread_mutex_unlock(&pool->lock);
+        cairo_surface_t* surface = NULL;
+        if (job->stream->decoder != NULL)
+            surface = guacenc_image_stream_decode(job->stream);
+        pthread_mutex_lock(&pool->lock);
+
+        job->surface = surface;
+        job->decoded = true;
+        pthread_cond_broadcast(&pool->job_decoded);
+
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+
+}
+
+guacenc_decoder_pool* guacenc_decoder_pool_alloc(int thread_count) {
+
+    guacenc_decoder_pool* pool = guac_mem_zalloc(sizeof(guacenc_decoder_pool));
+    pool->max_pending = guac_mem_ckd_mul_or_die(thread_count,
+            GUACENC_DECODER_POOL_JOBS_PER_THREAD);
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->job_submitted, NULL);
+    pthread_cond_init(&pool->job_decoded, NULL);
+
+    /* Start all worker threads */
+    pool->threads = guac_mem_alloc(sizeof(pthread_t), thread_count);
+    for (pool->thread_count = 0; pool->thread_count < thread_count;
+            pool->thread_count++) {
+
+        if (pthread_create(&pool->threads[pool->thread_count], NULL,
+                    guacenc_decoder_pool_worker, pool)) {
+            guacenc_log(GUAC_LOG_ERROR, "Unable to start image decoding "
+                    "thread.");
+            guacenc_decoder_pool_free(pool);
+            return NULL;
+        }
+
+    }
+
+    return pool;
+
+}
+
+/**
+ * Removes the oldest pending job from the given pool, waiting for its image
+ * to be decoded if necessary, and draws that image. The pool must have at
+ * least one pending job.
+ *
+ * @param pool
+ *     The pool whose oldest pending image should be drawn.
+ */
+static void guacenc_decoder_pool_draw_next(guacenc_decoder_pool* pool) {
+
+    pthread_mutex_lock(&pool->lock);
+
+    guacenc_decoder_job* job = pool->head;
+    while (!job->decoded)
+        pthread_cond_wait(&pool->job_decoded, &pool->lock);
+
+    /* Remove job from pending list */
+    pool->head = job->next;
+    if (pool->head == NULL)
+        pool->tail = NULL;
+    pool->pending--;
+
+    pthread_mutex_unlock(&pool->lock);
+
+    guacenc_image_stream* stream = job->stream;
+
+    /* Draw image, unless no decoder was available (silently ignored, as in
+     * guacenc_image_stream_end()) */
+    if (stream->decoder != NULL) {
+        if (job->surface == NULL
+                || guacenc_image_stream_draw(stream, job->surface,
+                    job->buffer))
+            guacenc_log(GUAC_LOG_DEBUG, "Decoding of image for layer %i "
+                    "failed.", stream->index);
+    }
+
+    guacenc_image_stream_free(stream);
+    guac_mem_free(job);
+
+}
+
+void guacenc_decoder_pool_submit(guacenc_decoder_pool* pool,
+        guacenc_image_stream* stream, guacenc_buffer* buffer) {
+
+    /* Limit the number of images held in memory */
+    if (pool->pending >= pool->max_pending)
+        guacenc_decoder_pool_draw_next(pool);
+
+    guacenc_decoder_job* job = guac_mem_zalloc(sizeof(guacenc_decoder_job));
+    job->stream = stream;
+    job->buffer = buffer;
+
+    pthread_mutex_lock(&pool->lock);
+
+    /* Append to pending list */
+    if (pool->tail != NULL)
+        pool->tail->next = job;
+    else
+        pool->head = job;
+    pool->tail = job;
+
+    if (pool->next_unclaimed == NULL)
+        pool->next_unclaimed = job;
+
+    pool->pending++;
+
+    pthread_cond_signal(&pool->job_submitted);
+    pthread_mutex_unlock(&pool->lock);
+
+}
+
+void guacenc_decoder_pool_flush(guacenc_decoder_pool* pool) {
+
+    /* Only the instruction-handling thread adds or removes jobs, thus the
+     * pending count may be read without locking */
+    while (pool->pending > 0)
+        guacenc_decoder_pool_draw_next(pool);
+
+}
+
+void guacenc_decoder_pool_free(guacenc_decoder_pool* pool) {
+
+    /* Stop all worker threads */
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->job_submitted);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->thread_count; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    /* Discard any pending images */
+    guacenc_decoder_job* job = pool->head;
+    while (job != NULL) {
+
+        guacenc_decoder_job* next = job->next;
+
+        if (job->surface != NULL)
+            cairo_surface_destroy(job->surface);
+
+        guacenc_image_stream_free(job->stream);
+        guac_mem_free(job);
+
+        job = next;
+
+    }
+
+    pthread_cond_destroy(&pool->job_decoded);
+    pthread_cond_destroy(&pool->job_submitted);
+    pthread_mutex_destroy(&pool->lock);
+
+    guac_mem_free(pool->threads);
+    guac_mem_free(pool);
+
+}
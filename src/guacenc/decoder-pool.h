@@ -0,0 +1,197 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUACENC_DECODER_POOL_H
+#define GUACENC_DECODER_POOL_H
+
+#include "config.h"
+#include "buffer.h"
+#include "image-stream.h"
+
+#include <cairo/cairo.h>
+
+#include <pthread.h>
+#include <stdbool.h>
+
+/**
+ * The maximum number of images which may be awaiting decoding or drawing for
+ * each thread of a guacenc_decoder_pool. Once this limit is reached, further
+ * images are not accepted until the oldest pending image has been drawn.
+ */
+#define GUACENC_DECODER_POOL_JOBS_PER_THREAD 4
+
+/**
+ * An image which has been fully received and is awaiting decoding and/or
+ * drawing.
+ */
+typedef struct guacenc_decoder_job {
+
+    /**
+     * The image stream containing the encoded image data, along with the
+     * position and compositing operation to use when drawing the image.
+     */
+    guacenc_image_stream* stream;
+
+    /**
+     * The buffer that the decoded image should be drawn to.
+     */
+    guacenc_buffer* buffer;
+
+    /**
+     * The decoded image, or NULL if decoding has not yet completed or has
+     * failed.
+     */
+    cairo_surface_t* surface;
+
+    /**
+     * Whether a worker thread has finished attempting to decode the image.
+     */
+    bool decoded;
+
+    /**
+     * The next pending job, in the order that the images were received, or
+     * NULL if this is the most recently received image.
+     */
+    struct guacenc_decoder_job* next;
+
+} guacenc_decoder_job;
+
+/**
+ * A pool of threads which decode received images in parallel. Images are
+ * always drawn in the order received, by the thread handling instructions,
+ * such that the resulting display state is identical to that produced by
+ * decoding each image as it is received.
+ */
+typedef struct guacenc_decoder_pool {
+
+    /**
+     * All worker threads within the pool.
+     */
+    pthread_t* threads;
+
+    /**
+     * The number of worker threads within the pool.
+     */
+    int thread_count;
+
+    /**
+     * Lock which guards all pending jobs and the stopping flag.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition which is signalled when a new job has been submitted or the
+     * pool is being freed.
+     */
+    pthread_cond_t job_submitted;
+
+    /**
+     * Condition which is signalled whenever a worker thread finishes decoding
+     * an image.
+     */
+    pthread_cond_t job_decoded;
+
+    /**
+     * The oldest pending job, or NULL if no jobs are pending.
+     */
+    guacenc_decoder_job* head;
+
+    /**
+     * The most recently submitted job, or NULL if no jobs are pending.
+     */
+    guacenc_decoder_job* tail;
+
+    /**
+     * The oldest pending job which has not yet been claimed by a worker
+     * thread, or NULL if all pending jobs have been claimed.
+     */
+    guacenc_decoder_job* next_unclaimed;
+
+    /**
+     * The number of pending jobs.
+     */
+    int pending;
+
+    /**
+     * The maximum number of pending jobs.
+     */
+    int max_pending;
+
+    /**
+     * Whether the worker threads should terminate.
+     */
+    bool stopping;
+
+} guacenc_decoder_pool;
+
+/**
+ * Allocates a new pool of image decoding threads.
+ *
+ * @param thread_count
+ *     The number of worker threads to start.
+ *
+ * @return
+ *     A newly-allocated guacenc_decoder_pool, or NULL if the pool cannot be
+ *     created.
+ */
+guacenc_decoder_pool* guacenc_decoder_pool_alloc(int thread_count);
+
+/**
+ * Submits the given fully-received image stream for decoding. Ownership of
+ * the image stream is transferred to the pool, which frees the stream once
+ * the decoded image has been drawn. If the maximum number of pending images
+ * has been reached, the oldest pending image is first drawn, waiting for its
+ * decoding to complete if necessary.
+ *
+ * @param pool
+ *     The pool that should decode the image.
+ *
+ * @param stream
+ *     The image stream containing the image to decode.
+ *
+ * @param buffer
+ *     The buffer that the decoded image should be drawn to. This buffer must
+ *     not be modified or freed until the image has been drawn (see
+ *     guacenc_decoder_pool_flush()).
+ */
+void guacenc_decoder_pool_submit(guacenc_decoder_pool* pool,
+        guacenc_image_stream* stream, guacenc_buffer* buffer);
+
+/**
+ * Draws all pending images, in the order they were submitted, waiting for
+ * their decoding to complete as necessary. This must be invoked before
+ * handling any instruction which may read or modify the buffers that pending
+ * images will be drawn to.
+ *
+ * @param pool
+ *     The pool whose pending images should be drawn.
+ */
+void guacenc_decoder_pool_flush(guacenc_decoder_pool* pool);
+
+/**
+ * Stops all worker threads and frees the given pool. Any pending images are
+ * discarded without being drawn.
+ *
+ * @param pool
+ *     The pool to free.
+ */
+void guacenc_decoder_pool_free(guacenc_decoder_pool* pool);
+
+#endif
+
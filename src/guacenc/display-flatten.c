@@ -26,28 +26,31 @@
 #include <guacamole/client.h>
 
 #include <assert.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
 /**
- * The Guacamole video encoder display related to the current qsort()
- * operation. As qsort() does not provide a means of passing arbitrary data to
- * the comparator, this value must be set prior to invoking qsort() with
- * guacenc_display_layer_comparator.
- */
-guacenc_display* __qsort_display;
-
-/**
- * Comparator which orders layer pointers such that (1) NULL pointers are last,
+ * Comparator which orders layers such that (1) NULL pointers are last,
  * (2) layers with the same parent_index are adjacent, and (3) layers with the
  * same parent_index are ordered by Z.
  *
- * @see qsort()
+ * @param display
+ *     The display containing both layers.
+ *
+ * @param layer_a
+ *     The first layer to compare, which may be NULL.
+ *
+ * @param layer_b
+ *     The second layer to compare, which may be NULL.
+ *
+ * @return
+ *     A negative value if layer_a must be rendered before layer_b, a positive
+ *     value if layer_a must be rendered after layer_b, or zero if their
+ *     relative order does not matter.
  */
-static int guacenc_display_layer_comparator(const void* a, const void* b) {
-
-    guacenc_layer* layer_a = *((guacenc_layer**) a);
-    guacenc_layer* layer_b = *((guacenc_layer**) b);
+static int guacenc_display_layer_comparator(guacenc_display* display,
+        guacenc_layer* layer_a, guacenc_layer* layer_b) {
 
     /* If a is NULL, sort it to bottom */
     if (layer_a == NULL) {
@@ -64,8 +67,8 @@ static int guacenc_display_layer_comparator(const void* a, const void* b) {
         return -1;
 
     /* Order such that the deepest layers are first */
-    int a_depth = guacenc_display_get_depth(__qsort_display, layer_a);
-    int b_depth = guacenc_display_get_depth(__qsort_display, layer_b);
+    int a_depth = guacenc_display_get_depth(display, layer_a);
+    int b_depth = guacenc_display_get_depth(display, layer_b);
     if (b_depth != a_depth)
         return b_depth - a_depth;
 
@@ -78,6 +81,242 @@ static int guacenc_display_layer_comparator(const void* a, const void* b) {
 
 }
 
+/**
+ * Sorts the given array of GUACENC_DISPLAY_MAX_LAYERS layers into the order
+ * that they must be rendered, as defined by
+ * guacenc_display_layer_comparator(). Unlike qsort(), this does not require
+ * any global state, and thus multiple displays may be flattened
+ * concurrently. The array is small, thus a simple insertion sort suffices.
+ *
+ * @param display
+ *     The display containing the layers being sorted.
+ *
+ * @param layers
+ *     The array of layers to sort, which may contain NULL entries.
+ */
+static void guacenc_display_sort_layers(guacenc_display* display,
+        guacenc_layer** layers) {
+
+    for (int i = 1; i < GUACENC_DISPLAY_MAX_LAYERS; i++) {
+
+        guacenc_layer* layer = layers[i];
+
+        /* Shift all layers which must be rendered later up by one */
+        int j = i;
+        while (j > 0 && guacenc_display_layer_comparator(display,
+                    layers[j - 1], layer) > 0) {
+            layers[j] = layers[j - 1];
+            j--;
+        }
+
+        layers[j] = layer;
+
+    }
+
+}
+
+/**
+ * Determines the position of the given layer relative to the default layer,
+ * returning whether the layer is actually part of the visible layer hierarchy
+ * (whether the chain of parents of the layer leads to the default layer).
+ * Unlike guacenc_display_get_layer(), this function never allocates layers.
+ *
+ * @param display
+ *     The display containing the given layer.
+ *
+ * @param layer
+ *     The layer whose position should be determined.
+ *
+ * @param x
+ *     Pointer to an int which will receive the X coordinate of the layer
+ *     relative to the default layer.
+ *
+ * @param y
+ *     Pointer to an int which will receive the Y coordinate of the layer
+ *     relative to the default layer.
+ *
+ * @return
+ *     true if the layer is the default layer or a descendant of the default
+ *     layer, false otherwise.
+ */
+static bool guacenc_display_get_position(guacenc_display* display,
+        guacenc_layer* layer, int* x, int* y) {
+
+    *x = 0;
+    *y = 0;
+
+    /* Walk up layer hierarchy (bounded to guard against cycles) */
+    for (int i = 0; i < GUACENC_DISPLAY_MAX_LAYERS; i++) {
+
+        /* Stop upon reaching the default layer */
+        if (layer == display->layers[0])
+            return true;
+
+        /* Layers other than the default layer without a valid parent are
+         * never rendered */
+        int parent_index = layer->parent_index;
+        if (parent_index < 0 || parent_index >= GUACENC_DISPLAY_MAX_LAYERS
+                || display->layers[parent_index] == NULL)
+            return false;
+
+        *x += layer->x;
+        *y += layer->y;
+
+        layer = display->layers[parent_index];
+
+    }
+
+    return false;
+
+}
+
+/**
+ * Expands the given rectangle such that it contains a second rectangle. Empty
+ * rectangles (those with no width or height) are ignored.
+ *
+ * @param x
+ *     Pointer to the X coordinate of the upper-left corner of the rectangle
+ *     to expand.
+ *
+ * @param y
+ *     Pointer to the Y coordinate of the upper-left corner of the rectangle
+ *     to expand.
+ *
+ * @param width
+ *     Pointer to the width of the rectangle to expand.
+ *
+ * @param height
+ *     Pointer to the height of the rectangle to expand.
+ *
+ * @param other_x
+ *     The X coordinate of the upper-left corner of the rectangle to include.
+ *
+ * @param other_y
+ *     The Y coordinate of the upper-left corner of the rectangle to include.
+ *
+ * @param other_width
+ *     The width of the rectangle to include.
+ *
+ * @param other_height
+ *     The height of the rectangle to include.
+ */
+static void guacenc_display_extend_rect(int* x, int* y, int* width,
+        int* height, int other_x, int other_y, int other_width,
+        int other_height) {
+
+    /* Nothing to include */
+    if (other_width <= 0 || other_height <= 0)
+        return;
+
+    /* Rectangle is currently empty and simply becomes the other rectangle */
+    if (*width <= 0 || *height <= 0) {
+        *x = other_x;
+        *y = other_y;
+        *width = other_width;
+        *height = other_height;
+        return;
+    }
+
+    int right = *x + *width;
+    int bottom = *y + *height;
+
+    if (other_x < *x) *x = other_x;
+    if (other_y < *y) *y = other_y;
+    if (other_x + other_width > right) right = other_x + other_width;
+    if (other_y + other_height > bottom) bottom = other_y + other_height;
+
+    *width = right - *x;
+    *height = bottom - *y;
+
+}
+
+/**
+ * Clips the given rectangle such that it is entirely contained within the
+ * bounds of a buffer having the given dimensions.
+ *
+ * @param x
+ *     Pointer to the X coordinate of the upper-left corner of the rectangle
+ *     to clip.
+ *
+ * @param y
+ *     Pointer to the Y coordinate of the upper-left corner of the rectangle
+ *     to clip.
+ *
+ * @param width
+ *     Pointer to the width of the rectangle to clip.
+ *
+ * @param height
+ *     Pointer to the height of the rectangle to clip.
+ *
+ * @param bounds_width
+ *     The width of the buffer that the rectangle must be within.
+ *
+ * @param bounds_height
+ *     The height of the buffer that the rectangle must be within.
+ *
+ * @return
+ *     true if the clipped rectangle still contains at least one pixel, false
+ *     otherwise.
+ */
+static bool guacenc_display_clip_rect(int* x, int* y, int* width, int* height,
+        int bounds_width, int bounds_height) {
+
+    int right = *x + *width;
+    int bottom = *y + *height;
+
+    if (*x < 0) *x = 0;
+    if (*y < 0) *y = 0;
+    if (right > bounds_width) right = bounds_width;
+    if (bottom > bounds_height) bottom = bounds_height;
+
+    *width = right - *x;
+    *height = bottom - *y;
+
+    return *width > 0 && *height > 0;
+
+}
+
+/**
+ * Determines the rectangle that the mouse cursor would currently occupy if
+ * rendered to the default layer. If the cursor would not be rendered, the
+ * resulting width and height are 0.
+ *
+ * @param display
+ *     The display whose mouse cursor should be located.
+ *
+ * @param x
+ *     Pointer to an int which will receive the X coordinate of the
+ *     upper-left corner of the cursor.
+ *
+ * @param y
+ *     Pointer to an int which will receive the Y coordinate of the
+ *     upper-left corner of the cursor.
+ *
+ * @param width
+ *     Pointer to an int which will receive the width of the cursor.
+ *
+ * @param height
+ *     Pointer to an int which will receive the height of the cursor.
+ */
+static void guacenc_display_get_cursor_rect(guacenc_display* display,
+        int* x, int* y, int* width, int* height) {
+
+    guacenc_cursor* cursor = display->cursor;
+
+    *x = cursor->x - cursor->hotspot_x;
+    *y = cursor->y - cursor->hotspot_y;
+
+    /* The cursor is not rendered if coordinates are negative */
+    if (cursor->x < 0 || cursor->y < 0) {
+        *width = *height = 0;
+        return;
+    }
+
+    *width = cursor->buffer->width;
+    *height = cursor->buffer->height;
+
+}
+
 /**
  * Renders the mouse cursor on top of the frame buffer of the default layer of
  * the given display.
@@ -105,8 +344,10 @@ static int guacenc_display_render_cursor(guacenc_display* display) {
     guacenc_buffer* src = cursor->buffer;
     guacenc_buffer* dst = def_layer->frame;
 
-    /* Render cursor to layer */
-    if (src->width > 0 && src->height > 0) {
+    /* Render cursor to layer, ignoring any clipping from rendering of
+     * other layers */
+    if (src->width > 0 && src->height > 0 && dst->cairo != NULL) {
+        cairo_reset_clip(dst->cairo);
         cairo_set_source_surface(dst->cairo, src->surface,
                 cursor->x - cursor->hotspot_x,
                 cursor->y - cursor->hotspot_y);
@@ -122,18 +363,51 @@ static int guacenc_display_render_cursor(guacenc_display* display) {
 
 }
 
-int guacenc_display_flatten(guacenc_display* display) {
+/**
+ * Records the current state of the mouse cursor as rendered and marks the
+ * contents of all layers and the cursor as unmodified, such that only future
+ * changes are recomposited.
+ *
+ * @param display
+ *     The display that has just been flattened.
+ */
+static void guacenc_display_clear_damage(guacenc_display* display) {
+
+    for (int i = 0; i < GUACENC_DISPLAY_MAX_LAYERS; i++) {
+        guacenc_layer* layer = display->layers[i];
+        if (layer != NULL)
+            guacenc_buffer_clear_damage(layer->buffer);
+    }
+
+    guacenc_buffer_clear_damage(display->cursor->buffer);
+
+    guacenc_display_get_cursor_rect(display,
+            &display->rendered_cursor_x, &display->rendered_cursor_y,
+            &display->rendered_cursor_width,
+            &display->rendered_cursor_height);
+
+}
+
+/**
+ * Fully recomposites all layers of the given display, re-sorting layers
+ * according to their current hierarchy and stacking order.
+ *
+ * @param display
+ *     The display to flatten.
+ *
+ * @return
+ *     Zero if flattening succeeds, non-zero otherwise.
+ */
+static int guacenc_display_flatten_all(guacenc_display* display) {
 
     int i;
-    guacenc_layer* render_order[GUACENC_DISPLAY_MAX_LAYERS];
+    guacenc_layer** render_order = display->render_order;
 
     /* Copy list of layers within display */
-    memcpy(render_order, display->layers, sizeof(render_order));
+    memcpy(render_order, display->layers, sizeof(display->render_order));
 
     /* Sort layers by depth, parent, and Z */
-    __qsort_display = display;
-    qsort(render_order, GUACENC_DISPLAY_MAX_LAYERS, sizeof(guacenc_layer*),
-            guacenc_display_layer_comparator);
+    guacenc_display_sort_layers(display, render_order);
 
     /* Reset layer frame buffers */
     for (i = 0; i < GUACENC_DISPLAY_MAX_LAYERS; i++) {
@@ -198,8 +472,220 @@ int guacenc_display_flatten(guacenc_display* display) {
 
     }
 
+    /* The entire frame of the default layer has been recomposited */
+    guacenc_layer* def_layer = display->layers[0];
+    guacenc_buffer_damage(def_layer->frame, 0, 0, def_layer->frame->width,
+            def_layer->frame->height);
+
     /* Render cursor on top of everything else */
     return guacenc_display_render_cursor(display);
 
 }
 
+/**
+ * Recomposites only the given rectangle of the default layer of the given
+ * display, reusing the layer ordering determined by the last full flatten.
+ * Layers which are not part of the visible layer hierarchy are skipped.
+ *
+ * @param display
+ *     The display to flatten.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the rectangle to
+ *     recomposite, relative to the default layer.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the rectangle to
+ *     recomposite, relative to the default layer.
+ *
+ * @param width
+ *     The width of the rectangle to recomposite, in pixels.
+ *
+ * @param height
+ *     The height of the rectangle to recomposite, in pixels.
+ *
+ * @return
+ *     Zero if flattening succeeds, non-zero otherwise.
+ */
+static int guacenc_display_flatten_rect(guacenc_display* display,
+        int x, int y, int width, int height) {
+
+    int i;
+    guacenc_layer** render_order = display->render_order;
+
+    /* Reset only the affected region of each visible layer's frame buffer */
+    for (i = 0; i < GUACENC_DISPLAY_MAX_LAYERS; i++) {
+
+        /* Pull current layer, ignoring unallocated layers */
+        guacenc_layer* layer = render_order[i];
+        if (layer == NULL)
+            continue;
+
+        /* Ignore layers which cannot be visible */
+        int layer_x, layer_y;
+        if (!guacenc_display_get_position(display, layer, &layer_x, &layer_y))
+            continue;
+
+        /* Translate region into coordinates of layer */
+        int rect_x = x - layer_x;
+        int rect_y = y - layer_y;
+        int rect_width = width;
+        int rect_height = height;
+
+        guacenc_buffer* buffer = layer->buffer;
+        if (!guacenc_display_clip_rect(&rect_x, &rect_y, &rect_width,
+                    &rect_height, buffer->width, buffer->height))
+            continue;
+
+        /* Overwrite region of frame with contents of layer */
+        cairo_t* cairo = layer->frame->cairo;
+        cairo_reset_clip(cairo);
+        cairo_rectangle(cairo, rect_x, rect_y, rect_width, rect_height);
+        cairo_clip(cairo);
+
+        cairo_set_operator(cairo, CAIRO_OPERATOR_SOURCE);
+        cairo_set_source_surface(cairo, buffer->surface, 0, 0);
+        cairo_paint(cairo);
+        cairo_set_operator(cairo, CAIRO_OPERATOR_OVER);
+
+    }
+
+    /* Render the affected region of each visible layer, in order */
+    for (i = 0; i < GUACENC_DISPLAY_MAX_LAYERS; i++) {
+
+        /* Pull current layer, ignoring unallocated layers */
+        guacenc_layer* layer = render_order[i];
+        if (layer == NULL)
+            continue;
+
+        /* Skip fully-transparent layers and the default layer (which is
+         * rendered to nothing) */
+        if (layer->opacity == 0 || layer == display->layers[0])
+            continue;
+
+        /* Ignore layers which cannot be visible */
+        int layer_x, layer_y;
+        if (!guacenc_display_get_position(display, layer, &layer_x, &layer_y))
+            continue;
+
+        /* Translate region into coordinates of layer */
+        int rect_x = x - layer_x;
+        int rect_y = y - layer_y;
+        int rect_width = width;
+        int rect_height = height;
+
+        guacenc_buffer* src = layer->frame;
+        if (!guacenc_display_clip_rect(&rect_x, &rect_y, &rect_width,
+                    &rect_height, src->width, src->height))
+            continue;
+
+        /* Ignore if parent has no pixels (parent is guaranteed to exist as
+         * the layer is visible) */
+        guacenc_layer* parent = display->layers[layer->parent_index];
+        cairo_t* cairo = parent->frame->cairo;
+        if (cairo == NULL)
+            continue;
+
+        /* Render affected region of buffer to parent */
+        cairo_reset_clip(cairo);
+        cairo_rectangle(cairo, layer->x + rect_x, layer->y + rect_y,
+                rect_width, rect_height);
+        cairo_clip(cairo);
+
+        cairo_set_source_surface(cairo, src->surface, layer->x, layer->y);
+        cairo_paint_with_alpha(cairo, layer->opacity / 255.0);
+
+    }
+
+    /* Only the given region of the default layer has been recomposited */
+    guacenc_layer* def_layer = display->layers[0];
+    guacenc_buffer_damage(def_layer->frame, x, y, width, height);
+
+    /* Render cursor on top of everything else (the cursor always lies
+     * entirely within the recomposited region) */
+    return guacenc_display_render_cursor(display);
+
+}
+
+int guacenc_display_flatten(guacenc_display* display) {
+
+    int i;
+
+    /* Retrieve default layer (guaranteed to not be NULL) */
+    guacenc_layer* def_layer = guacenc_display_get_layer(display, 0);
+    assert(def_layer != NULL);
+
+    /* Changes to the layers themselves require everything to be
+     * recomposited, as do changes to the size of any layer */
+    bool flatten_all = display->layers_changed;
+    for (i = 0; i < GUACENC_DISPLAY_MAX_LAYERS && !flatten_all; i++) {
+        guacenc_layer* layer = display->layers[i];
+        if (layer != NULL && (layer->frame->width != layer->buffer->width
+                    || layer->frame->height != layer->buffer->height))
+            flatten_all = true;
+    }
+
+    if (flatten_all) {
+        display->layers_changed = false;
+        int retval = guacenc_display_flatten_all(display);
+        guacenc_display_clear_damage(display);
+        return retval;
+    }
+
+    /* Determine the region of the default layer affected by changes to the
+     * contents of any visible layer */
+    int x = 0, y = 0, width = 0, height = 0;
+    for (i = 0; i < GUACENC_DISPLAY_MAX_LAYERS; i++) {
+
+        guacenc_layer* layer = display->layers[i];
+        if (layer == NULL)
+            continue;
+
+        guacenc_buffer* buffer = layer->buffer;
+        if (buffer->damage_width <= 0 || buffer->damage_height <= 0)
+            continue;
+
+        int layer_x, layer_y;
+        if (guacenc_display_get_position(display, layer, &layer_x, &layer_y))
+            guacenc_display_extend_rect(&x, &y, &width, &height,
+                    layer_x + buffer->damage_x, layer_y + buffer->damage_y,
+                    buffer->damage_width, buffer->damage_height);
+
+    }
+
+    /* Include both old and new locations of the cursor if it has changed */
+    int cursor_x, cursor_y, cursor_width, cursor_height;
+    guacenc_display_get_cursor_rect(display, &cursor_x, &cursor_y,
+            &cursor_width, &cursor_height);
+
+    guacenc_buffer* cursor_buffer = display->cursor->buffer;
+    if (cursor_buffer->damage_width > 0 || cursor_buffer->damage_height > 0
+            || cursor_x != display->rendered_cursor_x
+            || cursor_y != display->rendered_cursor_y
+            || cursor_width != display->rendered_cursor_width
+            || cursor_height != display->rendered_cursor_height) {
+
+        guacenc_display_extend_rect(&x, &y, &width, &height,
+                display->rendered_cursor_x, display->rendered_cursor_y,
+                display->rendered_cursor_width,
+                display->rendered_cursor_height);
+
+    }
+
+    /* Any recomposited region must include the cursor, as the cursor is
+     * drawn over the default layer in its entirety */
+    if (width > 0 && height > 0)
+        guacenc_display_extend_rect(&x, &y, &width, &height,
+                cursor_x, cursor_y, cursor_width, cursor_height);
+
+    guacenc_display_clear_damage(display);
+
+    /* Skip flattening entirely if nothing visible has changed, as the frame
+     * of the default layer already contains the current display */
+    if (!guacenc_display_clip_rect(&x, &y, &width, &height,
+                def_layer->buffer->width, def_layer->buffer->height))
+        return 0;
+
+    return guacenc_display_flatten_rect(display, x, y, width, height);
+
+}
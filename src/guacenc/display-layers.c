@@ -52,6 +52,7 @@ guacenc_layer* guacenc_display_get_layer(guacenc_display* display,
 
         /* Store layer within display for future retrieval / management */
         display->layers[index] = layer;
+        display->layers_changed = true;
 
     }
 
@@ -92,6 +93,7 @@ int guacenc_display_free_layer(guacenc_display* display,
 
     /* Mark layer as freed */
     display->layers[index] = NULL;
+    display->layers_changed = true;
 
     return 0;
 
@@ -40,6 +40,34 @@ int guacenc_display_sync(guacenc_display* display, guac_timestamp timestamp) {
     /* Update timestamp of display */
     display->last_sync = timestamp;
 
+    /* Range of recording to encode is relative to the first frame */
+    if (display->frame_count++ == 0)
+        display->first_sync = timestamp;
+
+    guac_timestamp offset = timestamp - display->first_sync;
+
+    /* Skip flattening and encoding entirely until the start of the range is
+     * reached, fully recompositing the first frame that is encoded */
+    if (offset < display->range_start) {
+        display->layers_changed = true;
+        return 0;
+    }
+
+    /* Upon passing the end of the range, hold the last encoded frame until
+     * exactly the end of the range and stop */
+    if (display->range_end != GUACENC_DISPLAY_NO_END
+            && offset > display->range_end) {
+
+        display->range_ended = true;
+        timestamp = display->first_sync + display->range_end;
+
+        if (display->frames != NULL)
+            return guacenc_frame_queue_push(display->frames, timestamp, NULL);
+
+        return guacenc_video_advance_timeline(display->output, timestamp);
+
+    }
+
     /* Flatten display to default layer */
     if (guacenc_display_flatten(display))
         return 1;
@@ -48,12 +76,24 @@ int guacenc_display_sync(guacenc_display* display, guac_timestamp timestamp) {
     guacenc_layer* def_layer = guacenc_display_get_layer(display, 0);
     assert(def_layer != NULL);
 
+    /* Avoid converting the frame again if flattening did not modify it (the
+     * previously-prepared frame remains valid) */
+    guacenc_buffer* frame = def_layer->frame;
+    if (frame->damage_width <= 0 || frame->damage_height <= 0)
+        frame = NULL;
+
+    guacenc_buffer_clear_damage(def_layer->frame);
+
+    /* Hand frame to encoding thread, if any */
+    if (display->frames != NULL)
+        return guacenc_frame_queue_push(display->frames, timestamp, frame);
+
     /* Update video timeline */
     if (guacenc_video_advance_timeline(display->output, timestamp))
         return 1;
 
     /* Prepare frame for write upon next flush */
-    guacenc_video_prepare_frame(display->output, def_layer->frame);
+    guacenc_video_prepare_frame(display->output, frame);
     return 0;
 
 }
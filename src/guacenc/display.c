@@ -84,11 +84,33 @@ cairo_operator_t guacenc_display_cairo_operator(guac_composite_mode mask) {
 
 }
 
+void guacenc_display_damage(guacenc_buffer* buffer, guac_composite_mode mask,
+        int x, int y, int width, int height) {
+
+    switch (guacenc_display_cairo_operator(mask)) {
+
+        /* Unbounded operators affect the destination outside the source */
+        case CAIRO_OPERATOR_IN:
+        case CAIRO_OPERATOR_OUT:
+        case CAIRO_OPERATOR_DEST_IN:
+        case CAIRO_OPERATOR_DEST_ATOP:
+            guacenc_buffer_damage(buffer, 0, 0, buffer->width, buffer->height);
+            break;
+
+        /* All other operators affect only the drawn rectangle */
+        default:
+            guacenc_buffer_damage(buffer, x, y, width, height);
+
+    }
+
+}
+
 guacenc_display* guacenc_display_alloc(const char* path, const char* codec,
-        int width, int height, int bitrate) {
+        int width, int height, int bitrate, int threads) {
 
     /* Prepare video encoding */
-    guacenc_video* video = guacenc_video_alloc(path, codec, width, height, bitrate);
+    guacenc_video* video = guacenc_video_alloc(path, codec, width, height,
+            bitrate, threads);
     if (video == NULL)
         return NULL;
 
@@ -102,6 +124,21 @@ guacenc_display* guacenc_display_alloc(const char* path, const char* codec,
     /* Allocate special-purpose cursor layer */
     display->cursor = guacenc_cursor_alloc();
 
+    /* The first frame must be fully composited */
+    display->layers_changed = true;
+
+    /* Encode entire recording unless otherwise specified */
+    display->range_start = 0;
+    display->range_end = GUACENC_DISPLAY_NO_END;
+
+    /* Decode images and encode frames in parallel with instruction handling,
+     * if multiple threads are available (falling back to handling everything
+     * within the current thread if threads cannot be started) */
+    if (threads > 1) {
+        display->decoders = guacenc_decoder_pool_alloc(threads);
+        display->frames = guacenc_frame_queue_alloc(video);
+    }
+
     return display;
 
 }
@@ -114,8 +151,17 @@ int guacenc_display_free(guacenc_display* display) {
     if (display == NULL)
         return 0;
 
+    /* Discard any images still being decoded */
+    if (display->decoders != NULL)
+        guacenc_decoder_pool_free(display->decoders);
+
+    /* Encode any frames still queued */
+    int retval = 0;
+    if (display->frames != NULL)
+        retval = guacenc_frame_queue_free(display->frames);
+
     /* Finalize video */
-    int retval = guacenc_video_free(display->output);
+    retval |= guacenc_video_free(display->output);
 
     /* Free all buffers */
     for (i = 0; i < GUACENC_DISPLAY_MAX_BUFFERS; i++)
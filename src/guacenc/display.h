@@ -23,6 +23,8 @@
 #include "config.h"
 #include "buffer.h"
 #include "cursor.h"
+#include "decoder-pool.h"
+#include "frame-queue.h"
 #include "image-stream.h"
 #include "layer.h"
 #include "video.h"
@@ -31,6 +33,8 @@
 #include <guacamole/protocol.h>
 #include <guacamole/timestamp.h>
 
+#include <stdbool.h>
+
 /**
  * The maximum number of buffers that the Guacamole video encoder will handle
  * within a single Guacamole protocol dump.
@@ -49,6 +53,12 @@
  */
 #define GUACENC_DISPLAY_MAX_STREAMS 64
 
+/**
+ * The value of the range_end property of a guacenc_display if encoding should
+ * continue until the end of the recording.
+ */
+#define GUACENC_DISPLAY_NO_END -1
+
 /**
  * The current state of the Guacamole video encoder's internal display.
  */
@@ -94,6 +104,90 @@ typedef struct guacenc_display {
      */
     guacenc_video* output;
 
+    /**
+     * The pool of threads decoding received images, or NULL if images are
+     * decoded as they are received.
+     */
+    guacenc_decoder_pool* decoders;
+
+    /**
+     * The queue of rendered frames awaiting encoding by a dedicated thread,
+     * or NULL if frames are encoded as they are rendered.
+     */
+    guacenc_frame_queue* frames;
+
+    /**
+     * The number of frames rendered thus far (the number of "sync"
+     * instructions handled).
+     */
+    int frame_count;
+
+    /**
+     * The timestamp of the first sync instruction handled. This value is
+     * undefined if no sync has yet been read.
+     */
+    guac_timestamp first_sync;
+
+    /**
+     * The point in the recording at which encoding should begin, in
+     * milliseconds relative to the first sync instruction. Frames prior to
+     * this point are not flattened or encoded; their instructions are
+     * handled only to reconstruct the state of the display.
+     */
+    guac_timestamp range_start;
+
+    /**
+     * The point in the recording at which encoding should end, in
+     * milliseconds relative to the first sync instruction, or
+     * GUACENC_DISPLAY_NO_END if the entire remainder of the recording should
+     * be encoded.
+     */
+    guac_timestamp range_end;
+
+    /**
+     * Whether the end of the range of the recording being encoded has been
+     * reached, such that no further instructions need be handled.
+     */
+    bool range_ended;
+
+    /**
+     * Whether the set, ordering, hierarchy, position, or opacity of layers
+     * has changed since the display was last flattened, requiring all layers
+     * to be recomposited rather than only their modified regions.
+     */
+    bool layers_changed;
+
+    /**
+     * All currently-allocated layers in the order that they must be
+     * composited, as determined when the display was last fully flattened.
+     * Unused entries are NULL and sorted last.
+     */
+    guacenc_layer* render_order[GUACENC_DISPLAY_MAX_LAYERS];
+
+    /**
+     * The X coordinate of the upper-left corner of the mouse cursor as last
+     * rendered to the default layer.
+     */
+    int rendered_cursor_x;
+
+    /**
+     * The Y coordinate of the upper-left corner of the mouse cursor as last
+     * rendered to the default layer.
+     */
+    int rendered_cursor_y;
+
+    /**
+     * The width of the mouse cursor as last rendered to the default layer, in
+     * pixels. If the cursor was not rendered, this will be 0.
+     */
+    int rendered_cursor_width;
+
+    /**
+     * The height of the mouse cursor as last rendered to the default layer,
+     * in pixels. If the cursor was not rendered, this will be 0.
+     */
+    int rendered_cursor_height;
+
 } guacenc_display;
 
 /**
@@ -150,12 +244,18 @@ int guacenc_display_flatten(guacenc_display* display);
  *     The desired overall bitrate of the resulting encoded video, in bits per
  *     second.
  *
+ * @param threads
+ *     The number of threads to use for decoding images and encoding video.
+ *     If greater than one, received images are decoded by a pool of worker
+ *     threads and rendered frames are encoded by a dedicated thread. If one,
+ *     all work is performed within the thread handling instructions.
+ *
  * @return
  *     The newly-allocated Guacamole video encoder display, or NULL if the
  *     display could not be allocated.
  */
 guacenc_display* guacenc_display_alloc(const char* path, const char* codec,
-        int width, int height, int bitrate);
+        int width, int height, int bitrate, int threads);
 
 /**
  * Frees all memory associated with the given Guacamole video encoder display,
@@ -367,5 +467,34 @@ int guacenc_display_free_image_stream(guacenc_display* display, int index);
  */
 cairo_operator_t guacenc_display_cairo_operator(guac_composite_mode mask);
 
+/**
+ * Marks the region of the given buffer affected by a draw operation using the
+ * given Guacamole protocol compositing mode (channel mask) as modified. For
+ * most compositing modes, only the given rectangle is affected. For modes
+ * which Cairo treats as unbounded (those which clear the destination outside
+ * of the source), the entire buffer is marked as modified.
+ *
+ * @param buffer
+ *     The buffer that was drawn to.
+ *
+ * @param mask
+ *     The Guacamole protocol compositing mode (channel mask) of the draw
+ *     operation.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the drawn rectangle.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the drawn rectangle.
+ *
+ * @param width
+ *     The width of the drawn rectangle, in pixels.
+ *
+ * @param height
+ *     The height of the drawn rectangle, in pixels.
+ */
+void guacenc_display_damage(guacenc_buffer* buffer, guac_composite_mode mask,
+        int x, int y, int width, int height);
+
 #endif
 
@@ -19,13 +19,17 @@
 
 #include "config.h"
 #include "display.h"
+#include "encode.h"
+#include "guacenc.h"
 #include "instructions.h"
 #include "log.h"
 
 #include <guacamole/client.h>
 #include <guacamole/error.h>
 #include <guacamole/parser.h>
+#include <guacamole/recording.h>
 #include <guacamole/socket.h>
+#include <guacamole/timestamp.h>
 
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -35,9 +39,46 @@
 #include <string.h>
 #include <unistd.h>
 
+/**
+ * Logs the progress of the encoding process at the informational level.
+ *
+ * @param display
+ *     The current internal display of the Guacamole video encoder.
+ *
+ * @param path
+ *     The name of the file being encoded.
+ *
+ * @param fd
+ *     The file descriptor of the file being encoded.
+ *
+ * @param size
+ *     The total size of the file being encoded, in bytes.
+ *
+ * @param start
+ *     The time at which the encoding process started.
+ */
+static void guacenc_log_progress(guacenc_display* display, const char* path,
+        int fd, off_t size, guac_timestamp start) {
+
+    /* Calculate frames rendered per second */
+    double elapsed = (guac_timestamp_current() - start) / 1000.0;
+    double rate = elapsed > 0 ? display->frame_count / elapsed : 0;
+
+    /* Estimate overall progress based on amount of file read */
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+    if (offset >= 0 && size > 0)
+        guacenc_log(GUAC_LOG_INFO, "%s: %i%% (%i frames, %.1f frames/second)",
+                path, (int) (offset * 100 / size), display->frame_count,
+                rate);
+    else
+        guacenc_log(GUAC_LOG_INFO, "%s: %i frames (%.1f frames/second)",
+                path, display->frame_count, rate);
+
+}
+
 /**
  * Reads and handles all Guacamole instructions from the given guac_socket
- * until end-of-stream is reached.
+ * until end-of-stream is reached, periodically logging progress.
  *
  * @param display
  *     The current internal display of the Guacamole video encoder.
@@ -46,6 +87,10 @@
  *     The name of the file being parsed (for logging purposes). This file
  *     must already be open and available through the given socket.
  *
+ * @param fd
+ *     The file descriptor of the file being parsed, used only to determine
+ *     the current position within that file for progress reporting.
+ *
  * @param socket
  *     The guac_socket through which instructions should be read.
  *
@@ -54,24 +99,53 @@
  *     the given socket fails.
  */
 static int guacenc_read_instructions(guacenc_display* display,
-        const char* path, guac_socket* socket) {
+        const char* path, int fd, guac_socket* socket) {
 
     /* Obtain Guacamole protocol parser */
     guac_parser* parser = guac_parser_alloc();
     if (parser == NULL)
         return 1;
 
+    /* Determine overall size of file for sake of progress reporting */
+    struct stat file_info;
+    off_t size = 0;
+    if (fstat(fd, &file_info) == 0)
+        size = file_info.st_size;
+
+    guac_timestamp start = guac_timestamp_current();
+    guac_timestamp last_progress = start;
+
     /* Continuously read and handle all instructions */
     while (!guac_parser_read(parser, socket, -1)) {
+
         if (guacenc_handle_instruction(display, parser->opcode,
                 parser->argc, parser->argv)) {
             guacenc_log(GUAC_LOG_DEBUG, "Handling of \"%s\" instruction "
                     "failed.", parser->opcode);
         }
+
+        /* Stop once the end of the requested range has been encoded */
+        if (display->range_ended)
+            break;
+
+        /* Periodically report progress */
+        guac_timestamp now = guac_timestamp_current();
+        if (now - last_progress >= GUACENC_PROGRESS_INTERVAL) {
+            guacenc_log_progress(display, path, fd, size, start);
+            last_progress = now;
+        }
+
     }
 
-    /* Fail on read/parse error */
-    if (guac_error != GUAC_STATUS_CLOSED) {
+    /* Report overall throughput */
+    double elapsed = (guac_timestamp_current() - start) / 1000.0;
+    guacenc_log(GUAC_LOG_INFO, "%s: %i frames rendered in %.1f seconds "
+            "(%.1f frames/second)", path, display->frame_count, elapsed,
+            elapsed > 0 ? display->frame_count / elapsed : 0);
+
+    /* Fail on read/parse error (unless reading intentionally stopped at the
+     * end of the requested range) */
+    if (!display->range_ended && guac_error != GUAC_STATUS_CLOSED) {
         guacenc_log(GUAC_LOG_ERROR, "%s: %s",
                 path, guac_status_string(guac_error));
         guac_parser_free(parser);
@@ -85,7 +159,18 @@ static int guacenc_read_instructions(guacenc_display* display,
 }
 
 int guacenc_encode(const char* path, const char* out_path, const char* codec,
-        int width, int height, int bitrate, bool force) {
+        int width, int height, int bitrate, int threads, guac_timestamp start,
+        guac_timestamp end, bool force, guacenc_encode_result* result) {
+
+    guacenc_encode_result unused_result;
+    if (result == NULL)
+        result = &unused_result;
+
+    /* Nothing has been encoded yet */
+    guac_timestamp started = guac_timestamp_current();
+    result->frames = 0;
+    result->bytes = 0;
+    result->duration = 0;
 
     /* Open input file */
     int fd = open(path, O_RDONLY);
@@ -123,14 +208,18 @@ int guacenc_encode(const char* path, const char* out_path, const char* codec,
 
     /* Allocate display for encoding process */
     guacenc_display* display = guacenc_display_alloc(out_path, codec,
-            width, height, bitrate);
+            width, height, bitrate, threads);
     if (display == NULL) {
         close(fd);
         return 1;
     }
 
-    /* Obtain guac_socket wrapping file descriptor */
-    guac_socket* socket = guac_socket_open(fd);
+    /* Restrict encoding to requested range of recording */
+    display->range_start = start;
+    display->range_end = end;
+
+    /* Obtain guac_socket reading the (possibly compressed) recording */
+    guac_socket* socket = guac_recording_reader_open(fd);
     if (socket == NULL) {
         guacenc_log(GUAC_LOG_ERROR, "%s: %s", path,
                 guac_status_string(guac_error));
@@ -142,15 +231,19 @@ int guacenc_encode(const char* path, const char* out_path, const char* codec,
     guacenc_log(GUAC_LOG_INFO, "Encoding \"%s\" to \"%s\" ...", path, out_path);
 
     /* Attempt to read all instructions in the file */
-    if (guacenc_read_instructions(display, path, socket)) {
-        guac_socket_free(socket);
-        guacenc_display_free(display);
-        return 1;
-    }
+    int failed = guacenc_read_instructions(display, path, fd, socket);
+
+    /* Record size of recording and number of frames read */
+    struct stat file_info;
+    if (fstat(fd, &file_info) == 0)
+        result->bytes = file_info.st_size;
+    result->frames = display->frame_count;
 
     /* Close input and finish encoding process */
     guac_socket_free(socket);
-    return guacenc_display_free(display);
+    failed |= guacenc_display_free(display);
 
-}
+    result->duration = guac_timestamp_current() - started;
+    return failed;
 
+}
@@ -22,7 +22,34 @@
 
 #include "config.h"
 
+#include <guacamole/timestamp.h>
+
 #include <stdbool.h>
+#include <sys/types.h>
+
+/**
+ * Statistics describing the encoding of a single recording, as produced by
+ * guacenc_encode().
+ */
+typedef struct guacenc_encode_result {
+
+    /**
+     * The number of frames read from the recording (the number of "sync"
+     * instructions handled).
+     */
+    int frames;
+
+    /**
+     * The total size of the recording, in bytes.
+     */
+    off_t bytes;
+
+    /**
+     * The amount of time taken to encode the recording, in milliseconds.
+     */
+    guac_timestamp duration;
+
+} guacenc_encode_result;
 
 /**
  * Encodes the given Guacamole protocol dump as video. A read lock will be
@@ -50,16 +77,36 @@
  *     The desired overall bitrate of the resulting encoded video, in bits per
  *     second.
  *
+ * @param threads
+ *     The number of threads to use for decoding images and encoding video.
+ *     If one, all work is performed within the calling thread.
+ *
+ * @param start
+ *     The point in the recording at which encoding should begin, in
+ *     milliseconds relative to the first frame. Any earlier part of the
+ *     recording is read only to reconstruct the state of the display.
+ *
+ * @param end
+ *     The point in the recording at which encoding should end, in
+ *     milliseconds relative to the first frame, or GUACENC_DISPLAY_NO_END to
+ *     encode the remainder of the recording.
+ *
  * @param force
  *     Perform the encoding, even if the input file appears to be an
  *     in-progress recording (has an associated lock).
  *
+ * @param result
+ *     A guacenc_encode_result to populate with statistics describing the
+ *     encoding process, or NULL if no such statistics are needed. Statistics
+ *     are populated regardless of whether encoding succeeds.
+ *
  * @return
  *     Zero on success, non-zero if an error prevented successful encoding of
  *     the video.
  */
 int guacenc_encode(const char* path, const char* out_path, const char* codec,
-        int width, int height, int bitrate, bool force);
+        int width, int height, int bitrate, int threads, guac_timestamp start,
+        guac_timestamp end, bool force, guacenc_encode_result* result);
 
 #endif
 
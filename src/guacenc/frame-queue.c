@@ -0,0 +1,208 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+#include "buffer.h"
+#include "frame-queue.h"
+#include "log.h"
+#include "video.h"
+
+#include <guacamole/client.h>
+#include <guacamole/mem.h>
+#include <guacamole/timestamp.h>
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/**
+ * The body of the encoding thread of a guacenc_frame_queue, repeatedly
+ * encoding the oldest queued frame until the queue is being freed and no
+ * frames remain.
+ *
+ * @param data
+ *     The guacenc_frame_queue whose frames should be encoded.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guacenc_frame_queue_thread(void* data) {
+
+    guacenc_frame_queue* queue = (guacenc_frame_queue*) data;
+
+    pthread_mutex_lock(&queue->lock);
+
+    for (;;) {
+
+        /* Wait for next frame */
+        while (queue->head == NULL && !queue->stopping)
+            pthread_cond_wait(&queue->frame_queued, &queue->lock);
+
+        /* Stop only once all queued frames are encoded */
+        guacenc_frame* frame = queue->head;
+        if (frame == NULL)
+            break;
+
+        /* Encode frame without holding the lock. The frame remains at the
+         * head of the queue until encoded such that the queue length
+         * accounts for it. */
+        bool failed = queue->failed;
+        pthread_mutex_unlock(&queue->lock);
+
+        if (!failed) {
+            if (guacenc_video_advance_timeline(queue->video, frame->timestamp))
+                failed = true;
+            else
+                guacenc_video_prepare_frame(queue->video,
+                        frame->changed ? frame->buffer : NULL);
+        }
+
+        pthread_mutex_lock(&queue->lock);
+
+        /* Remove frame from queue, retaining it for reuse */
+        queue->head = frame->next;
+        if (queue->head == NULL)
+            queue->tail = NULL;
+        queue->length--;
+
+        frame->next = queue->unused;
+        queue->unused = frame;
+
+        if (failed)
+            queue->failed = true;
+
+        pthread_cond_signal(&queue->frame_encoded);
+
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+
+}
+
+guacenc_frame_queue* guacenc_frame_queue_alloc(guacenc_video* video) {
+
+    guacenc_frame_queue* queue = guac_mem_zalloc(sizeof(guacenc_frame_queue));
+    queue->video = video;
+
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->frame_queued, NULL);
+    pthread_cond_init(&queue->frame_encoded, NULL);
+
+    /* Start encoding thread */
+    if (pthread_create(&queue->thread, NULL, guacenc_frame_queue_thread,
+                queue)) {
+        guacenc_log(GUAC_LOG_ERROR, "Unable to start video encoding thread.");
+        pthread_cond_destroy(&queue->frame_encoded);
+        pthread_cond_destroy(&queue->frame_queued);
+        pthread_mutex_destroy(&queue->lock);
+        guac_mem_free(queue);
+        return NULL;
+    }
+
+    return queue;
+
+}
+
+int guacenc_frame_queue_push(guacenc_frame_queue* queue,
+        guac_timestamp timestamp, guacenc_buffer* buffer) {
+
+    pthread_mutex_lock(&queue->lock);
+
+    /* Wait for space within queue */
+    while (queue->length >= GUACENC_FRAME_QUEUE_MAX_LENGTH && !queue->failed)
+        pthread_cond_wait(&queue->frame_encoded, &queue->lock);
+
+    /* Refuse further frames once encoding has failed */
+    if (queue->failed) {
+        pthread_mutex_unlock(&queue->lock);
+        return 1;
+    }
+
+    /* Reuse a previously-encoded frame, if possible */
+    guacenc_frame* frame = queue->unused;
+    if (frame != NULL)
+        queue->unused = frame->next;
+
+    pthread_mutex_unlock(&queue->lock);
+
+    /* Allocate new frame if no unused frames are available */
+    if (frame == NULL) {
+        frame = guac_mem_zalloc(sizeof(guacenc_frame));
+        frame->buffer = guacenc_buffer_alloc();
+    }
+
+    /* Copy frame contents outside the lock (the frame is not yet visible to
+     * the encoding thread) */
+    if (buffer != NULL && guacenc_buffer_copy(frame->buffer, buffer)) {
+        guacenc_buffer_free(frame->buffer);
+        guac_mem_free(frame);
+        return 1;
+    }
+
+    frame->changed = (buffer != NULL);
+    frame->timestamp = timestamp;
+    frame->next = NULL;
+
+    pthread_mutex_lock(&queue->lock);
+
+    /* Append to queue */
+    if (queue->tail != NULL)
+        queue->tail->next = frame;
+    else
+        queue->head = frame;
+    queue->tail = frame;
+    queue->length++;
+
+    pthread_cond_signal(&queue->frame_queued);
+    pthread_mutex_unlock(&queue->lock);
+
+    return 0;
+
+}
+
+int guacenc_frame_queue_free(guacenc_frame_queue* queue) {
+
+    /* Wait for all queued frames to be encoded */
+    pthread_mutex_lock(&queue->lock);
+    queue->stopping = true;
+    pthread_cond_signal(&queue->frame_queued);
+    pthread_mutex_unlock(&queue->lock);
+
+    pthread_join(queue->thread, NULL);
+
+    /* Free all frames (all queued frames are now unused) */
+    guacenc_frame* frame = queue->unused;
+    while (frame != NULL) {
+        guacenc_frame* next = frame->next;
+        guacenc_buffer_free(frame->buffer);
+        guac_mem_free(frame);
+        frame = next;
+    }
+
+    int retval = queue->failed;
+
+    pthread_cond_destroy(&queue->frame_encoded);
+    pthread_cond_destroy(&queue->frame_queued);
+    pthread_mutex_destroy(&queue->lock);
+    guac_mem_free(queue);
+
+    return retval;
+
+}
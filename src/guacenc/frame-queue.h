@@ -0,0 +1,189 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUACENC_FRAME_QUEUE_H
+#define GUACENC_FRAME_QUEUE_H
+
+#include "config.h"
+#include "buffer.h"
+#include "video.h"
+
+#include <guacamole/timestamp.h>
+
+#include <pthread.h>
+#include <stdbool.h>
+
+/**
+ * The maximum number of rendered frames which may be awaiting encoding at any
+ * one time. Once this limit is reached, further frames are not accepted until
+ * the encoding thread has encoded the oldest queued frame.
+ */
+#define GUACENC_FRAME_QUEUE_MAX_LENGTH 8
+
+/**
+ * A copy of a fully-rendered frame, awaiting encoding.
+ */
+typedef struct guacenc_frame {
+
+    /**
+     * The rendered contents of the frame.
+     */
+    guacenc_buffer* buffer;
+
+    /**
+     * The timestamp of the "sync" instruction which completed the frame.
+     */
+    guac_timestamp timestamp;
+
+    /**
+     * Whether the frame differs from the previous frame. If false, the
+     * contents of buffer are undefined and the previously-prepared frame is
+     * simply encoded again.
+     */
+    bool changed;
+
+    /**
+     * The next frame in the queue or list of unused frames, or NULL if this
+     * is the last such frame.
+     */
+    struct guacenc_frame* next;
+
+} guacenc_frame;
+
+/**
+ * A bounded queue of rendered frames which are encoded by a dedicated
+ * thread, such that rendering of the next frame may proceed while the
+ * previous frame is scaled, converted and encoded.
+ */
+typedef struct guacenc_frame_queue {
+
+    /**
+     * The video that all queued frames should be written to. Once the queue
+     * has been allocated, this video must not be used by any other thread
+     * until the queue is freed.
+     */
+    guacenc_video* video;
+
+    /**
+     * The thread encoding queued frames.
+     */
+    pthread_t thread;
+
+    /**
+     * Lock which guards all queued and unused frames, as well as the
+     * stopping and failed flags.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition which is signalled when a frame has been queued or the queue
+     * is being freed.
+     */
+    pthread_cond_t frame_queued;
+
+    /**
+     * Condition which is signalled when the encoding thread has finished
+     * encoding a frame.
+     */
+    pthread_cond_t frame_encoded;
+
+    /**
+     * The oldest queued frame, or NULL if the queue is empty.
+     */
+    guacenc_frame* head;
+
+    /**
+     * The most recently queued frame, or NULL if the queue is empty.
+     */
+    guacenc_frame* tail;
+
+    /**
+     * Frames which have been encoded and may be reused.
+     */
+    guacenc_frame* unused;
+
+    /**
+     * The number of queued frames.
+     */
+    int length;
+
+    /**
+     * Whether the encoding thread should encode all remaining frames and
+     * then terminate.
+     */
+    bool stopping;
+
+    /**
+     * Whether an error has occurred while encoding.
+     */
+    bool failed;
+
+} guacenc_frame_queue;
+
+/**
+ * Allocates a new frame queue, starting a dedicated thread which encodes all
+ * queued frames to the given video.
+ *
+ * @param video
+ *     The video that queued frames should be written to.
+ *
+ * @return
+ *     A newly-allocated guacenc_frame_queue, or NULL if the encoding thread
+ *     cannot be started.
+ */
+guacenc_frame_queue* guacenc_frame_queue_alloc(guacenc_video* video);
+
+/**
+ * Queues a copy of the given rendered frame for encoding, waiting for space
+ * within the queue if necessary. The encoding thread handles each frame
+ * exactly as guacenc_display_sync() would handle it directly, advancing the
+ * video timeline to the given timestamp and preparing the frame.
+ *
+ * @param queue
+ *     The queue to add the frame to.
+ *
+ * @param timestamp
+ *     The timestamp of the "sync" instruction which completed the frame.
+ *
+ * @param buffer
+ *     The rendered frame, or NULL if the frame is identical to the previous
+ *     frame. The contents of this buffer are copied, thus the buffer may be
+ *     modified as soon as this function returns.
+ *
+ * @return
+ *     Zero if the frame was queued, non-zero if an error has occurred while
+ *     encoding a previous frame or the frame cannot be copied.
+ */
+int guacenc_frame_queue_push(guacenc_frame_queue* queue,
+        guac_timestamp timestamp, guacenc_buffer* buffer);
+
+/**
+ * Waits for all queued frames to be encoded, stops the encoding thread and
+ * frees the given queue. The associated video is not freed.
+ *
+ * @param queue
+ *     The queue to free.
+ *
+ * @return
+ *     Zero if all frames were encoded successfully, non-zero otherwise.
+ */
+int guacenc_frame_queue_free(guacenc_frame_queue* queue);
+
+#endif
+
@@ -19,6 +19,8 @@
 
 #include "config.h"
 
+#include "batch.h"
+#include "display.h"
 #include "encode.h"
 #include "guacenc.h"
 #include "log.h"
@@ -27,9 +29,26 @@
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 
+#include <errno.h>
 #include <getopt.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * All long options accepted by guacenc, each corresponding to a short
+ * option of the same meaning.
+ */
+static const struct option guacenc_long_options[] = {
+    { "threads", required_argument, NULL, 't' },
+    { "start",   required_argument, NULL, 'S' },
+    { "end",     required_argument, NULL, 'E' },
+    { "jobs",    required_argument, NULL, 'j' },
+    { "list",    required_argument, NULL, 'l' },
+    { "report",  required_argument, NULL, 'R' },
+    { NULL,      0,                 NULL, 0   }
+};
 
 int main(int argc, char* argv[]) {
 
@@ -40,10 +59,22 @@ int main(int argc, char* argv[]) {
     int width = GUACENC_DEFAULT_WIDTH;
     int height = GUACENC_DEFAULT_HEIGHT;
     int bitrate = GUACENC_DEFAULT_BITRATE;
+    guac_timestamp start = 0;
+    guac_timestamp end = GUACENC_DISPLAY_NO_END;
+    int jobs = 1;
+    const char* list_path = NULL;
+    const char* report_path = NULL;
+    bool list_failed = false;
+
+    /* Use one thread per available processor by default */
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1)
+        threads = 1;
 
     /* Parse arguments */
     int opt;
-    while ((opt = getopt(argc, argv, "s:r:f")) != -1) {
+    while ((opt = getopt_long(argc, argv, "s:r:t:S:E:j:l:R:f",
+                    guacenc_long_options, NULL)) != -1) {
 
         /* -s: Dimensions (WIDTHxHEIGHT) */
         if (opt == 's') {
@@ -61,6 +92,46 @@ int main(int argc, char* argv[]) {
             }
         }
 
+        /* -t: Threads */
+        else if (opt == 't') {
+            if (guacenc_parse_int(optarg, &threads) || threads < 1) {
+                guacenc_log(GUAC_LOG_ERROR, "Invalid number of threads.");
+                goto invalid_options;
+            }
+        }
+
+        /* -S: Start of range to encode */
+        else if (opt == 'S') {
+            if (guacenc_parse_time(optarg, &start)) {
+                guacenc_log(GUAC_LOG_ERROR, "Invalid start time.");
+                goto invalid_options;
+            }
+        }
+
+        /* -E: End of range to encode */
+        else if (opt == 'E') {
+            if (guacenc_parse_time(optarg, &end)) {
+                guacenc_log(GUAC_LOG_ERROR, "Invalid end time.");
+                goto invalid_options;
+            }
+        }
+
+        /* -j: Number of files to encode concurrently */
+        else if (opt == 'j') {
+            if (guacenc_parse_int(optarg, &jobs)) {
+                guacenc_log(GUAC_LOG_ERROR, "Invalid number of jobs.");
+                goto invalid_options;
+            }
+        }
+
+        /* -l: File listing recordings to encode */
+        else if (opt == 'l')
+            list_path = optarg;
+
+        /* -R: Machine-readable report */
+        else if (opt == 'R')
+            report_path = optarg;
+
         /* -f: Force */
         else if (opt == 'f')
             force = true;
@@ -72,6 +143,12 @@ int main(int argc, char* argv[]) {
 
     }
 
+    /* The range to encode must not be empty */
+    if (end != GUACENC_DISPLAY_NO_END && end <= start) {
+        guacenc_log(GUAC_LOG_ERROR, "End time must be after start time.");
+        goto invalid_options;
+    }
+
     /* Log start */
     guacenc_log(GUAC_LOG_INFO, "Guacamole video encoder (guacenc) "
             "version " VERSION);
@@ -85,50 +162,78 @@ int main(int argc, char* argv[]) {
     av_register_all();
 #endif
 
-    /* Track number of overall failures */
-    int total_files = argc - optind;
-    int failures = 0;
+    /* Build list of all recordings to encode */
+    guacenc_batch* batch = guacenc_batch_alloc(width, height, bitrate,
+            threads, start, end, force);
+
+    for (i = optind; i < argc; i++) {
+        if (guacenc_batch_add(batch, argv[i]))
+            list_failed = true;
+    }
+
+    if (list_path != NULL && guacenc_batch_add_list(batch, list_path))
+        list_failed = true;
+
+    /* Abort if any directory or list of recordings could not be read */
+    if (list_failed) {
+        guacenc_batch_free(batch);
+        return 1;
+    }
 
     /* Abort if no files given */
+    int total_files = batch->count;
     if (total_files <= 0) {
         guacenc_log(GUAC_LOG_INFO, "No input files specified. Nothing to do.");
+        guacenc_batch_free(batch);
         return 0;
     }
 
     guacenc_log(GUAC_LOG_INFO, "%i input file(s) provided.", total_files);
 
     guacenc_log(GUAC_LOG_INFO, "Video will be encoded at %ix%i "
-            "and %i bps.", width, height, bitrate);
-
-    /* Encode all input files */
-    for (i = optind; i < argc; i++) {
+            "and %i bps using %i thread(s).", width, height, bitrate,
+            threads);
+
+    if (start != 0 || end != GUACENC_DISPLAY_NO_END) {
+        if (end != GUACENC_DISPLAY_NO_END)
+            guacenc_log(GUAC_LOG_INFO, "Only %.3f to %.3f seconds into each "
+                    "recording will be encoded.", start / 1000.0,
+                    end / 1000.0);
+        else
+            guacenc_log(GUAC_LOG_INFO, "Only %.3f seconds into each "
+                    "recording onward will be encoded.", start / 1000.0);
+    }
 
-        /* Get current filename */
-        const char* path = argv[i];
+    if (jobs > 1)
+        guacenc_log(GUAC_LOG_INFO, "Up to %i file(s) will be encoded "
+                "concurrently.", jobs);
 
-        /* Generate output filename */
-        char out_path[4096];
-        int len = snprintf(out_path, sizeof(out_path), "%s.m4v", path);
+    /* Open machine-readable report, if requested */
+    if (report_path != NULL) {
 
-        /* Do not write if filename exceeds maximum length */
-        if (len >= sizeof(out_path)) {
-            guacenc_log(GUAC_LOG_ERROR, "Cannot write output file for \"%s\": "
-                    "Name too long", path);
-            continue;
-        }
+        if (strcmp(report_path, "-") == 0)
+            batch->report = stdout;
 
-        /* Attempt encoding, log granular success/failure at debug level */
-        if (guacenc_encode(path, out_path, "mpeg4",
-                    width, height, bitrate, force)) {
-            failures++;
-            guacenc_log(GUAC_LOG_DEBUG,
-                    "%s was NOT successfully encoded.", path);
+        else {
+            batch->report = fopen(report_path, "w");
+            if (batch->report == NULL) {
+                guacenc_log(GUAC_LOG_ERROR, "Cannot write report \"%s\": %s",
+                        report_path, strerror(errno));
+                guacenc_batch_free(batch);
+                return 1;
+            }
         }
-        else
-            guacenc_log(GUAC_LOG_DEBUG, "%s was successfully encoded.", path);
 
     }
 
+    /* Encode all input files */
+    int failures = guacenc_batch_encode(batch, jobs);
+
+    if (batch->report != NULL && batch->report != stdout)
+        fclose(batch->report);
+
+    guacenc_batch_free(batch);
+
     /* Warn if at least one file failed */
     if (failures != 0)
         guacenc_log(GUAC_LOG_WARNING, "Encoding failed for %i of %i file(s).",
@@ -147,6 +252,12 @@ invalid_options:
     fprintf(stderr, "USAGE: %s"
             " [-s WIDTHxHEIGHT]"
             " [-r BITRATE]"
+            " [-t THREADS]"
+            " [-S START]"
+            " [-E END]"
+            " [-j JOBS]"
+            " [-l LIST]"
+            " [-R REPORT]"
             " [-f]"
             " [FILE]...\n", argv[0]);
 
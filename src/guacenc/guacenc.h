@@ -44,6 +44,12 @@
  */
 #define GUACENC_DEFAULT_BITRATE 2000000
 
+/**
+ * The interval between progress reports logged while encoding, in
+ * milliseconds.
+ */
+#define GUACENC_PROGRESS_INTERVAL 5000
+
 /**
  * The default log level below which no messages should be logged.
  */
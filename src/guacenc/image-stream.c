@@ -119,18 +119,15 @@ int guacenc_image_stream_receive(guacenc_image_stream* stream,
 
 }
 
-int guacenc_image_stream_end(guacenc_image_stream* stream,
-        guacenc_buffer* buffer) {
-
-    /* If there is no decoder, simply return success */
-    guacenc_decoder* decoder = stream->decoder;
-    if (decoder == NULL)
-        return 0;
+cairo_surface_t* guacenc_image_stream_decode(guacenc_image_stream* stream) {
 
     /* Decode received data to a Cairo surface */
-    cairo_surface_t* surface = stream->decoder(stream->buffer, stream->length);
-    if (surface == NULL)
-        return 1;
+    return stream->decoder(stream->buffer, stream->length);
+
+}
+
+int guacenc_image_stream_draw(guacenc_image_stream* stream,
+        cairo_surface_t* surface, guacenc_buffer* buffer) {
 
     /* Get surface dimensions */
     int width = cairo_image_surface_get_width(surface);
@@ -146,6 +143,8 @@ int guacenc_image_stream_end(guacenc_image_stream* stream,
         cairo_set_source_surface(buffer->cairo, surface, stream->x, stream->y);
         cairo_rectangle(buffer->cairo, stream->x, stream->y, width, height);
         cairo_fill(buffer->cairo);
+        guacenc_display_damage(buffer, stream->mask, stream->x, stream->y,
+                width, height);
     }
 
     cairo_surface_destroy(surface);
@@ -153,6 +152,24 @@ int guacenc_image_stream_end(guacenc_image_stream* stream,
 
 }
 
+int guacenc_image_stream_end(guacenc_image_stream* stream,
+        guacenc_buffer* buffer) {
+
+    /* If there is no decoder, simply return success */
+    guacenc_decoder* decoder = stream->decoder;
+    if (decoder == NULL)
+        return 0;
+
+    /* Decode received data to a Cairo surface */
+    cairo_surface_t* surface = guacenc_image_stream_decode(stream);
+    if (surface == NULL)
+        return 1;
+
+    /* Draw decoded image to buffer */
+    return guacenc_image_stream_draw(stream, surface, buffer);
+
+}
+
 int guacenc_image_stream_free(guacenc_image_stream* stream) {
 
     /* Ignore NULL streams */
@@ -215,6 +215,42 @@ int guacenc_image_stream_receive(guacenc_image_stream* stream,
 int guacenc_image_stream_end(guacenc_image_stream* stream,
         guacenc_buffer* buffer);
 
+/**
+ * Decodes all data received along the given image stream using the decoder
+ * associated with that stream, which must not be NULL. This function does
+ * not modify the stream and does not touch any buffer or layer, and thus may
+ * safely be invoked from a thread other than the one handling instructions.
+ *
+ * @param stream
+ *     The image stream that has ended.
+ *
+ * @return
+ *     A newly-allocated Cairo surface containing the decoded image, or NULL
+ *     if decoding fails.
+ */
+cairo_surface_t* guacenc_image_stream_decode(guacenc_image_stream* stream);
+
+/**
+ * Draws the given decoded image to the given buffer at the position and with
+ * the compositing operation specified when the image stream was created. The
+ * given surface is destroyed by this function.
+ *
+ * @param stream
+ *     The image stream whose data was decoded to produce the given surface.
+ *
+ * @param surface
+ *     The decoded image, as returned by guacenc_image_stream_decode().
+ *
+ * @param buffer
+ *     The buffer that the decoded image should be written to.
+ *
+ * @return
+ *     Zero if the image is written successfully, or non-zero if an error
+ *     occurs.
+ */
+int guacenc_image_stream_draw(guacenc_image_stream* stream,
+        cairo_surface_t* surface, guacenc_buffer* buffer);
+
 /**
  * Frees the given image stream and all associated data. If the image stream
  * has not yet ended (reached end-of-stream), no image will be drawn to the
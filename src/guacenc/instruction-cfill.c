@@ -48,9 +48,25 @@ int guacenc_handle_cfill(guacenc_display* display, int argc, char** argv) {
 
     /* Fill with RGBA color */
     if (buffer->cairo != NULL) {
+
+        /* Determine the area affected by the fill from the current path */
+        double x1, y1, x2, y2;
+        cairo_fill_extents(buffer->cairo, &x1, &y1, &x2, &y2);
+
+        /* Round outward to whole pixels (coordinates within the buffer are
+         * never negative, thus truncation rounds down) */
+        int x = x1;
+        int y = y1;
+        int right = x2;
+        int bottom = y2;
+        if (right < x2) right++;
+        if (bottom < y2) bottom++;
+        guacenc_display_damage(buffer, mask, x, y, right - x, bottom - y);
+
         cairo_set_operator(buffer->cairo, guacenc_display_cairo_operator(mask));
         cairo_set_source_rgba(buffer->cairo, r, g, b, a);
         cairo_fill(buffer->cairo);
+
     }
 
     return 0;
@@ -90,6 +90,7 @@ int guacenc_handle_copy(guacenc_display* display, int argc, char** argv) {
         cairo_set_source_surface(dst->cairo, surface, dx - sx, dy - sy);
         cairo_rectangle(dst->cairo, dx, dy, width, height);
         cairo_fill(dst->cairo);
+        guacenc_display_damage(dst, mask, dx, dy, width, height);
 
         /* Destroy temporary surface if it was created */
         if (surface != src->surface)
@@ -63,6 +63,7 @@ int guacenc_handle_cursor(guacenc_display* display, int argc, char** argv) {
         cairo_set_operator(dst->cairo, CAIRO_OPERATOR_SOURCE);
         cairo_set_source_surface(dst->cairo, src->surface, sx, sy);
         cairo_paint(dst->cairo);
+        guacenc_buffer_damage(dst, 0, 0, dst->width, dst->height);
     }
 
     return 0;
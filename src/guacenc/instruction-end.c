@@ -49,6 +49,14 @@ int guacenc_handle_end(guacenc_display* display, int argc, char** argv) {
     if (buffer == NULL)
         return 1;
 
+    /* Decode image in parallel with further instruction handling, if
+     * possible, transferring ownership of the ended stream to the pool */
+    if (display->decoders != NULL) {
+        display->image_streams[index] = NULL;
+        guacenc_decoder_pool_submit(display->decoders, stream, buffer);
+        return 0;
+    }
+
     /* End image stream, drawing final image to the buffer */
     return guacenc_image_stream_end(stream, buffer);
 
@@ -55,6 +55,9 @@ int guacenc_handle_move(guacenc_display* display, int argc, char** argv) {
     layer->y = y;
     layer->z = z;
 
+    /* Layer must be recomposited in its new position */
+    display->layers_changed = true;
+
     return 0;
 
 }
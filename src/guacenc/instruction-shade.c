@@ -45,6 +45,9 @@ int guacenc_handle_shade(guacenc_display* display, int argc, char** argv) {
     /* Update layer properties */
     layer->opacity = opacity;
 
+    /* Layer must be recomposited with its new opacity */
+    display->layers_changed = true;
+
     return 0;
 
 }
@@ -54,6 +54,15 @@ int guacenc_handle_instruction(guacenc_display* display, const char* opcode,
         /* Invoke handler if opcode matches (if defined) */
         if (strcmp(current->opcode, opcode) == 0) {
 
+            /* Draw any images still being decoded before handling any
+             * instruction which may depend on the contents of a layer or
+             * buffer (only image streams themselves are independent) */
+            if (display->decoders != NULL
+                    && current->handler != guacenc_handle_blob
+                    && current->handler != guacenc_handle_img
+                    && current->handler != guacenc_handle_end)
+                guacenc_decoder_pool_flush(display->decoders);
+
             /* Invoke defined handler */
             guacenc_instruction_handler* handler = current->handler;
             if (handler != NULL)
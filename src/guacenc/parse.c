@@ -23,9 +23,17 @@
 
 #include <errno.h>
 #include <limits.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 
+/**
+ * The largest number of whole seconds which guacenc_parse_time() will
+ * accept, such that the resulting number of milliseconds (including any
+ * fractional part) cannot overflow a guac_timestamp.
+ */
+#define GUACENC_MAX_TIME_SECONDS ((INT64_MAX - 999) / 1000)
+
 int guacenc_parse_int(char* arg, int* i) {
 
     char* end;
@@ -90,3 +98,74 @@ guac_timestamp guacenc_parse_timestamp(const char* str) {
 
 }
 
+int guacenc_parse_time(const char* arg, guac_timestamp* time) {
+
+    guac_timestamp seconds = 0;
+    int components = 0;
+
+    /* Parse each colon-separated component */
+    for (;;) {
+
+        /* Each component must begin with a digit */
+        if (*arg < '0' || *arg > '9')
+            return 1;
+
+        char* end;
+        errno = 0;
+        long int value = strtol(arg, &end, 10);
+        if (errno != 0)
+            return 1;
+
+        /* Only the leading component may be 60 or greater */
+        if (components > 0 && value >= 60)
+            return 1;
+
+        /* Reject durations too large to be represented in milliseconds */
+        if (value > GUACENC_MAX_TIME_SECONDS
+                || seconds > (GUACENC_MAX_TIME_SECONDS - value) / 60)
+            return 1;
+
+        seconds = seconds * 60 + value;
+        components++;
+        arg = end;
+
+        /* Stop after the last component (at most hours, minutes, seconds) */
+        if (*arg != ':')
+            break;
+
+        if (components == 3)
+            return 1;
+
+        arg++;
+
+    }
+
+    guac_timestamp milliseconds = seconds * 1000;
+
+    /* Parse optional fractional seconds */
+    if (*arg == '.') {
+
+        arg++;
+
+        int scale = 100;
+        for (; *arg >= '0' && *arg <= '9'; arg++) {
+
+            /* Sub-millisecond precision is not supported */
+            if (scale == 0)
+                return 1;
+
+            milliseconds += (*arg - '0') * scale;
+            scale /= 10;
+
+        }
+
+    }
+
+    /* Reject trailing garbage */
+    if (*arg != '\0')
+        return 1;
+
+    *time = milliseconds;
+    return 0;
+
+}
@@ -80,5 +80,25 @@ int guacenc_parse_dimensions(char* arg, int* width, int* height);
  */
 guac_timestamp guacenc_parse_timestamp(const char* str);
 
+/**
+ * Parses a non-negative duration of the form [[HH:]MM:]SS[.mmm] into a
+ * number of milliseconds. Each component other than the first must be less
+ * than 60, and any fractional part may have at most three digits. Durations
+ * too large to be represented as a guac_timestamp are rejected. A value will
+ * be stored in the provided guac_timestamp pointer only if valid.
+ *
+ * @param arg
+ *     The string to parse.
+ *
+ * @param time
+ *     A pointer to the guac_timestamp in which the parsed duration, in
+ *     milliseconds, should be stored.
+ *
+ * @return
+ *     Zero if parsing was successful, non-zero if the provided string was
+ *     invalid.
+ */
+int guacenc_parse_time(const char* arg, guac_timestamp* time);
+
 #endif
 
@@ -46,7 +46,7 @@
 #include <unistd.h>
 
 guacenc_video* guacenc_video_alloc(const char* path, const char* codec_name,
-        int width, int height, int bitrate) {
+        int width, int height, int bitrate, int threads) {
 
     const AVOutputFormat *container_format;
     AVFormatContext *container_format_context;
@@ -93,6 +93,9 @@ guacenc_video* guacenc_video_alloc(const char* path, const char* codec_name,
         goto fail_context;
     }
 
+    /* Allow codec to use multiple threads, if supported */
+    avcodec_context->thread_count = threads;
+
     /* If format needs global headers, write them */
     if (container_format_context->oformat->flags & AVFMT_GLOBALHEADER) {
         avcodec_context->flags |= GUACENC_FLAG_GLOBAL_HEADER;
@@ -155,6 +158,20 @@ guacenc_video* guacenc_video_alloc(const char* path, const char* codec_name,
     /* No frames have been written or prepared yet */
     video->last_timestamp = 0;
     video->next_pts = 0;
+    video->frame_pending = false;
+
+    /* Scaling context is created when the first frame is prepared */
+    video->sws = NULL;
+    video->source_width = 0;
+    video->source_height = 0;
+    video->scaled_x = 0;
+    video->scaled_y = 0;
+
+    /* Avoid encoding duplicate frames if the container does not require a
+     * constant frame rate */
+    video->variable_frame_rate =
+            (container_format->flags & AVFMT_VARIABLE_FPS)
+        && !(container_format->flags & AVFMT_NOTIMESTAMPS);
 
     return video;
 
@@ -241,6 +258,9 @@ static int guacenc_video_write_frame(guacenc_video* video, AVFrame* frame) {
  */
 static int guacenc_video_flush_frame(guacenc_video* video) {
 
+    /* Prepared frame will now have been written */
+    video->frame_pending = false;
+
     /* Write frame to video */
     return guacenc_video_write_frame(video, video->next_frame) < 0;
 
@@ -266,14 +286,34 @@ int guacenc_video_advance_timeline(guacenc_video* video,
         next_timestamp = video->last_timestamp
                         + elapsed * 1000 / GUACENC_VIDEO_FRAMERATE;
 
-        /* Flush frames to bring timeline in sync, duplicating if necessary */
-        do {
-            if (guacenc_video_flush_frame(video)) {
+        /* If frames may have arbitrary duration, write the prepared frame
+         * only once (and not at all if unchanged since last written), leaving
+         * a gap in presentation timestamps for the time elapsed */
+        if (video->variable_frame_rate) {
+
+            int64_t next_pts = video->next_pts + elapsed;
+
+            if (video->frame_pending && guacenc_video_flush_frame(video)) {
                 guacenc_log(GUAC_LOG_ERROR, "Unable to flush frame to video "
                         "stream.");
                 return 1;
             }
-        } while (--elapsed != 0);
+
+            video->next_pts = next_pts;
+
+        }
+
+        /* Otherwise, flush frames to bring timeline in sync, duplicating if
+         * necessary (the prepared frame is not converted again) */
+        else {
+            do {
+                if (guacenc_video_flush_frame(video)) {
+                    guacenc_log(GUAC_LOG_ERROR, "Unable to flush frame to "
+                            "video stream.");
+                    return 1;
+                }
+            } while (--elapsed != 0);
+        }
 
     }
 
@@ -284,125 +324,100 @@ int guacenc_video_advance_timeline(guacenc_video* video,
 }
 
 /**
- * Converts the given Guacamole video encoder buffer to a frame in the format
- * required by libavcodec / libswscale. Black margins of the specified sizes
- * will be added. No scaling is performed; the image data is copied verbatim.
+ * Fills the given frame with black, in the YCbCr format required by the
+ * codec. This is used to clear any letterboxes or pillarboxes around the
+ * region of the frame that scaled images are written to.
+ *
+ * @param frame
+ *     The frame to clear.
+ */
+static void guacenc_video_frame_clear(AVFrame* frame) {
+
+    int chroma_height = (frame->height + 1) / 2;
+
+    /* Black in limited-range YCbCr has a luma of 16 and neutral chroma */
+    memset(frame->data[0], 16, frame->linesize[0] * frame->height);
+    memset(frame->data[1], 128, frame->linesize[1] * chroma_height);
+    memset(frame->data[2], 128, frame->linesize[2] * chroma_height);
+
+}
+
+/**
+ * Updates the software scaling context of the given video such that it
+ * scales frames of the given dimensions to fit the video while preserving
+ * aspect ratio, reusing the existing context if possible. The destination
+ * frame is cleared to black such that any letterboxes or pillarboxes around
+ * the scaled region are already present for all future frames of the same
+ * size.
  *
- * @param buffer
- *     The guacenc_buffer to copy as a new AVFrame.
+ * @param video
+ *     The video whose scaling context should be updated.
  *
- * @param lsize
- *     The size of the letterboxes to add, in pixels. Letterboxes are the
- *     horizontal black boxes added to images which are scaled down to fit the
- *     destination because they are too wide (the width is scaled to exactly
- *     fit the destination, resulting in extra space at the top and bottom).
+ * @param width
+ *     The width of the frames that will be prepared, in pixels.
  *
- * @param psize
- *     The size of the pillarboxes to add, in pixels. Pillarboxes are the
- *     vertical black boxes added to images which are scaled down to fit the
- *     destination because they are too tall (the height is scaled to exactly
- *     fit the destination, resulting in extra space on the sides).
+ * @param height
+ *     The height of the frames that will be prepared, in pixels.
  *
  * @return
- *     A pointer to a newly-allocated AVFrame containing exactly the same image
- *     data as the given buffer. The image data within the frame and the frame
- *     itself must be manually freed later.
+ *     Zero if the scaling context was successfully updated, non-zero
+ *     otherwise.
  */
-static AVFrame* guacenc_video_frame_convert(guacenc_buffer* buffer, int lsize,
-        int psize) {
-
-    /* Init size of left/right pillarboxes */
-    int left = psize;
-    int right = psize;
+static int guacenc_video_update_scaling(guacenc_video* video, int width,
+        int height) {
 
-    /* Init size of top/bottom letterboxes */
-    int top = lsize;
-    int bottom = lsize;
-
-    /* Prepare source frame for buffer */
-    AVFrame* frame = av_frame_alloc();
-    if (frame == NULL)
-        return NULL;
+    AVFrame* dst = video->next_frame;
 
-    /* Copy buffer properties to frame */
-    frame->format = AV_PIX_FMT_RGB32;
-    frame->width = buffer->width + left + right;
-    frame->height = buffer->height + top + bottom;
+    int scaled_width;
+    int scaled_height;
 
-    /* Allocate actual backing data for frame */
-    if (av_image_alloc(frame->data, frame->linesize, frame->width,
-                frame->height, frame->format, 32) < 0) {
-        av_frame_free(&frame);
-        return NULL;
+    /* If height-based scaling results in a fit width, add pillarboxes */
+    if ((int64_t) width * dst->height <= (int64_t) dst->width * height) {
+        scaled_height = dst->height;
+        scaled_width = (int64_t) width * dst->height / height;
     }
 
-    /* Flush any pending operations */
-    cairo_surface_flush(buffer->surface);
-
-    /* Get pointer to source image data */
-    unsigned char* src_data = buffer->image;
-    int src_stride = buffer->stride;
-
-    /* Get pointer to destination image data */
-    unsigned char* dst_data = frame->data[0];
-    int dst_stride = frame->linesize[0];
-
-    /* Get source/destination dimensions */
-    int width = buffer->width;
-    int height = buffer->height;
-
-    /* Source buffer is guaranteed to fit within destination buffer */
-    assert(width <= frame->width);
-    assert(height <= frame->height);
-
-    /* Add top margin */
-    while (top > 0) {
-        memset(dst_data, 0, frame->width * 4);
-        dst_data += dst_stride;
-        top--;
+    /* Otherwise, width-based scaling results in a fit height, thus add
+     * letterboxes */
+    else {
+        scaled_width = dst->width;
+        scaled_height = (int64_t) height * dst->width / width;
     }
 
-    /* Copy all data from source buffer to destination frame */
-    while (height > 0) {
-
-        /* Calculate size of margin and data regions */
-        int left_size = left * 4;
-        int data_size = width * 4;
-        int right_size = right * 4;
-
-        /* Add left margin */
-        memset(dst_data, 0, left_size);
-
-        /* Copy data */
-        memcpy(dst_data + left_size, src_data, data_size);
+    /* Never scale to nothing */
+    if (scaled_width < 1) scaled_width = 1;
+    if (scaled_height < 1) scaled_height = 1;
 
-        /* Add right margin */
-        memset(dst_data + left_size + data_size, 0, right_size);
+    /* Retrieve (or replace) scaling context */
+    struct SwsContext* sws = sws_getCachedContext(video->sws,
+            width, height, AV_PIX_FMT_RGB32,
+            scaled_width, scaled_height, AV_PIX_FMT_YUV420P,
+            SWS_BICUBIC, NULL, NULL, NULL);
 
-        dst_data += dst_stride;
-        src_data += src_stride;
+    if (sws == NULL) {
+        sws_freeContext(video->sws);
+        video->sws = NULL;
+        return 1;
+    }
 
-        height--;
+    video->sws = sws;
+    video->source_width = width;
+    video->source_height = height;
 
-    }
+    /* Center scaled image within frame, keeping offsets even such that they
+     * correspond exactly to chroma samples */
+    video->scaled_x = ((dst->width - scaled_width) / 2) & ~1;
+    video->scaled_y = ((dst->height - scaled_height) / 2) & ~1;
 
-    /* Add bottom margin */
-    while (bottom > 0) {
-        memset(dst_data, 0, frame->width * 4);
-        dst_data += dst_stride;
-        bottom--;
-    }
+    /* Draw letterboxes / pillarboxes once */
+    guacenc_video_frame_clear(dst);
 
-    /* Frame converted */
-    return frame;
+    return 0;
 
 }
 
 void guacenc_video_prepare_frame(guacenc_video* video, guacenc_buffer* buffer) {
 
-    int lsize;
-    int psize;
-
     /* Ignore NULL buffers */
     if (buffer == NULL || buffer->surface == NULL)
         return;
@@ -410,59 +425,43 @@ void guacenc_video_prepare_frame(guacenc_video* video, guacenc_buffer* buffer) {
     /* Obtain destination frame */
     AVFrame* dst = video->next_frame;
 
-    /* Determine width of image if height is scaled to match destination */
-    int scaled_width = buffer->width * dst->height / buffer->height;
-
-    /* Determine height of image if width is scaled to match destination */
-    int scaled_height = buffer->height * dst->width / buffer->width;
+    /* Prepare scaling context if dimensions have changed */
+    if (video->sws == NULL || buffer->width != video->source_width
+            || buffer->height != video->source_height) {
 
-    /* If height-based scaling results in a fit width, add pillarboxes */
-    if (scaled_width <= dst->width) {
-        lsize = 0;
-        psize = (dst->width - scaled_width)
-               * buffer->height / dst->height / 2;
-    }
-
-    /* If width-based scaling results in a fit width, add letterboxes */
-    else {
-        assert(scaled_height <= dst->height);
-        psize = 0;
-        lsize = (dst->height - scaled_height)
-               * buffer->width / dst->width / 2;
-    }
+        if (guacenc_video_update_scaling(video, buffer->width,
+                    buffer->height)) {
+            guacenc_log(GUAC_LOG_WARNING, "Failed to allocate software "
+                    "scaling context. Frame dropped.");
+            return;
+        }
 
-    /* Prepare source frame for buffer */
-    AVFrame* src = guacenc_video_frame_convert(buffer, lsize, psize);
-    if (src == NULL) {
-        guacenc_log(GUAC_LOG_WARNING, "Failed to allocate source frame. "
-                "Frame dropped.");
-        return;
     }
 
-    /* Prepare scaling context */
-    struct SwsContext* sws = sws_getContext(src->width, src->height,
-            AV_PIX_FMT_RGB32, dst->width, dst->height, AV_PIX_FMT_YUV420P,
-            SWS_BICUBIC, NULL, NULL, NULL);
+    /* Flush any pending operations */
+    cairo_surface_flush(buffer->surface);
 
-    /* Abort if scaling context could not be created */
-    if (sws == NULL) {
-        guacenc_log(GUAC_LOG_WARNING, "Failed to allocate software scaling "
-                "context. Frame dropped.");
-        av_freep(&src->data[0]);
-        av_frame_free(&src);
-        return;
-    }
+    /* Scale directly from the buffer, which is already in the format
+     * expected by libswscale */
+    const uint8_t* src_data[4] = { buffer->image, NULL, NULL, NULL };
+    int src_linesize[4] = { buffer->stride, 0, 0, 0 };
 
-    /* Apply scaling, copying the source frame to the destination */
-    sws_scale(sws, (const uint8_t* const*) src->data, src->linesize,
-            0, src->height, dst->data, dst->linesize);
+    /* Write to the scaled region of the frame, leaving letterboxes and
+     * pillarboxes untouched */
+    int x = video->scaled_x;
+    int y = video->scaled_y;
+    uint8_t* dst_data[4] = {
+        dst->data[0] + y * dst->linesize[0] + x,
+        dst->data[1] + y / 2 * dst->linesize[1] + x / 2,
+        dst->data[2] + y / 2 * dst->linesize[2] + x / 2,
+        NULL
+    };
 
-    /* Free scaling context */
-    sws_freeContext(sws);
+    /* Apply scaling, copying the buffer to the destination */
+    sws_scale(video->sws, src_data, src_linesize, 0, buffer->height,
+            dst_data, dst->linesize);
 
-    /* Free source frame */
-    av_freep(&src->data[0]);
-    av_frame_free(&src);
+    video->frame_pending = true;
 
 }
 
@@ -494,6 +493,9 @@ int guacenc_video_free(guacenc_video* video) {
         avio_close(video->container_format_context->pb);
     }
 
+    /* Free scaling context */
+    sws_freeContext(video->sws);
+
     /* Free frame encoding data */
     av_freep(&video->next_frame->data[0]);
     av_frame_free(&video->next_frame);
@@ -34,6 +34,9 @@
 #include <libavformat/avformat.h>
 #endif
 
+#include <libswscale/swscale.h>
+
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -96,6 +99,54 @@ typedef struct guacenc_video {
      */
     int64_t next_pts;
 
+    /**
+     * Whether next_frame has been modified by guacenc_video_prepare_frame()
+     * since it was last written.
+     */
+    bool frame_pending;
+
+    /**
+     * Whether the output container records the presentation timestamp of
+     * each frame, allowing a frame to remain on screen for an arbitrary
+     * duration. If true, unchanged frames are not encoded repeatedly to fill
+     * idle periods; the timeline simply advances past them.
+     */
+    bool variable_frame_rate;
+
+    /**
+     * The software scaling context used to convert prepared frames to the
+     * format and size required by the codec, or NULL if no frame has yet
+     * been prepared. This context is reused for as long as the dimensions of
+     * prepared frames remain the same.
+     */
+    struct SwsContext* sws;
+
+    /**
+     * The width of the frames that the current scaling context converts, in
+     * pixels.
+     */
+    int source_width;
+
+    /**
+     * The height of the frames that the current scaling context converts, in
+     * pixels.
+     */
+    int source_height;
+
+    /**
+     * The X coordinate of the upper-left corner of the region of next_frame
+     * that scaled frames are written to. The remainder of next_frame is
+     * black, forming pillarboxes.
+     */
+    int scaled_x;
+
+    /**
+     * The Y coordinate of the upper-left corner of the region of next_frame
+     * that scaled frames are written to. The remainder of next_frame is
+     * black, forming letterboxes.
+     */
+    int scaled_y;
+
     /**
      * The timestamp associated with the last frame, or 0 if no frames have yet
      * been added.
@@ -127,18 +178,22 @@ typedef struct guacenc_video {
  * @param bitrate
  *     The desired overall bitrate of the resulting encoded video, in bits per
  *     second.
+ *
+ * @param threads
+ *     The number of threads that libavcodec may use when encoding.
  */
 guacenc_video* guacenc_video_alloc(const char* path, const char* codec_name,
-        int width, int height, int bitrate);
+        int width, int height, int bitrate, int threads);
 
 /**
  * Advances the timeline of the encoding process to the given timestamp, such
  * that frames added via guacenc_video_prepare_frame() will be encoded at the
  * proper frame boundaries within the video. Duplicate frames will be encoded
  * as necessary to ensure that the output is correctly timed with respect to
- * the given timestamp. This is particularly important as Guacamole does not
- * have a framerate per se, and the time between each Guacamole "frame" will
- * vary significantly.
+ * the given timestamp, unless the output container allows frames of
+ * arbitrary duration, in which case each frame is encoded only once. This is
+ * particularly important as Guacamole does not have a framerate per se, and
+ * the time between each Guacamole "frame" will vary significantly.
  *
  * This function MUST be called prior to invoking guacenc_video_prepare_frame()
  * to ensure the prepared frame will be encoded at the correct point in time.
@@ -175,7 +230,8 @@ int guacenc_video_advance_timeline(guacenc_video* video,
  *
  * @param buffer
  *     The guacenc_buffer representing the image data of the frame that should
- *     be queued.
+ *     be queued, or NULL if the previously-prepared frame should be retained
+ *     (the frame has not changed).
  */
 void guacenc_video_prepare_frame(guacenc_video* video, guacenc_buffer* buffer);
 
@@ -23,9 +23,14 @@
 #include "interpret.h"
 #include "log.h"
 
+#include <guacamole/timestamp-types.h>
+
+#include <errno.h>
 #include <getopt.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 int main(int argc, char* argv[]) {
 
@@ -33,6 +38,7 @@ int main(int argc, char* argv[]) {
 
     /* Load defaults */
     bool force = false;
+    guac_timestamp start = 0;
 
     /* Parse arguments */
     int opt;
@@ -42,6 +48,23 @@ int main(int argc, char* argv[]) {
         if (opt == 'f')
             force = true;
 
+        /* -s: Start offset, in seconds */
+        else if (opt == 's') {
+
+            char* end;
+            errno = 0;
+            long seconds = strtol(optarg, &end, 10);
+            if (errno || *optarg == '\0' || *end != '\0' || seconds < 0
+                    || seconds > LONG_MAX / 1000) {
+                guaclog_log(GUAC_LOG_ERROR, "Invalid start offset: \"%s\"",
+                        optarg);
+                goto invalid_options;
+            }
+
+            start = (guac_timestamp) seconds * 1000;
+
+        }
+
         /* Invalid option */
         else {
             goto invalid_options;
@@ -83,7 +106,7 @@ int main(int argc, char* argv[]) {
         }
 
         /* Attempt interpreting, log granular success/failure at debug level */
-        if (guaclog_interpret(path, out_path, force)) {
+        if (guaclog_interpret(path, out_path, force, start)) {
             failures++;
             guaclog_log(GUAC_LOG_DEBUG,
                     "%s was NOT successfully interpreted.", path);
@@ -111,6 +134,7 @@ invalid_options:
 
     fprintf(stderr, "USAGE: %s"
             " [-f]"
+            " [-s SECONDS]"
             " [FILE]...\n", argv[0]);
 
     return 1;
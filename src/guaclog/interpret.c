@@ -20,68 +20,122 @@
 #include "config.h"
 #include "instructions.h"
 #include "log.h"
+#include "scanner.h"
 #include "state.h"
 
 #include <guacamole/client.h>
 #include <guacamole/error.h>
-#include <guacamole/parser.h>
-#include <guacamole/socket.h>
+#include <guacamole/mem.h>
 
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 /**
- * Reads and handles all Guacamole instructions from the given guac_socket
- * until end-of-stream is reached.
+ * Scans for and handles all Guacamole instructions having a defined handler
+ * until end-of-stream is reached. All other instructions are skipped without
+ * being parsed.
  *
  * @param state
  *     The current state of the Guacamole input log interpreter.
  *
  * @param path
  *     The name of the file being parsed (for logging purposes). This file
- *     must already be open and available through the given socket.
+ *     must already be open and available through the given scanner.
  *
- * @param socket
- *     The guac_socket through which instructions should be read.
+ * @param scanner
+ *     The guaclog_scanner through which instructions should be read.
+ *
+ * @param start
+ *     The offset from the first "sync" instruction at which instructions
+ *     should begin being handled, in milliseconds, or zero if all
+ *     instructions should be handled.
  *
  * @return
  *     Zero on success, non-zero if parsing of Guacamole protocol data through
- *     the given socket fails.
+ *     the given scanner fails.
  */
 static int guaclog_read_instructions(guaclog_state* state,
-        const char* path, guac_socket* socket) {
+        const char* path, guaclog_scanner* scanner, guac_timestamp start) {
 
-    /* Obtain Guacamole protocol parser */
-    guac_parser* parser = guac_parser_alloc();
-    if (parser == NULL)
-        return 1;
+    /* Count instructions having handlers */
+    int count = 0;
+    guaclog_instruction_handler_mapping* current;
+    for (current = guaclog_instruction_handler_map; current->opcode != NULL;
+            current++)
+        count++;
+
+    /* Build list of opcodes of all instructions which must be handled, plus
+     * "sync" to track the position within the recording */
+    const char** opcodes = guac_mem_alloc(sizeof(const char*), count + 2);
+    for (int i = 0; i < count; i++)
+        opcodes[i] = guaclog_instruction_handler_map[i].opcode;
+    opcodes[count] = "sync";
+    opcodes[count + 1] = NULL;
+
+    /* Timestamp at which handling begins, known once the first "sync" has
+     * been read */
+    bool skipping = (start > 0);
+    bool first_sync = true;
+    guac_timestamp target = 0;
+
+    /* Continuously read and handle all instructions of interest */
+    int result;
+    while ((result = guaclog_scanner_next(scanner, opcodes)) == 0) {
+
+        if (strcmp(scanner->opcode, "sync") == 0) {
+
+            if (!skipping || scanner->argc < 1)
+                continue;
+
+            guac_timestamp timestamp = strtoll(scanner->argv[0], NULL, 10);
+
+            /* Jump directly to the requested point if the recording is
+             * seekable, scanning forward from there otherwise */
+            if (first_sync) {
+                first_sync = false;
+                target = timestamp + start;
+                if (!guaclog_scanner_seek(scanner, target))
+                    guaclog_log(GUAC_LOG_DEBUG, "%s: Sought to %" PRIi64
+                            ".", path, (int64_t) target);
+            }
+
+            if (timestamp >= target)
+                skipping = false;
+
+            continue;
+
+        }
+
+        if (!skipping)
+            guaclog_handle_instruction(state, scanner->opcode,
+                    scanner->argc, scanner->argv);
 
-    /* Continuously read and handle all instructions */
-    while (!guac_parser_read(parser, socket, -1)) {
-        guaclog_handle_instruction(state, parser->opcode,
-                parser->argc, parser->argv);
     }
 
+    guac_mem_free(opcodes);
+
     /* Fail on read/parse error */
-    if (guac_error != GUAC_STATUS_CLOSED) {
+    if (result < 0) {
         guaclog_log(GUAC_LOG_ERROR, "%s: %s",
                 path, guac_status_string(guac_error));
-        guac_parser_free(parser);
         return 1;
     }
 
     /* Parse complete */
-    guac_parser_free(parser);
     return 0;
 
 }
 
-int guaclog_interpret(const char* path, const char* out_path, bool force) {
+int guaclog_interpret(const char* path, const char* out_path, bool force,
+        guac_timestamp start) {
 
     /* Open input file */
     int fd = open(path, O_RDONLY);
@@ -124,9 +178,9 @@ int guaclog_interpret(const char* path, const char* out_path, bool force) {
         return 1;
     }
 
-    /* Obtain guac_socket wrapping file descriptor */
-    guac_socket* socket = guac_socket_open(fd);
-    if (socket == NULL) {
+    /* Obtain scanner reading the (possibly compressed) recording */
+    guaclog_scanner* scanner = guaclog_scanner_alloc(fd);
+    if (scanner == NULL) {
         guaclog_log(GUAC_LOG_ERROR, "%s: %s", path,
                 guac_status_string(guac_error));
         close(fd);
@@ -138,14 +192,14 @@ int guaclog_interpret(const char* path, const char* out_path, bool force) {
             "to \"%s\" ...", path, out_path);
 
     /* Attempt to read all instructions in the file */
-    if (guaclog_read_instructions(state, path, socket)) {
-        guac_socket_free(socket);
+    if (guaclog_read_instructions(state, path, scanner, start)) {
+        guaclog_scanner_free(scanner);
         guaclog_state_free(state);
         return 1;
     }
 
     /* Close input and finish interpreting process */
-    guac_socket_free(socket);
+    guaclog_scanner_free(scanner);
     return guaclog_state_free(state);
 
 }
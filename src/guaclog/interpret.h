@@ -22,6 +22,8 @@
 
 #include "config.h"
 
+#include <guacamole/timestamp-types.h>
+
 #include <stdbool.h>
 
 /**
@@ -41,11 +43,18 @@
  *     Interpret even if the input file appears to be an in-progress log (has
  *     an associated lock).
  *
+ * @param start
+ *     The offset from the first "sync" instruction of the recording at which
+ *     interpreting should begin, in milliseconds. Input events prior to this
+ *     point are ignored. Compressed recordings are sought directly to the
+ *     requested point rather than being scanned from the beginning.
+ *
  * @return
  *     Zero on success, non-zero if an error prevented successful
  *     interpretation of the log.
  */
-int guaclog_interpret(const char* path, const char* out_path, bool force);
+int guaclog_interpret(const char* path, const char* out_path, bool force,
+        guac_timestamp start);
 
 #endif
 
@@ -0,0 +1,512 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+#include "log.h"
+#include "scanner.h"
+
+#include <guacamole/client.h>
+#include <guacamole/error.h>
+#include <guacamole/mem.h>
+#include <guacamole/recording.h>
+#include <guacamole/socket.h>
+#include <guacamole/unicode.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * The result of attempting to scan a single element of an instruction,
+ * ensuring data is available, or scanning an entire instruction.
+ */
+typedef enum guaclog_scan_result {
+
+    /**
+     * Scanning succeeded.
+     */
+    GUACLOG_SCAN_OK,
+
+    /**
+     * The end of the recording was reached before scanning could complete.
+     */
+    GUACLOG_SCAN_END,
+
+    /**
+     * The recording is not valid Guacamole protocol data or cannot be read.
+     */
+    GUACLOG_SCAN_ERROR
+
+} guaclog_scan_result;
+
+/**
+ * The location of the value of a single element of an instruction within the
+ * data of a scanner.
+ */
+typedef struct guaclog_scan_element {
+
+    /**
+     * The offset of the first byte of the value.
+     */
+    size_t start;
+
+    /**
+     * The number of bytes within the value.
+     */
+    size_t length;
+
+} guaclog_scan_element;
+
+guaclog_scanner* guaclog_scanner_alloc(int fd) {
+
+    guaclog_scanner* scanner = guac_mem_zalloc(sizeof(guaclog_scanner));
+
+    /* Map uncompressed recordings (those not starting with the gzip magic
+     * number) directly into memory, if possible */
+    unsigned char magic[2];
+    struct stat file_info;
+    if (fstat(fd, &file_info) == 0 && S_ISREG(file_info.st_mode)
+            && (pread(fd, magic, sizeof(magic), 0) != sizeof(magic)
+                || magic[0] != 0x1F || magic[1] != 0x8B)) {
+
+        /* Empty recordings need not be mapped */
+        if (file_info.st_size == 0) {
+            scanner->end_of_data = true;
+            close(fd);
+            return scanner;
+        }
+
+        void* data = mmap(NULL, file_info.st_size, PROT_READ, MAP_PRIVATE,
+                fd, 0);
+
+        if (data != MAP_FAILED) {
+            posix_madvise(data, file_info.st_size, POSIX_MADV_SEQUENTIAL);
+            scanner->data = data;
+            scanner->length = file_info.st_size;
+            scanner->end_of_data = true;
+            close(fd);
+            return scanner;
+        }
+
+        guaclog_log(GUAC_LOG_DEBUG, "Recording cannot be mapped into "
+                "memory. Falling back to reading.");
+
+    }
+
+    /* Otherwise, read (and possibly decompress) recording through a
+     * guac_socket */
+    scanner->socket = guac_recording_reader_open(fd);
+    if (scanner->socket == NULL) {
+        guac_mem_free(scanner);
+        return NULL;
+    }
+
+    scanner->capacity = GUACLOG_SCANNER_READ_SIZE;
+    scanner->data = guac_mem_alloc(scanner->capacity);
+
+    return scanner;
+
+}
+
+/**
+ * Ensures that at least the given number of bytes of data are available
+ * within the given scanner, reading further data if necessary. Reading is
+ * possible only if the scanner is not mapping the recording into memory.
+ *
+ * @param scanner
+ *     The scanner whose data should be checked.
+ *
+ * @param length
+ *     The number of bytes of data that must be available, starting from the
+ *     beginning of the scanner's data.
+ *
+ * @return
+ *     GUACLOG_SCAN_OK if the requested data is available, GUACLOG_SCAN_END
+ *     if the end of the recording has been reached, or GUACLOG_SCAN_ERROR if
+ *     the data cannot be read or would exceed the maximum instruction size.
+ */
+static guaclog_scan_result guaclog_scanner_ensure(guaclog_scanner* scanner,
+        size_t length) {
+
+    while (scanner->length < length) {
+
+        if (scanner->end_of_data)
+            return GUACLOG_SCAN_END;
+
+        /* Refuse to buffer absurdly large instructions */
+        if (length - scanner->offset > GUACLOG_SCANNER_MAX_INSTRUCTION_SIZE) {
+            guac_error = GUAC_STATUS_PROTOCOL_ERROR;
+            guac_error_message = "Instruction too long";
+            return GUACLOG_SCAN_ERROR;
+        }
+
+        /* Expand buffer as necessary to read another block of data */
+        size_t required = guac_mem_ckd_add_or_die(scanner->length,
+                GUACLOG_SCANNER_READ_SIZE);
+        if (required > scanner->capacity) {
+            scanner->capacity = guac_mem_ckd_mul_or_die(required, 2);
+            scanner->data = guac_mem_realloc_or_die(scanner->data,
+                    scanner->capacity);
+        }
+
+        int received = guac_socket_read(scanner->socket,
+                scanner->data + scanner->length, GUACLOG_SCANNER_READ_SIZE);
+
+        /* Note end of data, failing only if the end was due to an error */
+        if (received <= 0) {
+            scanner->end_of_data = true;
+            if (received < 0 && guac_error != GUAC_STATUS_CLOSED)
+                return GUACLOG_SCAN_ERROR;
+        }
+
+        else
+            scanner->length += received;
+
+    }
+
+    return GUACLOG_SCAN_OK;
+
+}
+
+/**
+ * Returns the number of leading bytes of the given data which are ASCII
+ * characters (have their high bit clear), up to the given maximum. Data is
+ * tested a machine word at a time where possible.
+ *
+ * @param data
+ *     The data to test.
+ *
+ * @param length
+ *     The maximum number of bytes to test.
+ *
+ * @return
+ *     The number of leading ASCII bytes, which may be zero.
+ */
+static size_t guaclog_scanner_ascii_length(const char* data, size_t length) {
+
+    size_t i = 0;
+
+    /* Skip ASCII data a word at a time */
+    while (length - i >= sizeof(uint64_t)) {
+
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+
+        if (word & UINT64_C(0x8080808080808080))
+            break;
+
+        i += sizeof(word);
+
+    }
+
+    /* Test remaining bytes individually */
+    while (i < length && !(data[i] & 0x80))
+        i++;
+
+    return i;
+
+}
+
+/**
+ * Scans a single element of an instruction, advancing the given position
+ * past that element and its terminator. The value of the element is not
+ * copied or decoded; only its location is determined.
+ *
+ * @param scanner
+ *     The scanner to read from.
+ *
+ * @param position
+ *     Pointer to the offset within the scanner's data at which the element
+ *     begins. This offset is updated to point immediately after the
+ *     element's terminator.
+ *
+ * @param element
+ *     The guaclog_scan_element to populate with the location of the value of
+ *     the element.
+ *
+ * @param terminator
+ *     Pointer to a char which will receive the terminator of the element
+ *     (',' if further elements follow, ';' if this is the last element).
+ *
+ * @return
+ *     GUACLOG_SCAN_OK if the element was scanned successfully,
+ *     GUACLOG_SCAN_END if the recording ends within the element, or
+ *     GUACLOG_SCAN_ERROR if the element is invalid or cannot be read.
+ */
+static guaclog_scan_result guaclog_scanner_element(guaclog_scanner* scanner,
+        size_t* position, guaclog_scan_element* element, char* terminator) {
+
+    guaclog_scan_result result;
+    size_t pos = *position;
+
+    /* Parse length prefix */
+    size_t length = 0;
+    int digits = 0;
+    for (;;) {
+
+        if ((result = guaclog_scanner_ensure(scanner, pos + 1)))
+            return result;
+
+        char c = scanner->data[pos++];
+        if (c == '.')
+            break;
+
+        if (c < '0' || c > '9' || ++digits > GUAC_INSTRUCTION_MAX_DIGITS) {
+            guac_error = GUAC_STATUS_PROTOCOL_ERROR;
+            guac_error_message = "Invalid element length";
+            return GUACLOG_SCAN_ERROR;
+        }
+
+        length = length * 10 + c - '0';
+
+    }
+
+    element->start = pos;
+
+    /* Skip value, which is length Unicode characters (not bytes) long */
+    size_t remaining = length;
+    while (remaining > 0) {
+
+        /* At least one byte is required for each remaining character */
+        if ((result = guaclog_scanner_ensure(scanner, pos + remaining)))
+            return result;
+
+        /* Skip ASCII characters in bulk, as each is exactly one byte */
+        size_t ascii = guaclog_scanner_ascii_length(scanner->data + pos,
+                remaining);
+
+        pos += ascii;
+        remaining -= ascii;
+
+        /* Skip any multibyte character individually */
+        if (remaining > 0) {
+
+            size_t size = guac_utf8_charsize(scanner->data[pos]);
+            if ((result = guaclog_scanner_ensure(scanner, pos + size)))
+                return result;
+
+            pos += size;
+            remaining--;
+
+        }
+
+    }
+
+    element->length = pos - element->start;
+
+    /* Read terminator */
+    if ((result = guaclog_scanner_ensure(scanner, pos + 1)))
+        return result;
+
+    *terminator = scanner->data[pos++];
+    if (*terminator != ',' && *terminator != ';') {
+        guac_error = GUAC_STATUS_PROTOCOL_ERROR;
+        guac_error_message = "Invalid element terminator";
+        return GUACLOG_SCAN_ERROR;
+    }
+
+    *position = pos;
+    return GUACLOG_SCAN_OK;
+
+}
+
+/**
+ * Returns whether the given element of the given scanner's data is equal to
+ * any of the given opcodes.
+ *
+ * @param scanner
+ *     The scanner containing the element.
+ *
+ * @param element
+ *     The element to compare.
+ *
+ * @param opcodes
+ *     A NULL-terminated array of opcodes.
+ *
+ * @return
+ *     true if the element matches any of the given opcodes, false otherwise.
+ */
+static bool guaclog_scanner_is_opcode(guaclog_scanner* scanner,
+        guaclog_scan_element* element, const char** opcodes) {
+
+    const char* value = scanner->data + element->start;
+
+    for (; *opcodes != NULL; opcodes++) {
+        if (strlen(*opcodes) == element->length
+                && memcmp(*opcodes, value, element->length) == 0)
+            return true;
+    }
+
+    return false;
+
+}
+
+/**
+ * Copies the given elements of the scanner's data into the scanner's
+ * instruction storage as null-terminated strings, populating the opcode,
+ * argc and argv members of the scanner.
+ *
+ * @param scanner
+ *     The scanner whose current instruction should be populated.
+ *
+ * @param elements
+ *     The elements of the instruction, including the opcode.
+ *
+ * @param count
+ *     The number of elements, including the opcode.
+ */
+static void guaclog_scanner_store(guaclog_scanner* scanner,
+        guaclog_scan_element* elements, int count) {
+
+    /* Determine space required for all elements and null terminators */
+    size_t required = 0;
+    for (int i = 0; i < count; i++)
+        required = guac_mem_ckd_add_or_die(required, elements[i].length, 1);
+
+    if (required > scanner->instruction_capacity) {
+        guac_mem_free(scanner->instruction);
+        scanner->instruction = guac_mem_alloc(required);
+        scanner->instruction_capacity = required;
+    }
+
+    /* Copy each element */
+    char* current = scanner->instruction;
+    for (int i = 0; i < count; i++) {
+
+        memcpy(current, scanner->data + elements[i].start,
+                elements[i].length);
+        current[elements[i].length] = '\0';
+
+        if (i == 0)
+            scanner->opcode = current;
+        else
+            scanner->argv[i - 1] = current;
+
+        current += elements[i].length + 1;
+
+    }
+
+    scanner->argc = count - 1;
+
+}
+
+int guaclog_scanner_next(guaclog_scanner* scanner, const char** opcodes) {
+
+    guaclog_scan_element elements[GUAC_INSTRUCTION_MAX_ELEMENTS];
+
+    for (;;) {
+
+        /* Discard all previously-scanned data if it was read from a socket,
+         * such that the buffer need only contain the current instruction */
+        if (scanner->socket != NULL && scanner->offset > 0) {
+            memmove(scanner->data, scanner->data + scanner->offset,
+                    scanner->length - scanner->offset);
+            scanner->length -= scanner->offset;
+            scanner->offset = 0;
+        }
+
+        size_t pos = scanner->offset;
+        guaclog_scan_result result;
+        char terminator;
+
+        /* Stop cleanly at the end of the recording */
+        if ((result = guaclog_scanner_ensure(scanner, pos + 1)))
+            return result == GUACLOG_SCAN_END ? 1 : -1;
+
+        /* Read opcode */
+        if ((result = guaclog_scanner_element(scanner, &pos, &elements[0],
+                        &terminator)))
+            return result == GUACLOG_SCAN_END ? 1 : -1;
+
+        bool interesting = guaclog_scanner_is_opcode(scanner, &elements[0],
+                opcodes);
+
+        /* Read or skip all remaining elements */
+        int count = 1;
+        while (terminator == ',') {
+
+            guaclog_scan_element element;
+            if ((result = guaclog_scanner_element(scanner, &pos, &element,
+                            &terminator)))
+                return result == GUACLOG_SCAN_END ? 1 : -1;
+
+            /* Note the location of elements only if needed */
+            if (interesting) {
+
+                if (count == GUAC_INSTRUCTION_MAX_ELEMENTS) {
+                    guac_error = GUAC_STATUS_PROTOCOL_ERROR;
+                    guac_error_message = "Too many elements in instruction";
+                    return -1;
+                }
+
+                elements[count++] = element;
+
+            }
+
+        }
+
+        scanner->offset = pos;
+
+        /* Provide only instructions of interest */
+        if (interesting) {
+            guaclog_scanner_store(scanner, elements, count);
+            return 0;
+        }
+
+    }
+
+}
+
+int guaclog_scanner_seek(guaclog_scanner* scanner, guac_timestamp timestamp) {
+
+    /* Recordings mapped into memory are never compressed */
+    if (scanner->socket == NULL)
+        return 1;
+
+    if (guac_recording_reader_seek(scanner->socket, timestamp))
+        return 1;
+
+    /* Discard any data read from the previous position */
+    scanner->length = 0;
+    scanner->offset = 0;
+    scanner->end_of_data = false;
+
+    return 0;
+
+}
+
+void guaclog_scanner_free(guaclog_scanner* scanner) {
+
+    /* Close socket (and thus file) or unmap recording */
+    if (scanner->socket != NULL) {
+        guac_socket_free(scanner->socket);
+        guac_mem_free(scanner->data);
+    }
+
+    else if (scanner->data != NULL)
+        munmap(scanner->data, scanner->length);
+
+    guac_mem_free(scanner->instruction);
+    guac_mem_free(scanner);
+
+}
@@ -0,0 +1,186 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUACLOG_SCANNER_H
+#define GUACLOG_SCANNER_H
+
+#include "config.h"
+
+#include <guacamole/parser-constants.h>
+#include <guacamole/socket.h>
+#include <guacamole/timestamp-types.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * The number of bytes to read at a time when scanning a recording which
+ * cannot be mapped into memory (such as a compressed recording).
+ */
+#define GUACLOG_SCANNER_READ_SIZE 65536
+
+/**
+ * The maximum number of bytes which may be occupied by a single instruction.
+ * Recordings containing larger instructions are considered invalid.
+ */
+#define GUACLOG_SCANNER_MAX_INSTRUCTION_SIZE 16777216
+
+/**
+ * A scanner which locates specific instructions within a Guacamole protocol
+ * dump without fully parsing every instruction. The opcode of each
+ * instruction is read first; the remaining elements of any instruction which
+ * is not of interest are skipped using only their length prefixes. Values
+ * consisting solely of ASCII characters (such as the base64 data of "blob"
+ * instructions) are skipped without decoding individual characters.
+ *
+ * Uncompressed recordings are mapped into memory in their entirety and
+ * scanned in place. Other recordings are read through a guac_socket.
+ */
+typedef struct guaclog_scanner {
+
+    /**
+     * The socket from which data is read, or NULL if the entire recording is
+     * mapped into memory.
+     */
+    guac_socket* socket;
+
+    /**
+     * The data being scanned. If the recording is mapped into memory, this is
+     * the entire recording. Otherwise, this is a buffer containing all data
+     * read from the socket which has not yet been scanned.
+     */
+    char* data;
+
+    /**
+     * The number of bytes of data available.
+     */
+    size_t length;
+
+    /**
+     * The number of bytes allocated for data, if data is read from a socket.
+     */
+    size_t capacity;
+
+    /**
+     * The offset within data of the first byte not yet scanned.
+     */
+    size_t offset;
+
+    /**
+     * Whether the end of the recording has been reached, such that no
+     * further data can be read.
+     */
+    bool end_of_data;
+
+    /**
+     * Storage for the null-terminated elements of the most recently scanned
+     * instruction of interest.
+     */
+    char* instruction;
+
+    /**
+     * The number of bytes allocated for instruction.
+     */
+    size_t instruction_capacity;
+
+    /**
+     * The opcode of the most recently scanned instruction of interest.
+     */
+    char* opcode;
+
+    /**
+     * The number of arguments of the most recently scanned instruction of
+     * interest.
+     */
+    int argc;
+
+    /**
+     * The arguments of the most recently scanned instruction of interest.
+     */
+    char* argv[GUAC_INSTRUCTION_MAX_ELEMENTS];
+
+} guaclog_scanner;
+
+/**
+ * Allocates a new scanner which reads the recording within the given file.
+ * Compressed recordings are decompressed automatically. The file descriptor
+ * will be closed when the scanner is freed.
+ *
+ * @param fd
+ *     The file descriptor of the recording to scan.
+ *
+ * @return
+ *     A newly-allocated guaclog_scanner, or NULL if the recording cannot be
+ *     read.
+ */
+guaclog_scanner* guaclog_scanner_alloc(int fd);
+
+/**
+ * Repositions the given scanner near the given timestamp, such that the next
+ * instruction scanned is the first instruction of the last compressed block
+ * of the recording whose first "sync" instruction is at or before that
+ * timestamp. Only compressed recordings can be repositioned. Any data already
+ * read but not yet scanned is discarded.
+ *
+ * @param scanner
+ *     The scanner to reposition.
+ *
+ * @param timestamp
+ *     The timestamp to seek to, in the same units as the timestamps of the
+ *     "sync" instructions within the recording.
+ *
+ * @return
+ *     Zero if the scanner was repositioned, non-zero if the recording cannot
+ *     be sought, in which case the position of the scanner is unchanged.
+ */
+int guaclog_scanner_seek(guaclog_scanner* scanner, guac_timestamp timestamp);
+
+/**
+ * Scans forward to the next instruction having any of the given opcodes,
+ * storing its opcode and arguments within the opcode, argc and argv members
+ * of the scanner. These values remain valid only until the next call to this
+ * function.
+ *
+ * @param scanner
+ *     The scanner to read from.
+ *
+ * @param opcodes
+ *     A NULL-terminated array of the opcodes of all instructions of
+ *     interest.
+ *
+ * @return
+ *     Zero if an instruction of interest was found, a positive value if the
+ *     end of the recording was reached without finding any such instruction,
+ *     or a negative value if the recording is not valid Guacamole protocol
+ *     data or cannot be read. An incomplete instruction at the end of the
+ *     recording (as in the case of an in-progress recording) is treated as
+ *     the end of the recording.
+ */
+int guaclog_scanner_next(guaclog_scanner* scanner, const char** opcodes);
+
+/**
+ * Frees the given scanner, closing the file descriptor that it was reading.
+ *
+ * @param scanner
+ *     The scanner to free.
+ */
+void guaclog_scanner_free(guaclog_scanner* scanner);
+
+#endif
+
@@ -0,0 +1,359 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "guacamole/mem.h"
+#include "guacamole/audio.h"
+#include "guacamole/client.h"
+#include "guacamole/protocol.h"
+#include "guacamole/protocol-constants.h"
+#include "guacamole/socket.h"
+#include "guacamole/user.h"
+#include "adpcm_encoder.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * The IMA ADPCM quantizer step sizes, indexed by step index.
+ */
+static const int adpcm_step_table[89] = {
+        7,     8,     9,    10,    11,    12,    13,    14,    16,    17,
+       19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+       50,    55,    60,    66,    73,    80,    88,    97,   107,   118,
+      130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+      337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+      876,   963,  1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+     2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+     5894,  6484,  7132,  7845,  8630,  9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+/**
+ * The adjustment to apply to the step index after encoding each 4-bit
+ * ADPCM code, indexed by that code.
+ */
+static const int adpcm_index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+/**
+ * Encodes a single PCM sample as a 4-bit IMA ADPCM code, updating the given
+ * predictor and step index exactly as the decoder will.
+ *
+ * @param sample
+ *     The 16-bit PCM sample to encode.
+ *
+ * @param predictor
+ *     The current predicted value of the sample, as will be reconstructed by
+ *     the decoder. This value is updated to reflect the returned code.
+ *
+ * @param step_index
+ *     The current step index. This value is updated to reflect the returned
+ *     code.
+ *
+ * @return
+ *     The 4-bit IMA ADPCM code representing the given sample.
+ */
+static inline int adpcm_encode_sample(int sample, int* predictor,
+        int* step_index) {
+
+    int step = adpcm_step_table[*step_index];
+    int diff = sample - *predictor;
+    int code = 0;
+
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+
+    /* Quantize difference, tracking the value the decoder will derive */
+    int delta = step >> 3;
+
+    if (diff >= step) {
+        code |= 4;
+        diff -= step;
+        delta += step;
+    }
+
+    step >>= 1;
+    if (diff >= step) {
+        code |= 2;
+        diff -= step;
+        delta += step;
+    }
+
+    step >>= 1;
+    if (diff >= step) {
+        code |= 1;
+        delta += step;
+    }
+
+    /* Update predictor, clamping to the range of 16-bit PCM */
+    int value = *predictor + ((code & 8) ? -delta : delta);
+    if (value > 32767)
+        value = 32767;
+    else if (value < -32768)
+        value = -32768;
+
+    *predictor = value;
+
+    /* Update step index, clamping to the bounds of the step table */
+    int index = *step_index + adpcm_index_table[code];
+    if (index < 0)
+        index = 0;
+    else if (index > 88)
+        index = 88;
+
+    *step_index = index;
+
+    return code;
+
+}
+
+/**
+ * Encodes the given number of buffered frames as a single IMA ADPCM block and
+ * sends that block as a blob. The number of frames MUST be one greater than
+ * a multiple of eight, as the first frame of each block is stored within its
+ * header.
+ *
+ * @param audio
+ *     The audio stream whose buffered frames should be encoded and sent.
+ *
+ * @param frames
+ *     The number of buffered frames to encode.
+ */
+static void adpcm_encoder_send_block(guac_audio_stream* audio, int frames) {
+
+    adpcm_encoder_state* state = (adpcm_encoder_state*) audio->data;
+
+    int channels = audio->channels;
+    const int* pcm = state->pcm;
+    unsigned char* block = state->block;
+
+    int groups = (frames - 1) / 8;
+
+    for (int channel = 0; channel < channels; channel++) {
+
+        const int* current = pcm + channel;
+        int step_index = state->step_index[channel];
+
+        /* The first frame is stored verbatim within the header for the
+         * channel, and serves as the initial predicted value */
+        int predictor = *current;
+        current += channels;
+
+        unsigned char* header = block + channel * 4;
+        header[0] = predictor & 0xFF;
+        header[1] = (predictor >> 8) & 0xFF;
+        header[2] = step_index;
+        header[3] = 0;
+
+        /* Encode remaining frames as groups of eight 4-bit codes, with the
+         * groups for each channel interleaved */
+        for (int group = 0; group < groups; group++) {
+
+            unsigned char* output = block + (channels + group * channels
+                    + channel) * 4;
+
+            for (int i = 0; i < 4; i++) {
+
+                int low = adpcm_encode_sample(*current, &predictor,
+                        &step_index);
+                current += channels;
+
+                int high = adpcm_encode_sample(*current, &predictor,
+                        &step_index);
+                current += channels;
+
+                output[i] = low | (high << 4);
+
+            }
+
+        }
+
+        state->step_index[channel] = step_index;
+
+    }
+
+    /* Send entire block as a single blob such that each blob can be decoded
+     * independently of any other */
+    guac_protocol_send_blob(audio->client->socket, audio->stream, block,
+            (1 + groups) * channels * 4);
+
+    /* Retain any frames which were not encoded */
+    int encoded = frames * channels;
+    state->samples -= encoded;
+    memmove(state->pcm, state->pcm + encoded,
+            state->samples * sizeof(int));
+
+}
+
+/**
+ * Sends an "audio" instruction associating the given audio stream with the
+ * IMA ADPCM mimetype, including the rate and number of channels as mimetype
+ * parameters.
+ *
+ * @param audio
+ *     The audio stream being associated.
+ *
+ * @param socket
+ *     The socket over which the "audio" instruction should be sent.
+ */
+static void adpcm_encoder_send_audio(guac_audio_stream* audio,
+        guac_socket* socket) {
+
+    char mimetype[256];
+
+    /* Produce mimetype string from format info */
+    snprintf(mimetype, sizeof(mimetype), "%s;rate=%i,channels=%i",
+            adpcm_encoder->mimetype, audio->rate, audio->channels);
+
+    /* Associate stream */
+    guac_protocol_send_audio(socket, audio->stream, mimetype);
+
+}
+
+static void adpcm_encoder_begin_handler(guac_audio_stream* audio) {
+
+    adpcm_encoder_state* state;
+    int channels = audio->channels;
+
+    /* Broadcast existence of stream */
+    adpcm_encoder_send_audio(audio, audio->client->socket);
+
+    /* Use the largest block which fits within a single blob, while keeping
+     * each channel's portion a multiple of four bytes */
+    int block_size = GUAC_ADPCM_ENCODER_BLOCK_SIZE;
+    if (block_size * channels > GUAC_PROTOCOL_BLOB_MAX_LENGTH)
+        block_size = (GUAC_PROTOCOL_BLOB_MAX_LENGTH / channels) & ~0x3;
+
+    /* Allocate and init encoder state */
+    audio->data = state = guac_mem_zalloc(sizeof(adpcm_encoder_state));
+    state->block_frames = 1 + (block_size - 4) * 2;
+    state->block = guac_mem_alloc(block_size, channels);
+    state->pcm = guac_mem_alloc(sizeof(int), state->block_frames, channels);
+    state->step_index = guac_mem_zalloc(sizeof(int), channels);
+
+}
+
+static void adpcm_encoder_join_handler(guac_audio_stream* audio,
+        guac_user* user) {
+
+    /* Notify user of existence of stream */
+    adpcm_encoder_send_audio(audio, user->socket);
+
+}
+
+static void adpcm_encoder_end_handler(guac_audio_stream* audio) {
+
+    adpcm_encoder_state* state = (adpcm_encoder_state*) audio->data;
+
+    /* Send end of stream */
+    guac_protocol_send_end(audio->client->socket, audio->stream);
+
+    /* Free state information */
+    guac_mem_free(state->step_index);
+    guac_mem_free(state->pcm);
+    guac_mem_free(state->block);
+    guac_mem_free(state);
+
+}
+
+/**
+ * Appends the given 16-bit PCM sample to the PCM buffer of the given audio
+ * stream, encoding and sending a block if the buffer is now full.
+ *
+ * @param audio
+ *     The audio stream receiving the sample.
+ *
+ * @param low
+ *     The low-order byte of the 16-bit signed PCM sample.
+ *
+ * @param high
+ *     The high-order byte of the 16-bit signed PCM sample.
+ */
+static void adpcm_encoder_append(guac_audio_stream* audio,
+        unsigned char low, unsigned char high) {
+
+    adpcm_encoder_state* state = (adpcm_encoder_state*) audio->data;
+
+    state->pcm[state->samples++] = (((high ^ 0x80) << 8) | low) - 0x8000;
+
+    /* Send block once full */
+    if (state->samples == state->block_frames * audio->channels)
+        adpcm_encoder_send_block(audio, state->block_frames);
+
+}
+
+static void adpcm_encoder_write_handler(guac_audio_stream* audio,
+        const unsigned char* pcm_data, int length) {
+
+    adpcm_encoder_state* state = (adpcm_encoder_state*) audio->data;
+
+    if (length <= 0)
+        return;
+
+    /* Complete any sample split across the previous write */
+    if (state->partial_sample) {
+        adpcm_encoder_append(audio, state->partial_byte, pcm_data[0]);
+        state->partial_sample = 0;
+        pcm_data++;
+        length--;
+    }
+
+    for (; length >= 2; length -= 2, pcm_data += 2)
+        adpcm_encoder_append(audio, pcm_data[0], pcm_data[1]);
+
+    /* Retain any trailing half of a sample until the next write */
+    if (length == 1) {
+        state->partial_byte = pcm_data[0];
+        state->partial_sample = 1;
+    }
+
+}
+
+static void adpcm_encoder_flush_handler(guac_audio_stream* audio) {
+
+    adpcm_encoder_state* state = (adpcm_encoder_state*) audio->data;
+
+    /* Send as many buffered frames as can be represented by a block (one
+     * frame within the header plus a multiple of eight), leaving the
+     * remainder (fewer than eight frames) for the next block */
+    int frames = state->samples / audio->channels;
+    if (frames > 0)
+        adpcm_encoder_send_block(audio, frames - (frames - 1) % 8);
+
+}
+
+/* IMA ADPCM encoder handlers */
+guac_audio_encoder _adpcm_encoder = {
+    .mimetype      = "audio/x-ima-adpcm",
+    .begin_handler = adpcm_encoder_begin_handler,
+    .write_handler = adpcm_encoder_write_handler,
+    .flush_handler = adpcm_encoder_flush_handler,
+    .join_handler  = adpcm_encoder_join_handler,
+    .end_handler   = adpcm_encoder_end_handler
+};
+
+/* Actual encoder definition */
+guac_audio_encoder* adpcm_encoder = &_adpcm_encoder;
+
@@ -0,0 +1,103 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_ADPCM_ENCODER_H
+#define GUAC_ADPCM_ENCODER_H
+
+#include "config.h"
+
+#include "guacamole/audio.h"
+
+/**
+ * The maximum size of each encoded IMA ADPCM block, in bytes per channel,
+ * including the four-byte block header. Blocks of this size hold 2041 samples
+ * per channel. Each block is sent as a single blob, so the per-channel size
+ * is further reduced as necessary for the block to fit within a blob.
+ */
+#define GUAC_ADPCM_ENCODER_BLOCK_SIZE 1024
+
+/**
+ * The current state of the IMA ADPCM encoder. Received PCM is buffered until
+ * a full block is available, at which point that block is encoded and sent
+ * as its own blob. Flushing the encoder sends the largest partial block
+ * possible, retaining the remaining few samples for the next block.
+ *
+ * Each block follows the layout used by Microsoft's IMA ADPCM WAVE format:
+ * a four-byte header for each channel (the first sample of the block as a
+ * 16-bit signed, little-endian value, the current step index, and a
+ * reserved zero byte), followed by groups of eight samples per channel,
+ * stored as four bytes per channel with the earlier sample of each pair in
+ * the low nibble. As each block carries its own decoder state, every blob
+ * can be decoded independently, including by users joining mid-stream.
+ */
+typedef struct adpcm_encoder_state {
+
+    /**
+     * Buffer of not-yet-encoded PCM samples, interleaved by channel.
+     */
+    int* pcm;
+
+    /**
+     * The current number of samples (not frames) stored within the PCM
+     * buffer.
+     */
+    int samples;
+
+    /**
+     * The number of frames (samples per channel) within each full block.
+     */
+    int block_frames;
+
+    /**
+     * Buffer which receives each encoded block before it is sent.
+     */
+    unsigned char* block;
+
+    /**
+     * The current step index of each channel, carried from each block to the
+     * next.
+     */
+    int* step_index;
+
+    /**
+     * The first byte of a 16-bit PCM sample which was split across separate
+     * calls to the write handler. This value is only meaningful if
+     * partial_sample is non-zero.
+     */
+    unsigned char partial_byte;
+
+    /**
+     * Non-zero if partial_byte contains the first half of a 16-bit PCM
+     * sample whose second half has not yet been received, zero otherwise.
+     */
+    int partial_sample;
+
+} adpcm_encoder_state;
+
+/**
+ * Audio encoder which compresses 16-bit PCM to 4-bit IMA ADPCM, sent using
+ * the "audio/x-ima-adpcm" mimetype. The rate and number of channels of the
+ * encoded audio are included as mimetype parameters, as with raw PCM. The
+ * number of frames within each blob is not sent, as it can be derived from
+ * the length of the blob.
+ */
+extern guac_audio_encoder* adpcm_encoder;
+
+#endif
+
@@ -0,0 +1,416 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "audio-processor.h"
+#include "guacamole/audio.h"
+#include "guacamole/mem.h"
+
+#include <math.h>
+#include <string.h>
+
+/**
+ * Returns the greatest common divisor of the given positive integers.
+ *
+ * @param a
+ *     The first integer.
+ *
+ * @param b
+ *     The second integer.
+ *
+ * @return
+ *     The greatest common divisor of a and b.
+ */
+static int guac_audio_processor_gcd(int a, int b) {
+
+    while (b != 0) {
+        int remainder = a % b;
+        a = b;
+        b = remainder;
+    }
+
+    return a;
+
+}
+
+/**
+ * Precomputes the coefficients of every phase of the resampling filter used
+ * by the given processor. Each phase is a Blackman-windowed sinc low-pass
+ * filter, offset by that phase's fraction of an input frame, with a cutoff
+ * just below the Nyquist frequency of the lower of the input and output
+ * rates. Each phase is normalized to unity gain.
+ *
+ * @param processor
+ *     The guac_audio_processor whose filter coefficients should be computed.
+ */
+static void guac_audio_processor_init_filter(guac_audio_processor* processor) {
+
+    const int taps = GUAC_AUDIO_PROCESSOR_TAPS;
+    const int phases = GUAC_AUDIO_PROCESSOR_PHASES;
+
+    /* The output frame lies between the centermost two taps */
+    const double center = taps / 2 - 1;
+    const double half_width = taps / 2;
+
+    /* Cutoff frequency, in cycles per input frame */
+    double cutoff = 0.5 * 0.95;
+    if (processor->output_rate < processor->input_rate)
+        cutoff = cutoff * processor->output_rate / processor->input_rate;
+
+    processor->coefficients = guac_mem_alloc(sizeof(float), taps, phases);
+
+    for (int phase = 0; phase < phases; phase++) {
+
+        float* coefficients = processor->coefficients + phase * taps;
+        double offset = (double) phase / phases;
+        double sum = 0;
+
+        for (int tap = 0; tap < taps; tap++) {
+
+            /* Distance of tap from output frame, in input frames */
+            double x = center + offset - tap;
+
+            double sinc = (x == 0) ? 2 * cutoff
+                    : sin(2 * M_PI * cutoff * x) / (M_PI * x);
+
+            double window = 0.42 + 0.5 * cos(M_PI * x / half_width)
+                    + 0.08 * cos(2 * M_PI * x / half_width);
+
+            coefficients[tap] = sinc * window;
+            sum += coefficients[tap];
+
+        }
+
+        for (int tap = 0; tap < taps; tap++)
+            coefficients[tap] /= sum;
+
+    }
+
+}
+
+guac_audio_processor* guac_audio_processor_alloc(int input_rate,
+        int input_channels, int input_bps, int output_rate,
+        int output_channels, int output_bps) {
+
+    guac_audio_processor* processor =
+        guac_mem_zalloc(sizeof(guac_audio_processor));
+
+    /* Track rates only as a ratio, keeping all position arithmetic small */
+    int gcd = guac_audio_processor_gcd(input_rate, output_rate);
+    processor->input_rate = input_rate / gcd;
+    processor->output_rate = output_rate / gcd;
+
+    processor->input_channels = input_channels;
+    processor->input_bps = input_bps;
+    processor->output_channels = output_channels;
+    processor->output_bps = output_bps;
+
+    processor->input_capacity = GUAC_AUDIO_PROCESSOR_CHUNK_FRAMES;
+    processor->input = guac_mem_alloc(sizeof(float),
+            processor->input_capacity, output_channels);
+
+    processor->output = guac_mem_alloc(GUAC_AUDIO_PROCESSOR_CHUNK_FRAMES,
+            output_channels, output_bps / 8);
+
+    /* Prime the resampling filter with silence such that the first output
+     * frame corresponds to the first input frame */
+    if (processor->input_rate != processor->output_rate) {
+        guac_audio_processor_init_filter(processor);
+        processor->input_frames = GUAC_AUDIO_PROCESSOR_TAPS / 2 - 1;
+        memset(processor->input, 0, sizeof(float)
+                * processor->input_frames * output_channels);
+    }
+
+    return processor;
+
+}
+
+/**
+ * Passes all converted PCM within the output buffer of the given processor
+ * to the encoder of the given audio stream.
+ *
+ * @param processor
+ *     The guac_audio_processor whose output buffer should be flushed.
+ *
+ * @param audio
+ *     The audio stream whose encoder should receive the converted PCM.
+ */
+static void guac_audio_processor_flush(guac_audio_processor* processor,
+        guac_audio_stream* audio) {
+
+    int length = processor->output_frames * processor->output_channels
+        * processor->output_bps / 8;
+
+    if (length > 0 && audio->encoder != NULL
+            && audio->encoder->write_handler)
+        audio->encoder->write_handler(audio, processor->output, length);
+
+    processor->output_frames = 0;
+
+}
+
+/**
+ * Appends a single converted frame to the output buffer of the given
+ * processor, reducing bit depth as necessary, and flushing the output buffer
+ * to the encoder if full.
+ *
+ * @param processor
+ *     The guac_audio_processor producing the frame.
+ *
+ * @param audio
+ *     The audio stream whose encoder should receive the converted PCM.
+ *
+ * @param frame
+ *     The samples of the frame, one per output channel, scaled to the range
+ *     of 16-bit PCM.
+ */
+static void guac_audio_processor_emit(guac_audio_processor* processor,
+        guac_audio_stream* audio, const float* frame) {
+
+    int channels = processor->output_channels;
+    unsigned char* output = processor->output;
+
+    for (int channel = 0; channel < channels; channel++) {
+
+        float value = frame[channel];
+
+        /* 16-bit signed, little-endian */
+        if (processor->output_bps == 16) {
+            int sample = lrintf(value);
+            if (sample > 32767) sample = 32767;
+            else if (sample < -32768) sample = -32768;
+            int offset = (processor->output_frames * channels + channel) * 2;
+            output[offset]     = sample & 0xFF;
+            output[offset + 1] = (sample >> 8) & 0xFF;
+        }
+
+        /* 8-bit signed */
+        else {
+            int sample = lrintf(value / 256);
+            if (sample > 127) sample = 127;
+            else if (sample < -128) sample = -128;
+            output[processor->output_frames * channels + channel] =
+                sample & 0xFF;
+        }
+
+    }
+
+    if (++processor->output_frames == GUAC_AUDIO_PROCESSOR_CHUNK_FRAMES)
+        guac_audio_processor_flush(processor, audio);
+
+}
+
+/**
+ * Reads a single input frame, downmixing to the number of output channels.
+ * If the output has fewer channels than the input, input channels are
+ * averaged together in order, such that stereo becomes mono.
+ *
+ * @param processor
+ *     The guac_audio_processor receiving the frame.
+ *
+ * @param data
+ *     The bytes of the complete input frame.
+ *
+ * @param frame
+ *     The buffer which should receive the downmixed samples, one per output
+ *     channel, scaled to the range of 16-bit PCM.
+ */
+static void guac_audio_processor_read_frame(guac_audio_processor* processor,
+        const unsigned char* data, float* frame) {
+
+    int input_channels = processor->input_channels;
+    int output_channels = processor->output_channels;
+
+    for (int channel = 0; channel < output_channels; channel++)
+        frame[channel] = 0;
+
+    for (int channel = 0; channel < input_channels; channel++) {
+
+        float sample;
+
+        /* 16-bit signed, little-endian */
+        if (processor->input_bps == 16) {
+            sample = (((data[1] ^ 0x80) << 8) | data[0]) - 0x8000;
+            data += 2;
+        }
+
+        /* 8-bit signed */
+        else
+            sample = (float) ((*(data++) ^ 0x80) - 0x80) * 256;
+
+        frame[channel * output_channels / input_channels] += sample;
+
+    }
+
+    /* Average any channels that were combined */
+    if (output_channels != input_channels) {
+        float scale = (float) output_channels / input_channels;
+        for (int channel = 0; channel < output_channels; channel++)
+            frame[channel] *= scale;
+    }
+
+}
+
+/**
+ * Produces as many resampled output frames as the input buffer of the given
+ * processor allows, discarding any input frames which are no longer needed.
+ *
+ * @param processor
+ *     The guac_audio_processor to resample with.
+ *
+ * @param audio
+ *     The audio stream whose encoder should receive the converted PCM.
+ */
+static void guac_audio_processor_resample(guac_audio_processor* processor,
+        guac_audio_stream* audio) {
+
+    const int taps = GUAC_AUDIO_PROCESSOR_TAPS;
+    int channels = processor->output_channels;
+    float frame[GUAC_AUDIO_PROCESSOR_MAX_CHANNELS];
+
+    while (processor->position + taps <= processor->input_frames) {
+
+        int phase = (int) ((long long) processor->fraction
+                * GUAC_AUDIO_PROCESSOR_PHASES / processor->output_rate);
+
+        const float* coefficients = processor->coefficients + phase * taps;
+        const float* input = processor->input
+            + processor->position * channels;
+
+        for (int channel = 0; channel < channels; channel++) {
+
+            float sum = 0;
+            for (int tap = 0; tap < taps; tap++)
+                sum += input[tap * channels + channel] * coefficients[tap];
+
+            frame[channel] = sum;
+
+        }
+
+        guac_audio_processor_emit(processor, audio, frame);
+
+        /* Advance by input_rate/output_rate input frames */
+        processor->fraction += processor->input_rate;
+        processor->position += processor->fraction / processor->output_rate;
+        processor->fraction %= processor->output_rate;
+
+    }
+
+    /* Discard input frames which can no longer fall within the filter */
+    int consumed = processor->position;
+    if (consumed > processor->input_frames)
+        consumed = processor->input_frames;
+
+    processor->input_frames -= consumed;
+    processor->position -= consumed;
+
+    memmove(processor->input, processor->input + consumed * channels,
+            sizeof(float) * processor->input_frames * channels);
+
+}
+
+/**
+ * Accepts a single complete input frame, either converting it immediately
+ * or buffering it for resampling.
+ *
+ * @param processor
+ *     The guac_audio_processor receiving the frame.
+ *
+ * @param audio
+ *     The audio stream whose encoder should receive the converted PCM.
+ *
+ * @param data
+ *     The bytes of the complete input frame.
+ */
+static void guac_audio_processor_add_frame(guac_audio_processor* processor,
+        guac_audio_stream* audio, const unsigned char* data) {
+
+    int channels = processor->output_channels;
+
+    /* Without resampling, frames can be converted directly */
+    if (processor->coefficients == NULL) {
+        float frame[GUAC_AUDIO_PROCESSOR_MAX_CHANNELS];
+        guac_audio_processor_read_frame(processor, data, frame);
+        guac_audio_processor_emit(processor, audio, frame);
+        return;
+    }
+
+    /* Resample once input buffer is full */
+    if (processor->input_frames == processor->input_capacity)
+        guac_audio_processor_resample(processor, audio);
+
+    guac_audio_processor_read_frame(processor, data,
+            processor->input + processor->input_frames * channels);
+
+    processor->input_frames++;
+
+}
+
+void guac_audio_processor_write(guac_audio_processor* processor,
+        guac_audio_stream* audio, const unsigned char* data, int length) {
+
+    int frame_size = processor->input_channels * processor->input_bps / 8;
+
+    /* Complete any frame split across the previous write */
+    if (processor->partial_length > 0) {
+
+        int remaining = frame_size - processor->partial_length;
+        if (remaining > length)
+            remaining = length;
+
+        memcpy(processor->partial + processor->partial_length, data,
+                remaining);
+
+        processor->partial_length += remaining;
+        data += remaining;
+        length -= remaining;
+
+        /* Wait for further data if frame is still incomplete */
+        if (processor->partial_length < frame_size)
+            return;
+
+        guac_audio_processor_add_frame(processor, audio, processor->partial);
+        processor->partial_length = 0;
+
+    }
+
+    /* Process all complete frames */
+    for (; length >= frame_size; length -= frame_size, data += frame_size)
+        guac_audio_processor_add_frame(processor, audio, data);
+
+    /* Retain any trailing partial frame until the next write */
+    memcpy(processor->partial, data, length);
+    processor->partial_length = length;
+
+    /* Resample everything received so far */
+    if (processor->coefficients != NULL)
+        guac_audio_processor_resample(processor, audio);
+
+    guac_audio_processor_flush(processor, audio);
+
+}
+
+void guac_audio_processor_free(guac_audio_processor* processor) {
+    guac_mem_free(processor->coefficients);
+    guac_mem_free(processor->input);
+    guac_mem_free(processor->output);
+    guac_mem_free(processor);
+}
+
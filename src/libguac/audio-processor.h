@@ -0,0 +1,219 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_AUDIO_PROCESSOR_H
+#define GUAC_AUDIO_PROCESSOR_H
+
+#include "config.h"
+
+#include "guacamole/audio.h"
+
+/**
+ * The number of filter taps used for each output sample when resampling.
+ * Longer filters attenuate aliasing more effectively at the expense of CPU
+ * time.
+ */
+#define GUAC_AUDIO_PROCESSOR_TAPS 32
+
+/**
+ * The number of distinct filter phases precomputed for resampling. The
+ * fractional position of each output sample relative to the input is rounded
+ * down to the nearest of this many phases.
+ */
+#define GUAC_AUDIO_PROCESSOR_PHASES 64
+
+/**
+ * The maximum number of channels supported by guac_audio_processor. Audio
+ * with more channels than this is never processed.
+ */
+#define GUAC_AUDIO_PROCESSOR_MAX_CHANNELS 8
+
+/**
+ * The maximum number of frames to convert before passing converted audio
+ * along to the encoder.
+ */
+#define GUAC_AUDIO_PROCESSOR_CHUNK_FRAMES 4096
+
+/**
+ * Converts PCM audio from the format provided to a guac_audio_stream into the
+ * format expected by its encoder, downmixing to fewer channels, resampling
+ * with a polyphase windowed-sinc filter, and reducing bit depth as needed.
+ */
+typedef struct guac_audio_processor {
+
+    /**
+     * The sample rate of received PCM, in Hz, reduced by the greatest common
+     * divisor of the input and output rates.
+     */
+    int input_rate;
+
+    /**
+     * The number of channels of received PCM.
+     */
+    int input_channels;
+
+    /**
+     * The number of bits per sample of received PCM. This will be either 8
+     * (signed) or 16 (signed, little-endian).
+     */
+    int input_bps;
+
+    /**
+     * The sample rate of produced PCM, in Hz, reduced by the greatest common
+     * divisor of the input and output rates.
+     */
+    int output_rate;
+
+    /**
+     * The number of channels of produced PCM.
+     */
+    int output_channels;
+
+    /**
+     * The number of bits per sample of produced PCM. This will be either 8
+     * (signed) or 16 (signed, little-endian).
+     */
+    int output_bps;
+
+    /**
+     * Bytes of a partially-received input frame, split across separate
+     * writes.
+     */
+    unsigned char partial[GUAC_AUDIO_PROCESSOR_MAX_CHANNELS * 2];
+
+    /**
+     * The number of bytes currently stored within the partial buffer.
+     */
+    int partial_length;
+
+    /**
+     * Received frames that have been downmixed (if necessary) but not yet
+     * resampled, interleaved by channel. When not resampling, frames are
+     * never retained in this buffer beyond a single write.
+     */
+    float* input;
+
+    /**
+     * The number of frames that the input buffer can hold.
+     */
+    int input_capacity;
+
+    /**
+     * The number of frames currently stored within the input buffer.
+     */
+    int input_frames;
+
+    /**
+     * The index of the first input frame within the filter window of the
+     * next output frame.
+     */
+    int position;
+
+    /**
+     * The fractional position of the next output frame relative to the
+     * input frame at the center of its filter window, in units of
+     * 1/output_rate input frames.
+     */
+    int fraction;
+
+    /**
+     * Precomputed filter coefficients, GUAC_AUDIO_PROCESSOR_TAPS for each of
+     * GUAC_AUDIO_PROCESSOR_PHASES phases, or NULL if no resampling is
+     * performed.
+     */
+    float* coefficients;
+
+    /**
+     * Buffer which receives converted PCM before it is passed to the
+     * encoder, with room for GUAC_AUDIO_PROCESSOR_CHUNK_FRAMES frames.
+     */
+    unsigned char* output;
+
+    /**
+     * The number of frames currently stored within the output buffer.
+     */
+    int output_frames;
+
+} guac_audio_processor;
+
+/**
+ * Allocates a new guac_audio_processor which converts PCM from the given
+ * input format to the given output format. The output format must not have
+ * more channels than the input format, and neither format may have more than
+ * GUAC_AUDIO_PROCESSOR_MAX_CHANNELS channels.
+ *
+ * @param input_rate
+ *     The sample rate of received PCM, in Hz.
+ *
+ * @param input_channels
+ *     The number of channels of received PCM.
+ *
+ * @param input_bps
+ *     The number of bits per sample of received PCM. Legal values are 8 or
+ *     16.
+ *
+ * @param output_rate
+ *     The sample rate of produced PCM, in Hz.
+ *
+ * @param output_channels
+ *     The number of channels of produced PCM.
+ *
+ * @param output_bps
+ *     The number of bits per sample of produced PCM. Legal values are 8 or
+ *     16.
+ *
+ * @return
+ *     A newly-allocated guac_audio_processor, which must eventually be freed
+ *     with guac_audio_processor_free().
+ */
+guac_audio_processor* guac_audio_processor_alloc(int input_rate,
+        int input_channels, int input_bps, int output_rate,
+        int output_channels, int output_bps);
+
+/**
+ * Converts the given PCM, passing the result to the write handler of the
+ * encoder of the given audio stream. Frames which cannot yet be converted,
+ * either because they are incomplete or because the resampling filter
+ * requires further input, are retained for future calls.
+ *
+ * @param processor
+ *     The guac_audio_processor to use to convert the given PCM.
+ *
+ * @param audio
+ *     The audio stream whose encoder should receive the converted PCM.
+ *
+ * @param data
+ *     The PCM to convert, in the input format of the processor.
+ *
+ * @param length
+ *     The number of bytes of PCM provided.
+ */
+void guac_audio_processor_write(guac_audio_processor* processor,
+        guac_audio_stream* audio, const unsigned char* data, int length);
+
+/**
+ * Frees the given guac_audio_processor. Any retained PCM is discarded.
+ *
+ * @param processor
+ *     The guac_audio_processor to free.
+ */
+void guac_audio_processor_free(guac_audio_processor* processor);
+
+#endif
+
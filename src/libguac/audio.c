@@ -19,17 +19,40 @@
 
 #include "config.h"
 
+#include "audio-processor.h"
 #include "guacamole/mem.h"
 #include "guacamole/audio.h"
 #include "guacamole/client.h"
 #include "guacamole/protocol.h"
 #include "guacamole/stream.h"
+#include "guacamole/timestamp.h"
 #include "guacamole/user.h"
+#include "adpcm_encoder.h"
+#include "g711_encoder.h"
 #include "raw_encoder.h"
 
 #include <stdlib.h>
 #include <string.h>
 
+/**
+ * The state of a search for an encoder supported by any of several users,
+ * as performed by guac_audio_search_encoder().
+ */
+typedef struct guac_audio_encoder_search {
+
+    /**
+     * The number of bits per sample of the PCM data that the encoder must
+     * accept.
+     */
+    int bps;
+
+    /**
+     * The encoder found, or NULL if no encoder has yet been found.
+     */
+    guac_audio_encoder* encoder;
+
+} guac_audio_encoder_search;
+
 /**
  * Sets the encoder associated with the given guac_audio_stream, automatically
  * invoking its begin_handler. The guac_audio_stream MUST NOT already be
@@ -53,6 +76,81 @@ static void guac_audio_stream_set_encoder(guac_audio_stream* audio,
 
 }
 
+/**
+ * Returns the first built-in audio encoder which accepts PCM data with the
+ * given number of bits per sample and whose mimetype is declared as
+ * supported by the given user, in the order of the user's declared
+ * mimetypes.
+ *
+ * @param user
+ *     The user whose supported audio mimetypes should determine the audio
+ *     encoder selected.
+ *
+ * @param bps
+ *     The number of bits per sample of the PCM data that the encoder must
+ *     accept.
+ *
+ * @return
+ *     A built-in audio encoder supported by the given user, or NULL if the
+ *     user supports none of the built-in encoders applicable to the given
+ *     number of bits per sample.
+ */
+static guac_audio_encoder* guac_audio_find_encoder(guac_user* user, int bps) {
+
+    int i;
+
+    /* For each supported mimetype, check for an associated encoder */
+    for (i=0; user->info.audio_mimetypes[i] != NULL; i++) {
+
+        const char* mimetype = user->info.audio_mimetypes[i];
+
+        /* If 16-bit raw audio is supported, done. */
+        if (bps == 16 && strcmp(mimetype, raw16_encoder->mimetype) == 0)
+            return raw16_encoder;
+
+        /* If 8-bit raw audio is supported, done. */
+        if (bps == 8 && strcmp(mimetype, raw8_encoder->mimetype) == 0)
+            return raw8_encoder;
+
+        /* If IMA ADPCM is supported, done. Like G.711 below, this reduces
+         * 16-bit PCM and is thus not applicable to 8-bit audio. */
+        if (bps == 16 && strcmp(mimetype, adpcm_encoder->mimetype) == 0)
+            return adpcm_encoder;
+
+        /* If G.711 μ-law is supported, done. */
+        if (bps == 16 && strcmp(mimetype, ulaw_encoder->mimetype) == 0)
+            return ulaw_encoder;
+
+        /* If G.711 A-law is supported, done. */
+        if (bps == 16 && strcmp(mimetype, alaw_encoder->mimetype) == 0)
+            return alaw_encoder;
+
+    } /* end for each mimetype */
+
+    /* No supported encoder */
+    return NULL;
+
+}
+
+/**
+ * Returns whether the given audio encoder is one of the encoders built into
+ * libguac, and thus may be automatically replaced with another built-in
+ * encoder if the number of bits per sample changes.
+ *
+ * @param encoder
+ *     The encoder to test.
+ *
+ * @return
+ *     Non-zero if the given encoder is built into libguac, zero otherwise.
+ */
+static int guac_audio_is_builtin_encoder(guac_audio_encoder* encoder) {
+    return encoder == raw8_encoder
+        || encoder == raw16_encoder
+        || encoder == adpcm_encoder
+        || encoder == ulaw_encoder
+        || encoder == alaw_encoder;
+}
+
 /**
  * Assigns a new audio encoder to the given guac_audio_stream based on the
  * audio mimetypes declared as supported by the given user. If no audio encoder
@@ -74,37 +172,288 @@ static void guac_audio_stream_set_encoder(guac_audio_stream* audio,
  */
 static void* guac_audio_assign_encoder(guac_user* user, void* data) {
 
-    int i;
-
     guac_audio_stream* audio = (guac_audio_stream*) data;
-    int bps = audio->bps;
 
     /* If no user is provided, or an encoder has already been assigned,
      * do not attempt to assign a new encoder */
     if (user == NULL || audio->encoder != NULL)
         return audio->encoder;
 
-    /* For each supported mimetype, check for an associated encoder */
-    for (i=0; user->info.audio_mimetypes[i] != NULL; i++) {
+    /* Assign supported encoder, if any */
+    guac_audio_encoder* encoder = guac_audio_find_encoder(user, audio->bps);
+    if (encoder != NULL)
+        guac_audio_stream_set_encoder(audio, encoder);
 
-        const char* mimetype = user->info.audio_mimetypes[i];
+    /* Return assigned encoder, if any */
+    return audio->encoder;
 
-        /* If 16-bit raw audio is supported, done. */
-        if (bps == 16 && strcmp(mimetype, raw16_encoder->mimetype) == 0) {
-            guac_audio_stream_set_encoder(audio, raw16_encoder);
-            break;
-        }
+}
 
-        /* If 8-bit raw audio is supported, done. */
-        if (bps == 8 && strcmp(mimetype, raw8_encoder->mimetype) == 0) {
-            guac_audio_stream_set_encoder(audio, raw8_encoder);
-            break;
+/**
+ * Searches for a built-in audio encoder supported by the given user,
+ * updating the given guac_audio_encoder_search if an encoder is found and no
+ * encoder had been previously found. Unlike guac_audio_assign_encoder(), the
+ * encoder found is not assigned to any audio stream.
+ *
+ * @param user
+ *     The user whose supported audio mimetypes should be searched.
+ *
+ * @param data
+ *     The guac_audio_encoder_search describing the encoder required.
+ *
+ * @return
+ *     The encoder found by the search so far, which may be NULL.
+ */
+static void* guac_audio_search_encoder(guac_user* user, void* data) {
+
+    guac_audio_encoder_search* search = (guac_audio_encoder_search*) data;
+
+    if (user != NULL && search->encoder == NULL)
+        search->encoder = guac_audio_find_encoder(user, search->bps);
+
+    return search->encoder;
+
+}
+
+/**
+ * Returns a built-in audio encoder that accepts PCM data with the given
+ * number of bits per sample and is supported by the connection owner or,
+ * failing that, by any connected user.
+ *
+ * @param client
+ *     The guac_client whose users should be searched.
+ *
+ * @param bps
+ *     The number of bits per sample of the PCM data that the encoder must
+ *     accept.
+ *
+ * @return
+ *     A supported built-in audio encoder, or NULL if no such encoder is
+ *     supported by any connected user.
+ */
+static guac_audio_encoder* guac_audio_select_encoder(guac_client* client,
+        int bps) {
+
+    guac_audio_encoder_search search = {
+        .bps = bps,
+        .encoder = NULL
+    };
+
+    /* Prefer encoders supported by owner, falling back to ANY user */
+    guac_client_for_owner(client, guac_audio_search_encoder, &search);
+    if (search.encoder == NULL)
+        guac_client_foreach_user(client, guac_audio_search_encoder, &search);
+
+    return search.encoder;
+
+}
+
+/**
+ * Determines the format of the audio that should be passed to the encoder
+ * of the given audio stream, based on the format of the PCM data provided to
+ * the stream, any limits set with guac_audio_stream_set_limits(), and the
+ * current level of automatic reduction in quality.
+ *
+ * @param audio
+ *     The guac_audio_stream whose encoded format should be determined.
+ *
+ * @param rate
+ *     Pointer to an int which receives the number of samples per second.
+ *
+ * @param channels
+ *     Pointer to an int which receives the number of audio channels.
+ *
+ * @param bps
+ *     Pointer to an int which receives the number of bits per sample per
+ *     channel.
+ */
+static void guac_audio_stream_get_format(guac_audio_stream* audio,
+        int* rate, int* channels, int* bps) {
+
+    *rate = audio->input_rate;
+    *channels = audio->input_channels;
+    *bps = audio->input_bps;
+
+    /* Pass through any audio that cannot be processed */
+    if (*channels < 1 || *channels > GUAC_AUDIO_PROCESSOR_MAX_CHANNELS
+            || (*bps != 8 && *bps != 16) || *rate <= 0)
+        return;
+
+    /* Halve rate for each level of reduction beyond the first */
+    int max_rate = audio->__max_rate;
+    if (audio->__reduction >= 2) {
+        int reduced_rate = audio->input_rate >> (audio->__reduction - 1);
+        if (max_rate == 0 || reduced_rate < max_rate)
+            max_rate = reduced_rate;
+    }
+
+    /* Never resample below minimum rate */
+    if (max_rate != 0 && max_rate < GUAC_AUDIO_MIN_RATE)
+        max_rate = GUAC_AUDIO_MIN_RATE;
+
+    if (max_rate != 0 && *rate > max_rate)
+        *rate = max_rate;
+
+    /* Downmix to mono at first level of reduction */
+    if (audio->__max_channels > 0 && *channels > audio->__max_channels)
+        *channels = audio->__max_channels;
+
+    if (audio->__reduction >= 1)
+        *channels = 1;
+
+    if (audio->__max_bps > 0 && *bps > audio->__max_bps)
+        *bps = audio->__max_bps;
+
+}
+
+/**
+ * Restarts the given audio stream, flushing and ending any current encoding,
+ * and beginning a new encoding using the given encoder and PCM format. The
+ * format of the audio passed to the encoder is recalculated, with a
+ * conversion stage allocated if it differs from the given PCM format.
+ *
+ * @param audio
+ *     The guac_audio_stream to restart.
+ *
+ * @param encoder
+ *     The guac_audio_encoder to use when encoding audio, which may be NULL.
+ *
+ * @param rate
+ *     The number of samples per second of PCM data sent to this stream.
+ *
+ * @param channels
+ *     The number of audio channels per sample of PCM data.
+ *
+ * @param bps
+ *     The number of bits per sample per channel for PCM data.
+ */
+static void guac_audio_stream_restart(guac_audio_stream* audio,
+        guac_audio_encoder* encoder, int rate, int channels, int bps) {
+
+    /* Send any audio buffered in the old format before ending encoding */
+    if (audio->encoder != NULL) {
+
+        guac_audio_stream_flush(audio);
+
+        if (audio->encoder->end_handler)
+            audio->encoder->end_handler(audio);
+
+        audio->encoder = NULL;
+
+    }
+
+    /* Discard conversion stage of old format */
+    if (audio->__processor != NULL) {
+        guac_audio_processor_free(audio->__processor);
+        audio->__processor = NULL;
+    }
+
+    int previous_bps = audio->bps;
+
+    /* Set PCM properties */
+    audio->input_rate = rate;
+    audio->input_channels = channels;
+    audio->input_bps = bps;
+
+    guac_audio_stream_get_format(audio, &audio->rate, &audio->channels,
+            &audio->bps);
+
+    /* Built-in encoders accept only one bit depth, and must be reselected if
+     * the bit depth changes. If no encoder supports a reduced bit depth, the
+     * reduction is abandoned. */
+    if (audio->bps != previous_bps && guac_audio_is_builtin_encoder(encoder)) {
+
+        guac_audio_encoder* selected =
+            guac_audio_select_encoder(audio->client, audio->bps);
+
+        if (selected == NULL && audio->bps != bps) {
+            audio->bps = bps;
+            selected = guac_audio_select_encoder(audio->client, audio->bps);
         }
 
-    } /* end for each mimetype */
+        if (selected != NULL)
+            encoder = selected;
 
-    /* Return assigned encoder, if any */
-    return audio->encoder;
+    }
+
+    /* Convert PCM only if necessary */
+    if (audio->rate != rate || audio->channels != channels
+            || audio->bps != bps)
+        audio->__processor = guac_audio_processor_alloc(rate, channels, bps,
+                audio->rate, audio->channels, audio->bps);
+
+    /* Re-init encoder */
+    guac_audio_stream_set_encoder(audio, encoder);
+
+}
+
+/**
+ * Restarts the given audio stream if the format of the audio passed to its
+ * encoder would change due to a change in limits or the level of automatic
+ * reduction in quality.
+ *
+ * @param audio
+ *     The guac_audio_stream to update.
+ */
+static void guac_audio_stream_update(guac_audio_stream* audio) {
+
+    int rate, channels, bps;
+    guac_audio_stream_get_format(audio, &rate, &channels, &bps);
+
+    /* Do nothing if nothing is changing */
+    if (rate == audio->rate && channels == audio->channels
+            && bps == audio->bps)
+        return;
+
+    guac_audio_stream_restart(audio, audio->encoder, audio->input_rate,
+            audio->input_channels, audio->input_bps);
+
+}
+
+/**
+ * Checks the display lag of the client associated with the given audio
+ * stream, adjusting the level of automatic reduction in quality if
+ * necessary. Lag is checked no more frequently than
+ * GUAC_AUDIO_LAG_CHECK_INTERVAL.
+ *
+ * @param audio
+ *     The guac_audio_stream whose quality should be adjusted.
+ */
+static void guac_audio_stream_check_lag(guac_audio_stream* audio) {
+
+    guac_timestamp now = guac_timestamp_current();
+
+    /* Avoid checking lag more often than necessary */
+    if (now - audio->__last_lag_check < GUAC_AUDIO_LAG_CHECK_INTERVAL)
+        return;
+
+    audio->__last_lag_check = now;
+
+    int lag = guac_client_get_display_lag(audio->client);
+    guac_timestamp elapsed = now - audio->__last_reduction_change;
+    int reduction = audio->__reduction;
+
+    /* Reduce quality quickly under sustained lag ... */
+    if (lag > GUAC_AUDIO_HIGH_LAG && reduction < GUAC_AUDIO_MAX_REDUCTION
+            && elapsed >= GUAC_AUDIO_REDUCE_INTERVAL)
+        reduction++;
+
+    /* ... but restore quality only gradually */
+    else if (lag < GUAC_AUDIO_LOW_LAG && reduction > 0
+            && elapsed >= GUAC_AUDIO_RESTORE_INTERVAL)
+        reduction--;
+
+    else
+        return;
+
+    guac_client_log(audio->client, GUAC_LOG_DEBUG, "Processing lag is %i "
+            "ms. Audio quality reduction is now at level %i of %i.", lag,
+            reduction, GUAC_AUDIO_MAX_REDUCTION);
+
+    audio->__reduction = reduction;
+    audio->__last_reduction_change = now;
+
+    guac_audio_stream_update(audio);
 
 }
 
@@ -124,10 +473,11 @@ guac_audio_stream* guac_audio_stream_alloc(guac_client* client,
         return NULL;
     }
 
-    /* Load PCM properties */
-    audio->rate = rate;
-    audio->channels = channels;
-    audio->bps = bps;
+    /* Load PCM properties (no limits apply yet, so the encoder receives PCM
+     * in the same format) */
+    audio->rate = audio->input_rate = rate;
+    audio->channels = audio->input_channels = channels;
+    audio->bps = audio->input_bps = bps;
 
     /* Assign encoder if explicitly provided */
     if (encoder != NULL)
@@ -154,23 +504,36 @@ void guac_audio_stream_reset(guac_audio_stream* audio,
 
     /* Do nothing if nothing is changing */
     if (encoder == audio->encoder
-            && rate     == audio->rate
-            && channels == audio->channels
-            && bps      == audio->bps) {
+            && rate     == audio->input_rate
+            && channels == audio->input_channels
+            && bps      == audio->input_bps) {
         return;
     }
 
-    /* Free old encoder data */
-    if (audio->encoder != NULL && audio->encoder->end_handler)
-        audio->encoder->end_handler(audio);
+    guac_audio_stream_restart(audio, encoder, rate, channels, bps);
 
-    /* Set PCM properties */
-    audio->rate = rate;
-    audio->channels = channels;
-    audio->bps = bps;
+}
 
-    /* Re-init encoder */
-    guac_audio_stream_set_encoder(audio, encoder);
+void guac_audio_stream_set_limits(guac_audio_stream* audio, int max_rate,
+        int max_channels, int max_bps) {
+
+    audio->__max_rate = max_rate;
+    audio->__max_channels = max_channels;
+    audio->__max_bps = max_bps;
+
+    guac_audio_stream_update(audio);
+
+}
+
+void guac_audio_stream_set_adaptive(guac_audio_stream* audio, int adaptive) {
+
+    audio->__adaptive = adaptive;
+
+    /* Remove any existing reduction if no longer adaptive */
+    if (!adaptive && audio->__reduction != 0) {
+        audio->__reduction = 0;
+        guac_audio_stream_update(audio);
+    }
 
 }
 
@@ -195,6 +558,10 @@ void guac_audio_stream_free(guac_audio_stream* audio) {
     if (audio->encoder != NULL && audio->encoder->end_handler)
         audio->encoder->end_handler(audio);
 
+    /* Clean up conversion stage */
+    if (audio->__processor != NULL)
+        guac_audio_processor_free(audio->__processor);
+
     /* Release stream back to client pool */
     guac_client_free_stream(audio->client, audio->stream);
 
@@ -206,8 +573,16 @@ void guac_audio_stream_free(guac_audio_stream* audio) {
 void guac_audio_stream_write_pcm(guac_audio_stream* audio, 
         const unsigned char* data, int length) {
 
-    /* Write data */
-    if (audio->encoder != NULL && audio->encoder->write_handler)
+    /* Adjust quality in response to lag before encoding further audio */
+    if (audio->__adaptive)
+        guac_audio_stream_check_lag(audio);
+
+    /* Convert data to encoded format, if necessary */
+    if (audio->__processor != NULL)
+        guac_audio_processor_write(audio->__processor, audio, data, length);
+
+    /* Otherwise, write data directly */
+    else if (audio->encoder != NULL && audio->encoder->write_handler)
         audio->encoder->write_handler(audio, data, length);
 
 }
@@ -40,6 +40,7 @@
 #include <dlfcn.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdarg.h>
@@ -697,6 +698,83 @@ void* guac_client_for_user(guac_client* client, guac_user* user,
 
 }
 
+/**
+ * Callback which is invoked by guac_client_end_multiple_frames() for each
+ * user associated with the client, sampling the backlog of data awaiting
+ * delivery to that user and updating the user's estimated bandwidth and
+ * congestion lag accordingly.
+ *
+ * @param user
+ *     The user whose backlog should be sampled.
+ *
+ * @param data
+ *     Pointer to a guac_timestamp containing the current time.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* __update_congestion(guac_user* user, void* data) {
+
+    guac_timestamp now = *((guac_timestamp*) data);
+    guac_timestamp elapsed = now - user->__last_backlog_sample;
+
+    /* Avoid sampling more often than necessary */
+    if (elapsed < GUAC_USER_BACKLOG_SAMPLE_INTERVAL)
+        return NULL;
+
+    guac_socket* socket = user->socket;
+    int64_t backlog = guac_socket_get_backlog(socket);
+    uint64_t bytes_written = socket->bytes_written;
+
+    /* Congestion cannot be measured if the backlog is unknown */
+    if (backlog < 0) {
+        user->congestion_lag = 0;
+        return NULL;
+    }
+
+    /* Estimate throughput since the previous sample */
+    if (user->__last_backlog_sample != 0) {
+
+        int64_t delivered = (int64_t) (bytes_written - user->__last_bytes_written)
+                          + user->__last_backlog - backlog;
+
+        int64_t rate = delivered > 0 ? delivered * 1000 / elapsed : 0;
+        if (rate > INT_MAX)
+            rate = INT_MAX;
+
+        /* Throughput reflects available bandwidth only if data was waiting
+         * to be sent for the entire interval */
+        if (user->__last_backlog > 0 && backlog > 0)
+            user->bandwidth = user->bandwidth
+                ? (int) ((3 * (int64_t) user->bandwidth + rate) / 4)
+                : (int) rate;
+
+        /* Otherwise, the bandwidth is at least the observed throughput */
+        else if (rate > user->bandwidth)
+            user->bandwidth = (int) rate;
+
+    }
+
+    /* Estimate time required to deliver everything already sent */
+    int64_t congestion_lag = 0;
+    if (user->bandwidth > 0)
+        congestion_lag = backlog * 1000 / user->bandwidth;
+
+    user->congestion_lag = congestion_lag > INT_MAX ? INT_MAX
+                                                    : (int) congestion_lag;
+
+    user->__last_backlog_sample = now;
+    user->__last_bytes_written = bytes_written;
+    user->__last_backlog = backlog;
+
+    guac_user_log(user, GUAC_LOG_TRACE, "Socket backlog is %" PRId64 " "
+            "bytes (bandwidth=%i bytes/s, congestion_lag=%ims)", backlog,
+            user->bandwidth, user->congestion_lag);
+
+    return NULL;
+
+}
+
 int guac_client_end_frame(guac_client* client) {
     return guac_client_end_multiple_frames(client, 0);
 }
@@ -706,6 +784,10 @@ int guac_client_end_multiple_frames(guac_client* client, int frames) {
     /* Update and send timestamp */
     client->last_sent_timestamp = guac_timestamp_current();
 
+    /* Measure congestion of each user's connection */
+    guac_client_foreach_user(client, __update_congestion,
+            &client->last_sent_timestamp);
+
     /* Log received timestamp and calculated lag (at TRACE level only) */
     guac_client_log(client, GUAC_LOG_TRACE, "Server completed "
             "frame %" PRIu64 "ms (%i logical frames)", client->last_sent_timestamp, frames);
@@ -843,6 +925,47 @@ int guac_client_get_processing_lag(guac_client* client) {
 
 }
 
+/**
+ * A callback function which is invoked by guac_client_get_display_lag() for
+ * each user associated with the given client, updating the overall display
+ * lag to the total lag experienced by that user if larger.
+ *
+ * @param user
+ *     The guac_user to use to update the approximate display lag.
+ *
+ * @param data
+ *     Pointer to an int containing the current approximate display lag. The
+ *     int will be updated according to the processing and congestion lag of
+ *     the given user.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* __calculate_display_lag(guac_user* user, void* data) {
+
+    int* display_lag = (int*) data;
+
+    /* Lag is cumulative for each user, but the worst user determines the
+     * lag of the connection as a whole */
+    int lag = user->processing_lag + user->congestion_lag;
+    if (lag > *display_lag)
+        *display_lag = lag;
+
+    return NULL;
+
+}
+
+int guac_client_get_display_lag(guac_client* client) {
+
+    int display_lag = 0;
+
+    /* Approximate the total lag of all users */
+    guac_client_foreach_user(client, __calculate_display_lag, &display_lag);
+
+    return display_lag;
+
+}
+
 void guac_client_stream_argv(guac_client* client, guac_socket* socket,
         const char* mimetype, const char* name, const char* value) {
 
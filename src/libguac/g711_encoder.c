@@ -0,0 +1,321 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "guacamole/mem.h"
+#include "guacamole/audio.h"
+#include "guacamole/client.h"
+#include "guacamole/protocol.h"
+#include "guacamole/socket.h"
+#include "guacamole/user.h"
+#include "g711_encoder.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Returns the value of the 16-bit signed, little-endian PCM sample stored
+ * within the given buffer. The sample is assembled from its individual bytes
+ * such that the result does not depend on the byte order or alignment
+ * requirements of the host.
+ *
+ * @param pcm
+ *     The buffer containing the two bytes of the PCM sample.
+ *
+ * @return
+ *     The value of the PCM sample, between -32768 and 32767 inclusive.
+ */
+static inline int g711_read_sample(const unsigned char* pcm) {
+    return (((pcm[1] ^ 0x80) << 8) | pcm[0]) - 0x8000;
+}
+
+/**
+ * Compands the given number of 16-bit PCM samples to G.711 μ-law. The loop
+ * body is deliberately free of branches and table lookups, with the segment
+ * of each sample determined by a sum of comparisons, such that the compiler
+ * may vectorize the loop where the target architecture allows.
+ *
+ * @param pcm
+ *     The 16-bit signed, little-endian PCM samples to encode.
+ *
+ * @param output
+ *     The buffer which should receive the μ-law samples.
+ *
+ * @param count
+ *     The number of samples to encode.
+ */
+static void g711_encode_ulaw(const unsigned char* pcm,
+        unsigned char* output, int count) {
+
+    for (int i = 0; i < count; i++) {
+
+        int sample = g711_read_sample(pcm + i * 2);
+        int negative = sample < 0;
+
+        /* Clip and bias magnitude such that the segment (exponent) is
+         * simply the position of its highest set bit, less 7. As in the ITU
+         * reference implementation, the magnitude of negative samples is
+         * taken as their ones' complement. */
+        int magnitude = negative ? ~sample : sample;
+        if (magnitude > 32635)
+            magnitude = 32635;
+        magnitude += 0x84;
+
+        int exponent = (magnitude >= 0x100)  + (magnitude >= 0x200)
+                     + (magnitude >= 0x400)  + (magnitude >= 0x800)
+                     + (magnitude >= 0x1000) + (magnitude >= 0x2000)
+                     + (magnitude >= 0x4000);
+
+        int mantissa = (magnitude >> (exponent + 3)) & 0x0F;
+
+        /* μ-law codewords are transmitted with all bits inverted */
+        output[i] = ~((negative << 7) | (exponent << 4) | mantissa);
+
+    }
+
+}
+
+/**
+ * Compands the given number of 16-bit PCM samples to G.711 A-law. As with
+ * g711_encode_ulaw(), the loop body is free of branches and table lookups.
+ *
+ * @param pcm
+ *     The 16-bit signed, little-endian PCM samples to encode.
+ *
+ * @param output
+ *     The buffer which should receive the A-law samples.
+ *
+ * @param count
+ *     The number of samples to encode.
+ */
+static void g711_encode_alaw(const unsigned char* pcm,
+        unsigned char* output, int count) {
+
+    for (int i = 0; i < count; i++) {
+
+        int sample = g711_read_sample(pcm + i * 2);
+        int negative = sample < 0;
+
+        /* A-law operates on 13-bit magnitudes (0 through 4095) */
+        int magnitude = (negative ? ~sample : sample) >> 3;
+
+        int exponent = (magnitude > 0x1F)  + (magnitude > 0x3F)
+                     + (magnitude > 0x7F)  + (magnitude > 0xFF)
+                     + (magnitude > 0x1FF) + (magnitude > 0x3FF)
+                     + (magnitude > 0x7FF);
+
+        /* The first two segments share the same step size */
+        int mantissa = (magnitude >> (exponent + (exponent == 0))) & 0x0F;
+
+        /* A-law codewords are transmitted with even bits inverted, with the
+         * sign bit set for positive values */
+        output[i] = ((exponent << 4) | mantissa) ^ (negative ? 0x55 : 0xD5);
+
+    }
+
+}
+
+/**
+ * Sends an "audio" instruction associating the given audio stream with the
+ * mimetype of its G.711 encoder, including the rate and number of channels
+ * as mimetype parameters.
+ *
+ * @param audio
+ *     The audio stream being associated.
+ *
+ * @param socket
+ *     The socket over which the "audio" instruction should be sent.
+ */
+static void g711_encoder_send_audio(guac_audio_stream* audio,
+        guac_socket* socket) {
+
+    g711_encoder_state* state = (g711_encoder_state*) audio->data;
+    char mimetype[256];
+
+    /* Produce mimetype string from format info */
+    snprintf(mimetype, sizeof(mimetype), "%s;rate=%i,channels=%i",
+            state->mimetype, audio->rate, audio->channels);
+
+    /* Associate stream */
+    guac_protocol_send_audio(socket, audio->stream, mimetype);
+
+}
+
+/**
+ * Allocates and initializes the state of a G.711 encoder, announcing the new
+ * stream to all connected users.
+ *
+ * @param audio
+ *     The audio stream being initialized.
+ *
+ * @param mimetype
+ *     The mimetype of the encoded audio, excluding any parameters.
+ *
+ * @param encode
+ *     The function which should be used to compand each PCM sample.
+ */
+static void g711_encoder_begin(guac_audio_stream* audio,
+        const char* mimetype, g711_encode_function* encode) {
+
+    g711_encoder_state* state;
+
+    /* Allocate and init encoder state */
+    audio->data = state = guac_mem_zalloc(sizeof(g711_encoder_state));
+    state->mimetype = mimetype;
+    state->encode = encode;
+    state->length = guac_mem_ckd_mul_or_die(GUAC_G711_ENCODER_BUFFER_SIZE,
+            audio->rate, audio->channels) / 1000;
+
+    /* Always leave room for at least one sample */
+    if (state->length < 1)
+        state->length = 1;
+
+    state->buffer = guac_mem_alloc(state->length);
+
+    /* Broadcast existence of stream */
+    g711_encoder_send_audio(audio, audio->client->socket);
+
+}
+
+static void ulaw_encoder_begin_handler(guac_audio_stream* audio) {
+    g711_encoder_begin(audio, "audio/PCMU", g711_encode_ulaw);
+}
+
+static void alaw_encoder_begin_handler(guac_audio_stream* audio) {
+    g711_encoder_begin(audio, "audio/PCMA", g711_encode_alaw);
+}
+
+static void g711_encoder_join_handler(guac_audio_stream* audio,
+        guac_user* user) {
+
+    /* Notify user of existence of stream */
+    g711_encoder_send_audio(audio, user->socket);
+
+}
+
+static void g711_encoder_end_handler(guac_audio_stream* audio) {
+
+    g711_encoder_state* state = (g711_encoder_state*) audio->data;
+
+    /* Send end of stream */
+    guac_protocol_send_end(audio->client->socket, audio->stream);
+
+    /* Free state information */
+    guac_mem_free(state->buffer);
+    guac_mem_free(state);
+
+}
+
+static void g711_encoder_write_handler(guac_audio_stream* audio,
+        const unsigned char* pcm_data, int length) {
+
+    g711_encoder_state* state = (g711_encoder_state*) audio->data;
+
+    if (length <= 0)
+        return;
+
+    /* Complete any sample split across the previous write */
+    if (state->partial_sample) {
+
+        unsigned char sample[2] = { state->partial_byte, pcm_data[0] };
+
+        if (state->written == (int) state->length)
+            guac_audio_stream_flush(audio);
+
+        state->encode(sample, state->buffer + state->written, 1);
+        state->written++;
+        state->partial_sample = 0;
+
+        pcm_data++;
+        length--;
+
+    }
+
+    while (length >= 2) {
+
+        /* Prefer to encode a chunk of equal size to available buffer space */
+        int chunk_size = state->length - state->written;
+
+        /* If no space remains, flush and retry */
+        if (chunk_size == 0) {
+            guac_audio_stream_flush(audio);
+            continue;
+        }
+
+        /* Do not encode more samples than are available in source PCM */
+        if (chunk_size > length / 2)
+            chunk_size = length / 2;
+
+        /* Encode block of PCM samples into buffer */
+        state->encode(pcm_data, state->buffer + state->written, chunk_size);
+
+        /* Advance to next block */
+        state->written += chunk_size;
+        pcm_data += chunk_size * 2;
+        length -= chunk_size * 2;
+
+    }
+
+    /* Retain any trailing half of a sample until the next write */
+    if (length == 1) {
+        state->partial_byte = pcm_data[0];
+        state->partial_sample = 1;
+    }
+
+}
+
+static void g711_encoder_flush_handler(guac_audio_stream* audio) {
+
+    g711_encoder_state* state = (g711_encoder_state*) audio->data;
+    guac_socket* socket = audio->client->socket;
+    guac_stream* stream = audio->stream;
+
+    /* Flush all data in buffer as blobs */
+    guac_protocol_send_blobs(socket, stream, state->buffer, state->written);
+
+    /* All data has been flushed */
+    state->written = 0;
+
+}
+
+/* G.711 μ-law encoder handlers */
+guac_audio_encoder _ulaw_encoder = {
+    .mimetype      = "audio/PCMU",
+    .begin_handler = ulaw_encoder_begin_handler,
+    .write_handler = g711_encoder_write_handler,
+    .flush_handler = g711_encoder_flush_handler,
+    .join_handler  = g711_encoder_join_handler,
+    .end_handler   = g711_encoder_end_handler
+};
+
+/* G.711 A-law encoder handlers */
+guac_audio_encoder _alaw_encoder = {
+    .mimetype      = "audio/PCMA",
+    .begin_handler = alaw_encoder_begin_handler,
+    .write_handler = g711_encoder_write_handler,
+    .flush_handler = g711_encoder_flush_handler,
+    .join_handler  = g711_encoder_join_handler,
+    .end_handler   = g711_encoder_end_handler
+};
+
+/* Actual encoder definitions */
+guac_audio_encoder* ulaw_encoder = &_ulaw_encoder;
+guac_audio_encoder* alaw_encoder = &_alaw_encoder;
+
@@ -0,0 +1,116 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_G711_ENCODER_H
+#define GUAC_G711_ENCODER_H
+
+#include "config.h"
+
+#include "guacamole/audio.h"
+
+/**
+ * The size of the G.711 encoder output buffer, in milliseconds. As G.711
+ * produces exactly one byte per sample, the equivalent size in bytes will
+ * vary only by PCM rate and number of channels.
+ */
+#define GUAC_G711_ENCODER_BUFFER_SIZE 250
+
+/**
+ * Function which compands the given number of 16-bit signed, little-endian
+ * PCM samples to 8-bit G.711 samples.
+ *
+ * @param pcm
+ *     The 16-bit PCM samples to encode. This buffer must contain at least
+ *     count * 2 bytes.
+ *
+ * @param output
+ *     The buffer which should receive the encoded samples. This buffer must
+ *     have space for at least count bytes.
+ *
+ * @param count
+ *     The number of samples to encode.
+ */
+typedef void g711_encode_function(const unsigned char* pcm,
+        unsigned char* output, int count);
+
+/**
+ * The current state of a G.711 encoder. G.711 companding is stateless,
+ * mapping each 16-bit PCM sample independently to a single byte, so the
+ * encoder need only buffer its output until flushed.
+ */
+typedef struct g711_encoder_state {
+
+    /**
+     * Buffer of not-yet-written G.711 data.
+     */
+    unsigned char* buffer;
+
+    /**
+     * Size of the G.711 buffer, in bytes.
+     */
+    size_t length;
+
+    /**
+     * The current number of bytes stored within the G.711 buffer.
+     */
+    int written;
+
+    /**
+     * The function which should be used to compand each received PCM sample,
+     * depending on whether μ-law or A-law is being produced.
+     */
+    g711_encode_function* encode;
+
+    /**
+     * The mimetype of the encoded audio, excluding any parameters. This will
+     * be either "audio/PCMU" (μ-law) or "audio/PCMA" (A-law).
+     */
+    const char* mimetype;
+
+    /**
+     * The first byte of a 16-bit PCM sample which was split across separate
+     * calls to the write handler. This value is only meaningful if
+     * partial_sample is non-zero.
+     */
+    unsigned char partial_byte;
+
+    /**
+     * Non-zero if partial_byte contains the first half of a 16-bit PCM
+     * sample whose second half has not yet been received, zero otherwise.
+     */
+    int partial_sample;
+
+} g711_encoder_state;
+
+/**
+ * Audio encoder which compands 16-bit PCM to 8-bit G.711 μ-law, sent using
+ * the "audio/PCMU" mimetype. The rate and number of channels of the encoded
+ * audio are included as mimetype parameters, as with raw PCM.
+ */
+extern guac_audio_encoder* ulaw_encoder;
+
+/**
+ * Audio encoder which compands 16-bit PCM to 8-bit G.711 A-law, sent using
+ * the "audio/PCMA" mimetype. The rate and number of channels of the encoded
+ * audio are included as mimetype parameters, as with raw PCM.
+ */
+extern guac_audio_encoder* alaw_encoder;
+
+#endif
+
@@ -0,0 +1,77 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_AUDIO_CONSTANTS_H
+#define GUAC_AUDIO_CONSTANTS_H
+
+/**
+ * Constants related to simple streaming audio, in particular the automatic
+ * reduction of audio quality in response to processing lag.
+ *
+ * @file audio-constants.h
+ */
+
+/**
+ * The lowest sample rate that audio will be resampled to, in Hz, regardless
+ * of any limits or automatic reduction in quality. Audio provided at a lower
+ * rate than this is never resampled.
+ */
+#define GUAC_AUDIO_MIN_RATE 8000
+
+/**
+ * The maximum level of automatic reduction in audio quality. Each level
+ * reduces the audio further: level 1 downmixes to mono, and each level beyond
+ * that additionally halves the sample rate.
+ */
+#define GUAC_AUDIO_MAX_REDUCTION 3
+
+/**
+ * The minimum amount of time between consecutive checks of processing lag for
+ * audio streams that automatically reduce quality, in milliseconds.
+ */
+#define GUAC_AUDIO_LAG_CHECK_INTERVAL 250
+
+/**
+ * The processing lag above which the quality of audio streams that
+ * automatically reduce quality will be reduced, in milliseconds.
+ */
+#define GUAC_AUDIO_HIGH_LAG 400
+
+/**
+ * The processing lag below which the quality of audio streams that
+ * automatically reduce quality may be restored, in milliseconds.
+ */
+#define GUAC_AUDIO_LOW_LAG 100
+
+/**
+ * The minimum amount of time that must elapse after any change in quality
+ * before quality may be reduced further, in milliseconds.
+ */
+#define GUAC_AUDIO_REDUCE_INTERVAL 2000
+
+/**
+ * The minimum amount of time that must elapse after any change in quality
+ * before quality may be restored by one level, in milliseconds. This is
+ * deliberately longer than GUAC_AUDIO_REDUCE_INTERVAL, such that quality does
+ * not oscillate under sustained load.
+ */
+#define GUAC_AUDIO_RESTORE_INTERVAL 10000
+
+#endif
+
@@ -26,10 +26,12 @@
  * @file audio.h
  */
 
+#include "audio-constants.h"
 #include "audio-fntypes.h"
 #include "audio-types.h"
 #include "client-types.h"
 #include "stream-types.h"
+#include "timestamp-types.h"
 
 struct guac_audio_encoder {
 
@@ -86,19 +88,24 @@ struct guac_audio_stream {
     guac_stream* stream;
 
     /**
-     * The number of samples per second of PCM data sent to this stream.
+     * The number of samples per second of PCM data received by the encoder.
+     * Unless the audio is being resampled due to a configured limit or
+     * automatic reduction in quality, this will be identical to input_rate.
      */
     int rate;
 
     /**
-     * The number of audio channels per sample of PCM data. Legal values are
-     * 1 or 2.
+     * The number of audio channels per sample of PCM data received by the
+     * encoder. Legal values are 1 or 2. Unless the audio is being downmixed
+     * due to a configured limit or automatic reduction in quality, this will
+     * be identical to input_channels.
      */
     int channels;
 
     /**
-     * The number of bits per sample per channel for PCM data. Legal values are
-     * 8 or 16.
+     * The number of bits per sample per channel for PCM data received by the
+     * encoder. Legal values are 8 or 16. Unless bit depth is being reduced
+     * due to a configured limit, this will be identical to input_bps.
      */
     int bps;
 
@@ -107,6 +114,72 @@ struct guac_audio_stream {
      */
     void* data;
 
+    /**
+     * The number of samples per second of PCM data sent to this stream.
+     */
+    int input_rate;
+
+    /**
+     * The number of audio channels per sample of PCM data sent to this
+     * stream. Legal values are 1 or 2.
+     */
+    int input_channels;
+
+    /**
+     * The number of bits per sample per channel for PCM data sent to this
+     * stream. Legal values are 8 or 16.
+     */
+    int input_bps;
+
+    /**
+     * The maximum sample rate of audio sent to users, as set by
+     * guac_audio_stream_set_limits(), or zero if there is no limit.
+     */
+    int __max_rate;
+
+    /**
+     * The maximum number of channels of audio sent to users, as set by
+     * guac_audio_stream_set_limits(), or zero if there is no limit.
+     */
+    int __max_channels;
+
+    /**
+     * The maximum number of bits per sample of audio sent to users, as set
+     * by guac_audio_stream_set_limits(), or zero if there is no limit.
+     */
+    int __max_bps;
+
+    /**
+     * Non-zero if the quality of this audio stream should be automatically
+     * reduced in response to processing lag, zero otherwise.
+     */
+    int __adaptive;
+
+    /**
+     * The current level of automatic reduction in quality, from zero (no
+     * reduction) to GUAC_AUDIO_MAX_REDUCTION.
+     */
+    int __reduction;
+
+    /**
+     * The time that the processing lag of the associated client was last
+     * checked, for audio streams that automatically reduce quality.
+     */
+    guac_timestamp __last_lag_check;
+
+    /**
+     * The time that the level of automatic reduction in quality last
+     * changed.
+     */
+    guac_timestamp __last_reduction_change;
+
+    /**
+     * The conversion stage applied to PCM data sent to this stream before it
+     * is passed to the encoder, or NULL if the PCM data is passed to the
+     * encoder unmodified.
+     */
+    void* __processor;
+
 };
 
 /**
@@ -116,7 +189,9 @@ struct guac_audio_stream {
  * libguac and the level of support declared by users associated with the
  * given guac_client. The PCM format specified here (via rate, channels, and
  * bps) must be the format used for all PCM data provided to the audio stream.
- * The format may only be changed using guac_audio_stream_reset().
+ * The format may only be changed using guac_audio_stream_reset(). The audio
+ * actually sent to users may be reduced from this format using
+ * guac_audio_stream_set_limits() and guac_audio_stream_set_adaptive().
  *
  * If a new user joins the connection after the audio stream is created, that
  * user will not be aware of the existence of the audio stream, and
@@ -181,6 +256,56 @@ guac_audio_stream* guac_audio_stream_alloc(guac_client* client,
 void guac_audio_stream_reset(guac_audio_stream* audio,
         guac_audio_encoder* encoder, int rate, int channels, int bps);
 
+/**
+ * Limits the format of the audio sent to users along the given audio stream.
+ * PCM data provided to the audio stream that exceeds these limits is
+ * resampled, downmixed, and/or reduced in bit depth before being passed to
+ * the encoder. Sample rates are never reduced below GUAC_AUDIO_MIN_RATE.
+ * If the bit depth is reduced, the encoder is reselected for the new bit
+ * depth; if no connected user supports a built-in encoder for the reduced
+ * bit depth, the bit depth is left unchanged.
+ *
+ * If the resulting format differs from the format currently sent, the audio
+ * stream is restarted using the new format, as with
+ * guac_audio_stream_reset().
+ *
+ * @param audio
+ *     The guac_audio_stream to limit.
+ *
+ * @param max_rate
+ *     The maximum number of samples per second, or zero for no limit.
+ *
+ * @param max_channels
+ *     The maximum number of audio channels. Legal values are 1 or 2, or zero
+ *     for no limit.
+ *
+ * @param max_bps
+ *     The maximum number of bits per sample per channel. Legal values are 8
+ *     or 16, or zero for no limit.
+ */
+void guac_audio_stream_set_limits(guac_audio_stream* audio, int max_rate,
+        int max_channels, int max_bps);
+
+/**
+ * Sets whether the quality of the given audio stream should be automatically
+ * reduced in response to processing lag, as reported by
+ * guac_client_get_processing_lag(). While enabled, sustained lag above
+ * GUAC_AUDIO_HIGH_LAG progressively downmixes the audio to mono and then
+ * halves its sample rate, up to GUAC_AUDIO_MAX_REDUCTION levels. Quality is
+ * restored one level at a time once lag falls below GUAC_AUDIO_LOW_LAG.
+ * Any limits set with guac_audio_stream_set_limits() continue to apply.
+ * Processing lag is checked only when PCM data is written to the stream.
+ *
+ * @param audio
+ *     The guac_audio_stream to configure.
+ *
+ * @param adaptive
+ *     Non-zero if quality should be automatically reduced in response to
+ *     processing lag, zero otherwise. If zero, any existing reduction is
+ *     removed.
+ */
+void guac_audio_stream_set_adaptive(guac_audio_stream* audio, int adaptive);
+
 /**
  * Notifies the given audio stream that a user has joined the connection. The
  * audio stream itself may need to be restarted. and the audio stream will need
@@ -206,8 +331,10 @@ void guac_audio_stream_free(guac_audio_stream* stream);
 
 /**
  * Writes PCM data to the given audio stream. This PCM data will be
- * automatically encoded by the audio encoder associated with this stream. The
- * PCM data must be 2-channel, 44100 Hz, with signed 16-bit samples.
+ * automatically converted as required by any limits or automatic reduction
+ * in quality, and encoded by the audio encoder associated with this stream.
+ * The PCM data must be in the format given when the audio stream was
+ * allocated or last reset.
  *
  * @param stream
  *     The guac_audio_stream to write PCM data through.
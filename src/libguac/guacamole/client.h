@@ -655,6 +655,23 @@ int guac_client_load_plugin(guac_client* client, const char* protocol);
  */
 int guac_client_get_processing_lag(guac_client* client);
 
+/**
+ * Calculates and returns the approximate total lag experienced by the pool of
+ * users, including both processing lag and the estimated time required to
+ * deliver data which has been sent but is still queued due to network
+ * congestion. Unlike the processing lag alone, this grows as soon as data is
+ * sent faster than the network can carry it, before the resulting frames are
+ * delayed.
+ *
+ * @param client
+ *     The guac_client to calculate the display lag of.
+ *
+ * @return
+ *     The approximate total lag of the pool of users associated with the
+ *     given guac_client, in milliseconds.
+ */
+int guac_client_get_display_lag(guac_client* client);
+
 /**
  * Sends a request to the owner of the given guac_client for parameters required
  * to continue the connection started by the client. The function returns zero
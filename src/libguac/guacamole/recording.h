@@ -21,6 +21,11 @@
 #define GUAC_RECORDING_H
 
 #include <guacamole/client.h>
+#include <guacamole/socket-types.h>
+#include <guacamole/timestamp-types.h>
+
+#include <stddef.h>
+#include <stdint.h>
 
 /**
  * Provides functions and structures to be use for session recording.
@@ -48,6 +53,87 @@
  */
 #define GUAC_COMMON_RECORDING_MAX_NAME_LENGTH 2048
 
+/**
+ * The size of each chunk of recording data handed to the recording writer
+ * thread, in bytes. Recording data is written to disk in chunks of this size
+ * unless the recording is explicitly flushed.
+ */
+#define GUAC_RECORDING_CHUNK_SIZE 65536
+
+/**
+ * The default maximum number of bytes of recording data which may be queued
+ * for writing by the recording writer thread before the overflow policy of
+ * the recording takes effect.
+ */
+#define GUAC_RECORDING_DEFAULT_MAX_QUEUED 67108864
+
+/**
+ * The action to take when data is written to a recording while the amount of
+ * data queued for writing to disk has reached its limit.
+ */
+typedef enum guac_recording_overflow_policy {
+
+    /**
+     * Block the thread writing to the recording until the recording writer
+     * thread has written enough data to disk. No recording data is lost, but
+     * slow storage will ultimately stall the connection. This is the default
+     * policy.
+     */
+    GUAC_RECORDING_OVERFLOW_BLOCK,
+
+    /**
+     * Discard any instruction which begins while the queue is full. The
+     * connection is never stalled by slow storage, but the recording may be
+     * missing instructions and thus may not render correctly when played
+     * back. Instructions are always dropped in their entirety, such that the
+     * recording remains parseable.
+     */
+    GUAC_RECORDING_OVERFLOW_DROP
+
+} guac_recording_overflow_policy;
+
+/**
+ * Statistics describing the data written to an in-progress recording.
+ */
+typedef struct guac_recording_stats {
+
+    /**
+     * The number of bytes currently queued for writing by the recording
+     * writer thread.
+     */
+    size_t queued_bytes;
+
+    /**
+     * The largest number of bytes that have been queued for writing at any
+     * one time.
+     */
+    size_t peak_queued_bytes;
+
+    /**
+     * The total number of bytes written to disk.
+     */
+    uint64_t written_bytes;
+
+    /**
+     * The total number of bytes discarded due to the
+     * GUAC_RECORDING_OVERFLOW_DROP policy or write errors.
+     */
+    uint64_t dropped_bytes;
+
+    /**
+     * The total number of instructions discarded due to the
+     * GUAC_RECORDING_OVERFLOW_DROP policy.
+     */
+    uint64_t dropped_instructions;
+
+    /**
+     * Non-zero if an error has occurred while writing to disk, in which case
+     * all further recording data is discarded, zero otherwise.
+     */
+    int failed;
+
+} guac_recording_stats;
+
 /**
  * An in-progress session recording, attached to a guac_client instance such
  * that output Guacamole instructions may be dynamically intercepted and
@@ -95,6 +181,12 @@ typedef struct guac_recording {
      */
     int include_keys;
 
+    /**
+     * The client whose output is being recorded. Statistics describing the
+     * recording are logged through this client when the recording is freed.
+     */
+    guac_client* client;
+
 } guac_recording;
 
 /**
@@ -106,6 +198,12 @@ typedef struct guac_recording {
  * written. The recording will automatically be closed once the client is
  * freed.
  *
+ * Recording data is queued in chunks of GUAC_RECORDING_CHUNK_SIZE bytes and
+ * written to disk by a dedicated thread, such that writing to the client
+ * socket does not wait for disk I/O. By default, at most
+ * GUAC_RECORDING_DEFAULT_MAX_QUEUED bytes may be queued before writes block
+ * (see guac_recording_set_overflow_policy()).
+ *
  * @param client
  *     The client whose output should be copied to a recording file.
  *
@@ -148,6 +246,16 @@ typedef struct guac_recording {
  *     caution. Key events can easily contain sensitive information, such as
  *     passwords, credit card numbers, etc.
  *
+ * @param compress
+ *     Non-zero if the recording should be compressed, zero otherwise.
+ *     Compressed recordings are written as a series of independently-
+ *     compressed gzip blocks, each of which notes the timestamp of the first
+ *     "sync" instruction it contains, allowing guac_recording_reader_seek()
+ *     to locate any point in the recording without decompressing the data
+ *     preceding it. The resulting file remains a valid gzip file. If this
+ *     build of libguac lacks support for compression, a warning is logged
+ *     and the recording is written uncompressed.
+ *
  * @return
  *     A new guac_recording structure representing the in-progress
  *     recording if the recording file has been successfully created and a
@@ -156,19 +264,92 @@ typedef struct guac_recording {
 guac_recording* guac_recording_create(guac_client* client,
         const char* path, const char* name, int create_path,
         int include_output, int include_mouse, int include_touch,
-        int include_keys);
+        int include_keys, int compress);
 
 /**
- * Frees the resources associated with the given in-progress recording. Note
- * that, due to the manner that recordings are attached to the guac_client, the
- * underlying guac_socket is not freed. The guac_socket will be automatically
- * freed when the guac_client is freed.
+ * Frees the resources associated with the given in-progress recording,
+ * logging statistics describing the data written to the recording thus far,
+ * including any data dropped due to the GUAC_RECORDING_OVERFLOW_DROP policy.
+ * Note that, due to the manner that recordings are attached to the
+ * guac_client, the underlying guac_socket is not freed. The guac_socket will
+ * be automatically freed when the guac_client is freed.
  *
  * @param recording
  *     The guac_recording to free.
  */
 void guac_recording_free(guac_recording* recording);
 
+/**
+ * Sets the maximum amount of recording data which may be queued for writing
+ * to disk, and the action to take if further data is written while that
+ * limit is reached.
+ *
+ * @param recording
+ *     The guac_recording to configure.
+ *
+ * @param max_queued
+ *     The maximum number of bytes which may be queued for writing to disk.
+ *
+ * @param policy
+ *     The action to take when data is written while max_queued bytes are
+ *     already queued.
+ */
+void guac_recording_set_overflow_policy(guac_recording* recording,
+        size_t max_queued, guac_recording_overflow_policy policy);
+
+/**
+ * Retrieves statistics describing the data written to the given recording
+ * thus far, including the amount of data currently awaiting a write to disk.
+ *
+ * @param recording
+ *     The guac_recording to retrieve statistics for.
+ *
+ * @param stats
+ *     The guac_recording_stats structure to populate.
+ */
+void guac_recording_get_stats(guac_recording* recording,
+        guac_recording_stats* stats);
+
+/**
+ * Returns a new guac_socket which reads the session recording within the
+ * given file, transparently decompressing the recording if it was written
+ * with compression enabled. Uncompressed recordings are read as-is. The
+ * file descriptor is closed when the returned guac_socket is freed.
+ *
+ * @param fd
+ *     A file descriptor open for reading at the start of the recording.
+ *
+ * @return
+ *     A newly-allocated guac_socket from which the Guacamole protocol data
+ *     of the recording can be read, or NULL if the recording cannot be read
+ *     (including if it is compressed and this build of libguac lacks
+ *     support for compression).
+ */
+guac_socket* guac_recording_reader_open(int fd);
+
+/**
+ * Repositions the given recording reader such that the next data read is the
+ * start of the first instruction within the last block of the recording
+ * whose first "sync" instruction is at or before the given timestamp. If no
+ * such block exists, the reader is repositioned at the start of the
+ * recording. Only compressed recordings are seekable, and the underlying file
+ * descriptor must refer to a regular file.
+ *
+ * Note that the data read after seeking does not describe the display state
+ * established by prior instructions.
+ *
+ * @param socket
+ *     A guac_socket returned by guac_recording_reader_open().
+ *
+ * @param timestamp
+ *     The timestamp to seek to, in the same units as the timestamps of the
+ *     "sync" instructions within the recording.
+ *
+ * @return
+ *     Zero if seeking succeeded, non-zero otherwise.
+ */
+int guac_recording_reader_seek(guac_socket* socket, guac_timestamp timestamp);
+
 /**
  * Reports the current mouse position and button state within the recording.
  *
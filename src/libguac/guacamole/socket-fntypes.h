@@ -102,6 +102,21 @@ typedef void guac_socket_lock_handler(guac_socket* socket);
  */
 typedef void guac_socket_unlock_handler(guac_socket* socket);
 
+/**
+ * When set within a guac_socket, a handler of this type will be called when
+ * guac_socket_get_backlog() is called to determine how much data written to
+ * the guac_socket has not yet been delivered.
+ *
+ * @param socket
+ *     The guac_socket being queried.
+ *
+ * @return
+ *     The number of bytes written to the guac_socket which are still buffered
+ *     locally or queued for transmission by the operating system, or a
+ *     negative value if this cannot be determined.
+ */
+typedef ssize_t guac_socket_backlog_handler(guac_socket* socket);
+
 /**
  * Generic handler for the closing of a socket, modeled after the standard
  * POSIX close() function. When set within a guac_socket, a handler of this type
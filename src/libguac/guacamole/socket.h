@@ -118,6 +118,18 @@ struct guac_socket {
      */
     pthread_t __keep_alive_thread;
 
+    /**
+     * Handler which will be called whenever guac_socket_get_backlog() is
+     * invoked on this socket.
+     */
+    guac_socket_backlog_handler* backlog_handler;
+
+    /**
+     * The total number of bytes written to this guac_socket since it was
+     * allocated.
+     */
+    uint64_t bytes_written;
+
 };
 
 /**
@@ -382,6 +394,23 @@ ssize_t guac_socket_flush_base64(guac_socket* socket);
  */
 ssize_t guac_socket_flush(guac_socket* socket);
 
+/**
+ * Returns the number of bytes written to the given guac_socket which have not
+ * yet been delivered, including data buffered internally by the guac_socket
+ * and data queued for transmission by the operating system. A persistently
+ * large backlog indicates that data is being written faster than the
+ * underlying connection can carry it.
+ *
+ * @param socket
+ *     The guac_socket to query.
+ *
+ * @return
+ *     The number of bytes written to the given guac_socket which have not yet
+ *     been delivered, or a negative value if the backlog of the socket cannot
+ *     be determined.
+ */
+ssize_t guac_socket_get_backlog(guac_socket* socket);
+
 /**
  * Waits for input to be available on the given guac_socket object until the
  * specified timeout elapses.
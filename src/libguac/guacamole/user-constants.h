@@ -64,5 +64,12 @@
  */
 #define GUAC_USER_STREAM_INDEX_MIMETYPE "application/vnd.glyptodon.guacamole.stream-index+json"
 
+/**
+ * The minimum amount of time between samples of the backlog of data awaiting
+ * delivery to a user, in milliseconds. Shorter intervals produce noisier
+ * estimates of available bandwidth.
+ */
+#define GUAC_USER_BACKLOG_SAMPLE_INTERVAL 100
+
 #endif
 
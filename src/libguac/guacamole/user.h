@@ -42,6 +42,7 @@
 
 #include <pthread.h>
 #include <stdarg.h>
+#include <stdint.h>
 
 struct guac_user_info {
 
@@ -538,6 +539,37 @@ struct guac_user {
      */
     guac_user_touch_handler* touch_handler;
 
+    /**
+     * The estimated rate at which data written to the user's socket is
+     * actually delivered, in bytes per second, or zero if not yet known. This
+     * is updated as frames are completed by guac_client_end_frame().
+     */
+    int bandwidth;
+
+    /**
+     * The estimated time required to deliver all data already written to the
+     * user's socket, in milliseconds, based on the current backlog of that
+     * socket and the estimated bandwidth. Unlike processing_lag, this reflects
+     * congestion of the network connection before frames are delayed.
+     */
+    int congestion_lag;
+
+    /**
+     * The time at which the backlog of the user's socket was last sampled.
+     */
+    guac_timestamp __last_backlog_sample;
+
+    /**
+     * The total number of bytes written to the user's socket at the time the
+     * backlog was last sampled.
+     */
+    uint64_t __last_bytes_written;
+
+    /**
+     * The backlog of the user's socket, in bytes, as of the last sample.
+     */
+    int64_t __last_backlog;
+
 };
 
 /**
@@ -0,0 +1,132 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "recording-block.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The gzip FLG bit indicating that an extra field is present.
+ */
+#define GUAC_RECORDING_BLOCK_FEXTRA 0x04
+
+/**
+ * Stores the given value at the given location in little-endian byte order,
+ * as required by RFC 1952.
+ *
+ * @param buffer
+ *     The location to store the value at.
+ *
+ * @param value
+ *     The value to store.
+ *
+ * @param size
+ *     The number of bytes of the value to store.
+ */
+static void guac_recording_block_put(unsigned char* buffer, uint64_t value,
+        int size) {
+    for (int i = 0; i < size; i++) {
+        buffer[i] = value & 0xFF;
+        value >>= 8;
+    }
+}
+
+/**
+ * Reads a little-endian value of the given size from the given location.
+ *
+ * @param buffer
+ *     The location to read the value from.
+ *
+ * @param size
+ *     The number of bytes of the value to read.
+ *
+ * @return
+ *     The value read.
+ */
+static uint64_t guac_recording_block_get(const unsigned char* buffer,
+        int size) {
+    uint64_t value = 0;
+    for (int i = size - 1; i >= 0; i--)
+        value = (value << 8) | buffer[i];
+    return value;
+}
+
+void guac_recording_block_write_header(unsigned char* buffer,
+        const guac_recording_block_header* header) {
+
+    /* Fixed gzip member header (deflate, extra field present, no
+     * modification time, unknown OS) */
+    buffer[0] = 0x1F;
+    buffer[1] = 0x8B;
+    buffer[2] = 0x08;
+    buffer[3] = GUAC_RECORDING_BLOCK_FEXTRA;
+    guac_recording_block_put(buffer + 4, 0, 4);
+    buffer[8] = 0x00;
+    buffer[9] = 0xFF;
+
+    /* Extra field containing a single subfield */
+    guac_recording_block_put(buffer + 10,
+            4 + GUAC_RECORDING_BLOCK_SUBFIELD_LENGTH, 2);
+    buffer[12] = GUAC_RECORDING_BLOCK_SI1;
+    buffer[13] = GUAC_RECORDING_BLOCK_SI2;
+    guac_recording_block_put(buffer + 14,
+            GUAC_RECORDING_BLOCK_SUBFIELD_LENGTH, 2);
+
+    /* Block description */
+    guac_recording_block_put(buffer + 16, header->length, 4);
+    guac_recording_block_put(buffer + 20, header->first_instruction, 4);
+    guac_recording_block_put(buffer + 24, (uint64_t) header->timestamp, 8);
+
+}
+
+int guac_recording_block_read_header(const unsigned char* buffer,
+        size_t length, guac_recording_block_header* header) {
+
+    if (length < GUAC_RECORDING_BLOCK_HEADER_LENGTH)
+        return 1;
+
+    /* Verify gzip member header with extra field */
+    if (buffer[0] != 0x1F || buffer[1] != 0x8B || buffer[2] != 0x08
+            || !(buffer[3] & GUAC_RECORDING_BLOCK_FEXTRA))
+        return 1;
+
+    /* Verify extra field is exactly the expected subfield */
+    if (guac_recording_block_get(buffer + 10, 2)
+                != 4 + GUAC_RECORDING_BLOCK_SUBFIELD_LENGTH
+            || buffer[12] != GUAC_RECORDING_BLOCK_SI1
+            || buffer[13] != GUAC_RECORDING_BLOCK_SI2
+            || guac_recording_block_get(buffer + 14, 2)
+                != GUAC_RECORDING_BLOCK_SUBFIELD_LENGTH)
+        return 1;
+
+    header->length = guac_recording_block_get(buffer + 16, 4);
+    header->first_instruction = guac_recording_block_get(buffer + 20, 4);
+    header->timestamp = (guac_timestamp) guac_recording_block_get(buffer + 24, 8);
+
+    /* Block must at least contain its own header and trailer */
+    if (header->length < GUAC_RECORDING_BLOCK_HEADER_LENGTH
+            + GUAC_RECORDING_BLOCK_TRAILER_LENGTH)
+        return 1;
+
+    return 0;
+
+}
@@ -0,0 +1,153 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_RECORDING_BLOCK_H
+#define GUAC_RECORDING_BLOCK_H
+
+/**
+ * Compressed session recordings are stored as a series of independent gzip
+ * members ("blocks"), each containing the compressed contents of a single
+ * chunk of recording data. As with any series of concatenated gzip members,
+ * the recording as a whole remains a valid gzip file. The header of each
+ * block additionally contains an extra field (RFC 1952, section 2.3.1.1)
+ * identified by GUAC_RECORDING_BLOCK_SI1 and GUAC_RECORDING_BLOCK_SI2 which
+ * records the total size of the block, the offset of the first instruction
+ * beginning within the block, and the timestamp of the first "sync"
+ * instruction within the block. Readers may thus seek to an arbitrary
+ * timestamp by hopping from block header to block header without
+ * decompressing any data.
+ *
+ * @file recording-block.h
+ */
+
+#include "guacamole/timestamp-types.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The first subfield ID byte of the gzip extra field describing a block of a
+ * compressed recording.
+ */
+#define GUAC_RECORDING_BLOCK_SI1 'G'
+
+/**
+ * The second subfield ID byte of the gzip extra field describing a block of
+ * a compressed recording.
+ */
+#define GUAC_RECORDING_BLOCK_SI2 'R'
+
+/**
+ * The length of the data within the gzip extra subfield describing a block
+ * of a compressed recording, in bytes.
+ */
+#define GUAC_RECORDING_BLOCK_SUBFIELD_LENGTH 16
+
+/**
+ * The size of the header of each block of a compressed recording, in bytes.
+ * This is the size of the fixed portion of a gzip member header, plus the
+ * extra field.
+ */
+#define GUAC_RECORDING_BLOCK_HEADER_LENGTH 32
+
+/**
+ * The size of the trailer of each block of a compressed recording (the CRC32
+ * and uncompressed size of the block), in bytes.
+ */
+#define GUAC_RECORDING_BLOCK_TRAILER_LENGTH 8
+
+/**
+ * The value of the first_instruction field of a block header if no
+ * instruction begins within the block.
+ */
+#define GUAC_RECORDING_BLOCK_NO_INSTRUCTION UINT32_MAX
+
+/**
+ * The value of the timestamp field of a block header if no "sync"
+ * instruction begins within the block.
+ */
+#define GUAC_RECORDING_BLOCK_NO_TIMESTAMP -1
+
+/**
+ * The contents of the extra field within the header of a single block of a
+ * compressed recording.
+ */
+typedef struct guac_recording_block_header {
+
+    /**
+     * The total size of the block, including its header and trailer, in
+     * bytes.
+     */
+    uint32_t length;
+
+    /**
+     * The offset within the uncompressed contents of the block of the first
+     * byte of the first instruction beginning within the block, or
+     * GUAC_RECORDING_BLOCK_NO_INSTRUCTION if no instruction begins within the
+     * block.
+     */
+    uint32_t first_instruction;
+
+    /**
+     * The timestamp of the first "sync" instruction beginning within the
+     * block, or GUAC_RECORDING_BLOCK_NO_TIMESTAMP if no "sync" instruction
+     * begins within the block.
+     */
+    guac_timestamp timestamp;
+
+} guac_recording_block_header;
+
+/**
+ * Writes the gzip member header of a block of a compressed recording to the
+ * given buffer, which must be at least GUAC_RECORDING_BLOCK_HEADER_LENGTH
+ * bytes long.
+ *
+ * @param buffer
+ *     The buffer to write the header to.
+ *
+ * @param header
+ *     The values to store within the extra field of the header.
+ */
+void guac_recording_block_write_header(unsigned char* buffer,
+        const guac_recording_block_header* header);
+
+/**
+ * Parses the gzip member header of a block of a compressed recording,
+ * populating the given guac_recording_block_header with the values stored
+ * within its extra field.
+ *
+ * @param buffer
+ *     The buffer containing the header.
+ *
+ * @param length
+ *     The number of bytes available within the buffer.
+ *
+ * @param header
+ *     The guac_recording_block_header to populate.
+ *
+ * @return
+ *     Zero if the buffer contains a valid block header, non-zero otherwise
+ *     (including if the buffer contains an ordinary gzip member header
+ *     lacking the expected extra field).
+ */
+int guac_recording_block_read_header(const unsigned char* buffer,
+        size_t length, guac_recording_block_header* header);
+
+#endif
+
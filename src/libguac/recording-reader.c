@@ -0,0 +1,421 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "guacamole/error.h"
+#include "guacamole/mem.h"
+#include "guacamole/recording.h"
+#include "guacamole/socket.h"
+#include "guacamole/timestamp.h"
+#include "recording-block.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifdef ENABLE_ZLIB
+#include <zlib.h>
+#endif
+
+/**
+ * Data associated with a guac_socket which reads a session recording,
+ * transparently decompressing the recording if it is compressed.
+ */
+typedef struct guac_recording_reader_data {
+
+    /**
+     * The file descriptor from which the recording is read.
+     */
+    int fd;
+
+    /**
+     * Whether the recording is compressed.
+     */
+    bool compressed;
+
+    /**
+     * Buffer containing data read from the file but not yet consumed.
+     */
+    unsigned char input[GUAC_RECORDING_CHUNK_SIZE];
+
+    /**
+     * The offset of the first unconsumed byte within the input buffer.
+     */
+    size_t input_offset;
+
+    /**
+     * The number of bytes within the input buffer, including bytes which
+     * have already been consumed.
+     */
+    size_t input_length;
+
+    /**
+     * The number of bytes of decompressed data which should be discarded
+     * before any further data is returned, as the result of seeking to a
+     * block which begins partway through an instruction.
+     */
+    size_t skip;
+
+#ifdef ENABLE_ZLIB
+    /**
+     * The zlib stream used to decompress compressed recordings.
+     */
+    z_stream inflate_stream;
+#endif
+
+} guac_recording_reader_data;
+
+/**
+ * Reads as much data as possible from the underlying file into the input
+ * buffer of the given reader, replacing any data which has already been
+ * consumed.
+ *
+ * @param data
+ *     The guac_recording_reader_data of the socket.
+ *
+ * @return
+ *     The number of bytes read, zero if the end of the file has been
+ *     reached, or -1 if an error occurs.
+ */
+static ssize_t guac_recording_reader_fill(guac_recording_reader_data* data) {
+
+    ssize_t retval;
+    do {
+        retval = read(data->fd, data->input, sizeof(data->input));
+    } while (retval < 0 && errno == EINTR);
+
+    if (retval < 0) {
+        guac_error = GUAC_STATUS_SEE_ERRNO;
+        guac_error_message = "Error reading recording";
+        return -1;
+    }
+
+    data->input_offset = 0;
+    data->input_length = retval;
+
+    return retval;
+
+}
+
+#ifdef ENABLE_ZLIB
+/**
+ * Decompresses data from the input buffer of the given reader into the given
+ * buffer, reading further data from the underlying file as needed. Each
+ * block of the recording is an independent gzip member, and decompression
+ * continues seamlessly from one member to the next.
+ *
+ * @param data
+ *     The guac_recording_reader_data of the socket.
+ *
+ * @param buf
+ *     The buffer to store decompressed data within.
+ *
+ * @param count
+ *     The maximum number of bytes to store within the buffer.
+ *
+ * @return
+ *     The number of bytes stored, zero if the end of the recording has been
+ *     reached, or -1 if an error occurs.
+ */
+static ssize_t guac_recording_reader_inflate(guac_recording_reader_data* data,
+        void* buf, size_t count) {
+
+    z_stream* stream = &data->inflate_stream;
+
+    for (;;) {
+
+        /* Refill input buffer if empty */
+        if (data->input_offset == data->input_length) {
+
+            ssize_t length = guac_recording_reader_fill(data);
+            if (length < 0)
+                return -1;
+
+            /* A truncated final block (such as that of an in-progress
+             * recording) is treated as the end of the recording */
+            if (length == 0)
+                return 0;
+
+        }
+
+        stream->next_in = data->input + data->input_offset;
+        stream->avail_in = data->input_length - data->input_offset;
+        stream->next_out = buf;
+        stream->avail_out = count;
+
+        int result = inflate(stream, Z_NO_FLUSH);
+        data->input_offset = data->input_length - stream->avail_in;
+
+        if (result != Z_OK && result != Z_STREAM_END
+                && result != Z_BUF_ERROR) {
+            guac_error = GUAC_STATUS_PROTOCOL_ERROR;
+            guac_error_message = "Recording is corrupt";
+            return -1;
+        }
+
+        /* Continue with next block once current block is complete */
+        if (result == Z_STREAM_END)
+            inflateReset(stream);
+
+        size_t length = count - stream->avail_out;
+
+        /* Discard data preceding the first instruction of a block sought
+         * via guac_recording_reader_seek() */
+        if (data->skip > 0) {
+
+            size_t skipped = length;
+            if (skipped > data->skip)
+                skipped = data->skip;
+
+            memmove(buf, (char*) buf + skipped, length - skipped);
+            length -= skipped;
+            data->skip -= skipped;
+
+        }
+
+        if (length > 0)
+            return length;
+
+    }
+
+}
+#endif
+
+/**
+ * Reads data from the given recording, decompressing that data if the
+ * recording is compressed.
+ *
+ * @param socket
+ *     The recording reader socket to read from.
+ *
+ * @param buf
+ *     The buffer to store data within.
+ *
+ * @param count
+ *     The maximum number of bytes to read.
+ *
+ * @return
+ *     The number of bytes read, zero if the end of the recording has been
+ *     reached, or -1 if an error occurs.
+ */
+static ssize_t guac_recording_reader_read_handler(guac_socket* socket,
+        void* buf, size_t count) {
+
+    guac_recording_reader_data* data =
+        (guac_recording_reader_data*) socket->data;
+
+#ifdef ENABLE_ZLIB
+    if (data->compressed)
+        return guac_recording_reader_inflate(data, buf, count);
+#endif
+
+    /* Return any data remaining from format detection before reading
+     * directly from the file */
+    if (data->input_offset < data->input_length) {
+
+        size_t length = data->input_length - data->input_offset;
+        if (length > count)
+            length = count;
+
+        memcpy(buf, data->input + data->input_offset, length);
+        data->input_offset += length;
+        return length;
+
+    }
+
+    ssize_t retval;
+    do {
+        retval = read(data->fd, buf, count);
+    } while (retval < 0 && errno == EINTR);
+
+    if (retval < 0) {
+        guac_error = GUAC_STATUS_SEE_ERRNO;
+        guac_error_message = "Error reading recording";
+    }
+
+    return retval;
+
+}
+
+/**
+ * Frees all implementation-specific data associated with the given socket,
+ * closing the underlying file descriptor.
+ *
+ * @param socket
+ *     The recording reader socket to free.
+ *
+ * @return
+ *     Always zero.
+ */
+static int guac_recording_reader_free_handler(guac_socket* socket) {
+
+    guac_recording_reader_data* data =
+        (guac_recording_reader_data*) socket->data;
+
+#ifdef ENABLE_ZLIB
+    if (data->compressed)
+        inflateEnd(&data->inflate_stream);
+#endif
+
+    close(data->fd);
+
+    guac_mem_free(data);
+    return 0;
+
+}
+
+guac_socket* guac_recording_reader_open(int fd) {
+
+    guac_recording_reader_data* data =
+        guac_mem_zalloc(sizeof(guac_recording_reader_data));
+    data->fd = fd;
+
+    /* Read initial data to determine recording format */
+    if (guac_recording_reader_fill(data) < 0) {
+        guac_mem_free(data);
+        return NULL;
+    }
+
+    /* Compressed recordings are gzip files */
+    data->compressed = data->input_length >= 2
+        && data->input[0] == 0x1F && data->input[1] == 0x8B;
+
+    if (data->compressed) {
+
+#ifdef ENABLE_ZLIB
+        /* Accept any gzip data, not only recordings produced by libguac */
+        if (inflateInit2(&data->inflate_stream, 16 + MAX_WBITS) != Z_OK) {
+            guac_error = GUAC_STATUS_NO_MEMORY;
+            guac_error_message = "Unable to initialize recording "
+                "decompression";
+            guac_mem_free(data);
+            return NULL;
+        }
+#else
+        guac_error = GUAC_STATUS_NOT_SUPPORTED;
+        guac_error_message = "Reading compressed recordings requires zlib";
+        guac_mem_free(data);
+        return NULL;
+#endif
+
+    }
+
+    guac_socket* socket = guac_socket_alloc();
+    if (socket == NULL) {
+#ifdef ENABLE_ZLIB
+        if (data->compressed)
+            inflateEnd(&data->inflate_stream);
+#endif
+        guac_mem_free(data);
+        return NULL;
+    }
+
+    socket->data = data;
+    socket->read_handler = guac_recording_reader_read_handler;
+    socket->free_handler = guac_recording_reader_free_handler;
+
+    return socket;
+
+}
+
+int guac_recording_reader_seek(guac_socket* socket, guac_timestamp timestamp) {
+
+#ifdef ENABLE_ZLIB
+    guac_recording_reader_data* data =
+        (guac_recording_reader_data*) socket->data;
+
+    /* Only compressed recordings contain the block headers needed to seek */
+    if (!data->compressed) {
+        guac_error = GUAC_STATUS_NOT_SUPPORTED;
+        guac_error_message = "Only compressed recordings are seekable";
+        return 1;
+    }
+
+    /* Find the last block beginning with a sync at or before the requested
+     * timestamp, hopping from header to header */
+    off_t offset = 0;
+    off_t found_offset = 0;
+    uint32_t found_instruction = 0;
+
+    for (;;) {
+
+        unsigned char buffer[GUAC_RECORDING_BLOCK_HEADER_LENGTH];
+        ssize_t length = pread(data->fd, buffer, sizeof(buffer), offset);
+        if (length < 0) {
+            guac_error = GUAC_STATUS_SEE_ERRNO;
+            guac_error_message = "Error reading recording";
+            return 1;
+        }
+
+        /* Stop at end of recording */
+        if (length == 0)
+            break;
+
+        guac_recording_block_header header;
+        if (guac_recording_block_read_header(buffer, length, &header)) {
+
+            /* A partially-written final block simply ends the recording */
+            if (length < sizeof(buffer))
+                break;
+
+            guac_error = GUAC_STATUS_NOT_SUPPORTED;
+            guac_error_message = "Recording does not contain block headers";
+            return 1;
+
+        }
+
+        /* Blocks are in chronological order */
+        if (header.timestamp != GUAC_RECORDING_BLOCK_NO_TIMESTAMP) {
+
+            if (header.timestamp > timestamp)
+                break;
+
+            found_offset = offset;
+            found_instruction = header.first_instruction;
+
+        }
+
+        offset += header.length;
+
+    }
+
+    /* Resume decompression at start of block */
+    if (lseek(data->fd, found_offset, SEEK_SET) == (off_t) -1) {
+        guac_error = GUAC_STATUS_SEE_ERRNO;
+        guac_error_message = "Unable to seek within recording";
+        return 1;
+    }
+
+    inflateReset(&data->inflate_stream);
+    data->input_offset = 0;
+    data->input_length = 0;
+    data->skip = found_instruction;
+
+    return 0;
+#else
+    guac_error = GUAC_STATUS_NOT_SUPPORTED;
+    guac_error_message = "Seeking within recordings requires zlib";
+    return 1;
+#endif
+
+}
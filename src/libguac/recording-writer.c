@@ -0,0 +1,1021 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "guacamole/error.h"
+#include "guacamole/mem.h"
+#include "guacamole/recording.h"
+#include "guacamole/socket.h"
+#include "guacamole/timestamp.h"
+#include "guacamole/unicode.h"
+#include "recording-block.h"
+#include "recording-writer.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef ENABLE_ZLIB
+#include <zlib.h>
+#endif
+
+/**
+ * A single chunk of recording data awaiting a write to disk.
+ */
+typedef struct guac_recording_chunk {
+
+    /**
+     * The next chunk in the queue or free list containing this chunk, or NULL
+     * if this is the last chunk.
+     */
+    struct guac_recording_chunk* next;
+
+    /**
+     * The number of bytes of data currently stored within this chunk.
+     */
+    size_t length;
+
+    /**
+     * The offset within this chunk of the first byte of the first instruction
+     * beginning within this chunk, or GUAC_RECORDING_BLOCK_NO_INSTRUCTION if
+     * no instruction begins within this chunk.
+     */
+    uint32_t first_instruction;
+
+    /**
+     * The data stored within this chunk.
+     */
+    char data[GUAC_RECORDING_CHUNK_SIZE];
+
+} guac_recording_chunk;
+
+/**
+ * Data associated with a guac_socket which writes recording data to a file
+ * descriptor from a dedicated writer thread.
+ */
+typedef struct guac_recording_writer_data {
+
+    /**
+     * The file descriptor to which recording data is written.
+     */
+    int fd;
+
+    /**
+     * The chunk currently receiving data written to the socket, or NULL if no
+     * data has been written since the last chunk was queued. Access to this
+     * chunk is guarded by buffer_lock.
+     */
+    guac_recording_chunk* current;
+
+    /**
+     * The time at which data was first written to the current chunk. Access
+     * to this timestamp is guarded by buffer_lock.
+     */
+    guac_timestamp current_started;
+
+    /**
+     * Whether the instruction currently being written is being discarded due
+     * to the GUAC_RECORDING_OVERFLOW_DROP policy. Access to this flag is
+     * guarded by socket_lock.
+     */
+    bool dropping;
+
+    /**
+     * Whether an instruction has begun but none of its data has yet been
+     * written. Access to this flag is guarded by socket_lock.
+     */
+    bool instruction_started;
+
+    /**
+     * Whether chunks are compressed into the blocks of a compressed recording
+     * before being written.
+     */
+    bool compress;
+
+#ifdef ENABLE_ZLIB
+    /**
+     * The zlib stream used by the writer thread to compress each chunk.
+     */
+    z_stream deflate_stream;
+
+    /**
+     * Buffer used by the writer thread to hold each compressed block.
+     */
+    unsigned char* block;
+
+    /**
+     * The size of the block buffer, in bytes.
+     */
+    size_t block_size;
+#endif
+
+    /**
+     * Lock which is acquired when an instruction is being written, and
+     * released when the instruction is finished being written.
+     */
+    pthread_mutex_t socket_lock;
+
+    /**
+     * Lock which guards the current chunk, guaranteeing atomicity of writes
+     * and flushes.
+     */
+    pthread_mutex_t buffer_lock;
+
+    /**
+     * Lock which guards the queue, free list, limits, statistics, and
+     * stopping flag. This lock is never held while writing to disk.
+     */
+    pthread_mutex_t queue_lock;
+
+    /**
+     * Condition which is signalled when a chunk has been queued or the
+     * writer thread has been asked to stop.
+     */
+    pthread_cond_t chunk_queued;
+
+    /**
+     * Condition which is signalled when the writer thread has written a
+     * chunk, freeing space within the queue.
+     */
+    pthread_cond_t chunk_written;
+
+    /**
+     * The first chunk awaiting a write to disk, or NULL if the queue is
+     * empty.
+     */
+    guac_recording_chunk* queue_head;
+
+    /**
+     * The last chunk awaiting a write to disk, or NULL if the queue is empty.
+     */
+    guac_recording_chunk* queue_tail;
+
+    /**
+     * Chunks which have been written and may be reused.
+     */
+    guac_recording_chunk* free_chunks;
+
+    /**
+     * The number of chunks within the free_chunks list.
+     */
+    int free_chunk_count;
+
+    /**
+     * The maximum number of bytes which may be queued.
+     */
+    size_t max_queued;
+
+    /**
+     * The action to take when data is written while max_queued bytes are
+     * already queued.
+     */
+    guac_recording_overflow_policy policy;
+
+    /**
+     * Statistics describing all data written through this socket thus far.
+     */
+    guac_recording_stats stats;
+
+    /**
+     * Whether the writer thread should write all remaining queued chunks and
+     * then terminate.
+     */
+    bool stopping;
+
+    /**
+     * The thread which writes queued chunks to disk.
+     */
+    pthread_t writer_thread;
+
+} guac_recording_writer_data;
+
+/**
+ * Writes the entire contents of the given buffer to the given file
+ * descriptor, retrying as necessary.
+ *
+ * @param fd
+ *     The file descriptor to write to.
+ *
+ * @param buffer
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes to write.
+ *
+ * @return
+ *     Zero if all data was written, non-zero if an error occurs.
+ */
+static int guac_recording_writer_write(int fd, const void* buffer,
+        size_t length) {
+
+    const char* current = buffer;
+    while (length > 0) {
+
+        ssize_t written = write(fd, current, length);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return 1;
+        }
+
+        current += written;
+        length -= written;
+
+    }
+
+    return 0;
+
+}
+
+#ifdef ENABLE_ZLIB
+/**
+ * Parses the decimal length prefix of the Guacamole protocol element at the
+ * given offset within the given buffer, advancing the offset past the
+ * element's value. The element's terminating character (',' or ';') is not
+ * consumed.
+ *
+ * @param buffer
+ *     The buffer containing Guacamole protocol data.
+ *
+ * @param length
+ *     The number of bytes within the buffer.
+ *
+ * @param offset
+ *     The offset of the element within the buffer. This is updated to the
+ *     offset of the element's terminator if parsing succeeds.
+ *
+ * @param value
+ *     Receives the offset of the first byte of the element's value.
+ *
+ * @return
+ *     Zero if the entire element was parsed, non-zero if the element is
+ *     malformed or extends beyond the end of the buffer.
+ */
+static int guac_recording_writer_skip_element(const char* buffer,
+        size_t length, size_t* offset, size_t* value) {
+
+    size_t i = *offset;
+    size_t element_length = 0;
+
+    /* Parse length prefix */
+    while (i < length && buffer[i] >= '0' && buffer[i] <= '9')
+        element_length = element_length * 10 + (buffer[i++] - '0');
+
+    if (i == *offset || i >= length || buffer[i] != '.')
+        return 1;
+
+    /* Skip value, which is measured in Unicode codepoints */
+    *value = ++i;
+    while (element_length > 0) {
+        if (i >= length)
+            return 1;
+        i += guac_utf8_charsize((unsigned char) buffer[i]);
+        element_length--;
+    }
+
+    if (i >= length)
+        return 1;
+
+    *offset = i;
+    return 0;
+
+}
+
+/**
+ * Returns the timestamp of the first "sync" instruction beginning within
+ * the given chunk.
+ *
+ * @param chunk
+ *     The chunk to search.
+ *
+ * @return
+ *     The timestamp of the first "sync" instruction within the chunk, or
+ *     GUAC_RECORDING_BLOCK_NO_TIMESTAMP if no complete "sync" instruction
+ *     begins within the chunk.
+ */
+static guac_timestamp guac_recording_writer_find_sync(
+        const guac_recording_chunk* chunk) {
+
+    if (chunk->first_instruction == GUAC_RECORDING_BLOCK_NO_INSTRUCTION)
+        return GUAC_RECORDING_BLOCK_NO_TIMESTAMP;
+
+    const char* buffer = chunk->data;
+    size_t length = chunk->length;
+    size_t offset = chunk->first_instruction;
+
+    while (offset < length) {
+
+        /* Parse opcode */
+        size_t opcode;
+        if (guac_recording_writer_skip_element(buffer, length,
+                    &offset, &opcode))
+            break;
+
+        /* Parse timestamp of sync instruction */
+        if (offset - opcode == 4 && memcmp(buffer + opcode, "sync", 4) == 0
+                && buffer[offset] == ',') {
+
+            size_t value;
+            offset++;
+            if (guac_recording_writer_skip_element(buffer, length,
+                        &offset, &value))
+                break;
+
+            guac_timestamp timestamp = 0;
+            while (value < offset && buffer[value] >= '0'
+                    && buffer[value] <= '9')
+                timestamp = timestamp * 10 + (buffer[value++] - '0');
+
+            return timestamp;
+
+        }
+
+        /* Skip remaining arguments */
+        while (buffer[offset] == ',') {
+            size_t value;
+            offset++;
+            if (guac_recording_writer_skip_element(buffer, length,
+                        &offset, &value))
+                return GUAC_RECORDING_BLOCK_NO_TIMESTAMP;
+        }
+
+        /* Advance past terminating semicolon */
+        offset++;
+
+    }
+
+    return GUAC_RECORDING_BLOCK_NO_TIMESTAMP;
+
+}
+
+/**
+ * Compresses the given chunk into a single block of a compressed recording,
+ * storing the result within the block buffer of the given writer. This
+ * function may only be invoked by the writer thread.
+ *
+ * @param data
+ *     The guac_recording_writer_data of the socket.
+ *
+ * @param chunk
+ *     The chunk to compress.
+ *
+ * @return
+ *     The total size of the compressed block, in bytes, or zero if
+ *     compression fails.
+ */
+static size_t guac_recording_writer_compress(guac_recording_writer_data* data,
+        const guac_recording_chunk* chunk) {
+
+    z_stream* stream = &data->deflate_stream;
+    if (deflateReset(stream) != Z_OK)
+        return 0;
+
+    /* Compress entire chunk at once, leaving room for header and trailer */
+    stream->next_in = (Bytef*) chunk->data;
+    stream->avail_in = chunk->length;
+    stream->next_out = data->block + GUAC_RECORDING_BLOCK_HEADER_LENGTH;
+    stream->avail_out = data->block_size - GUAC_RECORDING_BLOCK_HEADER_LENGTH
+        - GUAC_RECORDING_BLOCK_TRAILER_LENGTH;
+
+    if (deflate(stream, Z_FINISH) != Z_STREAM_END)
+        return 0;
+
+    size_t length = GUAC_RECORDING_BLOCK_HEADER_LENGTH + stream->total_out
+        + GUAC_RECORDING_BLOCK_TRAILER_LENGTH;
+
+    /* Describe block within header */
+    guac_recording_block_header header = {
+        .length = length,
+        .first_instruction = chunk->first_instruction,
+        .timestamp = guac_recording_writer_find_sync(chunk)
+    };
+
+    guac_recording_block_write_header(data->block, &header);
+
+    /* Trailer (CRC32 and size of uncompressed data, little-endian) */
+    uLong crc = crc32(0L, (const Bytef*) chunk->data, chunk->length);
+    unsigned char* trailer = data->block + length
+        - GUAC_RECORDING_BLOCK_TRAILER_LENGTH;
+
+    for (int i = 0; i < 4; i++) {
+        trailer[i] = (crc >> (i * 8)) & 0xFF;
+        trailer[i + 4] = (chunk->length >> (i * 8)) & 0xFF;
+    }
+
+    return length;
+
+}
+#endif
+
+/**
+ * Adds the current chunk of the given recording writer socket to the end of
+ * the queue, regardless of the amount of data already queued. The buffer
+ * lock and queue lock of the socket must already be held, and the current
+ * chunk must be non-NULL.
+ *
+ * @param data
+ *     The guac_recording_writer_data of the socket.
+ */
+static void guac_recording_writer_append_current(
+        guac_recording_writer_data* data) {
+
+    guac_recording_chunk* chunk = data->current;
+
+    /* Append chunk to queue */
+    chunk->next = NULL;
+    if (data->queue_tail != NULL)
+        data->queue_tail->next = chunk;
+    else
+        data->queue_head = chunk;
+    data->queue_tail = chunk;
+
+    data->stats.queued_bytes += chunk->length;
+    if (data->stats.queued_bytes > data->stats.peak_queued_bytes)
+        data->stats.peak_queued_bytes = data->stats.queued_bytes;
+
+    pthread_cond_signal(&data->chunk_queued);
+
+    data->current = NULL;
+
+}
+
+/**
+ * Adds the current chunk of the given recording writer socket to the end of
+ * the queue, if any data has been written to that chunk, waiting for space
+ * within the queue if the GUAC_RECORDING_OVERFLOW_BLOCK policy is in effect.
+ * The buffer lock of the socket must already be held. As each chunk of a
+ * compressed recording is compressed independently, partially-filled chunks
+ * of compressed recordings are normally queued only once they have been
+ * partially filled for GUAC_RECORDING_WRITER_FLUSH_INTERVAL milliseconds
+ * (see guac_recording_writer_queue_stale()) or when the socket is being
+ * freed.
+ *
+ * @param data
+ *     The guac_recording_writer_data of the socket.
+ *
+ * @param force
+ *     Whether the current chunk should be queued even if it is a partial
+ *     chunk of a compressed recording.
+ */
+static void guac_recording_writer_queue_current(
+        guac_recording_writer_data* data, bool force) {
+
+    guac_recording_chunk* chunk = data->current;
+    if (chunk == NULL || chunk->length == 0)
+        return;
+
+    /* Avoid splitting compressed recordings into inefficiently small blocks */
+    if (data->compress && !force && chunk->length < sizeof(chunk->data))
+        return;
+
+    pthread_mutex_lock(&data->queue_lock);
+
+    /* Wait for space, unless writing has failed (in which case the queue is
+     * being discarded as quickly as possible anyway) */
+    if (data->policy == GUAC_RECORDING_OVERFLOW_BLOCK) {
+        while (data->stats.queued_bytes > 0
+                && data->stats.queued_bytes + chunk->length > data->max_queued
+                && !data->stats.failed)
+            pthread_cond_wait(&data->chunk_written, &data->queue_lock);
+    }
+
+    guac_recording_writer_append_current(data);
+    pthread_mutex_unlock(&data->queue_lock);
+
+}
+
+/**
+ * Queues the current chunk of the given recording writer socket if data was
+ * first written to that chunk at least GUAC_RECORDING_WRITER_FLUSH_INTERVAL
+ * milliseconds ago, such that a partially-filled block of a compressed
+ * recording is not held in memory indefinitely. This function is invoked
+ * only by the writer thread, and the queue lock must NOT be held.
+ *
+ * @param data
+ *     The guac_recording_writer_data of the socket.
+ */
+static void guac_recording_writer_queue_stale(
+        guac_recording_writer_data* data) {
+
+    /* If the buffer lock is held, data is being written and the current
+     * chunk will be queued by that write or a later flush. Waiting for the
+     * lock here could deadlock with a writer waiting for space within the
+     * queue. */
+    if (pthread_mutex_trylock(&data->buffer_lock))
+        return;
+
+    /* The chunk is queued even if the queue is full, as waiting for space
+     * would mean waiting on this thread */
+    guac_recording_chunk* chunk = data->current;
+    if (chunk != NULL && chunk->length > 0
+            && guac_timestamp_current() - data->current_started
+                >= GUAC_RECORDING_WRITER_FLUSH_INTERVAL) {
+        pthread_mutex_lock(&data->queue_lock);
+        guac_recording_writer_append_current(data);
+        pthread_mutex_unlock(&data->queue_lock);
+    }
+
+    pthread_mutex_unlock(&data->buffer_lock);
+
+}
+
+/**
+ * The body of the writer thread of a recording writer socket, repeatedly
+ * removing chunks from the head of the queue and writing them to disk until
+ * the socket is being freed and no queued chunks remain.
+ *
+ * @param arg
+ *     The guac_recording_writer_data of the socket.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_recording_writer_thread(void* arg) {
+
+    guac_recording_writer_data* data = (guac_recording_writer_data*) arg;
+
+    pthread_mutex_lock(&data->queue_lock);
+
+    for (;;) {
+
+        /* Wait for the next chunk, periodically writing any data which has
+         * been left within a partially-filled chunk for too long */
+        while (data->queue_head == NULL && !data->stopping) {
+
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += GUAC_RECORDING_WRITER_FLUSH_INTERVAL / 1000;
+            deadline.tv_nsec +=
+                (GUAC_RECORDING_WRITER_FLUSH_INTERVAL % 1000) * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+
+            if (pthread_cond_timedwait(&data->chunk_queued, &data->queue_lock,
+                        &deadline) == ETIMEDOUT) {
+                pthread_mutex_unlock(&data->queue_lock);
+                guac_recording_writer_queue_stale(data);
+                pthread_mutex_lock(&data->queue_lock);
+            }
+
+        }
+
+        /* Stop only once all queued chunks are written */
+        guac_recording_chunk* chunk = data->queue_head;
+        if (chunk == NULL)
+            break;
+
+        /* Write chunk without holding the queue lock, such that writes to the
+         * socket are never blocked by disk I/O. The chunk remains at the head
+         * of the queue until written, as its length is included within the
+         * number of queued bytes. */
+        bool failed = data->stats.failed;
+        pthread_mutex_unlock(&data->queue_lock);
+
+        size_t written = 0;
+        if (!failed) {
+
+#ifdef ENABLE_ZLIB
+            if (data->compress) {
+                size_t length = guac_recording_writer_compress(data, chunk);
+                if (length == 0
+                        || guac_recording_writer_write(data->fd,
+                            data->block, length))
+                    failed = true;
+                else
+                    written = length;
+            }
+            else
+#endif
+            if (guac_recording_writer_write(data->fd, chunk->data,
+                        chunk->length))
+                failed = true;
+            else
+                written = chunk->length;
+
+        }
+
+        pthread_mutex_lock(&data->queue_lock);
+
+        /* Update statistics */
+        if (failed) {
+            data->stats.failed = 1;
+            data->stats.dropped_bytes += chunk->length;
+        }
+        data->stats.written_bytes += written;
+        data->stats.queued_bytes -= chunk->length;
+
+        /* Remove chunk from queue */
+        data->queue_head = chunk->next;
+        if (data->queue_head == NULL)
+            data->queue_tail = NULL;
+
+        /* Retain chunk for reuse if possible */
+        if (data->free_chunk_count < GUAC_RECORDING_WRITER_MAX_FREE_CHUNKS) {
+            chunk->next = data->free_chunks;
+            data->free_chunks = chunk;
+            data->free_chunk_count++;
+        }
+        else
+            guac_mem_free(chunk);
+
+        pthread_cond_broadcast(&data->chunk_written);
+
+    }
+
+    pthread_mutex_unlock(&data->queue_lock);
+    return NULL;
+
+}
+
+/**
+ * Returns a chunk which can receive data written to the given recording
+ * writer socket, reusing a previously-written chunk if possible. The buffer
+ * lock of the socket must already be held.
+ *
+ * @param data
+ *     The guac_recording_writer_data of the socket.
+ *
+ * @return
+ *     An empty chunk.
+ */
+static guac_recording_chunk* guac_recording_writer_next_chunk(
+        guac_recording_writer_data* data) {
+
+    guac_recording_chunk* chunk = NULL;
+
+    pthread_mutex_lock(&data->queue_lock);
+    if (data->free_chunks != NULL) {
+        chunk = data->free_chunks;
+        data->free_chunks = chunk->next;
+        data->free_chunk_count--;
+    }
+    pthread_mutex_unlock(&data->queue_lock);
+
+    if (chunk == NULL)
+        chunk = guac_mem_alloc(sizeof(guac_recording_chunk));
+
+    if (chunk != NULL) {
+        chunk->next = NULL;
+        chunk->length = 0;
+        chunk->first_instruction = GUAC_RECORDING_BLOCK_NO_INSTRUCTION;
+    }
+
+    return chunk;
+
+}
+
+/**
+ * Copies the given data into the current chunk of the given socket, queueing
+ * that chunk for writing each time it is filled.
+ *
+ * @param socket
+ *     The recording writer socket being written to.
+ *
+ * @param buf
+ *     The data to write.
+ *
+ * @param count
+ *     The number of bytes to write.
+ *
+ * @return
+ *     The number of bytes written, or -1 if an error occurs.
+ */
+static ssize_t guac_recording_writer_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_recording_writer_data* data =
+        (guac_recording_writer_data*) socket->data;
+
+    /* Discard entirety of any instruction started while the queue was full */
+    if (data->dropping) {
+        pthread_mutex_lock(&data->queue_lock);
+        data->stats.dropped_bytes += count;
+        pthread_mutex_unlock(&data->queue_lock);
+        return count;
+    }
+
+    const char* current = buf;
+    size_t remaining = count;
+
+    pthread_mutex_lock(&data->buffer_lock);
+
+    while (remaining > 0) {
+
+        /* Obtain new chunk if necessary */
+        if (data->current == NULL) {
+            data->current = guac_recording_writer_next_chunk(data);
+            if (data->current == NULL) {
+                pthread_mutex_unlock(&data->buffer_lock);
+                return -1;
+            }
+            data->current_started = guac_timestamp_current();
+        }
+
+        guac_recording_chunk* chunk = data->current;
+
+        /* Note where the first instruction within the chunk begins */
+        if (data->instruction_started) {
+            if (chunk->first_instruction == GUAC_RECORDING_BLOCK_NO_INSTRUCTION)
+                chunk->first_instruction = chunk->length;
+            data->instruction_started = false;
+        }
+
+        /* Copy as much as fits into the current chunk */
+        size_t chunk_size = sizeof(chunk->data) - chunk->length;
+        if (chunk_size > remaining)
+            chunk_size = remaining;
+
+        memcpy(chunk->data + chunk->length, current, chunk_size);
+        chunk->length += chunk_size;
+
+        current += chunk_size;
+        remaining -= chunk_size;
+
+        /* Hand off chunk once full */
+        if (chunk->length == sizeof(chunk->data))
+            guac_recording_writer_queue_current(data, false);
+
+    }
+
+    pthread_mutex_unlock(&data->buffer_lock);
+    return count;
+
+}
+
+/**
+ * Hands any partially-filled chunk of the given socket to the writer thread.
+ * This does not wait for the chunk to actually be written.
+ *
+ * @param socket
+ *     The recording writer socket to flush.
+ *
+ * @return
+ *     Always zero.
+ */
+static ssize_t guac_recording_writer_flush_handler(guac_socket* socket) {
+
+    guac_recording_writer_data* data =
+        (guac_recording_writer_data*) socket->data;
+
+    pthread_mutex_lock(&data->buffer_lock);
+    guac_recording_writer_queue_current(data, false);
+    pthread_mutex_unlock(&data->buffer_lock);
+
+    return 0;
+
+}
+
+/**
+ * Acquires exclusive access to the given socket for the duration of an
+ * instruction. If the GUAC_RECORDING_OVERFLOW_DROP policy is in effect and
+ * the queue is currently full, the instruction will be discarded.
+ *
+ * @param socket
+ *     The recording writer socket to lock.
+ */
+static void guac_recording_writer_lock_handler(guac_socket* socket) {
+
+    guac_recording_writer_data* data =
+        (guac_recording_writer_data*) socket->data;
+
+    pthread_mutex_lock(&data->socket_lock);
+
+    pthread_mutex_lock(&data->queue_lock);
+    data->dropping = data->policy == GUAC_RECORDING_OVERFLOW_DROP
+        && data->stats.queued_bytes >= data->max_queued;
+    pthread_mutex_unlock(&data->queue_lock);
+
+    data->instruction_started = !data->dropping;
+
+}
+
+/**
+ * Relinquishes exclusive access to the given socket at the end of an
+ * instruction.
+ *
+ * @param socket
+ *     The recording writer socket to unlock.
+ */
+static void guac_recording_writer_unlock_handler(guac_socket* socket) {
+
+    guac_recording_writer_data* data =
+        (guac_recording_writer_data*) socket->data;
+
+    if (data->dropping) {
+        pthread_mutex_lock(&data->queue_lock);
+        data->stats.dropped_instructions++;
+        pthread_mutex_unlock(&data->queue_lock);
+        data->dropping = false;
+    }
+
+    data->instruction_started = false;
+
+    pthread_mutex_unlock(&data->socket_lock);
+
+}
+
+/**
+ * Waits for all queued data to be written, stops the writer thread, and
+ * frees all implementation-specific data associated with the given socket,
+ * but not the socket object itself. The underlying file descriptor is
+ * closed.
+ *
+ * @param socket
+ *     The recording writer socket to free.
+ *
+ * @return
+ *     Always zero.
+ */
+static int guac_recording_writer_free_handler(guac_socket* socket) {
+
+    guac_recording_writer_data* data =
+        (guac_recording_writer_data*) socket->data;
+
+    /* Queue any remaining data (guac_socket_free() will already have flushed
+     * the socket, but the current chunk may still be allocated) */
+    pthread_mutex_lock(&data->buffer_lock);
+    guac_recording_writer_queue_current(data, true);
+    guac_mem_free(data->current);
+    pthread_mutex_unlock(&data->buffer_lock);
+
+    /* Wait for writer thread to write everything */
+    pthread_mutex_lock(&data->queue_lock);
+    data->stopping = true;
+    pthread_cond_signal(&data->chunk_queued);
+    pthread_mutex_unlock(&data->queue_lock);
+
+    pthread_join(data->writer_thread, NULL);
+
+    /* Free all unused chunks */
+    guac_recording_chunk* chunk = data->free_chunks;
+    while (chunk != NULL) {
+        guac_recording_chunk* next = chunk->next;
+        guac_mem_free(chunk);
+        chunk = next;
+    }
+
+#ifdef ENABLE_ZLIB
+    if (data->compress) {
+        deflateEnd(&data->deflate_stream);
+        guac_mem_free(data->block);
+    }
+#endif
+
+    pthread_cond_destroy(&data->chunk_written);
+    pthread_cond_destroy(&data->chunk_queued);
+    pthread_mutex_destroy(&data->queue_lock);
+    pthread_mutex_destroy(&data->buffer_lock);
+    pthread_mutex_destroy(&data->socket_lock);
+
+    close(data->fd);
+
+    guac_mem_free(data);
+    return 0;
+
+}
+
+guac_socket* guac_recording_writer_open(int fd, int compress) {
+
+    /* Allocate socket and associated data */
+    guac_socket* socket = guac_socket_alloc();
+    if (socket == NULL)
+        return NULL;
+
+    guac_recording_writer_data* data =
+        guac_mem_zalloc(sizeof(guac_recording_writer_data));
+
+    data->fd = fd;
+    data->max_queued = GUAC_RECORDING_DEFAULT_MAX_QUEUED;
+    data->policy = GUAC_RECORDING_OVERFLOW_BLOCK;
+    socket->data = data;
+
+#ifdef ENABLE_ZLIB
+    if (compress) {
+
+        z_stream* stream = &data->deflate_stream;
+
+        /* Each block is a raw deflate stream wrapped manually in a gzip
+         * member header and trailer */
+        if (deflateInit2(stream, GUAC_RECORDING_COMPRESSION_LEVEL, Z_DEFLATED,
+                    -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            guac_error = GUAC_STATUS_NO_MEMORY;
+            guac_error_message = "Unable to initialize recording compression";
+            guac_mem_free(data);
+            socket->data = NULL;
+            guac_socket_free(socket);
+            return NULL;
+        }
+
+        data->block_size = GUAC_RECORDING_BLOCK_HEADER_LENGTH
+            + deflateBound(stream, GUAC_RECORDING_CHUNK_SIZE)
+            + GUAC_RECORDING_BLOCK_TRAILER_LENGTH;
+        data->block = guac_mem_alloc(data->block_size);
+        data->compress = true;
+
+    }
+#else
+    /* Compression is not available without zlib */
+    if (compress) {
+        guac_error = GUAC_STATUS_NOT_SUPPORTED;
+        guac_error_message = "Recording compression requires zlib";
+        guac_mem_free(data);
+        socket->data = NULL;
+        guac_socket_free(socket);
+        return NULL;
+    }
+#endif
+
+    pthread_mutex_init(&data->socket_lock, NULL);
+    pthread_mutex_init(&data->buffer_lock, NULL);
+    pthread_mutex_init(&data->queue_lock, NULL);
+    pthread_cond_init(&data->chunk_queued, NULL);
+    pthread_cond_init(&data->chunk_written, NULL);
+
+    /* Start writer thread */
+    if (pthread_create(&data->writer_thread, NULL,
+                guac_recording_writer_thread, data)) {
+
+        guac_error = GUAC_STATUS_SEE_ERRNO;
+        guac_error_message = "Unable to start recording writer thread";
+
+        pthread_cond_destroy(&data->chunk_written);
+        pthread_cond_destroy(&data->chunk_queued);
+        pthread_mutex_destroy(&data->queue_lock);
+        pthread_mutex_destroy(&data->buffer_lock);
+        pthread_mutex_destroy(&data->socket_lock);
+#ifdef ENABLE_ZLIB
+        if (data->compress) {
+            deflateEnd(&data->deflate_stream);
+            guac_mem_free(data->block);
+        }
+#endif
+        guac_mem_free(data);
+
+        socket->data = NULL;
+        guac_socket_free(socket);
+        return NULL;
+
+    }
+
+    /* Set handlers */
+    socket->write_handler  = guac_recording_writer_write_handler;
+    socket->lock_handler   = guac_recording_writer_lock_handler;
+    socket->unlock_handler = guac_recording_writer_unlock_handler;
+    socket->flush_handler  = guac_recording_writer_flush_handler;
+    socket->free_handler   = guac_recording_writer_free_handler;
+
+    return socket;
+
+}
+
+void guac_recording_writer_set_overflow_policy(guac_socket* socket,
+        size_t max_queued, guac_recording_overflow_policy policy) {
+
+    guac_recording_writer_data* data =
+        (guac_recording_writer_data*) socket->data;
+
+    pthread_mutex_lock(&data->queue_lock);
+    data->max_queued = max_queued;
+    data->policy = policy;
+
+    /* Writers blocked under the previous limit may now be able to continue */
+    pthread_cond_broadcast(&data->chunk_written);
+    pthread_mutex_unlock(&data->queue_lock);
+
+}
+
+void guac_recording_writer_get_stats(guac_socket* socket,
+        guac_recording_stats* stats) {
+
+    guac_recording_writer_data* data =
+        (guac_recording_writer_data*) socket->data;
+
+    pthread_mutex_lock(&data->queue_lock);
+    *stats = data->stats;
+    pthread_mutex_unlock(&data->queue_lock);
+
+}
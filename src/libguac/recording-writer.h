@@ -0,0 +1,111 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_RECORDING_WRITER_H
+#define GUAC_RECORDING_WRITER_H
+
+#include "guacamole/recording.h"
+#include "guacamole/socket.h"
+
+#include <stddef.h>
+
+/**
+ * The maximum number of unused chunks to retain for reuse by a recording
+ * writer. Chunks beyond this number are freed once written.
+ */
+#define GUAC_RECORDING_WRITER_MAX_FREE_CHUNKS 8
+
+/**
+ * The zlib compression level to use for compressed recordings. Recordings
+ * are compressed as they are written, so a moderate level is used to keep
+ * pace with busy sessions.
+ */
+#define GUAC_RECORDING_COMPRESSION_LEVEL 6
+
+/**
+ * The maximum amount of time that data may remain within a partially-filled
+ * chunk before being handed to the writer thread, in milliseconds. This
+ * bounds the amount of a compressed recording which may be lost if the
+ * process terminates abnormally, as partially-filled chunks of compressed
+ * recordings are otherwise not written until filled.
+ */
+#define GUAC_RECORDING_WRITER_FLUSH_INTERVAL 5000
+
+/**
+ * Allocates a new guac_socket which queues all data written to it in chunks
+ * of GUAC_RECORDING_CHUNK_SIZE bytes, writing those chunks to the given file
+ * descriptor from a dedicated thread. Flushing the returned socket hands any
+ * partially-filled chunk to that thread but does not wait for the write to
+ * complete. Freeing the returned socket waits for all queued data to be
+ * written and closes the file descriptor.
+ *
+ * If compression is requested, each chunk is compressed independently into
+ * a single block of a compressed, seekable recording. Flushing then does not
+ * hand partially-filled chunks to the writer thread, as doing so would
+ * produce inefficiently small blocks. Such chunks are instead written once
+ * they have been partially filled for GUAC_RECORDING_WRITER_FLUSH_INTERVAL
+ * milliseconds.
+ *
+ * @param fd
+ *     The file descriptor to which recording data should be written.
+ *
+ * @param compress
+ *     Non-zero if the data written should be compressed, zero otherwise.
+ *
+ * @return
+ *     A newly-allocated guac_socket which writes to the given file
+ *     descriptor from a dedicated thread, or NULL if the socket or its
+ *     thread cannot be created, or if compression was requested but is not
+ *     supported by this build of libguac.
+ */
+guac_socket* guac_recording_writer_open(int fd, int compress);
+
+/**
+ * Sets the maximum amount of data which may be queued by the given recording
+ * writer socket, and the action to take if further data is written while
+ * that limit is reached.
+ *
+ * @param socket
+ *     A guac_socket returned by guac_recording_writer_open().
+ *
+ * @param max_queued
+ *     The maximum number of bytes which may be queued for writing.
+ *
+ * @param policy
+ *     The action to take when data is written while max_queued bytes are
+ *     already queued.
+ */
+void guac_recording_writer_set_overflow_policy(guac_socket* socket,
+        size_t max_queued, guac_recording_overflow_policy policy);
+
+/**
+ * Retrieves statistics describing the data written through the given
+ * recording writer socket.
+ *
+ * @param socket
+ *     A guac_socket returned by guac_recording_writer_open().
+ *
+ * @param stats
+ *     The guac_recording_stats structure to populate.
+ */
+void guac_recording_writer_get_stats(guac_socket* socket,
+        guac_recording_stats* stats);
+
+#endif
+
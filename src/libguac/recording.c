@@ -19,10 +19,12 @@
 
 #include "guacamole/mem.h"
 #include "guacamole/client.h"
+#include "guacamole/error.h"
 #include "guacamole/protocol.h"
 #include "guacamole/recording.h"
 #include "guacamole/socket.h"
 #include "guacamole/timestamp.h"
+#include "recording-writer.h"
 
 #ifdef __MINGW32__
 #include <direct.h>
@@ -32,6 +34,7 @@
 #include <sys/types.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -138,7 +141,7 @@ static int guac_recording_open(const char* path,
 guac_recording* guac_recording_create(guac_client* client,
         const char* path, const char* name, int create_path,
         int include_output, int include_mouse, int include_touch,
-        int include_keys) {
+        int include_keys, int compress) {
 
     char filename[GUAC_COMMON_RECORDING_MAX_NAME_LENGTH];
 
@@ -162,13 +165,34 @@ guac_recording* guac_recording_create(guac_client* client,
         return NULL;
     }
 
+#ifndef ENABLE_ZLIB
+    /* Fall back to an uncompressed recording if compression is unavailable */
+    if (compress) {
+        guac_client_log(client, GUAC_LOG_WARNING, "Session recording will "
+                "not be compressed, as this build of libguac lacks support "
+                "for compression.");
+        compress = 0;
+    }
+#endif
+
+    /* Write recording from a dedicated thread such that disk I/O does not
+     * block the client socket */
+    guac_socket* socket = guac_recording_writer_open(fd, compress);
+    if (socket == NULL) {
+        guac_client_log(client, GUAC_LOG_ERROR,
+                "Creation of recording failed: %s", guac_error_message);
+        close(fd);
+        return NULL;
+    }
+
     /* Create recording structure with reference to underlying socket */
     guac_recording* recording = guac_mem_alloc(sizeof(guac_recording));
-    recording->socket = guac_socket_open(fd);
+    recording->socket = socket;
     recording->include_output = include_output;
     recording->include_mouse = include_mouse;
     recording->include_touch = include_touch;
     recording->include_keys = include_keys;
+    recording->client = client;
 
     /* Replace client socket with wrapped recording socket only if including
      * output within the recording */
@@ -186,6 +210,31 @@ guac_recording* guac_recording_create(guac_client* client,
 
 void guac_recording_free(guac_recording* recording) {
 
+    guac_client* client = recording->client;
+
+    /* Hand any partially-written data to the writer thread before reporting
+     * statistics */
+    guac_socket_flush(recording->socket);
+
+    guac_recording_stats stats;
+    guac_recording_get_stats(recording, &stats);
+
+    guac_client_log(client, GUAC_LOG_INFO, "Session recording: %" PRIu64
+            " bytes written, %zu bytes still queued, at most %zu bytes "
+            "queued at once.", stats.written_bytes, stats.queued_bytes,
+            stats.peak_queued_bytes);
+
+    if (stats.dropped_instructions > 0)
+        guac_client_log(client, GUAC_LOG_WARNING, "%" PRIu64 " instructions "
+                "(%" PRIu64 " bytes) were dropped from the session recording "
+                "because the recording could not be written quickly enough.",
+                stats.dropped_instructions, stats.dropped_bytes);
+
+    if (stats.failed)
+        guac_client_log(client, GUAC_LOG_ERROR, "Session recording is "
+                "incomplete, as writing to disk failed. %" PRIu64 " bytes "
+                "were discarded.", stats.dropped_bytes);
+
     /* If not including broadcast output, the output socket is not associated
      * with the client, and must be freed manually */
     if (!recording->include_output)
@@ -196,6 +245,17 @@ void guac_recording_free(guac_recording* recording) {
 
 }
 
+void guac_recording_set_overflow_policy(guac_recording* recording,
+        size_t max_queued, guac_recording_overflow_policy policy) {
+    guac_recording_writer_set_overflow_policy(recording->socket,
+            max_queued, policy);
+}
+
+void guac_recording_get_stats(guac_recording* recording,
+        guac_recording_stats* stats) {
+    guac_recording_writer_get_stats(recording->socket, stats);
+}
+
 void guac_recording_report_mouse(guac_recording* recording,
         int x, int y, int button_mask) {
 
@@ -36,6 +36,11 @@
 #include <winsock2.h>
 #endif
 
+#ifdef HAVE_SIOCOUTQNSD
+#include <linux/sockios.h>
+#include <sys/ioctl.h>
+#endif
+
 /**
  * Data associated with an open socket which writes to a file descriptor.
  */
@@ -418,6 +423,41 @@ static void guac_socket_fd_unlock_handler(guac_socket* socket) {
 
 }
 
+/**
+ * Returns the number of bytes written to the given socket which have not yet
+ * been sent, including both data within the main write buffer and, if
+ * supported by the operating system, data queued within the kernel which has
+ * not yet been transmitted. Data which has been transmitted but not yet
+ * acknowledged is not included, as the time taken to deliver that data is
+ * already reflected by the round trip of each frame.
+ *
+ * @param socket
+ *     The guac_socket to query.
+ *
+ * @return
+ *     The number of bytes written to the given socket which have not yet been
+ *     delivered, or a negative value if this cannot be determined.
+ */
+static ssize_t guac_socket_fd_backlog_handler(guac_socket* socket) {
+
+#ifdef HAVE_SIOCOUTQNSD
+    guac_socket_fd_data* data = (guac_socket_fd_data*) socket->data;
+
+    /* Determine amount of data queued within the kernel and not yet sent */
+    int queued;
+    if (ioctl(data->fd, SIOCOUTQNSD, &queued))
+        return -1;
+
+    /* The buffer is read without locking, as a write in progress may block
+     * for as long as the connection is congested, and an approximate value
+     * is sufficient */
+    return data->written + queued;
+#else
+    return -1;
+#endif
+
+}
+
 guac_socket* guac_socket_open(int fd) {
 
     pthread_mutexattr_t lock_attributes;
@@ -446,6 +486,7 @@ guac_socket* guac_socket_open(int fd) {
     socket->unlock_handler = guac_socket_fd_unlock_handler;
     socket->flush_handler  = guac_socket_fd_flush_handler;
     socket->free_handler   = guac_socket_fd_free_handler;
+    socket->backlog_handler = guac_socket_fd_backlog_handler;
 
     return socket;
 
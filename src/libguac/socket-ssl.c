@@ -30,6 +30,11 @@
 
 #include <openssl/ssl.h>
 
+#ifdef HAVE_SIOCOUTQNSD
+#include <linux/sockios.h>
+#include <sys/ioctl.h>
+#endif
+
 static ssize_t __guac_socket_ssl_read_handler(guac_socket* socket,
         void* buf, size_t count) {
 
@@ -104,6 +109,36 @@ static int __guac_socket_ssl_free_handler(guac_socket* socket) {
     return 0;
 }
 
+/**
+ * Returns the number of bytes of encrypted data written to the given socket
+ * which have not yet been sent. As data is written directly via SSL_write()
+ * without further buffering, this is only the data queued within the kernel
+ * which has not yet been transmitted. Data which has been transmitted but not
+ * yet acknowledged is not included.
+ *
+ * @param socket
+ *      The guac_socket to query.
+ *
+ * @return
+ *      The number of bytes written to the given socket which have not yet
+ *      been delivered, or a negative value if this cannot be determined.
+ */
+static ssize_t __guac_socket_ssl_backlog_handler(guac_socket* socket) {
+
+#ifdef HAVE_SIOCOUTQNSD
+    guac_socket_ssl_data* data = (guac_socket_ssl_data*) socket->data;
+
+    int queued;
+    if (ioctl(data->fd, SIOCOUTQNSD, &queued))
+        return -1;
+
+    return queued;
+#else
+    return -1;
+#endif
+
+}
+
 /**
  * Acquires exclusive access to the given socket.
  *
@@ -178,6 +213,7 @@ guac_socket* guac_socket_open_secure(SSL_CTX* context, int fd) {
     socket->free_handler   = __guac_socket_ssl_free_handler;
     socket->lock_handler   = __guac_socket_ssl_lock_handler;
     socket->unlock_handler = __guac_socket_ssl_unlock_handler;
+    socket->backlog_handler = __guac_socket_ssl_backlog_handler;
 
     return socket;
 
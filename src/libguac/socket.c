@@ -87,10 +87,18 @@ static ssize_t __guac_socket_write(guac_socket* socket,
     socket->last_write_timestamp = guac_timestamp_current();
 
     /* If handler defined, call it. */
-    if (socket->write_handler)
-        return socket->write_handler(socket, buf, count);
+    if (socket->write_handler) {
+
+        ssize_t written = socket->write_handler(socket, buf, count);
+        if (written > 0)
+            socket->bytes_written += written;
+
+        return written;
+
+    }
 
     /* Otherwise, pretend everything was written. */
+    socket->bytes_written += count;
     return count;
 
 }
@@ -155,6 +163,7 @@ guac_socket* guac_socket_alloc() {
     socket->data = NULL;
     socket->state = GUAC_SOCKET_OPEN;
     socket->last_write_timestamp = guac_timestamp_current();
+    socket->bytes_written = 0;
 
     /* No keep alive ping by default */
     socket->__keep_alive_enabled = 0;
@@ -167,6 +176,7 @@ guac_socket* guac_socket_alloc() {
     socket->flush_handler  = NULL;
     socket->lock_handler   = NULL;
     socket->unlock_handler = NULL;
+    socket->backlog_handler = NULL;
 
     return socket;
 
@@ -389,3 +399,14 @@ ssize_t guac_socket_flush(guac_socket* socket) {
     return 0;
 
 }
+
+ssize_t guac_socket_get_backlog(guac_socket* socket) {
+
+    /* If handler defined, call it. */
+    if (socket->backlog_handler)
+        return socket->backlog_handler(socket);
+
+    /* Otherwise, the backlog is unknown */
+    return -1;
+
+}
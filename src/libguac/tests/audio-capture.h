@@ -0,0 +1,161 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef GUAC_LIBGUAC_TESTS_AUDIO_CAPTURE_H
+#define GUAC_LIBGUAC_TESTS_AUDIO_CAPTURE_H
+
+#include <CUnit/CUnit.h>
+#include <guacamole/audio.h>
+#include <guacamole/client.h>
+#include <guacamole/parser.h>
+#include <guacamole/protocol.h>
+#include <guacamole/socket.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Handler which is invoked for each blob of audio data produced by an audio
+ * encoder.
+ *
+ * @param data
+ *     The decoded contents of the blob.
+ *
+ * @param length
+ *     The number of bytes within the blob.
+ *
+ * @param arg
+ *     The arbitrary value provided to audio_capture_encode().
+ */
+typedef void audio_capture_blob_handler(const unsigned char* data,
+        int length, void* arg);
+
+/**
+ * Encodes the given 16-bit PCM using the given audio encoder, invoking the
+ * given handler for each blob of encoded data sent by the encoder. The PCM is
+ * written in pieces of the given size, such that the handling of samples
+ * split across writes can be verified, and the encoder is flushed once all
+ * PCM has been written.
+ *
+ * @param encoder
+ *     The audio encoder to test.
+ *
+ * @param rate
+ *     The sample rate of the PCM, in Hz.
+ *
+ * @param channels
+ *     The number of channels of the PCM.
+ *
+ * @param pcm
+ *     The 16-bit signed, little-endian PCM to encode.
+ *
+ * @param length
+ *     The number of bytes of PCM.
+ *
+ * @param write_size
+ *     The number of bytes of PCM to provide to each call to the write
+ *     handler of the encoder.
+ *
+ * @param handler
+ *     The handler to invoke for each blob of encoded data.
+ *
+ * @param arg
+ *     An arbitrary value to pass to the handler.
+ */
+static inline void audio_capture_encode(guac_audio_encoder* encoder,
+        int rate, int channels, const unsigned char* pcm, int length,
+        int write_size, audio_capture_blob_handler* handler, void* arg) {
+
+    FILE* output = tmpfile();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(output);
+
+    guac_client* client = guac_client_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+
+    /* Redirect all data broadcast by the encoder to the temporary file */
+    guac_socket* broadcast = client->socket;
+    client->socket = guac_socket_open(dup(fileno(output)));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client->socket);
+
+    guac_audio_stream audio = {
+        .encoder  = encoder,
+        .client   = client,
+        .stream   = guac_client_alloc_stream(client),
+        .rate     = rate,
+        .channels = channels,
+        .bps      = 16
+    };
+
+    encoder->begin_handler(&audio);
+
+    for (int offset = 0; offset < length; offset += write_size) {
+        int size = length - offset;
+        if (size > write_size)
+            size = write_size;
+        encoder->write_handler(&audio, pcm + offset, size);
+    }
+
+    encoder->flush_handler(&audio);
+    encoder->end_handler(&audio);
+
+    guac_client_free_stream(client, audio.stream);
+    guac_socket_free(client->socket);
+    client->socket = broadcast;
+    guac_client_free(client);
+
+    /* Read back all blobs */
+    CU_ASSERT_EQUAL_FATAL(fseek(output, 0, SEEK_SET), 0);
+    guac_socket* socket = guac_socket_open(dup(fileno(output)));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(socket);
+
+    guac_parser* parser = guac_parser_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(parser);
+
+    while (guac_parser_read(parser, socket, -1) == 0) {
+        if (strcmp(parser->opcode, "blob") == 0 && parser->argc == 2) {
+            int size = guac_protocol_decode_base64(parser->argv[1]);
+            handler((const unsigned char*) parser->argv[1], size, arg);
+        }
+    }
+
+    guac_parser_free(parser);
+    guac_socket_free(socket);
+    fclose(output);
+
+}
+
+/**
+ * Stores the given sample within the given buffer as 16-bit signed,
+ * little-endian PCM.
+ *
+ * @param pcm
+ *     The buffer to store the sample within.
+ *
+ * @param sample
+ *     The sample to store.
+ */
+static inline void audio_capture_write_sample(unsigned char* pcm,
+        int sample) {
+    pcm[0] = sample & 0xFF;
+    pcm[1] = (sample >> 8) & 0xFF;
+}
+
+#endif
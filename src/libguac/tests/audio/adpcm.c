@@ -0,0 +1,345 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "adpcm_encoder.h"
+#include "audio-capture.h"
+
+#include <CUnit/CUnit.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The number of frames of PCM used for round-trip tests. This is large
+ * enough to span several blocks, and deliberately leaves a partial block to
+ * be sent when the encoder is flushed.
+ */
+#define TEST_FRAMES 10000
+
+/**
+ * The sample rate of the PCM used for round-trip tests, in Hz.
+ */
+#define TEST_RATE 8000
+
+/**
+ * The peak amplitude of the sine wave used for round-trip tests.
+ */
+#define TEST_AMPLITUDE 12000
+
+/**
+ * The IMA ADPCM step size table.
+ */
+static const int test_adpcm_steps[89] = {
+        7,     8,     9,    10,    11,    12,    13,    14,    16,    17,
+       19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+       50,    55,    60,    66,    73,    80,    88,    97,   107,   118,
+      130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+      337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+      876,   963,  1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+     2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+     5894,  6484,  7132,  7845,  8630,  9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+/**
+ * The IMA ADPCM step index adjustment for each 4-bit code.
+ */
+static const int test_adpcm_index_adjust[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+/**
+ * The PCM decoded from all blocks received thus far, along with the decoder
+ * state needed to verify the continuity of consecutive blocks.
+ */
+typedef struct test_adpcm_output {
+
+    /**
+     * The number of channels of the encoded audio.
+     */
+    int channels;
+
+    /**
+     * Decoded samples, interleaved by channel.
+     */
+    int samples[TEST_FRAMES * 2];
+
+    /**
+     * The number of frames decoded thus far.
+     */
+    int frames;
+
+    /**
+     * The number of blocks decoded thus far.
+     */
+    int blocks;
+
+    /**
+     * The step index of each channel at the end of the previous block.
+     */
+    int step_index[2];
+
+    /**
+     * The raw contents of the most recently received block.
+     */
+    unsigned char block[GUAC_ADPCM_ENCODER_BLOCK_SIZE * 2];
+
+    /**
+     * The size of the most recently received block, in bytes.
+     */
+    int block_length;
+
+} test_adpcm_output;
+
+/**
+ * Decodes a single 4-bit IMA ADPCM code, as done by the reference decoder.
+ *
+ * @param code
+ *     The code to decode.
+ *
+ * @param predictor
+ *     The current predicted value, which will be updated.
+ *
+ * @param step_index
+ *     The current step index, which will be updated.
+ *
+ * @return
+ *     The decoded sample.
+ */
+static int test_adpcm_decode_sample(int code, int* predictor,
+        int* step_index) {
+
+    int step = test_adpcm_steps[*step_index];
+
+    int delta = step >> 3;
+    if (code & 4) delta += step;
+    if (code & 2) delta += step >> 1;
+    if (code & 1) delta += step >> 2;
+
+    int value = *predictor + ((code & 8) ? -delta : delta);
+    if (value > 32767)
+        value = 32767;
+    else if (value < -32768)
+        value = -32768;
+
+    *predictor = value;
+
+    *step_index += test_adpcm_index_adjust[code];
+    if (*step_index < 0)
+        *step_index = 0;
+    else if (*step_index > 88)
+        *step_index = 88;
+
+    return value;
+
+}
+
+/**
+ * Decodes each IMA ADPCM block into the test_adpcm_output provided as the
+ * arbitrary argument, verifying that each block carries forward the step
+ * index of the previous block.
+ */
+static void test_adpcm_blob_handler(const unsigned char* data, int length,
+        void* arg) {
+
+    test_adpcm_output* output = (test_adpcm_output*) arg;
+    int channels = output->channels;
+
+    /* Each block is a four-byte header per channel followed by groups of
+     * four bytes (eight samples) per channel */
+    CU_ASSERT_FATAL(length >= channels * 4);
+    CU_ASSERT_EQUAL_FATAL(length % (channels * 4), 0);
+
+    CU_ASSERT_FATAL(length <= (int) sizeof(output->block));
+    memcpy(output->block, data, length);
+    output->block_length = length;
+
+    int groups = length / (channels * 4) - 1;
+    int frames = 1 + groups * 8;
+    CU_ASSERT_FATAL(output->frames + frames <= TEST_FRAMES);
+
+    for (int channel = 0; channel < channels; channel++) {
+
+        const unsigned char* header = data + channel * 4;
+        int predictor = (int16_t) (header[0] | (header[1] << 8));
+        int step_index = header[2];
+
+        CU_ASSERT(step_index <= 88);
+        CU_ASSERT_EQUAL(header[3], 0);
+
+        if (output->blocks > 0)
+            CU_ASSERT_EQUAL(step_index, output->step_index[channel]);
+
+        int* current = output->samples + output->frames * channels + channel;
+        *current = predictor;
+        current += channels;
+
+        for (int group = 0; group < groups; group++) {
+
+            const unsigned char* codes = data + (channels + group * channels
+                    + channel) * 4;
+
+            /* The earlier sample of each pair is in the low nibble */
+            for (int i = 0; i < 4; i++) {
+                *current = test_adpcm_decode_sample(codes[i] & 0x0F,
+                        &predictor, &step_index);
+                current += channels;
+                *current = test_adpcm_decode_sample(codes[i] >> 4,
+                        &predictor, &step_index);
+                current += channels;
+            }
+
+        }
+
+        output->step_index[channel] = step_index;
+
+    }
+
+    output->frames += frames;
+    output->blocks++;
+
+}
+
+/**
+ * Encodes a sine wave with the given number of channels using the IMA ADPCM
+ * encoder, verifying that the reference decoder reproduces that sine wave
+ * closely.
+ *
+ * @param channels
+ *     The number of channels to encode (1 or 2).
+ */
+static void test_adpcm_round_trip(int channels) {
+
+    int* samples = malloc(sizeof(int) * TEST_FRAMES * channels);
+    unsigned char* pcm = malloc(TEST_FRAMES * channels * 2);
+    test_adpcm_output* output = calloc(1, sizeof(test_adpcm_output));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(samples);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pcm);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(output);
+
+    /* Each channel receives a sine wave of a different frequency */
+    for (int frame = 0; frame < TEST_FRAMES; frame++) {
+        for (int channel = 0; channel < channels; channel++) {
+            int index = frame * channels + channel;
+            samples[index] = lrint(TEST_AMPLITUDE * sin(2 * M_PI
+                        * (440 + 220 * channel) * frame / TEST_RATE));
+            audio_capture_write_sample(pcm + index * 2, samples[index]);
+        }
+    }
+
+    /* Write PCM in pieces which split samples across writes */
+    output->channels = channels;
+    audio_capture_encode(adpcm_encoder, TEST_RATE, channels, pcm,
+            TEST_FRAMES * channels * 2, 1001, test_adpcm_blob_handler,
+            output);
+
+    /* Flushing sends all but fewer than eight trailing frames */
+    CU_ASSERT(output->blocks > 1);
+    CU_ASSERT(output->frames <= TEST_FRAMES);
+    CU_ASSERT(output->frames > TEST_FRAMES - 8);
+
+    /* Each decoded sample must track the original to within the precision
+     * of 4-bit ADPCM (an SNR of roughly 30 dB for a full-scale sine) */
+    double error = 0;
+    for (int i = 0; i < output->frames * channels; i++) {
+        double difference = output->samples[i] - samples[i];
+        error += difference * difference;
+    }
+
+    double rms = sqrt(error / (output->frames * channels));
+    CU_ASSERT(rms < TEST_AMPLITUDE / 20.0);
+
+    free(output);
+    free(pcm);
+    free(samples);
+
+}
+
+/**
+ * Encodes nine frames of mono PCM (the smallest possible non-trivial block)
+ * using the IMA ADPCM encoder, verifying that the resulting block matches
+ * the given expected block exactly.
+ *
+ * @param first
+ *     The first sample of the PCM. All remaining samples are zero.
+ *
+ * @param expected
+ *     The expected contents of the encoded block, which must be eight bytes
+ *     long.
+ */
+static void test_adpcm_vector(int first, const unsigned char* expected) {
+
+    unsigned char pcm[9 * 2] = { 0 };
+    audio_capture_write_sample(pcm, first);
+
+    test_adpcm_output* output = calloc(1, sizeof(test_adpcm_output));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(output);
+    output->channels = 1;
+
+    audio_capture_encode(adpcm_encoder, TEST_RATE, 1, pcm, sizeof(pcm),
+            sizeof(pcm), test_adpcm_blob_handler, output);
+
+    CU_ASSERT_EQUAL(output->blocks, 1);
+    CU_ASSERT_EQUAL(output->frames, 9);
+    CU_ASSERT_EQUAL_FATAL(output->block_length, 8);
+    CU_ASSERT(memcmp(output->block, expected, 8) == 0);
+
+    free(output);
+
+}
+
+/**
+ * Verifies that the IMA ADPCM encoder produces known blocks: silence encodes
+ * as all-zero codes, while a step from 0x1234 to silence stores 0x1234 in
+ * the block header and saturates the codes of the following samples until
+ * the predictor converges.
+ */
+void test_audio__adpcm_vectors() {
+
+    const unsigned char silence[] = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    };
+
+    const unsigned char step[] = {
+        0x34, 0x12, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xDF
+    };
+
+    test_adpcm_vector(0, silence);
+    test_adpcm_vector(0x1234, step);
+
+}
+
+/**
+ * Verifies that mono PCM round-trips through the IMA ADPCM encoder and the
+ * reference decoder with little error.
+ */
+void test_audio__adpcm_round_trip_mono() {
+    test_adpcm_round_trip(1);
+}
+
+/**
+ * Verifies that stereo PCM round-trips through the IMA ADPCM encoder and the
+ * reference decoder with little error, with channels correctly interleaved.
+ */
+void test_audio__adpcm_round_trip_stereo() {
+    test_adpcm_round_trip(2);
+}
@@ -0,0 +1,254 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "audio-capture.h"
+#include "g711_encoder.h"
+
+#include <CUnit/CUnit.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The number of samples within the PCM used for round-trip tests, covering
+ * the full range of 16-bit PCM.
+ */
+#define TEST_SWEEP_SAMPLES 9363
+
+/**
+ * The difference between consecutive samples within the PCM used for
+ * round-trip tests.
+ */
+#define TEST_SWEEP_STEP 7
+
+/**
+ * Buffer which receives the G.711 data produced by an encoder under test.
+ */
+typedef struct test_g711_output {
+
+    /**
+     * The G.711 data received thus far.
+     */
+    unsigned char data[TEST_SWEEP_SAMPLES];
+
+    /**
+     * The number of bytes of G.711 data received thus far.
+     */
+    int length;
+
+} test_g711_output;
+
+/**
+ * Appends each blob produced by a G.711 encoder to the test_g711_output
+ * provided as the arbitrary argument.
+ */
+static void test_g711_blob_handler(const unsigned char* data, int length,
+        void* arg) {
+
+    test_g711_output* output = (test_g711_output*) arg;
+
+    CU_ASSERT_FATAL(output->length + length <= (int) sizeof(output->data));
+    memcpy(output->data + output->length, data, length);
+    output->length += length;
+
+}
+
+/**
+ * Expands the given μ-law codeword to 16-bit PCM, as done by the ITU-T G.711
+ * reference decoder.
+ *
+ * @param codeword
+ *     The μ-law codeword to expand.
+ *
+ * @return
+ *     The corresponding 16-bit PCM sample.
+ */
+static int test_ulaw_decode(unsigned char codeword) {
+
+    codeword = ~codeword;
+
+    int value = (((codeword & 0x0F) << 3) + 0x84)
+        << ((codeword & 0x70) >> 4);
+
+    return (codeword & 0x80) ? 0x84 - value : value - 0x84;
+
+}
+
+/**
+ * Expands the given A-law codeword to 16-bit PCM, as done by the ITU-T G.711
+ * reference decoder.
+ *
+ * @param codeword
+ *     The A-law codeword to expand.
+ *
+ * @return
+ *     The corresponding 16-bit PCM sample.
+ */
+static int test_alaw_decode(unsigned char codeword) {
+
+    codeword ^= 0x55;
+
+    int value = (codeword & 0x0F) << 4;
+    int segment = (codeword & 0x70) >> 4;
+
+    if (segment == 0)
+        value += 8;
+    else {
+        value += 0x108;
+        if (segment > 1)
+            value <<= segment - 1;
+    }
+
+    return (codeword & 0x80) ? value : -value;
+
+}
+
+/**
+ * Encodes the given samples using the given G.711 encoder, storing the
+ * result within the given output buffer.
+ *
+ * @param encoder
+ *     The G.711 encoder to test.
+ *
+ * @param samples
+ *     The samples to encode.
+ *
+ * @param count
+ *     The number of samples.
+ *
+ * @param write_size
+ *     The number of bytes of PCM to write at a time.
+ *
+ * @param output
+ *     The buffer which should receive the encoded data.
+ */
+static void test_g711_encode(guac_audio_encoder* encoder, const int* samples,
+        int count, int write_size, test_g711_output* output) {
+
+    unsigned char* pcm = malloc(count * 2);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pcm);
+
+    for (int i = 0; i < count; i++)
+        audio_capture_write_sample(pcm + i * 2, samples[i]);
+
+    output->length = 0;
+    audio_capture_encode(encoder, 8000, 1, pcm, count * 2, write_size,
+            test_g711_blob_handler, output);
+
+    free(pcm);
+
+}
+
+/**
+ * Verifies that the given G.711 encoder round-trips PCM spanning the full
+ * 16-bit range through the given reference decoder within the precision of
+ * G.711, regardless of how the PCM is split across writes.
+ *
+ * @param encoder
+ *     The G.711 encoder to test.
+ *
+ * @param decode
+ *     The reference decoder for the codewords produced by the encoder.
+ */
+static void test_g711_round_trip(guac_audio_encoder* encoder,
+        int (*decode)(unsigned char)) {
+
+    int* samples = malloc(sizeof(int) * TEST_SWEEP_SAMPLES);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(samples);
+
+    for (int i = 0; i < TEST_SWEEP_SAMPLES; i++)
+        samples[i] = -32768 + i * TEST_SWEEP_STEP;
+
+    test_g711_output whole;
+    test_g711_output split;
+
+    /* Write all PCM at once, and again with samples split across writes */
+    test_g711_encode(encoder, samples, TEST_SWEEP_SAMPLES,
+            TEST_SWEEP_SAMPLES * 2, &whole);
+    test_g711_encode(encoder, samples, TEST_SWEEP_SAMPLES, 333, &split);
+
+    CU_ASSERT_EQUAL_FATAL(whole.length, TEST_SWEEP_SAMPLES);
+    CU_ASSERT_EQUAL_FATAL(split.length, TEST_SWEEP_SAMPLES);
+    CU_ASSERT(memcmp(whole.data, split.data, TEST_SWEEP_SAMPLES) == 0);
+
+    /* G.711 quantizes logarithmically, with a step size (and thus error)
+     * proportional to the magnitude of each sample */
+    for (int i = 0; i < TEST_SWEEP_SAMPLES; i++) {
+        int error = abs(decode(whole.data[i]) - samples[i]);
+        if (error > abs(samples[i]) / 16 + 16) {
+            CU_FAIL("Decoded sample differs too greatly from original");
+            break;
+        }
+    }
+
+    free(samples);
+
+}
+
+/**
+ * Verifies that the μ-law encoder produces the same codewords as the ITU-T
+ * G.711 reference encoder for a set of known samples.
+ */
+void test_audio__ulaw_vectors() {
+
+    const int samples[]            = {    0,   -1, 1000, -1000, 32767, -32768 };
+    const unsigned char expected[] = { 0xFF, 0x7F, 0xCE,  0x4E,  0x80,   0x00 };
+    const int count = sizeof(samples) / sizeof(samples[0]);
+
+    test_g711_output output;
+    test_g711_encode(ulaw_encoder, samples, count, count * 2, &output);
+
+    CU_ASSERT_EQUAL_FATAL(output.length, count);
+    CU_ASSERT(memcmp(output.data, expected, count) == 0);
+
+}
+
+/**
+ * Verifies that the A-law encoder produces the same codewords as the ITU-T
+ * G.711 reference encoder for a set of known samples.
+ */
+void test_audio__alaw_vectors() {
+
+    const int samples[]            = {    0,   -1, 1000, -1000, 32767, -32768 };
+    const unsigned char expected[] = { 0xD5, 0x55, 0xFA,  0x7A,  0xAA,   0x2A };
+    const int count = sizeof(samples) / sizeof(samples[0]);
+
+    test_g711_output output;
+    test_g711_encode(alaw_encoder, samples, count, count * 2, &output);
+
+    CU_ASSERT_EQUAL_FATAL(output.length, count);
+    CU_ASSERT(memcmp(output.data, expected, count) == 0);
+
+}
+
+/**
+ * Verifies that μ-law encoded PCM can be decoded by the reference decoder to
+ * within the precision of μ-law.
+ */
+void test_audio__ulaw_round_trip() {
+    test_g711_round_trip(ulaw_encoder, test_ulaw_decode);
+}
+
+/**
+ * Verifies that A-law encoded PCM can be decoded by the reference decoder to
+ * within the precision of A-law.
+ */
+void test_audio__alaw_round_trip() {
+    test_g711_round_trip(alaw_encoder, test_alaw_decode);
+}
@@ -0,0 +1,270 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "audio-processor.h"
+#include "audio-capture.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/audio.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The maximum number of bytes of converted PCM that a single test may
+ * produce.
+ */
+#define TEST_MAX_OUTPUT 262144
+
+/**
+ * The peak amplitude of the sine wave used by resampling tests.
+ */
+#define TEST_AMPLITUDE 16000
+
+/**
+ * The frequency of the sine wave used by resampling tests, in Hz.
+ */
+#define TEST_FREQUENCY 440
+
+/**
+ * The PCM produced by the audio processor under test.
+ */
+static unsigned char test_output[TEST_MAX_OUTPUT];
+
+/**
+ * The number of bytes of PCM within test_output.
+ */
+static int test_output_length;
+
+/**
+ * Audio encoder write handler which appends all PCM produced by the audio
+ * processor to test_output.
+ */
+static void test_processor_write_handler(guac_audio_stream* audio,
+        const unsigned char* pcm, int length) {
+
+    CU_ASSERT_FATAL(test_output_length + length <= TEST_MAX_OUTPUT);
+    memcpy(test_output + test_output_length, pcm, length);
+    test_output_length += length;
+
+}
+
+/**
+ * Audio encoder which receives the PCM produced by the audio processor.
+ */
+static guac_audio_encoder test_processor_encoder = {
+    .mimetype      = "audio/L16",
+    .write_handler = test_processor_write_handler
+};
+
+/**
+ * Converts the given PCM using a new audio processor, storing the result
+ * within test_output.
+ *
+ * @param processor
+ *     The audio processor to use.
+ *
+ * @param pcm
+ *     The PCM to convert.
+ *
+ * @param length
+ *     The number of bytes of PCM.
+ *
+ * @param write_size
+ *     The number of bytes of PCM to provide to the processor at a time.
+ */
+static void test_processor_convert(guac_audio_processor* processor,
+        const unsigned char* pcm, int length, int write_size) {
+
+    guac_audio_stream audio = { .encoder = &test_processor_encoder };
+
+    test_output_length = 0;
+    for (int offset = 0; offset < length; offset += write_size) {
+        int size = length - offset;
+        if (size > write_size)
+            size = write_size;
+        guac_audio_processor_write(processor, &audio, pcm + offset, size);
+    }
+
+}
+
+/**
+ * Returns the 16-bit signed, little-endian sample at the given index within
+ * test_output.
+ *
+ * @param index
+ *     The index of the sample to return.
+ *
+ * @return
+ *     The sample at the given index.
+ */
+static int test_output_sample(int index) {
+    return (int16_t) (test_output[index * 2]
+            | (test_output[index * 2 + 1] << 8));
+}
+
+/**
+ * Resamples a sine wave between the given rates, verifying that the number
+ * of frames produced matches the ratio of the rates and that the resulting
+ * PCM closely matches the same sine wave sampled at the output rate.
+ *
+ * @param input_rate
+ *     The sample rate of the input, in Hz.
+ *
+ * @param output_rate
+ *     The sample rate of the output, in Hz.
+ */
+static void test_processor_resample(int input_rate, int output_rate) {
+
+    /* One second of mono 16-bit PCM */
+    int frames = input_rate;
+    unsigned char* pcm = malloc(frames * 2);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pcm);
+
+    for (int i = 0; i < frames; i++)
+        audio_capture_write_sample(pcm + i * 2, lrint(TEST_AMPLITUDE
+                    * sin(2 * M_PI * TEST_FREQUENCY * i / input_rate)));
+
+    guac_audio_processor* processor = guac_audio_processor_alloc(
+            input_rate, 1, 16, output_rate, 1, 16);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(processor);
+
+    /* Write in pieces which split frames across writes */
+    test_processor_convert(processor, pcm, frames * 2, 4801);
+    guac_audio_processor_free(processor);
+    free(pcm);
+
+    /* Frames within the final half of the filter are retained until further
+     * input arrives */
+    int produced = test_output_length / 2;
+    int retained = GUAC_AUDIO_PROCESSOR_TAPS * output_rate / input_rate + 1;
+    CU_ASSERT(produced <= output_rate);
+    CU_ASSERT(produced >= output_rate - retained);
+
+    /* Output must be aligned with input, with only slight attenuation and
+     * filtering error */
+    double error = 0;
+    for (int i = 0; i < produced; i++) {
+        double expected = TEST_AMPLITUDE
+            * sin(2 * M_PI * TEST_FREQUENCY * i / output_rate);
+        double difference = test_output_sample(i) - expected;
+        error += difference * difference;
+    }
+
+    double rms = sqrt(error / produced);
+    CU_ASSERT(rms < TEST_AMPLITUDE / 100.0);
+
+}
+
+/**
+ * Verifies that stereo PCM is downmixed to mono by averaging channels,
+ * without altering the sample rate.
+ */
+void test_audio__processor_downmix() {
+
+    const int input[] = { 1000, 3000, -2000, -4000, 32767, 32767 };
+    const int expected[] = { 2000, -3000, 32767 };
+    const int frames = 3;
+
+    unsigned char pcm[sizeof(input) / sizeof(input[0]) * 2];
+    for (int i = 0; i < frames * 2; i++)
+        audio_capture_write_sample(pcm + i * 2, input[i]);
+
+    guac_audio_processor* processor = guac_audio_processor_alloc(
+            44100, 2, 16, 44100, 1, 16);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(processor);
+
+    /* Split the first frame across writes */
+    test_processor_convert(processor, pcm, sizeof(pcm), 3);
+    guac_audio_processor_free(processor);
+
+    CU_ASSERT_EQUAL_FATAL(test_output_length, frames * 2);
+    for (int i = 0; i < frames; i++)
+        CU_ASSERT_EQUAL(test_output_sample(i), expected[i]);
+
+}
+
+/**
+ * Verifies that 16-bit PCM is reduced to 8-bit PCM by rounding to the
+ * nearest representable value, clamping at the limits of 8-bit PCM.
+ */
+void test_audio__processor_reduce_depth() {
+
+    const int input[] = { 0, 12800, -12800, 32767, -32768, 127 };
+    const signed char expected[] = { 0, 50, -50, 127, -128, 0 };
+    const int frames = 6;
+
+    unsigned char pcm[sizeof(input) / sizeof(input[0]) * 2];
+    for (int i = 0; i < frames; i++)
+        audio_capture_write_sample(pcm + i * 2, input[i]);
+
+    guac_audio_processor* processor = guac_audio_processor_alloc(
+            8000, 1, 16, 8000, 1, 8);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(processor);
+
+    /* Split every sample across writes */
+    test_processor_convert(processor, pcm, sizeof(pcm), 1);
+    guac_audio_processor_free(processor);
+
+    CU_ASSERT_EQUAL_FATAL(test_output_length, frames);
+    for (int i = 0; i < frames; i++)
+        CU_ASSERT_EQUAL((signed char) test_output[i], expected[i]);
+
+}
+
+/**
+ * Verifies that 8-bit PCM is expanded to 16-bit PCM by scaling each sample
+ * to the full 16-bit range.
+ */
+void test_audio__processor_expand_depth() {
+
+    const unsigned char pcm[] = { 0x00, 0x7F, 0x80, 0xFF };
+    const int expected[] = { 0, 32512, -32768, -256 };
+    const int frames = 4;
+
+    guac_audio_processor* processor = guac_audio_processor_alloc(
+            8000, 1, 8, 8000, 1, 16);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(processor);
+
+    test_processor_convert(processor, pcm, sizeof(pcm), sizeof(pcm));
+    guac_audio_processor_free(processor);
+
+    CU_ASSERT_EQUAL_FATAL(test_output_length, frames * 2);
+    for (int i = 0; i < frames; i++)
+        CU_ASSERT_EQUAL(test_output_sample(i), expected[i]);
+
+}
+
+/**
+ * Verifies that PCM is downsampled from 48 kHz to 8 kHz without distorting
+ * frequencies within the output passband.
+ */
+void test_audio__processor_downsample() {
+    test_processor_resample(48000, 8000);
+}
+
+/**
+ * Verifies that PCM is upsampled from 8 kHz to 44.1 kHz (a non-integer
+ * ratio) without distorting the original signal.
+ */
+void test_audio__processor_upsample() {
+    test_processor_resample(8000, 44100);
+}
@@ -0,0 +1,149 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <CUnit/CUnit.h>
+#include <guacamole/client.h>
+#include <guacamole/socket.h>
+#include <guacamole/user.h>
+
+#include <sys/types.h>
+#include <time.h>
+
+/**
+ * The maximum number of 10ms intervals to wait for a newly-added user to be
+ * promoted from a pending user to a full user.
+ */
+#define TEST_CONGESTION_MAX_JOIN_WAIT 100
+
+/**
+ * The interval to wait between frames, which must exceed
+ * GUAC_USER_BACKLOG_SAMPLE_INTERVAL such that each frame samples the backlog.
+ */
+static const struct timespec test_congestion_frame_interval = {
+    .tv_sec = 0,
+    .tv_nsec = 200000000
+};
+
+/**
+ * The backlog reported by test_congestion_backlog_handler().
+ */
+static ssize_t test_congestion_backlog = 0;
+
+/**
+ * Write handler which accepts and discards all data.
+ */
+static ssize_t test_congestion_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+    return count;
+}
+
+/**
+ * Backlog handler which reports the value of test_congestion_backlog.
+ */
+static ssize_t test_congestion_backlog_handler(guac_socket* socket) {
+    return test_congestion_backlog;
+}
+
+/**
+ * Callback for guac_client_foreach_user() which counts each user.
+ *
+ * @param user
+ *     The user being counted.
+ *
+ * @param data
+ *     Pointer to the int count to increment.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* test_congestion_count_user(guac_user* user, void* data) {
+    (*((int*) data))++;
+    return NULL;
+}
+
+/**
+ * Verifies that the bandwidth and congestion lag of a user are estimated
+ * from the backlog of that user's socket as frames are completed, that the
+ * congestion lag contributes to the display lag of the client, and that
+ * congestion is ignored once the backlog becomes unknown.
+ */
+void test_client__congestion() {
+
+    guac_client* client = guac_client_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+
+    guac_socket* socket = guac_socket_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(socket);
+    socket->write_handler = test_congestion_write_handler;
+    socket->backlog_handler = test_congestion_backlog_handler;
+
+    guac_user* user = guac_user_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(user);
+    user->client = client;
+    user->socket = socket;
+
+    CU_ASSERT_EQUAL_FATAL(guac_client_add_user(client, user, 0, NULL), 0);
+
+    /* Wait for the user to be promoted from pending */
+    struct timespec interval = { .tv_sec = 0, .tv_nsec = 10000000 };
+    int users = 0;
+    for (int i = 0; i < TEST_CONGESTION_MAX_JOIN_WAIT && users == 0; i++) {
+        nanosleep(&interval, NULL);
+        guac_client_foreach_user(client, test_congestion_count_user, &users);
+    }
+
+    CU_ASSERT_EQUAL_FATAL(users, 1);
+
+    /* Bandwidth cannot be known from the first sample alone */
+    test_congestion_backlog = 50000;
+    guac_client_end_frame(client);
+    CU_ASSERT_EQUAL(user->bandwidth, 0);
+    CU_ASSERT_EQUAL(user->congestion_lag, 0);
+
+    /* Delivering 20000 bytes over roughly 200ms while data remains queued
+     * indicates roughly 100000 bytes/second of bandwidth */
+    nanosleep(&test_congestion_frame_interval, NULL);
+    test_congestion_backlog = 30000;
+    guac_client_end_frame(client);
+    CU_ASSERT(user->bandwidth > 10000);
+    CU_ASSERT(user->bandwidth <= 110000);
+
+    /* The remaining backlog will take time to deliver at that rate */
+    CU_ASSERT_FATAL(user->bandwidth > 0);
+    CU_ASSERT_EQUAL(user->congestion_lag,
+            30000 * 1000 / user->bandwidth);
+    CU_ASSERT(guac_client_get_display_lag(client)
+            >= user->congestion_lag);
+
+    /* Congestion cannot be measured if the backlog becomes unknown */
+    nanosleep(&test_congestion_frame_interval, NULL);
+    test_congestion_backlog = -1;
+    guac_client_end_frame(client);
+    CU_ASSERT_EQUAL(user->congestion_lag, 0);
+    CU_ASSERT_EQUAL(guac_client_get_display_lag(client),
+            user->processing_lag);
+
+    guac_client_remove_user(client, user);
+    guac_user_free(user);
+    guac_socket_free(socket);
+    guac_client_free(client);
+
+}
+
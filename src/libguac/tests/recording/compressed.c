@@ -0,0 +1,276 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/client.h>
+#include <guacamole/error.h>
+#include <guacamole/parser.h>
+#include <guacamole/protocol.h>
+#include <guacamole/recording.h>
+#include <guacamole/socket.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * The number of "sync" instructions to write to each test recording. This
+ * is large enough that the recording spans many compressed blocks.
+ */
+#define TEST_SYNC_COUNT 50000
+
+/**
+ * The interval between the timestamps of consecutive "sync" instructions
+ * within each test recording.
+ */
+#define TEST_SYNC_INTERVAL 10
+
+/**
+ * The maximum amount of time to wait for a partially-filled block of a
+ * compressed recording to be written, in seconds. This is comfortably longer
+ * than the interval at which the recording writer writes such blocks.
+ */
+#define TEST_MAX_FLUSH_WAIT 15
+
+/**
+ * Writes a compressed recording containing TEST_SYNC_COUNT "sync"
+ * instructions, each preceded by a "name" instruction, to a new temporary
+ * directory. The timestamp of the Nth "sync" instruction (counting from one)
+ * is N * TEST_SYNC_INTERVAL.
+ *
+ * @param path
+ *     Buffer which receives the full path of the written recording.
+ *
+ * @param length
+ *     The size of the given buffer, in bytes.
+ */
+static void write_compressed_recording(char* path, size_t length) {
+
+    char dir[] = "/tmp/guac-recording-XXXXXX";
+    CU_ASSERT_PTR_NOT_NULL_FATAL(mkdtemp(dir));
+    snprintf(path, length, "%s/recording", dir);
+
+    guac_client* client = guac_client_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+
+    guac_recording* recording = guac_recording_create(client, dir,
+            "recording", 0, 1, 0, 0, 0, 1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(recording);
+
+    for (int i = 1; i <= TEST_SYNC_COUNT; i++) {
+        guac_protocol_send_name(client->socket, "test \xc3\xa1");
+        guac_protocol_send_sync(client->socket, i * TEST_SYNC_INTERVAL, 1);
+        guac_socket_flush(client->socket);
+    }
+
+    /* Freeing the client frees the recording socket, writing the final
+     * block of the recording */
+    guac_recording_free(recording);
+    guac_client_free(client);
+
+}
+
+/**
+ * Reads all remaining instructions from the given recording reader,
+ * verifying that the "sync" instructions read have consecutive timestamps
+ * starting with the given timestamp and that each is preceded by the
+ * expected "name" instruction.
+ *
+ * @param parser
+ *     The parser to use to read instructions.
+ *
+ * @param socket
+ *     The recording reader to read from.
+ *
+ * @param first_timestamp
+ *     The expected timestamp of the first "sync" instruction read.
+ *
+ * @return
+ *     The number of "sync" instructions read.
+ */
+static int read_syncs(guac_parser* parser, guac_socket* socket,
+        int first_timestamp) {
+
+    int syncs = 0;
+    int names = 0;
+    int expected = first_timestamp;
+
+    while (!guac_parser_read(parser, socket, -1)) {
+
+        if (strcmp(parser->opcode, "name") == 0) {
+            CU_ASSERT_EQUAL(parser->argc, 1);
+            CU_ASSERT_STRING_EQUAL(parser->argv[0], "test \xc3\xa1");
+            names++;
+        }
+
+        else {
+            CU_ASSERT_STRING_EQUAL_FATAL(parser->opcode, "sync");
+            CU_ASSERT_EQUAL(atoi(parser->argv[0]), expected);
+            expected += TEST_SYNC_INTERVAL;
+            syncs++;
+        }
+
+    }
+
+    /* Every sync must have been preceded by a name, except possibly the
+     * first if reading began partway through the recording */
+    CU_ASSERT(names == syncs || names == syncs - 1);
+    CU_ASSERT_EQUAL(guac_error, GUAC_STATUS_CLOSED);
+
+    return syncs;
+
+}
+
+/**
+ * Verifies that compressed recordings are valid gzip files and can be read
+ * in their entirety through guac_recording_reader_open().
+ */
+void test_recording__compressed_read() {
+
+    char path[1024];
+    write_compressed_recording(path, sizeof(path));
+
+    int fd = open(path, O_RDONLY);
+    CU_ASSERT_NOT_EQUAL_FATAL(fd, -1);
+
+    /* Compressed recordings begin with the gzip magic number */
+    unsigned char magic[2];
+    CU_ASSERT_EQUAL_FATAL(read(fd, magic, sizeof(magic)), sizeof(magic));
+    CU_ASSERT_EQUAL(magic[0], 0x1F);
+    CU_ASSERT_EQUAL(magic[1], 0x8B);
+    CU_ASSERT_EQUAL_FATAL(lseek(fd, 0, SEEK_SET), 0);
+
+    guac_socket* socket = guac_recording_reader_open(fd);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(socket);
+
+    guac_parser* parser = guac_parser_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(parser);
+
+    CU_ASSERT_EQUAL(read_syncs(parser, socket, TEST_SYNC_INTERVAL),
+            TEST_SYNC_COUNT);
+
+    guac_parser_free(parser);
+    guac_socket_free(socket);
+
+    /* Remove recording and its temporary directory */
+    unlink(path);
+    *strrchr(path, '/') = '\0';
+    rmdir(path);
+
+}
+
+/**
+ * Verifies that guac_recording_reader_seek() positions compressed recordings
+ * at an instruction boundary at or shortly before the requested timestamp.
+ */
+void test_recording__compressed_seek() {
+
+    char path[1024];
+    write_compressed_recording(path, sizeof(path));
+
+    int fd = open(path, O_RDONLY);
+    CU_ASSERT_NOT_EQUAL_FATAL(fd, -1);
+
+    guac_socket* socket = guac_recording_reader_open(fd);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(socket);
+
+    /* Seek to the middle of the recording */
+    int target = TEST_SYNC_COUNT / 2 * TEST_SYNC_INTERVAL;
+    CU_ASSERT_EQUAL_FATAL(guac_recording_reader_seek(socket, target), 0);
+
+    /* Determine the timestamp of the first sync following the seek */
+    guac_parser* parser = guac_parser_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(parser);
+
+    int first = -1;
+    while (first == -1 && !guac_parser_read(parser, socket, -1)) {
+        if (strcmp(parser->opcode, "sync") == 0)
+            first = atoi(parser->argv[0]);
+    }
+
+    /* The seek must land at or before the target, but must not require
+     * reading the recording from the beginning */
+    CU_ASSERT(first > TEST_SYNC_INTERVAL);
+    CU_ASSERT(first <= target);
+
+    /* All remaining syncs must be read in order */
+    int remaining = (TEST_SYNC_COUNT * TEST_SYNC_INTERVAL - first)
+        / TEST_SYNC_INTERVAL;
+    CU_ASSERT_EQUAL(read_syncs(parser, socket, first + TEST_SYNC_INTERVAL),
+            remaining);
+
+    guac_parser_free(parser);
+    guac_socket_free(socket);
+
+    /* Remove recording and its temporary directory */
+    unlink(path);
+    *strrchr(path, '/') = '\0';
+    rmdir(path);
+
+}
+
+/**
+ * Verifies that a partially-filled block of a compressed recording is written
+ * to disk after a bounded delay, rather than only when the recording is
+ * freed.
+ */
+void test_recording__compressed_flush() {
+
+    char dir[] = "/tmp/guac-recording-XXXXXX";
+    CU_ASSERT_PTR_NOT_NULL_FATAL(mkdtemp(dir));
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/recording", dir);
+
+    guac_client* client = guac_client_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+
+    guac_recording* recording = guac_recording_create(client, dir,
+            "recording", 0, 1, 0, 0, 0, 1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(recording);
+
+    /* Write far less than a full block */
+    guac_protocol_send_sync(client->socket, TEST_SYNC_INTERVAL, 1);
+    guac_socket_flush(client->socket);
+
+    /* Wait for the partial block to be written without freeing the
+     * recording */
+    struct stat file_stat;
+    struct timespec interval = { .tv_sec = 0, .tv_nsec = 100000000 };
+    for (int i = 0; i < TEST_MAX_FLUSH_WAIT * 10; i++) {
+        CU_ASSERT_EQUAL_FATAL(stat(path, &file_stat), 0);
+        if (file_stat.st_size > 0)
+            break;
+        nanosleep(&interval, NULL);
+    }
+
+    CU_ASSERT(file_stat.st_size > 0);
+
+    guac_recording_free(recording);
+    guac_client_free(client);
+
+    /* Remove recording and its temporary directory */
+    unlink(path);
+    rmdir(dir);
+
+}
@@ -0,0 +1,232 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <CUnit/CUnit.h>
+#include <guacamole/client.h>
+#include <guacamole/protocol.h>
+#include <guacamole/recording.h>
+#include <guacamole/socket.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * The number of instructions to write to each test recording. This is large
+ * enough that the recording spans many chunks.
+ */
+#define TEST_INSTRUCTION_COUNT 20000
+
+/**
+ * The instruction written repeatedly to each test recording, in its encoded
+ * form.
+ */
+#define TEST_INSTRUCTION "4.name,4.test;"
+
+/**
+ * The maximum number of times to check whether the recording writer thread
+ * has written all queued data before giving up.
+ */
+#define TEST_MAX_WAIT_ATTEMPTS 1000
+
+/**
+ * Creates a new recording within a new temporary directory. Output is not
+ * included, such that the recording socket is written only by the test.
+ *
+ * @param client
+ *     The client to associate with the recording.
+ *
+ * @param path
+ *     Buffer which receives the full path of the recording.
+ *
+ * @param length
+ *     The size of the given buffer, in bytes.
+ *
+ * @return
+ *     The newly-created recording.
+ */
+static guac_recording* create_recording(guac_client* client, char* path,
+        size_t length) {
+
+    char dir[] = "/tmp/guac-recording-XXXXXX";
+    CU_ASSERT_PTR_NOT_NULL_FATAL(mkdtemp(dir));
+    snprintf(path, length, "%s/recording", dir);
+
+    guac_recording* recording = guac_recording_create(client, dir,
+            "recording", 0, 0, 0, 0, 0, 0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(recording);
+
+    return recording;
+
+}
+
+/**
+ * Waits for the writer thread of the given recording to write all queued
+ * data, returning the final statistics of the recording.
+ *
+ * @param recording
+ *     The recording to wait for.
+ *
+ * @param stats
+ *     The guac_recording_stats structure to populate.
+ */
+static void wait_for_writer(guac_recording* recording,
+        guac_recording_stats* stats) {
+
+    struct timespec interval = { .tv_sec = 0, .tv_nsec = 10000000 };
+
+    guac_socket_flush(recording->socket);
+
+    for (int i = 0; i < TEST_MAX_WAIT_ATTEMPTS; i++) {
+        guac_recording_get_stats(recording, stats);
+        if (stats->queued_bytes == 0)
+            return;
+        nanosleep(&interval, NULL);
+    }
+
+    CU_FAIL_FATAL("Recording writer did not finish writing queued data");
+
+}
+
+/**
+ * Verifies that the recording at the given path consists of exactly the
+ * given number of copies of TEST_INSTRUCTION and nothing else, removing the
+ * recording and its directory afterwards.
+ *
+ * @param path
+ *     The full path of the recording.
+ *
+ * @param count
+ *     The expected number of instructions.
+ */
+static void verify_recording(char* path, int count) {
+
+    const int instruction_length = strlen(TEST_INSTRUCTION);
+
+    int fd = open(path, O_RDONLY);
+    CU_ASSERT_NOT_EQUAL_FATAL(fd, -1);
+
+    char instruction[64];
+    int read_count = 0;
+    while (read(fd, instruction, instruction_length) == instruction_length) {
+        CU_ASSERT_NSTRING_EQUAL_FATAL(instruction, TEST_INSTRUCTION,
+                instruction_length);
+        read_count++;
+    }
+
+    /* No partial instruction may remain */
+    CU_ASSERT_EQUAL(read(fd, instruction, 1), 0);
+    CU_ASSERT_EQUAL(read_count, count);
+
+    close(fd);
+
+    /* Remove recording and its temporary directory */
+    unlink(path);
+    *strrchr(path, '/') = '\0';
+    rmdir(path);
+
+}
+
+/**
+ * Verifies that, under the default GUAC_RECORDING_OVERFLOW_BLOCK policy, all
+ * data written to a recording reaches disk in order and is accounted for by
+ * the statistics of the recording.
+ */
+void test_recording__writer_block() {
+
+    guac_client* client = guac_client_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+
+    char path[1024];
+    guac_recording* recording = create_recording(client, path, sizeof(path));
+
+    for (int i = 0; i < TEST_INSTRUCTION_COUNT; i++)
+        guac_protocol_send_name(recording->socket, "test");
+
+    guac_recording_stats stats;
+    wait_for_writer(recording, &stats);
+
+    const uint64_t total = (uint64_t) TEST_INSTRUCTION_COUNT
+        * strlen(TEST_INSTRUCTION);
+
+    CU_ASSERT_EQUAL(stats.written_bytes, total);
+    CU_ASSERT_EQUAL(stats.dropped_bytes, 0);
+    CU_ASSERT_EQUAL(stats.dropped_instructions, 0);
+    CU_ASSERT_EQUAL(stats.failed, 0);
+
+    /* Data is handed to the writer thread in whole chunks unless flushed */
+    CU_ASSERT(stats.peak_queued_bytes >= GUAC_RECORDING_CHUNK_SIZE);
+
+    guac_recording_free(recording);
+    guac_client_free(client);
+
+    verify_recording(path, TEST_INSTRUCTION_COUNT);
+
+}
+
+/**
+ * Verifies that, under the GUAC_RECORDING_OVERFLOW_DROP policy, instructions
+ * written while the queue is full are dropped in their entirety, and that
+ * all data written is accounted for as either written or dropped.
+ */
+void test_recording__writer_drop() {
+
+    guac_client* client = guac_client_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+
+    char path[1024];
+    guac_recording* recording = create_recording(client, path, sizeof(path));
+
+    /* Consider the queue full whenever anything at all is queued */
+    guac_recording_set_overflow_policy(recording, 1,
+            GUAC_RECORDING_OVERFLOW_DROP);
+
+    /* Queue each instruction separately, such that instructions are written
+     * while previous instructions are still queued */
+    for (int i = 0; i < TEST_INSTRUCTION_COUNT; i++) {
+        guac_protocol_send_name(recording->socket, "test");
+        guac_socket_flush(recording->socket);
+    }
+
+    guac_recording_stats stats;
+    wait_for_writer(recording, &stats);
+
+    const int instruction_length = strlen(TEST_INSTRUCTION);
+    const uint64_t total = (uint64_t) TEST_INSTRUCTION_COUNT
+        * instruction_length;
+
+    CU_ASSERT_EQUAL(stats.failed, 0);
+    CU_ASSERT_EQUAL(stats.written_bytes + stats.dropped_bytes, total);
+    CU_ASSERT_EQUAL(stats.dropped_bytes,
+            stats.dropped_instructions * instruction_length);
+
+    /* The first instruction is always written, as nothing is yet queued */
+    CU_ASSERT(stats.dropped_instructions < TEST_INSTRUCTION_COUNT);
+
+    guac_recording_free(recording);
+    guac_client_free(client);
+
+    verify_recording(path, TEST_INSTRUCTION_COUNT
+            - stats.dropped_instructions);
+
+}
@@ -0,0 +1,160 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <CUnit/CUnit.h>
+#include <guacamole/protocol.h>
+#include <guacamole/socket.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * The maximum number of 10ms intervals to wait for flushed data to be
+ * transmitted over the loopback interface.
+ */
+#define TEST_BACKLOG_MAX_WAIT 100
+
+/**
+ * The backlog reported by test_backlog_handler().
+ */
+static ssize_t test_backlog = 0;
+
+/**
+ * Backlog handler which reports the value of test_backlog.
+ */
+static ssize_t test_backlog_handler(guac_socket* socket) {
+    return test_backlog;
+}
+
+/**
+ * Verifies that the backlog of a guac_socket without a backlog handler is
+ * reported as unknown.
+ */
+void test_socket__get_backlog_unknown() {
+
+    guac_socket* socket = guac_socket_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(socket);
+
+    CU_ASSERT(guac_socket_get_backlog(socket) < 0);
+
+    guac_socket_free(socket);
+
+}
+
+/**
+ * Verifies that guac_socket_get_backlog() reports the value returned by the
+ * backlog handler of the guac_socket.
+ */
+void test_socket__get_backlog_handler() {
+
+    guac_socket* socket = guac_socket_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(socket);
+
+    socket->backlog_handler = test_backlog_handler;
+
+    test_backlog = 12345;
+    CU_ASSERT_EQUAL(guac_socket_get_backlog(socket), 12345);
+
+    test_backlog = -1;
+    CU_ASSERT(guac_socket_get_backlog(socket) < 0);
+
+    guac_socket_free(socket);
+
+}
+
+/**
+ * Verifies that the backlog of a file descriptor guac_socket over a TCP
+ * connection includes data still buffered by the guac_socket, and does not
+ * include data which has been transmitted but not yet read by the remote
+ * end. If the backlog cannot be determined on the current platform, only
+ * that this is reported consistently is verified.
+ */
+void test_socket__get_backlog_fd() {
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+        .sin_port = 0
+    };
+
+    socklen_t addr_len = sizeof(addr);
+
+    /* Listen on an arbitrary port of the loopback interface */
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    CU_ASSERT_NOT_EQUAL_FATAL(listen_fd, -1);
+    CU_ASSERT_EQUAL_FATAL(bind(listen_fd, (struct sockaddr*) &addr,
+                sizeof(addr)), 0);
+    CU_ASSERT_EQUAL_FATAL(listen(listen_fd, 1), 0);
+    CU_ASSERT_EQUAL_FATAL(getsockname(listen_fd, (struct sockaddr*) &addr,
+                &addr_len), 0);
+
+    /* Connect to that port, never reading from the accepted connection */
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    CU_ASSERT_NOT_EQUAL_FATAL(fd, -1);
+    CU_ASSERT_EQUAL_FATAL(connect(fd, (struct sockaddr*) &addr,
+                sizeof(addr)), 0);
+
+    int remote_fd = accept(listen_fd, NULL, NULL);
+    CU_ASSERT_NOT_EQUAL_FATAL(remote_fd, -1);
+
+    guac_socket* socket = guac_socket_open(fd);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(socket);
+
+    ssize_t backlog = guac_socket_get_backlog(socket);
+    if (backlog < 0) {
+
+        /* If unsupported, the backlog must never be known */
+        guac_protocol_send_nop(socket);
+        CU_ASSERT(guac_socket_get_backlog(socket) < 0);
+
+    }
+
+    else {
+
+        CU_ASSERT_EQUAL(backlog, 0);
+
+        /* Data still buffered by the guac_socket is part of the backlog */
+        guac_protocol_send_nop(socket);
+        CU_ASSERT_EQUAL(guac_socket_get_backlog(socket), strlen("3.nop;"));
+
+        /* Once transmitted, data is no longer part of the backlog, even
+         * though the remote end has not yet read it */
+        guac_socket_flush(socket);
+
+        struct timespec interval = { .tv_sec = 0, .tv_nsec = 10000000 };
+        for (int i = 0; i < TEST_BACKLOG_MAX_WAIT
+                && guac_socket_get_backlog(socket) != 0; i++)
+            nanosleep(&interval, NULL);
+
+        CU_ASSERT_EQUAL(guac_socket_get_backlog(socket), 0);
+
+    }
+
+    guac_socket_free(socket);
+    close(remote_fd);
+    close(listen_fd);
+
+}
+
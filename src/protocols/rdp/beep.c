@@ -94,11 +94,11 @@ static void guac_rdp_beep_fill_triangle_wave(unsigned char* buffer,
 static void guac_rdp_beep_write_pcm(guac_audio_stream* audio,
         int frequency, int duration) {
 
-    size_t buffer_size = guac_mem_ckd_mul_or_die(audio->rate, duration) / 1000;
+    size_t buffer_size = guac_mem_ckd_mul_or_die(audio->input_rate, duration) / 1000;
     unsigned char* buffer = guac_mem_alloc(buffer_size);
 
     /* Beep for given frequency/duration using a simple triangle wave */
-    guac_rdp_beep_fill_triangle_wave(buffer, frequency, audio->rate, buffer_size);
+    guac_rdp_beep_fill_triangle_wave(buffer, frequency, audio->input_rate, buffer_size);
     guac_audio_stream_write_pcm(audio, buffer, buffer_size);
 
     guac_mem_free(buffer);
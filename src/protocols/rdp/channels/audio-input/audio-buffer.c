@@ -28,11 +28,12 @@
 #include <guacamole/timestamp.h>
 #include <guacamole/user.h>
 
-#include <assert.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 /**
@@ -40,6 +41,11 @@
  */
 #define NANOS_PER_SECOND 1000000000L
 
+/**
+ * The number of microseconds in one second.
+ */
+#define MICROS_PER_SECOND 1000000L
+
 /**
  * Returns whether the given timespec represents a point in time in the future
  * relative to the current system time.
@@ -63,6 +69,60 @@ static int guac_rdp_audio_buffer_is_future(const struct timespec* ts) {
 
 }
 
+/**
+ * Returns the number of microseconds that the current system time is past
+ * the given timespec. If the given timespec is in the future, the result is
+ * negative.
+ *
+ * @param ts
+ *     The timespec to compare against the current system time.
+ *
+ * @return
+ *     The number of microseconds elapsed since the given timespec.
+ */
+static int64_t guac_rdp_audio_buffer_elapsed(const struct timespec* ts) {
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    return (int64_t) (now.tv_sec - ts->tv_sec) * MICROS_PER_SECOND
+         + (now.tv_nsec - ts->tv_nsec) / 1000;
+
+}
+
+/**
+ * Returns the current value of a monotonic clock, in microseconds, for
+ * measuring the intervals between received audio data.
+ *
+ * @return
+ *     The current value of a monotonic clock, in microseconds.
+ */
+static int64_t guac_rdp_audio_buffer_now() {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (int64_t) now.tv_sec * MICROS_PER_SECOND + now.tv_nsec / 1000;
+
+}
+
+/**
+ * Returns the number of bytes of converted audio data currently stored
+ * within the ring buffer of the given audio buffer.
+ *
+ * IMPORTANT: The guac_rdp_audio_buffer's lock MUST already be held when
+ * invoking this function.
+ *
+ * @param audio_buffer
+ *     The guac_rdp_audio_buffer to test.
+ *
+ * @return
+ *     The number of bytes stored within the ring buffer.
+ */
+static size_t guac_rdp_audio_buffer_buffered(guac_rdp_audio_buffer* audio_buffer) {
+    return audio_buffer->ring_head - audio_buffer->ring_tail;
+}
+
 /**
  * Returns whether the given audio buffer may be flushed. An audio buffer may
  * be flushed if the audio buffer is not currently being freed, at least one
@@ -83,7 +143,7 @@ static int guac_rdp_audio_buffer_is_future(const struct timespec* ts) {
 static int guac_rdp_audio_buffer_may_flush(guac_rdp_audio_buffer* audio_buffer) {
     return !audio_buffer->stopping
         && audio_buffer->packet_size > 0
-        && audio_buffer->bytes_written >= audio_buffer->packet_size
+        && guac_rdp_audio_buffer_buffered(audio_buffer) >= audio_buffer->packet_size
         && !guac_rdp_audio_buffer_is_future(&audio_buffer->next_flush);
 }
 
@@ -123,7 +183,7 @@ static size_t guac_rdp_audio_buffer_length(const guac_rdp_audio_format* format,
 
 /**
  * Notifies the given guac_rdp_audio_buffer that a single packet of audio data
- * has just been flushed, updating the scheduled time of the next flush. The
+ * is about to be flushed, updating the scheduled time of the next flush. The
  * timing of the next flush will be set such that the overall real time audio
  * generation rate is not exceeded, but will be adjusted as necessary to
  * compensate for latency induced by differences in audio packet size/duration.
@@ -150,7 +210,7 @@ static void guac_rdp_audio_buffer_schedule_flush(guac_rdp_audio_buffer* audio_bu
     /* Amortize the additional latency from packet data buffered beyond the
      * desired packet size over each remaining packet such that we gradually
      * approach an effective additional latency of 0 */
-    int packets_remaining = audio_buffer->bytes_written / audio_buffer->packet_size;
+    int packets_remaining = guac_rdp_audio_buffer_buffered(audio_buffer) / audio_buffer->packet_size;
     if (packets_remaining > 1)
         delta_nsecs = delta_nsecs * (packets_remaining - 1) / packets_remaining;
 
@@ -175,30 +235,103 @@ static void guac_rdp_audio_buffer_schedule_flush(guac_rdp_audio_buffer* audio_bu
  * buffer after this function returns to verify whether the desired state
  * change has occurred and re-invoke the function if needed.
  *
+ * IMPORTANT: The guac_rdp_audio_buffer's lock MUST already be held when
+ * invoking this function. The lock is released while waiting and reacquired
+ * before this function returns.
+ *
  * @param audio_buffer
  *     The guac_rdp_audio_buffer to wait for.
  */
 static void guac_rdp_audio_buffer_wait(guac_rdp_audio_buffer* audio_buffer) {
 
-    pthread_mutex_lock(&(audio_buffer->lock));
-
     /* Do not wait if audio_buffer is already closed */
-    if (!audio_buffer->stopping) {
+    if (audio_buffer->stopping)
+        return;
 
-        /* If sufficient data exists for a flush, wait until next possible
-         * flush OR until some other state change occurs (such as the buffer
-         * being closed) */
-        if (audio_buffer->bytes_written && audio_buffer->bytes_written >= audio_buffer->packet_size)
-            pthread_cond_timedwait(&audio_buffer->modified, &audio_buffer->lock,
-                    &audio_buffer->next_flush);
+    /* If sufficient data exists for a flush, wait until next possible
+     * flush OR until some other state change occurs (such as the buffer
+     * being closed) */
+    if (audio_buffer->packet_size > 0
+            && guac_rdp_audio_buffer_buffered(audio_buffer) >= audio_buffer->packet_size)
+        pthread_cond_timedwait(&audio_buffer->modified, &audio_buffer->lock,
+                &audio_buffer->next_flush);
 
-        /* If sufficient data DOES NOT exist, we should wait indefinitely */
-        else
-            pthread_cond_wait(&audio_buffer->modified, &audio_buffer->lock);
+    /* If sufficient data DOES NOT exist, we should wait indefinitely */
+    else
+        pthread_cond_wait(&audio_buffer->modified, &audio_buffer->lock);
 
-    }
+}
+
+/**
+ * Waits until neither the producer nor the flush thread is accessing the
+ * ring buffer of the given audio buffer without the lock held, such that the
+ * ring buffer may be safely reset or freed.
+ *
+ * IMPORTANT: The guac_rdp_audio_buffer's lock MUST already be held when
+ * invoking this function. The lock is released while waiting and reacquired
+ * before this function returns.
+ *
+ * @param audio_buffer
+ *     The guac_rdp_audio_buffer to wait for.
+ */
+static void guac_rdp_audio_buffer_wait_idle(guac_rdp_audio_buffer* audio_buffer) {
+    while (audio_buffer->writing || audio_buffer->flushing)
+        pthread_cond_wait(&audio_buffer->modified, &audio_buffer->lock);
+}
+
+/**
+ * Resets the ring buffer, conversion state, and statistics of the given
+ * audio buffer, discarding any buffered audio data.
+ *
+ * IMPORTANT: The guac_rdp_audio_buffer's lock MUST already be held when
+ * invoking this function, and neither the producer nor the flush thread may
+ * be accessing the ring buffer (see guac_rdp_audio_buffer_wait_idle()).
+ *
+ * @param audio_buffer
+ *     The guac_rdp_audio_buffer to reset.
+ */
+static void guac_rdp_audio_buffer_reset(guac_rdp_audio_buffer* audio_buffer) {
+
+    audio_buffer->ring_head = 0;
+    audio_buffer->ring_tail = 0;
+
+    audio_buffer->frames_received = 0;
+    audio_buffer->frames_sent = 0;
+    audio_buffer->partial_length = 0;
+
+    memset(&audio_buffer->stats, 0, sizeof(audio_buffer->stats));
+
+}
+
+/**
+ * Copies the given number of bytes out of the ring buffer of the given audio
+ * buffer, beginning at the given absolute position, wrapping around the end
+ * of the ring buffer as necessary.
+ *
+ * @param audio_buffer
+ *     The guac_rdp_audio_buffer whose ring buffer should be read.
+ *
+ * @param position
+ *     The absolute position of the first byte to copy, as would be stored
+ *     within ring_tail.
+ *
+ * @param buffer
+ *     The buffer which should receive the copied bytes.
+ *
+ * @param length
+ *     The number of bytes to copy.
+ */
+static void guac_rdp_audio_buffer_read_ring(guac_rdp_audio_buffer* audio_buffer,
+        uint64_t position, char* buffer, size_t length) {
+
+    size_t offset = position % audio_buffer->packet_buffer_size;
+    size_t contiguous = audio_buffer->packet_buffer_size - offset;
 
-    pthread_mutex_unlock(&(audio_buffer->lock)); 
+    if (contiguous > length)
+        contiguous = length;
+
+    memcpy(buffer, audio_buffer->ring + offset, contiguous);
+    memcpy(buffer + contiguous, audio_buffer->ring, length - contiguous);
 
 }
 
@@ -209,6 +342,11 @@ static void guac_rdp_audio_buffer_wait(guac_rdp_audio_buffer* audio_buffer) {
  * the software running within the RDP server. Once started, this thread runs
  * until the associated audio buffer is freed via guac_rdp_audio_buffer_free().
  *
+ * The lock of the audio buffer is held only while deciding whether to flush;
+ * each packet is copied out of the ring buffer and passed to the flush
+ * handler with the lock released, such that a slow flush never blocks the
+ * receipt of further audio data.
+ *
  * @param data
  *     A pointer to the guac_rdp_audio_buffer that should be flushed.
  *
@@ -218,13 +356,12 @@ static void guac_rdp_audio_buffer_wait(guac_rdp_audio_buffer* audio_buffer) {
 static void* guac_rdp_audio_buffer_flush_thread(void* data) {
 
     guac_rdp_audio_buffer* audio_buffer = (guac_rdp_audio_buffer*) data;
-    while (!audio_buffer->stopping) {
 
-        pthread_mutex_lock(&(audio_buffer->lock));
+    pthread_mutex_lock(&(audio_buffer->lock));
 
-        if (!guac_rdp_audio_buffer_may_flush(audio_buffer)) {
+    while (!audio_buffer->stopping) {
 
-            pthread_mutex_unlock(&(audio_buffer->lock));
+        if (!guac_rdp_audio_buffer_may_flush(audio_buffer)) {
 
             /* Wait for additional data if we aren't able to flush */
             guac_rdp_audio_buffer_wait(audio_buffer);
@@ -236,26 +373,54 @@ static void* guac_rdp_audio_buffer_flush_thread(void* data) {
 
         }
 
-        guac_client_log(audio_buffer->client, GUAC_LOG_TRACE, "Current audio input latency: %i ms (%i bytes waiting in buffer)",
-                guac_rdp_audio_buffer_duration(&audio_buffer->out_format, audio_buffer->bytes_written),
-                audio_buffer->bytes_written);
+        size_t buffered = guac_rdp_audio_buffer_buffered(audio_buffer);
+        size_t packet_size = audio_buffer->packet_size;
+        guac_rdp_audio_buffer_stats* stats = &audio_buffer->stats;
 
-        /* Only actually invoke if defined */
-        if (audio_buffer->flush_handler) {
-            guac_rdp_audio_buffer_schedule_flush(audio_buffer);
-            audio_buffer->flush_handler(audio_buffer,
-                    audio_buffer->packet_size);
-        }
+        guac_client_log(audio_buffer->client, GUAC_LOG_TRACE, "Current audio input latency: %i ms (%zu bytes waiting in buffer)",
+                guac_rdp_audio_buffer_duration(&audio_buffer->out_format, buffered),
+                buffered);
 
-        /* Shift buffer back by one packet */
-        audio_buffer->bytes_written -= audio_buffer->packet_size;
-        memmove(audio_buffer->packet, audio_buffer->packet + audio_buffer->packet_size, audio_buffer->bytes_written);
+        /* Track greatest latency added by buffer */
+        if (buffered > stats->max_buffered)
+            stats->max_buffered = buffered;
 
-        pthread_cond_broadcast(&(audio_buffer->modified));
+        /* Count any packet flushed late by more than its own duration as an
+         * underrun (the RDP server ran out of audio) */
+        int64_t lateness = guac_rdp_audio_buffer_elapsed(&audio_buffer->next_flush);
+        if (stats->packets_sent > 0 && lateness > (int64_t) 1000
+                * guac_rdp_audio_buffer_duration(&audio_buffer->out_format, packet_size))
+            stats->underruns++;
+
+        guac_rdp_audio_buffer_flush_handler* flush_handler = audio_buffer->flush_handler;
+        uint64_t position = audio_buffer->ring_tail;
+
+        guac_rdp_audio_buffer_schedule_flush(audio_buffer);
+        audio_buffer->flushing = 1;
         pthread_mutex_unlock(&(audio_buffer->lock));
 
+        /* Copy packet out of ring and flush (only actually invoke handler if
+         * defined). The producer will not overwrite this region of the ring
+         * until ring_tail is advanced, nor will the ring be freed or reset
+         * while flushing. */
+        guac_rdp_audio_buffer_read_ring(audio_buffer, position,
+                audio_buffer->packet, packet_size);
+
+        if (flush_handler)
+            flush_handler(audio_buffer, packet_size);
+
+        /* Release flushed packet back to the producer */
+        pthread_mutex_lock(&(audio_buffer->lock));
+        audio_buffer->ring_tail += packet_size;
+        audio_buffer->flushing = 0;
+        stats->packets_sent++;
+
+        pthread_cond_broadcast(&(audio_buffer->modified));
+
     }
 
+    pthread_mutex_unlock(&(audio_buffer->lock));
+
     return NULL;
 
 }
@@ -331,7 +496,7 @@ static void* guac_rdp_audio_buffer_ack(guac_user* user, void* data) {
     guac_stream* stream = audio_buffer->stream;
 
     /* Do not send ack unless both sides of the audio stream are ready */
-    if (user == NULL || stream == NULL || audio_buffer->packet == NULL)
+    if (user == NULL || stream == NULL || audio_buffer->ring == NULL)
         return NULL;
 
     /* Send ack instruction */
@@ -347,6 +512,14 @@ void guac_rdp_audio_buffer_set_stream(guac_rdp_audio_buffer* audio_buffer,
 
     pthread_mutex_lock(&(audio_buffer->lock));
 
+    /* Restart conversion and statistics for the new stream, retaining any
+     * audio already converted for the RDP server */
+    guac_rdp_audio_buffer_wait_idle(audio_buffer);
+    audio_buffer->frames_received = 0;
+    audio_buffer->frames_sent = 0;
+    audio_buffer->partial_length = 0;
+    memset(&audio_buffer->stats, 0, sizeof(audio_buffer->stats));
+
     /* Associate received stream */
     audio_buffer->user = user;
     audio_buffer->stream = stream;
@@ -364,6 +537,14 @@ void guac_rdp_audio_buffer_set_stream(guac_rdp_audio_buffer* audio_buffer,
             audio_buffer->in_format.rate,
             audio_buffer->in_format.bps);
 
+    /* Received audio will be ignored if it cannot be converted */
+    if (rate <= 0 || channels <= 0
+            || channels > GUAC_RDP_AUDIO_BUFFER_MAX_CHANNELS) {
+        guac_user_log(user, GUAC_LOG_WARNING, "Audio input from user will be "
+                "ignored (unsupported rate or number of channels).");
+        audio_buffer->in_format.channels = 0;
+    }
+
     pthread_cond_broadcast(&(audio_buffer->modified));
     pthread_mutex_unlock(&(audio_buffer->lock));
 
@@ -391,7 +572,8 @@ void guac_rdp_audio_buffer_begin(guac_rdp_audio_buffer* audio_buffer,
     pthread_mutex_lock(&(audio_buffer->lock));
 
     /* Reset buffer state to provided values */
-    audio_buffer->bytes_written = 0;
+    guac_rdp_audio_buffer_wait_idle(audio_buffer);
+    guac_rdp_audio_buffer_reset(audio_buffer);
     audio_buffer->flush_handler = flush_handler;
     audio_buffer->data = data;
 
@@ -410,12 +592,16 @@ void guac_rdp_audio_buffer_begin(guac_rdp_audio_buffer* audio_buffer,
                 guac_mem_ckd_add_or_die(ideal_size, audio_buffer->packet_size), 1
             ) / audio_buffer->packet_size;
 
-    /* Allocate new buffer */
+    /* Allocate new ring buffer and packet, replacing any from a previous
+     * call that was not matched by guac_rdp_audio_buffer_end() */
+    guac_mem_free(audio_buffer->ring);
+    guac_mem_free(audio_buffer->packet);
     audio_buffer->packet_buffer_size = guac_mem_ckd_mul_or_die(ideal_packets, audio_buffer->packet_size);
-    audio_buffer->packet = guac_mem_alloc(audio_buffer->packet_buffer_size);
+    audio_buffer->ring = guac_mem_alloc(audio_buffer->packet_buffer_size);
+    audio_buffer->packet = guac_mem_alloc(audio_buffer->packet_size);
 
     guac_client_log(audio_buffer->client, GUAC_LOG_DEBUG, "Output buffer for "
-            "audio input is %i bytes (up to %i ms).", audio_buffer->packet_buffer_size,
+            "audio input is %zu bytes (up to %i ms).", audio_buffer->packet_buffer_size,
             guac_rdp_audio_buffer_duration(&audio_buffer->out_format, audio_buffer->packet_buffer_size));
 
     /* Next flush can occur as soon as data is received */
@@ -433,148 +619,306 @@ void guac_rdp_audio_buffer_begin(guac_rdp_audio_buffer* audio_buffer,
 }
 
 /**
- * Reads a single sample from the given buffer of data, using the input
- * format defined within the given audio buffer. Each read sample is
- * translated to a signed 16-bit value, even if the input format is 8-bit.
- * The offset into the given buffer will be determined according to the
- * input and output formats, the number of bytes sent thus far, and the
- * number of bytes received (excluding the contents of the buffer).
+ * Reads a single sample from the given buffer of PCM data, translating the
+ * sample to a signed 16-bit value, even if the sample is 8-bit.
  *
- * IMPORTANT: The guac_rdp_audio_buffer's lock MUST already be held when
- * invoking this function.
+ * @param buffer
+ *     The buffer containing the sample. 16-bit samples are little-endian.
  *
- * @param audio_buffer
- *     The audio buffer dictating the format of the given data buffer, as
- *     well as the offset from which the sample should be read.
+ * @param bps
+ *     The size of the sample, in bytes. This must be 1 or 2.
+ *
+ * @return
+ *     The value of the sample as a signed 16-bit value.
+ */
+static inline int guac_rdp_audio_buffer_read_sample(const unsigned char* buffer,
+        int bps) {
+
+    /* Translate to 16-bit if input is 8-bit */
+    if (bps == 1)
+        return ((buffer[0] ^ 0x80) - 0x80) * 256;
+
+    return (((buffer[1] ^ 0x80) << 8) | buffer[0]) - 0x8000;
+
+}
+
+/**
+ * Writes a single signed 16-bit sample to the given buffer, reducing the
+ * sample to 8-bit if required.
  *
  * @param buffer
- *     The buffer of raw PCM audio data from which the sample should be read.
- *     This buffer MUST NOT contain data already taken into account by the
- *     audio buffer's total_bytes_received counter.
+ *     The buffer which should receive the sample. 16-bit samples are written
+ *     little-endian.
  *
- * @param length
- *     The number of bytes within the given buffer of PCM data.
+ * @param bps
+ *     The size of the sample to write, in bytes. This must be 1 or 2.
  *
  * @param sample
- *     A pointer to the int16_t in which the read sample should be stored. If
- *     the input format is 8-bit, the sample will be shifted left by 8 bits
- *     to produce a 16-bit sample.
+ *     The value of the sample as a signed 16-bit value.
+ */
+static inline void guac_rdp_audio_buffer_write_sample(unsigned char* buffer,
+        int bps, int sample) {
+
+    /* Store as 16-bit or 8-bit, depending on output format */
+    if (bps == 1)
+        buffer[0] = (sample >> 8) & 0xFF;
+
+    else {
+        buffer[0] = sample & 0xFF;
+        buffer[1] = (sample >> 8) & 0xFF;
+    }
+
+}
+
+/**
+ * Converts the given block of complete input frames to the output format,
+ * storing the result within the ring buffer. Output frames are mapped to
+ * input frames by sample rate, with each output channel taken from the
+ * input channel of the same index (or the last input channel, if the input
+ * has fewer channels). Output frames that do not fit within the available
+ * space are counted as dropped.
+ *
+ * This function is invoked only by the producer with the lock released. It
+ * touches only the region of the ring buffer between the head and the
+ * available space, which the flush thread never reads.
+ *
+ * @param audio_buffer
+ *     The audio buffer receiving the frames.
+ *
+ * @param data
+ *     The complete input frames to convert.
+ *
+ * @param frames
+ *     The number of input frames provided.
+ *
+ * @param head
+ *     The absolute position within the ring buffer that the next output
+ *     frame should be written to. This value is updated as frames are
+ *     written.
+ *
+ * @param space
+ *     The number of bytes of space available within the ring buffer. This
+ *     value is updated as frames are written.
  *
  * @return
- *     Non-zero if a sample was successfully read, zero if no data remains
- *     within the given buffer that has not already been mapped to an
- *     output sample.
+ *     The number of output frames dropped due to insufficient space.
  */
-static int guac_rdp_audio_buffer_read_sample(
-        guac_rdp_audio_buffer* audio_buffer, const char* buffer, int length,
-        int16_t* sample) {
-
-    int in_bps = audio_buffer->in_format.bps;
-    int in_rate = audio_buffer->in_format.rate;
-    int in_channels = audio_buffer->in_format.channels;
-
-    int out_bps = audio_buffer->out_format.bps;
-    int out_rate = audio_buffer->out_format.rate;
-    int out_channels = audio_buffer->out_format.channels;
-
-    /* Calculate position within audio output */
-    int current_sample  = audio_buffer->total_bytes_sent / out_bps;
-    int current_frame   = current_sample / out_channels;
-    int current_channel = current_sample % out_channels;
-
-    /* Map output channel to input channel */
-    if (current_channel >= in_channels)
-        current_channel = in_channels - 1;
-
-    /* Transform output position to input position */
-    current_frame = (int) current_frame * ((double) in_rate / out_rate);
-    current_sample = current_frame * in_channels + current_channel;
-
-    /* Calculate offset within given buffer from absolute input position */
-    int offset = current_sample * in_bps
-               - audio_buffer->total_bytes_received;
-
-    /* It should be impossible for the offset to ever go negative */
-    assert(offset >= 0);
-
-    /* Apply offset to buffer */
-    buffer += offset;
-    length -= offset;
-
-    /* Read only if sufficient data is present in the given buffer */
-    if (length < in_bps)
-        return 0;
-
-    /* Simply read sample directly if input is 16-bit */
-    if (in_bps == 2) {
-        *sample = *((int16_t*) buffer);
-        return 1;
+static uint64_t guac_rdp_audio_buffer_convert(guac_rdp_audio_buffer* audio_buffer,
+        const unsigned char* data, int frames, uint64_t* head, size_t* space) {
+
+    const guac_rdp_audio_format* in_format = &audio_buffer->in_format;
+    const guac_rdp_audio_format* out_format = &audio_buffer->out_format;
+
+    int in_frame_size = in_format->channels * in_format->bps;
+    int out_frame_size = out_format->channels * out_format->bps;
+
+    uint64_t first = audio_buffer->frames_received;
+    uint64_t end = first + frames;
+    uint64_t dropped = 0;
+
+    /* Copy blocks verbatim if no conversion is needed. As the ring is a
+     * whole number of output frames, no frame will straddle the end. */
+    if (in_format->rate == out_format->rate
+            && in_format->channels == out_format->channels
+            && in_format->bps == out_format->bps) {
+
+        size_t length = (size_t) frames * in_frame_size;
+        if (length > *space) {
+            dropped = (length - *space) / out_frame_size;
+            length = *space;
+        }
+
+        size_t offset = *head % audio_buffer->packet_buffer_size;
+        size_t contiguous = audio_buffer->packet_buffer_size - offset;
+        if (contiguous > length)
+            contiguous = length;
+
+        memcpy(audio_buffer->ring + offset, data, contiguous);
+        memcpy(audio_buffer->ring, data + contiguous, length - contiguous);
+
+        *head += length;
+        *space -= length;
+
+        audio_buffer->frames_received = end;
+        audio_buffer->frames_sent += frames;
+        return dropped;
+
     }
 
-    /* Translate to 16-bit if input is 8-bit */
-    if (in_bps == 1) {
-        *sample = *buffer << 8;
-        return 1;
+    /* Map output channels to input channels */
+    int channel_offset[GUAC_RDP_AUDIO_BUFFER_MAX_CHANNELS];
+    int out_channels = out_format->channels;
+    if (out_channels > GUAC_RDP_AUDIO_BUFFER_MAX_CHANNELS)
+        out_channels = GUAC_RDP_AUDIO_BUFFER_MAX_CHANNELS;
+
+    for (int channel = 0; channel < out_channels; channel++) {
+        int in_channel = channel;
+        if (in_channel >= in_format->channels)
+            in_channel = in_format->channels - 1;
+        channel_offset[channel] = in_channel * in_format->bps;
+    }
+
+    for (;;) {
+
+        /* Transform output position to input position */
+        uint64_t in_frame = audio_buffer->frames_sent
+            * in_format->rate / out_format->rate;
+
+        /* Stop once all provided input has been used */
+        if (in_frame >= end)
+            break;
+
+        audio_buffer->frames_sent++;
+
+        /* Drop frames that do not fit */
+        if (*space < (size_t) out_frame_size) {
+            dropped++;
+            continue;
+        }
+
+        const unsigned char* in = data + (in_frame - first) * in_frame_size;
+        unsigned char* out = (unsigned char*) audio_buffer->ring
+            + *head % audio_buffer->packet_buffer_size;
+
+        for (int channel = 0; channel < out_channels; channel++) {
+            int sample = guac_rdp_audio_buffer_read_sample(
+                    in + channel_offset[channel], in_format->bps);
+            guac_rdp_audio_buffer_write_sample(out, out_format->bps, sample);
+            out += out_format->bps;
+        }
+
+        *head += out_frame_size;
+        *space -= out_frame_size;
+
+    }
+
+    audio_buffer->frames_received = end;
+    return dropped;
+
+}
+
+/**
+ * Updates the interarrival jitter statistics of the given audio buffer to
+ * reflect the receipt of a new blob of audio data, as described by RFC 3550.
+ *
+ * IMPORTANT: The guac_rdp_audio_buffer's lock MUST already be held when
+ * invoking this function.
+ *
+ * @param audio_buffer
+ *     The guac_rdp_audio_buffer receiving audio data.
+ */
+static void guac_rdp_audio_buffer_update_jitter(guac_rdp_audio_buffer* audio_buffer) {
+
+    guac_rdp_audio_buffer_stats* stats = &audio_buffer->stats;
+
+    /* Relative transit time is the difference between the arrival time and
+     * the point within the audio stream that the received data begins */
+    int64_t position = (int64_t) (audio_buffer->frames_received
+            * MICROS_PER_SECOND / audio_buffer->in_format.rate);
+    int64_t transit = guac_rdp_audio_buffer_now() - position;
+
+    if (stats->blobs_received > 0) {
+
+        int64_t difference = transit - stats->last_transit;
+        if (difference < 0)
+            difference = -difference;
+
+        stats->jitter += (difference - stats->jitter)
+            / GUAC_RDP_AUDIO_BUFFER_JITTER_SMOOTHING;
+
+        if (stats->jitter > stats->max_jitter)
+            stats->max_jitter = stats->jitter;
+
     }
 
-    /* Accepted audio formats are required to be 8- or 16-bit */
-    return 0;
+    stats->last_transit = transit;
+    stats->blobs_received++;
 
 }
 
 void guac_rdp_audio_buffer_write(guac_rdp_audio_buffer* audio_buffer,
         char* buffer, int length) {
 
-    int16_t sample;
+    const unsigned char* data = (const unsigned char*) buffer;
 
     pthread_mutex_lock(&(audio_buffer->lock));
 
-    guac_client_log(audio_buffer->client, GUAC_LOG_TRACE, "Received %i bytes (%i ms) of audio data",
-            length, guac_rdp_audio_buffer_duration(&audio_buffer->in_format, length));
+    /* Only one producer may write to the ring at any given time */
+    while (audio_buffer->writing)
+        pthread_cond_wait(&audio_buffer->modified, &audio_buffer->lock);
 
-    /* Ignore packet if there is no buffer */
-    if (audio_buffer->packet_buffer_size == 0 || audio_buffer->packet == NULL) {
+    /* Ignore packet if there is no buffer or the format is unsupported */
+    if (audio_buffer->packet_buffer_size == 0 || audio_buffer->ring == NULL
+            || audio_buffer->in_format.channels == 0) {
         guac_client_log(audio_buffer->client, GUAC_LOG_DEBUG, "Dropped %i "
                 "bytes of received audio data (buffer full or closed).", length);
         pthread_mutex_unlock(&(audio_buffer->lock));
         return;
     }
 
-    /* Truncate received samples if exceeding size of buffer */
-    int available = audio_buffer->packet_buffer_size - audio_buffer->bytes_written;
-    if (length > available) {
-        guac_client_log(audio_buffer->client, GUAC_LOG_DEBUG, "Truncating %i "
-                "bytes of received audio data to %i bytes (insufficient space "
-                "in buffer).", length, available);
-        length = available;
-    }
+    guac_client_log(audio_buffer->client, GUAC_LOG_TRACE, "Received %i bytes (%i ms) of audio data",
+            length, guac_rdp_audio_buffer_duration(&audio_buffer->in_format, length));
 
-    int out_bps = audio_buffer->out_format.bps;
+    guac_rdp_audio_buffer_update_jitter(audio_buffer);
 
-    /* Continuously write packets until no data remains */
-    while (guac_rdp_audio_buffer_read_sample(audio_buffer,
-                buffer, length, &sample) > 0) {
+    /* Reserve all currently-free space within the ring */
+    uint64_t head = audio_buffer->ring_head;
+    size_t space = audio_buffer->packet_buffer_size
+        - guac_rdp_audio_buffer_buffered(audio_buffer);
 
-        char* current = audio_buffer->packet + audio_buffer->bytes_written;
+    audio_buffer->writing = 1;
+    pthread_mutex_unlock(&(audio_buffer->lock));
 
-        /* Store as 16-bit or 8-bit, depending on output format */
-        if (out_bps == 2)
-            *((int16_t*) current) = sample;
-        else if (out_bps == 1)
-            *current = sample >> 8;
+    int frame_size = audio_buffer->in_format.channels * audio_buffer->in_format.bps;
+    uint64_t dropped = 0;
 
-        /* Accepted audio formats are required to be 8- or 16-bit */
-        else
-            assert(0);
+    /* Complete any frame split across the previous blob */
+    if (audio_buffer->partial_length > 0) {
 
-        /* Update byte counters */
-        audio_buffer->bytes_written += out_bps;
-        audio_buffer->total_bytes_sent += out_bps;
+        int remaining = frame_size - audio_buffer->partial_length;
+        if (remaining > length)
+            remaining = length;
 
-    } /* end packet write loop */
+        memcpy(audio_buffer->partial + audio_buffer->partial_length, data,
+                remaining);
 
-    /* Track current position in audio stream */
-    audio_buffer->total_bytes_received += length;
+        audio_buffer->partial_length += remaining;
+        data += remaining;
+        length -= remaining;
+
+        if (audio_buffer->partial_length == frame_size) {
+            dropped += guac_rdp_audio_buffer_convert(audio_buffer,
+                    (const unsigned char*) audio_buffer->partial, 1,
+                    &head, &space);
+            audio_buffer->partial_length = 0;
+        }
+
+    }
+
+    /* Convert all complete frames as a single block */
+    int frames = length / frame_size;
+    dropped += guac_rdp_audio_buffer_convert(audio_buffer, data, frames,
+            &head, &space);
+
+    /* Retain any trailing partial frame until the next blob */
+    int trailing = length - frames * frame_size;
+    if (trailing > 0) {
+        memcpy(audio_buffer->partial, data + frames * frame_size, trailing);
+        audio_buffer->partial_length = trailing;
+    }
+
+    /* Commit converted data, making it available to the flush thread */
+    pthread_mutex_lock(&(audio_buffer->lock));
+
+    if (dropped > 0) {
+        guac_client_log(audio_buffer->client, GUAC_LOG_DEBUG, "Dropped %"
+                PRIu64 " frames of received audio data (insufficient space "
+                "in buffer).", dropped);
+        audio_buffer->stats.frames_dropped += dropped;
+    }
+
+    audio_buffer->ring_head = head;
+    audio_buffer->writing = 0;
 
     pthread_cond_broadcast(&(audio_buffer->modified));
     pthread_mutex_unlock(&(audio_buffer->lock));
@@ -601,17 +945,26 @@ void guac_rdp_audio_buffer_end(guac_rdp_audio_buffer* audio_buffer) {
     audio_buffer->user = NULL;
     audio_buffer->stream = NULL;
 
+    /* Wait for any in-progress write or flush to complete */
+    guac_rdp_audio_buffer_wait_idle(audio_buffer);
+
+    guac_rdp_audio_buffer_stats* stats = &audio_buffer->stats;
+    guac_client_log(audio_buffer->client, GUAC_LOG_DEBUG, "Audio input "
+            "statistics: %i blobs received, %i packets sent, %" PRIu64
+            " frames dropped, %i underruns, interarrival jitter %i ms (peak "
+            "%i ms), peak buffered audio %zu bytes.", stats->blobs_received,
+            stats->packets_sent, stats->frames_dropped, stats->underruns,
+            (int) (stats->jitter / 1000), (int) (stats->max_jitter / 1000),
+            stats->max_buffered);
+
     /* Reset buffer state */
-    audio_buffer->bytes_written = 0;
+    guac_rdp_audio_buffer_reset(audio_buffer);
     audio_buffer->packet_size = 0;
     audio_buffer->packet_buffer_size = 0;
     audio_buffer->flush_handler = NULL;
 
-    /* Reset I/O counters */
-    audio_buffer->total_bytes_sent = 0;
-    audio_buffer->total_bytes_received = 0;
-
-    /* Free packet (if any) */
+    /* Free ring and packet (if any) */
+    guac_mem_free(audio_buffer->ring);
     guac_mem_free(audio_buffer->packet);
 
     pthread_cond_broadcast(&(audio_buffer->modified));
@@ -632,9 +985,13 @@ void guac_rdp_audio_buffer_free(guac_rdp_audio_buffer* audio_buffer) {
     /* Clean up flush thread */
     pthread_join(audio_buffer->flush_thread, NULL);
 
+    /* Free ring and packet if guac_rdp_audio_buffer_end() had nothing to
+     * end */
+    guac_mem_free(audio_buffer->ring);
+    guac_mem_free(audio_buffer->packet);
+
     pthread_mutex_destroy(&(audio_buffer->lock));
     pthread_cond_destroy(&(audio_buffer->modified));
     guac_mem_free(audio_buffer);
 
 }
-
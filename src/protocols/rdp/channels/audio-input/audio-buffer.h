@@ -23,6 +23,7 @@
 #include <guacamole/stream.h>
 #include <guacamole/user.h>
 #include <pthread.h>
+#include <stdint.h>
 #include <time.h>
 
 /**
@@ -34,6 +35,19 @@
  */
 #define GUAC_RDP_AUDIO_BUFFER_MIN_DURATION 250
 
+/**
+ * The maximum number of channels that may be present in audio received from
+ * the user. Audio streams with more channels than this are ignored.
+ */
+#define GUAC_RDP_AUDIO_BUFFER_MAX_CHANNELS 8
+
+/**
+ * The weight given to each new measurement of interarrival jitter, expressed
+ * as the reciprocal of that weight (the jitter estimate moves 1/16th of the
+ * way toward each new measurement, as described by RFC 3550).
+ */
+#define GUAC_RDP_AUDIO_BUFFER_JITTER_SMOOTHING 16
+
 /**
  * A buffer of arbitrary audio data. Received audio data can be written to this
  * buffer, and will automatically be flushed via a given handler once the
@@ -79,12 +93,74 @@ typedef struct guac_rdp_audio_format {
 
 } guac_rdp_audio_format;
 
+/**
+ * Statistics describing the behavior of the jitter buffer of a
+ * guac_rdp_audio_buffer for the current audio stream. These statistics are
+ * reset whenever a new audio stream begins and are logged when the stream
+ * ends.
+ */
+typedef struct guac_rdp_audio_buffer_stats {
+
+    /**
+     * The number of blobs of audio data received from the user.
+     */
+    int blobs_received;
+
+    /**
+     * The number of audio packets flushed to the RDP server.
+     */
+    int packets_sent;
+
+    /**
+     * The number of output frames dropped because the buffer was full.
+     */
+    uint64_t frames_dropped;
+
+    /**
+     * The number of times the buffer ran dry, such that a packet was flushed
+     * to the RDP server more than one packet's duration later than
+     * scheduled.
+     */
+    int underruns;
+
+    /**
+     * The current estimate of interarrival jitter of received audio data, in
+     * microseconds, calculated as described by RFC 3550: the smoothed
+     * absolute difference between the time elapsed between the arrival of
+     * consecutive blobs and the duration of audio those blobs represent.
+     */
+    int64_t jitter;
+
+    /**
+     * The greatest interarrival jitter estimate observed, in microseconds.
+     */
+    int64_t max_jitter;
+
+    /**
+     * The greatest amount of audio data buffered at the time a packet was
+     * flushed, in bytes. This is the greatest latency added by the buffer.
+     */
+    size_t max_buffered;
+
+    /**
+     * The difference between the arrival time of the most recent blob and
+     * the point in the audio stream at which that blob begins, in
+     * microseconds. This is the "relative transit time" of RFC 3550.
+     */
+    int64_t last_transit;
+
+} guac_rdp_audio_buffer_stats;
+
 struct guac_rdp_audio_buffer {
 
     /**
-     * Lock which is acquired/released to ensure accesses to the audio buffer
-     * are atomic. This lock is also bound to the modified pthread_cond_t,
-     * which should be signalled whenever the audio buffer structure has been
+     * Lock which is acquired/released to ensure accesses to the state of the
+     * audio buffer are atomic. This lock guards only bookkeeping (ring
+     * positions, formats, and flags); audio data is converted into the ring
+     * and copied out of the ring by the producer and consumer without this
+     * lock held, within regions of the ring that the other side will not
+     * touch. This lock is also bound to the modified pthread_cond_t, which
+     * should be signalled whenever the audio buffer structure has been
      * modified.
      */
     pthread_mutex_t lock;
@@ -130,37 +206,86 @@ struct guac_rdp_audio_buffer {
 
     /**
      * The size that each audio packet must be, in bytes. The packet buffer
-     * within this structure will be at least this size.
+     * within this structure will be exactly this size, and the ring buffer
+     * will be a whole multiple of this size.
      */
     size_t packet_size;
 
     /**
-     * The total number of bytes available within the packet buffer.
+     * The total number of bytes available within the ring buffer. This is
+     * always a whole number of packets.
      */
     size_t packet_buffer_size;
 
     /**
-     * The number of bytes currently stored within the packet buffer.
+     * Ring buffer of converted audio data awaiting flush to the AUDIO_INPUT
+     * channel, in the output format. Data is written to the ring only by
+     * guac_rdp_audio_buffer_write() (the single producer) and read from the
+     * ring only by the flush thread (the single consumer).
+     */
+    char* ring;
+
+    /**
+     * The total number of bytes ever committed to the ring buffer since the
+     * audio stream began. The byte at this position modulo
+     * packet_buffer_size is the next to be written.
      */
-    int bytes_written;
+    uint64_t ring_head;
 
     /**
-     * The total number of bytes having ever been received by the Guacamole
-     * server for the current audio stream.
+     * The total number of bytes ever flushed from the ring buffer since the
+     * audio stream began. The byte at this position modulo
+     * packet_buffer_size is the next to be flushed.
      */
-    int total_bytes_received;
+    uint64_t ring_tail;
 
     /**
-     * The total number of bytes having ever been sent to the RDP server for
-     * the current audio stream.
+     * Non-zero if the producer is currently converting received audio data
+     * into the ring buffer without the lock held, zero otherwise.
      */
-    int total_bytes_sent;
+    int writing;
 
     /**
-     * All audio data being prepared for sending to the AUDIO_INPUT channel.
+     * Non-zero if the flush thread is currently copying a packet out of the
+     * ring buffer or invoking the flush handler without the lock held, zero
+     * otherwise.
+     */
+    int flushing;
+
+    /**
+     * The total number of input frames received from the user for the
+     * current audio stream.
+     */
+    uint64_t frames_received;
+
+    /**
+     * The total number of output frames produced for the current audio
+     * stream, including any frames dropped because the buffer was full.
+     */
+    uint64_t frames_sent;
+
+    /**
+     * Bytes of an input frame which was split across separate blobs.
+     */
+    char partial[GUAC_RDP_AUDIO_BUFFER_MAX_CHANNELS * 2];
+
+    /**
+     * The number of bytes currently stored within the partial buffer.
+     */
+    int partial_length;
+
+    /**
+     * The packet currently being flushed to the AUDIO_INPUT channel. This
+     * buffer is exactly packet_size bytes and is populated from the ring
+     * buffer immediately before the flush handler is invoked.
      */
     char* packet;
 
+    /**
+     * Jitter buffer statistics for the current audio stream.
+     */
+    guac_rdp_audio_buffer_stats stats;
+
     /**
      * Thread which flushes the audio buffer at a rate that does not exceed the
      * the audio sample rate (which might result in dropped samples due to
@@ -0,0 +1,498 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "channels/common-svc.h"
+#include "channels/rdpdr/rdpdr-fs-io.h"
+#include "channels/rdpdr/rdpdr.h"
+#include "fs.h"
+#include "rdp.h"
+
+#include <freerdp/channels/rdpdr.h>
+#include <guacamole/client.h>
+#include <guacamole/mem.h>
+#include <winpr/nt.h>
+#include <winpr/stream.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Performs the read described by the given job, returning the Device I/O
+ * Response which should be sent in reply. Data is read directly into the
+ * response, avoiding any intermediate buffer.
+ *
+ * @param pool
+ *     The pool performing the read.
+ *
+ * @param job
+ *     The read job to perform.
+ *
+ * @return
+ *     A newly-allocated wStream containing the Device I/O Response for the
+ *     read.
+ */
+static wStream* guac_rdpdr_fs_io_perform_read(guac_rdpdr_fs_io_pool* pool,
+        guac_rdpdr_fs_io_job* job) {
+
+    wStream* output_stream = guac_rdpdr_new_io_completion(pool->device,
+            job->completion_id, STATUS_SUCCESS, 4 + job->length);
+
+    /* Read directly into response, leaving room for length */
+    size_t length_position = Stream_GetPosition(output_stream);
+    Stream_Seek(output_stream, 4);
+    ssize_t bytes_read = pread(job->file->fd, Stream_Pointer(output_stream),
+            job->length, job->offset);
+
+    /* If error, replace response with one describing the failure */
+    if (bytes_read < 0) {
+        int status = guac_rdp_fs_get_status(guac_rdp_fs_get_errorcode(errno));
+        Stream_Free(output_stream, TRUE);
+        output_stream = guac_rdpdr_new_io_completion(pool->device,
+                job->completion_id, status, 4);
+        Stream_Write_UINT32(output_stream, 0); /* Length */
+        return output_stream;
+    }
+
+    /* Otherwise, fill in length of data read */
+    Stream_SetPosition(output_stream, length_position);
+    Stream_Write_UINT32(output_stream, bytes_read); /* Length */
+    Stream_Seek(output_stream, bytes_read);         /* ReadData */
+    return output_stream;
+
+}
+
+/**
+ * Performs the write described by the given job, returning the Device I/O
+ * Response which should be sent in reply.
+ *
+ * @param pool
+ *     The pool performing the write.
+ *
+ * @param job
+ *     The write job to perform.
+ *
+ * @param bytes_written
+ *     Pointer to an integer which will receive the number of bytes
+ *     successfully written.
+ *
+ * @return
+ *     A newly-allocated wStream containing the Device I/O Response for the
+ *     write.
+ */
+static wStream* guac_rdpdr_fs_io_perform_write(guac_rdpdr_fs_io_pool* pool,
+        guac_rdpdr_fs_io_job* job, ssize_t* bytes_written) {
+
+    wStream* output_stream;
+
+    /* Attempt write at given offset without disturbing file position */
+    *bytes_written = pwrite(job->file->fd, job->buffer, job->length,
+            job->offset);
+
+    /* If error, return appropriate status */
+    if (*bytes_written < 0) {
+        int status = guac_rdp_fs_get_status(guac_rdp_fs_get_errorcode(errno));
+        output_stream = guac_rdpdr_new_io_completion(pool->device,
+                job->completion_id, status, 5);
+        Stream_Write_UINT32(output_stream, 0); /* Length */
+        Stream_Write_UINT8(output_stream, 0);  /* Padding */
+        *bytes_written = 0;
+    }
+
+    /* Otherwise, send success */
+    else {
+        output_stream = guac_rdpdr_new_io_completion(pool->device,
+                job->completion_id, STATUS_SUCCESS, 5);
+        Stream_Write_UINT32(output_stream, *bytes_written); /* Length */
+        Stream_Write_UINT8(output_stream, 0);               /* Padding */
+    }
+
+    return output_stream;
+
+}
+
+/**
+ * Returns the given completed job to the free list of the given pool for
+ * reuse, or frees it if the free list is full. The pool lock must be held.
+ *
+ * @param pool
+ *     The pool that processed the job.
+ *
+ * @param job
+ *     The completed job.
+ */
+static void guac_rdpdr_fs_io_recycle(guac_rdpdr_fs_io_pool* pool,
+        guac_rdpdr_fs_io_job* job) {
+
+    if (pool->free_count >= GUAC_RDPDR_FS_IO_MAX_FREE_JOBS) {
+        guac_mem_free(job->buffer);
+        guac_mem_free(job);
+        return;
+    }
+
+    job->next = pool->free_jobs;
+    pool->free_jobs = job;
+    pool->free_count++;
+
+}
+
+/**
+ * Sends the responses of all completed jobs of the given pool, in the order
+ * that those jobs completed, recycling each job once its response has been
+ * sent. As the responses are taken from the pool and sent while the message
+ * lock is held, responses sent by concurrent invocations cannot be
+ * interleaved out of order. The RDP client's message lock must be held, and
+ * the pool lock must not be held.
+ *
+ * @param pool
+ *     The pool whose completed jobs should have their responses sent.
+ */
+static void guac_rdpdr_fs_io_send_completed(guac_rdpdr_fs_io_pool* pool) {
+
+    pthread_mutex_lock(&pool->lock);
+    guac_rdpdr_fs_io_job* job = pool->completed_head;
+    pool->completed_head = NULL;
+    pool->completed_tail = NULL;
+    pthread_mutex_unlock(&pool->lock);
+
+    while (job != NULL) {
+
+        guac_rdpdr_fs_io_job* next = job->next;
+
+        guac_rdp_common_svc_write(pool->svc, job->output_stream);
+        job->output_stream = NULL;
+
+        pthread_mutex_lock(&pool->lock);
+        guac_rdpdr_fs_io_recycle(pool, job);
+        pthread_mutex_unlock(&pool->lock);
+
+        job = next;
+
+    }
+
+}
+
+/**
+ * Sends the responses of all completed jobs of the given pool from a worker
+ * thread. The RDP thread may hold the message lock while waiting for this
+ * pool to be stopped, thus the message lock is awaited only until the pool
+ * is being stopped, with any responses still unsent being left for
+ * guac_rdpdr_fs_io_pool_free() to send.
+ *
+ * @param pool
+ *     The pool whose completed jobs should have their responses sent.
+ */
+static void guac_rdpdr_fs_io_worker_send(guac_rdpdr_fs_io_pool* pool) {
+
+    guac_rdp_client* rdp_client = (guac_rdp_client*) pool->svc->client->data;
+
+    for (;;) {
+
+        /* Stop if there is nothing to send (another thread may have already
+         * sent this worker's response) or if the pool is stopping */
+        pthread_mutex_lock(&pool->lock);
+        int done = pool->completed_head == NULL || pool->stopping;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (done)
+            return;
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+
+        uint64_t nsecs = deadline.tv_nsec
+            + (uint64_t) GUAC_RDPDR_FS_IO_SEND_INTERVAL * 1000000;
+
+        deadline.tv_sec += nsecs / 1000000000;
+        deadline.tv_nsec = nsecs % 1000000000;
+
+        if (pthread_mutex_timedlock(&(rdp_client->message_lock),
+                    &deadline) == 0) {
+            guac_rdpdr_fs_io_send_completed(pool);
+            pthread_mutex_unlock(&(rdp_client->message_lock));
+            return;
+        }
+
+    }
+
+}
+
+/**
+ * Worker thread which performs queued jobs until the pool is stopped and no
+ * jobs remain.
+ *
+ * @param data
+ *     The guac_rdpdr_fs_io_pool that the worker belongs to.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_rdpdr_fs_io_worker(void* data) {
+
+    guac_rdpdr_fs_io_pool* pool = (guac_rdpdr_fs_io_pool*) data;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+
+        /* Wait for work */
+        while (pool->queue_head == NULL && !pool->stopping)
+            pthread_cond_wait(&pool->job_queued, &pool->lock);
+
+        guac_rdpdr_fs_io_job* job = pool->queue_head;
+        if (job == NULL)
+            break;
+
+        pool->queue_head = job->next;
+        if (pool->queue_head == NULL)
+            pool->queue_tail = NULL;
+
+        pthread_mutex_unlock(&pool->lock);
+
+        /* Perform I/O outside the lock so jobs proceed in parallel */
+        wStream* output_stream;
+        ssize_t bytes_written = 0;
+        if (job->major_func == IRP_MJ_READ)
+            output_stream = guac_rdpdr_fs_io_perform_read(pool, job);
+        else
+            output_stream = guac_rdpdr_fs_io_perform_write(pool, job,
+                    &bytes_written);
+
+        /* Queue completion before releasing the file, such that
+         * guac_rdpdr_fs_io_wait() sends it before any completion for later
+         * requests affecting the file. The job must be released without
+         * acquiring the message lock, as guac_rdpdr_fs_io_wait() is invoked
+         * by the RDP thread while holding that lock. */
+        pthread_mutex_lock(&pool->lock);
+        job->file->bytes_written += bytes_written;
+        job->output_stream = output_stream;
+        job->next = NULL;
+
+        if (pool->completed_tail != NULL)
+            pool->completed_tail->next = job;
+        else
+            pool->completed_head = job;
+        pool->completed_tail = job;
+
+        pool->pending[job->file_id]--;
+        pthread_cond_broadcast(&pool->job_completed);
+        pthread_mutex_unlock(&pool->lock);
+
+        guac_rdpdr_fs_io_worker_send(pool);
+
+        pthread_mutex_lock(&pool->lock);
+
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+
+}
+
+/**
+ * Returns a job which may be populated and queued, reusing a previously
+ * completed job if possible. The pool lock must be held.
+ *
+ * @param pool
+ *     The pool that will process the job.
+ *
+ * @return
+ *     An unqueued job.
+ */
+static guac_rdpdr_fs_io_job* guac_rdpdr_fs_io_get_job(
+        guac_rdpdr_fs_io_pool* pool) {
+
+    guac_rdpdr_fs_io_job* job = pool->free_jobs;
+    if (job == NULL)
+        return guac_mem_zalloc(sizeof(guac_rdpdr_fs_io_job));
+
+    pool->free_jobs = job->next;
+    pool->free_count--;
+    return job;
+
+}
+
+/**
+ * Adds the given populated job to the end of the queue of the given pool,
+ * waking a worker to process it. The pool lock must be held.
+ *
+ * @param pool
+ *     The pool that should process the job.
+ *
+ * @param job
+ *     The job to queue.
+ */
+static void guac_rdpdr_fs_io_queue(guac_rdpdr_fs_io_pool* pool,
+        guac_rdpdr_fs_io_job* job) {
+
+    job->next = NULL;
+    if (pool->queue_tail != NULL)
+        pool->queue_tail->next = job;
+    else
+        pool->queue_head = job;
+    pool->queue_tail = job;
+
+    pool->pending[job->file_id]++;
+    pthread_cond_signal(&pool->job_queued);
+
+}
+
+guac_rdpdr_fs_io_pool* guac_rdpdr_fs_io_pool_alloc(guac_rdp_common_svc* svc,
+        guac_rdpdr_device* device) {
+
+    guac_rdpdr_fs_io_pool* pool =
+        guac_mem_zalloc(sizeof(guac_rdpdr_fs_io_pool));
+
+    pool->svc = svc;
+    pool->device = device;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->job_queued, NULL);
+    pthread_cond_init(&pool->job_completed, NULL);
+
+    /* Start as many workers as possible */
+    for (int i = 0; i < GUAC_RDPDR_FS_IO_THREADS; i++) {
+        if (pthread_create(&pool->workers[pool->worker_count], NULL,
+                    guac_rdpdr_fs_io_worker, pool))
+            break;
+        pool->worker_count++;
+    }
+
+    /* Fall back to synchronous I/O if no workers could be started */
+    if (pool->worker_count == 0) {
+        guac_client_log(svc->client, GUAC_LOG_WARNING, "Unable to start "
+                "filesystem I/O threads. Drive I/O will be performed "
+                "synchronously.");
+        pthread_cond_destroy(&pool->job_completed);
+        pthread_cond_destroy(&pool->job_queued);
+        pthread_mutex_destroy(&pool->lock);
+        guac_mem_free(pool);
+        return NULL;
+    }
+
+    return pool;
+
+}
+
+void guac_rdpdr_fs_io_pool_free(guac_rdpdr_fs_io_pool* pool) {
+
+    /* Signal workers to exit once all queued jobs are complete */
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->job_queued);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->worker_count; i++)
+        pthread_join(pool->workers[i], NULL);
+
+    /* Send any completions which the workers left unsent */
+    guac_rdp_client* rdp_client = (guac_rdp_client*) pool->svc->client->data;
+    pthread_mutex_lock(&(rdp_client->message_lock));
+    guac_rdpdr_fs_io_send_completed(pool);
+    pthread_mutex_unlock(&(rdp_client->message_lock));
+
+    /* Free all retained jobs */
+    guac_rdpdr_fs_io_job* job = pool->free_jobs;
+    while (job != NULL) {
+        guac_rdpdr_fs_io_job* next = job->next;
+        guac_mem_free(job->buffer);
+        guac_mem_free(job);
+        job = next;
+    }
+
+    pthread_cond_destroy(&pool->job_completed);
+    pthread_cond_destroy(&pool->job_queued);
+    pthread_mutex_destroy(&pool->lock);
+    guac_mem_free(pool);
+
+}
+
+void guac_rdpdr_fs_io_read(guac_rdpdr_fs_io_pool* pool,
+        guac_rdpdr_iorequest* iorequest, guac_rdp_fs_file* file,
+        uint64_t offset, int length) {
+
+    pthread_mutex_lock(&pool->lock);
+
+    guac_rdpdr_fs_io_job* job = guac_rdpdr_fs_io_get_job(pool);
+    job->major_func = IRP_MJ_READ;
+    job->file_id = iorequest->file_id;
+    job->completion_id = iorequest->completion_id;
+    job->file = file;
+    job->offset = offset;
+    job->length = length;
+
+    guac_rdpdr_fs_io_queue(pool, job);
+    pthread_mutex_unlock(&pool->lock);
+
+}
+
+void guac_rdpdr_fs_io_write(guac_rdpdr_fs_io_pool* pool,
+        guac_rdpdr_iorequest* iorequest, guac_rdp_fs_file* file,
+        uint64_t offset, const void* data, int length) {
+
+    pthread_mutex_lock(&pool->lock);
+    guac_rdpdr_fs_io_job* job = guac_rdpdr_fs_io_get_job(pool);
+    pthread_mutex_unlock(&pool->lock);
+
+    /* Grow buffer of reused job only if necessary */
+    if (job->buffer_size < length) {
+        guac_mem_free(job->buffer);
+        job->buffer = guac_mem_alloc(length);
+        job->buffer_size = length;
+    }
+
+    /* Copy data, as the received PDU will be freed once handled */
+    memcpy(job->buffer, data, length);
+
+    job->major_func = IRP_MJ_WRITE;
+    job->file_id = iorequest->file_id;
+    job->completion_id = iorequest->completion_id;
+    job->file = file;
+    job->offset = offset;
+    job->length = length;
+
+    pthread_mutex_lock(&pool->lock);
+    guac_rdpdr_fs_io_queue(pool, job);
+    pthread_mutex_unlock(&pool->lock);
+
+}
+
+void guac_rdpdr_fs_io_wait(guac_rdpdr_fs_io_pool* pool, int file_id) {
+
+    /* Requests for invalid file IDs cannot have outstanding I/O */
+    if (file_id < 0 || file_id >= GUAC_RDP_FS_MAX_FILES)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending[file_id] > 0)
+        pthread_cond_wait(&pool->job_completed, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+
+    /* Send completions of the awaited jobs before those of any later
+     * requests (the message lock is recursive, and is typically already held
+     * by the RDP thread) */
+    guac_rdp_client* rdp_client = (guac_rdp_client*) pool->svc->client->data;
+    pthread_mutex_lock(&(rdp_client->message_lock));
+    guac_rdpdr_fs_io_send_completed(pool);
+    pthread_mutex_unlock(&(rdp_client->message_lock));
+
+}
+
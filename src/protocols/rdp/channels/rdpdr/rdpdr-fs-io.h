@@ -0,0 +1,310 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_RDP_CHANNELS_RDPDR_FS_IO_H
+#define GUAC_RDP_CHANNELS_RDPDR_FS_IO_H
+
+/**
+ * Asynchronous handling of the bulk data requests (reads and writes) of a
+ * redirected filesystem. Such requests are performed by a small pool of
+ * worker threads, with each completion sent as soon as its I/O finishes
+ * rather than in the order requests were received. Completions are queued
+ * before being sent, as sending requires the RDP client's message lock, which
+ * is held by the RDP thread while it waits for outstanding I/O.
+ *
+ * @file rdpdr-fs-io.h
+ */
+
+#include "channels/common-svc.h"
+#include "channels/rdpdr/rdpdr.h"
+#include "fs.h"
+
+#include <winpr/stream.h>
+
+#include <pthread.h>
+#include <stdint.h>
+
+/**
+ * The number of worker threads performing I/O for each redirected
+ * filesystem.
+ */
+#define GUAC_RDPDR_FS_IO_THREADS 4
+
+/**
+ * The maximum number of completed jobs (and their data buffers) to retain
+ * for reuse by later write requests.
+ */
+#define GUAC_RDPDR_FS_IO_MAX_FREE_JOBS 16
+
+/**
+ * The number of milliseconds that a worker thread should wait to acquire the
+ * RDP client's message lock, in order to send queued completions, before
+ * checking whether the pool is being stopped.
+ */
+#define GUAC_RDPDR_FS_IO_SEND_INTERVAL 10
+
+/**
+ * A single read or write request awaiting or undergoing processing by a
+ * worker thread.
+ */
+typedef struct guac_rdpdr_fs_io_job {
+
+    /**
+     * The major function of the request, either IRP_MJ_READ or IRP_MJ_WRITE.
+     */
+    int major_func;
+
+    /**
+     * The ID of the file being read or written.
+     */
+    int file_id;
+
+    /**
+     * The completion ID which must be included in the response to the
+     * request.
+     */
+    int completion_id;
+
+    /**
+     * The file being read or written. This file is guaranteed to remain open
+     * until the job completes, as all other requests affecting the file wait
+     * for its outstanding jobs.
+     */
+    guac_rdp_fs_file* file;
+
+    /**
+     * The offset within the file at which the read or write begins.
+     */
+    uint64_t offset;
+
+    /**
+     * The number of bytes to read or write.
+     */
+    int length;
+
+    /**
+     * The data to be written, if this job is a write. This buffer is retained
+     * when the job is recycled and may be larger than length.
+     */
+    char* buffer;
+
+    /**
+     * The size of buffer, in bytes.
+     */
+    int buffer_size;
+
+    /**
+     * The Device I/O Response to send once the job has completed, or NULL if
+     * the job has not yet completed.
+     */
+    wStream* output_stream;
+
+    /**
+     * The next job in the queue, completed list, or free list, or NULL if this
+     * is the last.
+     */
+    struct guac_rdpdr_fs_io_job* next;
+
+} guac_rdpdr_fs_io_job;
+
+/**
+ * A pool of worker threads performing the reads and writes of a single
+ * redirected filesystem device.
+ */
+typedef struct guac_rdpdr_fs_io_pool {
+
+    /**
+     * The static virtual channel along which completions are sent.
+     */
+    guac_rdp_common_svc* svc;
+
+    /**
+     * The device whose reads and writes are being performed.
+     */
+    guac_rdpdr_device* device;
+
+    /**
+     * Lock which guards all other members of this structure, as well as the
+     * bytes_written counters of files having outstanding writes.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition which is signalled whenever a job is added to the queue or
+     * the pool is being stopped.
+     */
+    pthread_cond_t job_queued;
+
+    /**
+     * Condition which is signalled whenever a job completes.
+     */
+    pthread_cond_t job_completed;
+
+    /**
+     * The worker threads of this pool.
+     */
+    pthread_t workers[GUAC_RDPDR_FS_IO_THREADS];
+
+    /**
+     * The number of worker threads successfully started.
+     */
+    int worker_count;
+
+    /**
+     * The oldest queued job, or NULL if no jobs are queued.
+     */
+    guac_rdpdr_fs_io_job* queue_head;
+
+    /**
+     * The most recently queued job, or NULL if no jobs are queued.
+     */
+    guac_rdpdr_fs_io_job* queue_tail;
+
+    /**
+     * The oldest completed job whose response has not yet been sent, or NULL
+     * if all responses have been sent.
+     */
+    guac_rdpdr_fs_io_job* completed_head;
+
+    /**
+     * The most recently completed job whose response has not yet been sent,
+     * or NULL if all responses have been sent.
+     */
+    guac_rdpdr_fs_io_job* completed_tail;
+
+    /**
+     * Completed jobs available for reuse.
+     */
+    guac_rdpdr_fs_io_job* free_jobs;
+
+    /**
+     * The number of jobs within free_jobs.
+     */
+    int free_count;
+
+    /**
+     * The number of queued or running jobs for each file ID. Jobs whose I/O
+     * has finished are not counted, even if their responses have not yet been
+     * sent.
+     */
+    int pending[GUAC_RDP_FS_MAX_FILES];
+
+    /**
+     * Non-zero if the worker threads should exit once the queue is empty.
+     */
+    int stopping;
+
+} guac_rdpdr_fs_io_pool;
+
+/**
+ * Allocates a new pool of worker threads which will perform reads and writes
+ * for the given filesystem device, sending each completion along the given
+ * channel.
+ *
+ * @param svc
+ *     The static virtual channel being used for RDPDR.
+ *
+ * @param device
+ *     The filesystem device whose I/O should be performed by the new pool.
+ *
+ * @return
+ *     A newly-allocated pool, or NULL if no worker threads could be started.
+ */
+guac_rdpdr_fs_io_pool* guac_rdpdr_fs_io_pool_alloc(guac_rdp_common_svc* svc,
+        guac_rdpdr_device* device);
+
+/**
+ * Completes all outstanding jobs, stops the worker threads of the given pool,
+ * sends any responses not yet sent, and frees the pool. This function may be
+ * invoked while the RDP client's message lock is held.
+ *
+ * @param pool
+ *     The pool to free.
+ */
+void guac_rdpdr_fs_io_pool_free(guac_rdpdr_fs_io_pool* pool);
+
+/**
+ * Queues a read of the given open file. The read data is sent within a
+ * Device I/O Response once the read completes.
+ *
+ * @param pool
+ *     The pool which should perform the read.
+ *
+ * @param iorequest
+ *     The Device I/O Request requesting the read.
+ *
+ * @param file
+ *     The file to read, which must be the open file having the file ID of
+ *     the given request.
+ *
+ * @param offset
+ *     The offset within the file at which to begin reading.
+ *
+ * @param length
+ *     The maximum number of bytes to read.
+ */
+void guac_rdpdr_fs_io_read(guac_rdpdr_fs_io_pool* pool,
+        guac_rdpdr_iorequest* iorequest, guac_rdp_fs_file* file,
+        uint64_t offset, int length);
+
+/**
+ * Queues a write of the given data to the given open file. The data is
+ * copied, and a Device I/O Response is sent once the write completes.
+ *
+ * @param pool
+ *     The pool which should perform the write.
+ *
+ * @param iorequest
+ *     The Device I/O Request requesting the write.
+ *
+ * @param file
+ *     The file to write, which must be the open file having the file ID of
+ *     the given request.
+ *
+ * @param offset
+ *     The offset within the file at which to begin writing.
+ *
+ * @param data
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes to write.
+ */
+void guac_rdpdr_fs_io_write(guac_rdpdr_fs_io_pool* pool,
+        guac_rdpdr_iorequest* iorequest, guac_rdp_fs_file* file,
+        uint64_t offset, const void* data, int length);
+
+/**
+ * Waits for all queued and running jobs affecting the file having the given
+ * ID to complete, and sends the responses of all completed jobs. This must be
+ * invoked before handling any request other than a read or write for that
+ * file, such that requests which change or close a file (and their
+ * responses) are not reordered with respect to its outstanding I/O. This
+ * function may be invoked while the RDP client's message lock is held.
+ *
+ * @param pool
+ *     The pool performing I/O for the file.
+ *
+ * @param file_id
+ *     The ID of the file whose outstanding I/O should be waited for.
+ */
+void guac_rdpdr_fs_io_wait(guac_rdpdr_fs_io_pool* pool, int file_id);
+
+#endif
+
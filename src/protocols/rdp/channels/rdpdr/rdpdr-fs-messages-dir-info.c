@@ -32,9 +32,7 @@
 
 void guac_rdpdr_fs_process_query_directory_info(guac_rdp_common_svc* svc,
         guac_rdpdr_device* device, guac_rdpdr_iorequest* iorequest,
-        const char* entry_name, int entry_file_id) {
-
-    guac_rdp_fs_file* file;
+        const char* entry_name, const guac_rdp_fs_dir_entry* entry) {
 
     wStream* output_stream;
     int length = guac_utf8_strlen(entry_name);
@@ -44,14 +42,8 @@ void guac_rdpdr_fs_process_query_directory_info(guac_rdp_common_svc* svc,
     guac_rdp_utf8_to_utf16((const unsigned char*) entry_name, length,
             (char*) utf16_entry_name, sizeof(utf16_entry_name));
 
-    /* Get file */
-    file = guac_rdp_fs_get_file((guac_rdp_fs*) device->data, entry_file_id);
-    if (file == NULL)
-        return;
-
     guac_client_log(svc->client, GUAC_LOG_DEBUG,
-            "%s: [file_id=%i (entry_name=\"%s\")]",
-            __func__, entry_file_id, entry_name);
+            "%s: [entry_name=\"%s\"]", __func__, entry_name);
 
     output_stream = guac_rdpdr_new_io_completion(device,
             iorequest->completion_id, STATUS_SUCCESS,
@@ -62,13 +54,13 @@ void guac_rdpdr_fs_process_query_directory_info(guac_rdp_common_svc* svc,
 
     Stream_Write_UINT32(output_stream, 0); /* NextEntryOffset */
     Stream_Write_UINT32(output_stream, 0); /* FileIndex */
-    Stream_Write_UINT64(output_stream, file->ctime); /* CreationTime */
-    Stream_Write_UINT64(output_stream, file->atime); /* LastAccessTime */
-    Stream_Write_UINT64(output_stream, file->mtime); /* LastWriteTime */
-    Stream_Write_UINT64(output_stream, file->mtime); /* ChangeTime */
-    Stream_Write_UINT64(output_stream, file->size);  /* EndOfFile */
-    Stream_Write_UINT64(output_stream, file->size);  /* AllocationSize */
-    Stream_Write_UINT32(output_stream, file->attributes);   /* FileAttributes */
+    Stream_Write_UINT64(output_stream, entry->ctime); /* CreationTime */
+    Stream_Write_UINT64(output_stream, entry->atime); /* LastAccessTime */
+    Stream_Write_UINT64(output_stream, entry->mtime); /* LastWriteTime */
+    Stream_Write_UINT64(output_stream, entry->mtime); /* ChangeTime */
+    Stream_Write_UINT64(output_stream, entry->size);  /* EndOfFile */
+    Stream_Write_UINT64(output_stream, entry->size);  /* AllocationSize */
+    Stream_Write_UINT32(output_stream, entry->attributes);   /* FileAttributes */
     Stream_Write_UINT32(output_stream, utf16_length+2); /* FileNameLength*/
 
     Stream_Write(output_stream, utf16_entry_name, utf16_length); /* FileName */
@@ -80,9 +72,7 @@ void guac_rdpdr_fs_process_query_directory_info(guac_rdp_common_svc* svc,
 
 void guac_rdpdr_fs_process_query_full_directory_info(guac_rdp_common_svc* svc,
         guac_rdpdr_device* device, guac_rdpdr_iorequest* iorequest,
-        const char* entry_name, int entry_file_id) {
-
-    guac_rdp_fs_file* file;
+        const char* entry_name, const guac_rdp_fs_dir_entry* entry) {
 
     wStream* output_stream;
     int length = guac_utf8_strlen(entry_name);
@@ -92,14 +82,8 @@ void guac_rdpdr_fs_process_query_full_directory_info(guac_rdp_common_svc* svc,
     guac_rdp_utf8_to_utf16((const unsigned char*) entry_name, length,
             (char*) utf16_entry_name, sizeof(utf16_entry_name));
 
-    /* Get file */
-    file = guac_rdp_fs_get_file((guac_rdp_fs*) device->data, entry_file_id);
-    if (file == NULL)
-        return;
-
     guac_client_log(svc->client, GUAC_LOG_DEBUG,
-            "%s: [file_id=%i (entry_name=\"%s\")]",
-            __func__, entry_file_id, entry_name);
+            "%s: [entry_name=\"%s\"]", __func__, entry_name);
 
     output_stream = guac_rdpdr_new_io_completion(device,
             iorequest->completion_id, STATUS_SUCCESS,
@@ -110,13 +94,13 @@ void guac_rdpdr_fs_process_query_full_directory_info(guac_rdp_common_svc* svc,
 
     Stream_Write_UINT32(output_stream, 0); /* NextEntryOffset */
     Stream_Write_UINT32(output_stream, 0); /* FileIndex */
-    Stream_Write_UINT64(output_stream, file->ctime); /* CreationTime */
-    Stream_Write_UINT64(output_stream, file->atime); /* LastAccessTime */
-    Stream_Write_UINT64(output_stream, file->mtime); /* LastWriteTime */
-    Stream_Write_UINT64(output_stream, file->mtime); /* ChangeTime */
-    Stream_Write_UINT64(output_stream, file->size);  /* EndOfFile */
-    Stream_Write_UINT64(output_stream, file->size);  /* AllocationSize */
-    Stream_Write_UINT32(output_stream, file->attributes);   /* FileAttributes */
+    Stream_Write_UINT64(output_stream, entry->ctime); /* CreationTime */
+    Stream_Write_UINT64(output_stream, entry->atime); /* LastAccessTime */
+    Stream_Write_UINT64(output_stream, entry->mtime); /* LastWriteTime */
+    Stream_Write_UINT64(output_stream, entry->mtime); /* ChangeTime */
+    Stream_Write_UINT64(output_stream, entry->size);  /* EndOfFile */
+    Stream_Write_UINT64(output_stream, entry->size);  /* AllocationSize */
+    Stream_Write_UINT32(output_stream, entry->attributes);   /* FileAttributes */
     Stream_Write_UINT32(output_stream, utf16_length+2); /* FileNameLength*/
     Stream_Write_UINT32(output_stream, 0); /* EaSize */
 
@@ -129,9 +113,7 @@ void guac_rdpdr_fs_process_query_full_directory_info(guac_rdp_common_svc* svc,
 
 void guac_rdpdr_fs_process_query_both_directory_info(guac_rdp_common_svc* svc,
         guac_rdpdr_device* device, guac_rdpdr_iorequest* iorequest,
-        const char* entry_name, int entry_file_id) {
-
-    guac_rdp_fs_file* file;
+        const char* entry_name, const guac_rdp_fs_dir_entry* entry) {
 
     wStream* output_stream;
     int length = guac_utf8_strlen(entry_name);
@@ -141,14 +123,8 @@ void guac_rdpdr_fs_process_query_both_directory_info(guac_rdp_common_svc* svc,
     guac_rdp_utf8_to_utf16((const unsigned char*) entry_name, length,
             (char*) utf16_entry_name, sizeof(utf16_entry_name));
 
-    /* Get file */
-    file = guac_rdp_fs_get_file((guac_rdp_fs*) device->data, entry_file_id);
-    if (file == NULL)
-        return;
-
     guac_client_log(svc->client, GUAC_LOG_DEBUG,
-            "%s: [file_id=%i (entry_name=\"%s\")]",
-            __func__, entry_file_id, entry_name);
+            "%s: [entry_name=\"%s\"]", __func__, entry_name);
 
     output_stream = guac_rdpdr_new_io_completion(device,
             iorequest->completion_id, STATUS_SUCCESS,
@@ -159,13 +135,13 @@ void guac_rdpdr_fs_process_query_both_directory_info(guac_rdp_common_svc* svc,
 
     Stream_Write_UINT32(output_stream, 0); /* NextEntryOffset */
     Stream_Write_UINT32(output_stream, 0); /* FileIndex */
-    Stream_Write_UINT64(output_stream, file->ctime); /* CreationTime */
-    Stream_Write_UINT64(output_stream, file->atime); /* LastAccessTime */
-    Stream_Write_UINT64(output_stream, file->mtime); /* LastWriteTime */
-    Stream_Write_UINT64(output_stream, file->mtime); /* ChangeTime */
-    Stream_Write_UINT64(output_stream, file->size);  /* EndOfFile */
-    Stream_Write_UINT64(output_stream, file->size);  /* AllocationSize */
-    Stream_Write_UINT32(output_stream, file->attributes);   /* FileAttributes */
+    Stream_Write_UINT64(output_stream, entry->ctime); /* CreationTime */
+    Stream_Write_UINT64(output_stream, entry->atime); /* LastAccessTime */
+    Stream_Write_UINT64(output_stream, entry->mtime); /* LastWriteTime */
+    Stream_Write_UINT64(output_stream, entry->mtime); /* ChangeTime */
+    Stream_Write_UINT64(output_stream, entry->size);  /* EndOfFile */
+    Stream_Write_UINT64(output_stream, entry->size);  /* AllocationSize */
+    Stream_Write_UINT32(output_stream, entry->attributes);   /* FileAttributes */
     Stream_Write_UINT32(output_stream, utf16_length+2); /* FileNameLength*/
     Stream_Write_UINT32(output_stream, 0); /* EaSize */
     Stream_Write_UINT8(output_stream,  0); /* ShortNameLength */
@@ -182,9 +158,7 @@ void guac_rdpdr_fs_process_query_both_directory_info(guac_rdp_common_svc* svc,
 
 void guac_rdpdr_fs_process_query_names_info(guac_rdp_common_svc* svc,
         guac_rdpdr_device* device, guac_rdpdr_iorequest* iorequest,
-        const char* entry_name, int entry_file_id) {
-
-    guac_rdp_fs_file* file;
+        const char* entry_name, const guac_rdp_fs_dir_entry* entry) {
 
     wStream* output_stream;
     int length = guac_utf8_strlen(entry_name);
@@ -194,14 +168,8 @@ void guac_rdpdr_fs_process_query_names_info(guac_rdp_common_svc* svc,
     guac_rdp_utf8_to_utf16((const unsigned char*) entry_name, length,
             (char*) utf16_entry_name, sizeof(utf16_entry_name));
 
-    /* Get file */
-    file = guac_rdp_fs_get_file((guac_rdp_fs*) device->data, entry_file_id);
-    if (file == NULL)
-        return;
-
     guac_client_log(svc->client, GUAC_LOG_DEBUG,
-            "%s: [file_id=%i (entry_name=\"%s\")]",
-            __func__, entry_file_id, entry_name);
+            "%s: [entry_name=\"%s\"]", __func__, entry_name);
 
     output_stream = guac_rdpdr_new_io_completion(device,
             iorequest->completion_id, STATUS_SUCCESS,
@@ -22,6 +22,7 @@
 #include "channels/rdpdr/rdpdr-fs-messages-file-info.h"
 #include "channels/rdpdr/rdpdr-fs-messages-vol-info.h"
 #include "channels/rdpdr/rdpdr-fs-messages.h"
+#include "channels/rdpdr/rdpdr-fs-io.h"
 #include "channels/rdpdr/rdpdr.h"
 #include "download.h"
 #include "fs.h"
@@ -165,6 +166,14 @@ void guac_rdpdr_fs_process_read(guac_rdp_common_svc* svc,
     if (length > GUAC_RDP_MAX_READ_BUFFER)
         length = GUAC_RDP_MAX_READ_BUFFER;
 
+    /* Hand off read of a valid file to worker threads, if available */
+    guac_rdp_fs_file* file = guac_rdp_fs_get_file((guac_rdp_fs*) device->data,
+            iorequest->file_id);
+    if (device->io_pool != NULL && file != NULL) {
+        guac_rdpdr_fs_io_read(device->io_pool, iorequest, file, offset, length);
+        return;
+    }
+
     /* Allocate buffer */
     buffer = guac_mem_alloc(length);
 
@@ -227,6 +236,15 @@ void guac_rdpdr_fs_process_write(guac_rdp_common_svc* svc,
         return;
     }
     
+    /* Hand off write to a valid file to worker threads, if available */
+    guac_rdp_fs_file* file = guac_rdp_fs_get_file((guac_rdp_fs*) device->data,
+            iorequest->file_id);
+    if (device->io_pool != NULL && file != NULL) {
+        guac_rdpdr_fs_io_write(device->io_pool, iorequest, file, offset,
+                Stream_Pointer(input_stream), length);
+        return;
+    }
+
     /* Attempt write */
     bytes_written = guac_rdp_fs_write((guac_rdp_fs*) device->data,
             iorequest->file_id, offset, Stream_Pointer(input_stream), length);
@@ -470,7 +488,7 @@ void guac_rdpdr_fs_process_query_directory(guac_rdp_common_svc* svc,
     int fs_information_class, initial_query;
     int path_length;
 
-    const char* entry_name;
+    const guac_rdp_fs_dir_entry* entry;
 
     /* Get file */
     file = guac_rdp_fs_get_file((guac_rdp_fs*) device->data, iorequest->file_id);
@@ -516,59 +534,50 @@ void guac_rdpdr_fs_process_query_directory(guac_rdp_common_svc* svc,
             iorequest->file_id, initial_query, file->dir_pattern);
 
     /* Find first matching entry in directory */
-    while ((entry_name = guac_rdp_fs_read_dir((guac_rdp_fs*) device->data,
+    while ((entry = guac_rdp_fs_read_dir_entry((guac_rdp_fs*) device->data,
                     iorequest->file_id)) != NULL) {
 
         /* Convert to absolute path */
         char entry_path[GUAC_RDP_FS_MAX_PATH];
         if (guac_rdp_fs_convert_path(file->absolute_path,
-                    entry_name, entry_path) == 0) {
-
-            int entry_file_id;
+                    entry->name, entry_path) == 0) {
 
             /* Pattern defined and match fails, continue with next file */
             if (guac_rdp_fs_matches(entry_path, file->dir_pattern))
                 continue;
 
-            /* Open directory entry */
-            entry_file_id = guac_rdp_fs_open((guac_rdp_fs*) device->data,
-                    entry_path, FILE_READ_DATA, 0, FILE_OPEN, 0);
-
-            if (entry_file_id >= 0) {
-
-                /* Dispatch to appropriate class-specific handler */
-                switch (fs_information_class) {
-
-                    case FileDirectoryInformation:
-                        guac_rdpdr_fs_process_query_directory_info(svc, device,
-                                iorequest, entry_name, entry_file_id);
-                        break;
-
-                    case FileFullDirectoryInformation:
-                        guac_rdpdr_fs_process_query_full_directory_info(svc,
-                                device, iorequest, entry_name, entry_file_id);
-                        break;
-
-                    case FileBothDirectoryInformation:
-                        guac_rdpdr_fs_process_query_both_directory_info(svc,
-                                device, iorequest, entry_name, entry_file_id);
-                        break;
-
-                    case FileNamesInformation:
-                        guac_rdpdr_fs_process_query_names_info(svc, device,
-                                iorequest, entry_name, entry_file_id);
-                        break;
-
-                    default:
-                        guac_client_log(svc->client, GUAC_LOG_DEBUG,
-                                "Unknown dir information class: 0x%x",
-                                fs_information_class);
-                }
+            /* Dispatch to appropriate class-specific handler, using the
+             * metadata read with the directory listing */
+            switch (fs_information_class) {
+
+                case FileDirectoryInformation:
+                    guac_rdpdr_fs_process_query_directory_info(svc, device,
+                            iorequest, entry->name, entry);
+                    break;
+
+                case FileFullDirectoryInformation:
+                    guac_rdpdr_fs_process_query_full_directory_info(svc,
+                            device, iorequest, entry->name, entry);
+                    break;
+
+                case FileBothDirectoryInformation:
+                    guac_rdpdr_fs_process_query_both_directory_info(svc,
+                            device, iorequest, entry->name, entry);
+                    break;
+
+                case FileNamesInformation:
+                    guac_rdpdr_fs_process_query_names_info(svc, device,
+                            iorequest, entry->name, entry);
+                    break;
+
+                default:
+                    guac_client_log(svc->client, GUAC_LOG_DEBUG,
+                            "Unknown dir information class: 0x%x",
+                            fs_information_class);
+            }
 
-                guac_rdp_fs_close((guac_rdp_fs*) device->data, entry_file_id);
-                return;
+            return;
 
-            } /* end if file exists */
         } /* end if path valid */
     } /* end if entry exists */
 
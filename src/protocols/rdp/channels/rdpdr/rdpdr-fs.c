@@ -18,6 +18,7 @@
  */
 
 #include "channels/rdpdr/rdpdr-fs.h"
+#include "channels/rdpdr/rdpdr-fs-io.h"
 #include "channels/rdpdr/rdpdr-fs-messages.h"
 #include "channels/rdpdr/rdpdr.h"
 #include "rdp.h"
@@ -34,6 +35,15 @@ void guac_rdpdr_device_fs_iorequest_handler(guac_rdp_common_svc* svc,
         guac_rdpdr_device* device, guac_rdpdr_iorequest* iorequest,
         wStream* input_stream) {
 
+    /* Requests other than reads and writes must not be reordered with
+     * respect to any reads and writes of the same file that are still in
+     * progress */
+    if (device->io_pool != NULL
+            && iorequest->major_func != IRP_MJ_CREATE
+            && iorequest->major_func != IRP_MJ_READ
+            && iorequest->major_func != IRP_MJ_WRITE)
+        guac_rdpdr_fs_io_wait(device->io_pool, iorequest->file_id);
+
     switch (iorequest->major_func) {
 
         /* File open */
@@ -111,6 +121,10 @@ void guac_rdpdr_device_fs_iorequest_handler(guac_rdp_common_svc* svc,
 void guac_rdpdr_device_fs_free_handler(guac_rdp_common_svc* svc,
         guac_rdpdr_device* device) {
 
+    /* Finish any outstanding I/O */
+    if (device->io_pool != NULL)
+        guac_rdpdr_fs_io_pool_free(device->io_pool);
+
     Stream_Free(device->device_announce, 1);
     
 }
@@ -150,5 +164,8 @@ void guac_rdpdr_register_fs(guac_rdp_common_svc* svc, char* drive_name) {
     /* Init data */
     device->data = rdp_client->filesystem;
 
+    /* Perform reads and writes in parallel using a pool of worker threads */
+    device->io_pool = guac_rdpdr_fs_io_pool_alloc(svc, device);
+
 }
 
@@ -164,6 +164,12 @@ struct guac_rdpdr_device {
      */
     void* data;
 
+    /**
+     * The pool of worker threads performing reads and writes for this device,
+     * or NULL if all requests for this device are handled synchronously.
+     */
+    struct guac_rdpdr_fs_io_pool* io_pool;
+
 };
 
 /**
@@ -18,6 +18,7 @@
  */
 
 #include "common/json.h"
+#include "common/transfer.h"
 #include "download.h"
 #include "fs.h"
 #include "ls.h"
@@ -35,14 +36,49 @@
 #include <winpr/nt.h>
 #include <winpr/shell.h>
 
+#include <fcntl.h>
 #include <stdlib.h>
 
+/**
+ * Allocates and initializes the transfer status of a new download of the
+ * given file, advising the operating system that the file will be read
+ * sequentially such that data is read ahead of each blob sent.
+ *
+ * @param fs
+ *     The filesystem containing the file being downloaded.
+ *
+ * @param file_id
+ *     The ID of the open file being downloaded.
+ *
+ * @return
+ *     A newly-allocated guac_rdp_download_status, which must eventually be
+ *     freed with guac_mem_free().
+ */
+static guac_rdp_download_status* guac_rdp_download_status_alloc(
+        guac_rdp_fs* fs, int file_id) {
+
+    guac_rdp_download_status* download_status = guac_mem_alloc(sizeof(guac_rdp_download_status));
+    download_status->file_id = file_id;
+    download_status->offset = 0;
+    guac_common_transfer_init(&download_status->transfer, 0, 0);
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    guac_rdp_fs_file* file = guac_rdp_fs_get_file(fs, file_id);
+    if (file != NULL)
+        posix_fadvise(file->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    return download_status;
+
+}
+
 int guac_rdp_download_ack_handler(guac_user* user, guac_stream* stream,
         char* message, guac_protocol_status status) {
 
     guac_client* client = user->client;
     guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
     guac_rdp_download_status* download_status = (guac_rdp_download_status*) stream->data;
+    guac_common_transfer* transfer = &download_status->transfer;
 
     /* Get filesystem, return error if no filesystem */
     guac_rdp_fs* fs = rdp_client->filesystem;
@@ -56,30 +92,40 @@ int guac_rdp_download_ack_handler(guac_user* user, guac_stream* stream,
     /* If successful, read data */
     if (status == GUAC_PROTOCOL_STATUS_SUCCESS) {
 
-        /* Attempt read into buffer */
-        char buffer[4096];
-        int bytes_read = guac_rdp_fs_read(fs,
-                download_status->file_id,
-                download_status->offset, buffer, sizeof(buffer));
-
-        /* If bytes read, send as blob */
-        if (bytes_read > 0) {
-            download_status->offset += bytes_read;
-            guac_protocol_send_blob(user->socket, stream,
-                    buffer, bytes_read);
-        }
+        guac_common_transfer_acked(transfer);
+
+        /* Keep as many blobs in flight as the transfer window allows */
+        char buffer[GUAC_PROTOCOL_BLOB_MAX_LENGTH];
+        while (guac_common_transfer_available(transfer) > 0) {
+
+            /* Attempt read into buffer */
+            int bytes_read = guac_rdp_fs_read(fs,
+                    download_status->file_id,
+                    download_status->offset, buffer, transfer->chunk_size);
+
+            /* If bytes read, send as blob */
+            if (bytes_read > 0) {
+                download_status->offset += bytes_read;
+                guac_protocol_send_blob(user->socket, stream,
+                        buffer, bytes_read);
+                guac_common_transfer_sent(transfer);
+            }
+
+            /* Stop reading upon EOF or error */
+            else {
+
+                if (bytes_read < 0)
+                    guac_user_log(user, GUAC_LOG_ERROR,
+                            "Error reading file for download");
+
+                transfer->eof = 1;
+
+            }
 
-        /* If EOF, send end */
-        else if (bytes_read == 0) {
-            guac_protocol_send_end(user->socket, stream);
-            guac_user_free_stream(user, stream);
-            guac_mem_free(download_status);
         }
 
-        /* Otherwise, fail stream */
-        else {
-            guac_user_log(user, GUAC_LOG_ERROR,
-                    "Error reading file for download");
+        /* Send end once all blobs have been acknowledged */
+        if (guac_common_transfer_complete(transfer)) {
             guac_protocol_send_end(user->socket, stream);
             guac_user_free_stream(user, stream);
             guac_mem_free(download_status);
@@ -134,6 +180,7 @@ int guac_rdp_download_get_handler(guac_user* user, guac_object* object,
         ls_status->file_id = file_id;
         guac_strlcpy(ls_status->directory_name, name,
                 sizeof(ls_status->directory_name));
+        guac_common_transfer_init(&ls_status->transfer, 0, 0);
 
         /* Allocate stream for body */
         guac_stream* stream = guac_user_alloc_stream(user);
@@ -154,9 +201,8 @@ int guac_rdp_download_get_handler(guac_user* user, guac_object* object,
     else if (!fs->disable_download) {
 
         /* Create stream data */
-        guac_rdp_download_status* download_status = guac_mem_alloc(sizeof(guac_rdp_download_status));
-        download_status->file_id = file_id;
-        download_status->offset = 0;
+        guac_rdp_download_status* download_status =
+            guac_rdp_download_status_alloc(fs, file_id);
 
         /* Allocate stream for body */
         guac_stream* stream = guac_user_alloc_stream(user);
@@ -210,11 +256,10 @@ void* guac_rdp_download_to_user(guac_user* user, void* data) {
 
         /* Associate stream with transfer status */
         guac_stream* stream = guac_user_alloc_stream(user);
-        guac_rdp_download_status* download_status = guac_mem_alloc(sizeof(guac_rdp_download_status));
+        guac_rdp_download_status* download_status =
+            guac_rdp_download_status_alloc(filesystem, file_id);
         stream->data = download_status;
         stream->ack_handler = guac_rdp_download_ack_handler;
-        download_status->file_id = file_id;
-        download_status->offset = 0;
 
         guac_user_log(user, GUAC_LOG_DEBUG, "%s: Initiating download "
                 "of \"%s\"", __func__, path);
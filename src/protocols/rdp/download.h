@@ -21,6 +21,7 @@
 #define GUAC_RDP_DOWNLOAD_H
 
 #include "common/json.h"
+#include "common/transfer.h"
 
 #include <guacamole/protocol.h>
 #include <guacamole/stream.h>
@@ -43,6 +44,11 @@ typedef struct guac_rdp_download_status {
      */
     uint64_t offset;
 
+    /**
+     * The sliding window of blobs currently being sent to the user.
+     */
+    guac_common_transfer transfer;
+
 } guac_rdp_download_status;
 
 /**
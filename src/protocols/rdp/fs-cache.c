@@ -0,0 +1,472 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+#include "fs.h"
+#include "fs-cache.h"
+
+#include <guacamole/client.h>
+#include <guacamole/mem.h>
+#include <guacamole/string.h>
+#include <winpr/file.h>
+#include <winpr/nt.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
+#ifdef HAVE_SYS_INOTIFY_H
+/**
+ * The inotify events which invalidate the cached listing of a directory.
+ * Any change to an entry within the directory, including its metadata,
+ * affects the listing.
+ */
+#define GUAC_RDP_FS_CACHE_EVENTS (IN_ATTRIB | IN_CREATE | IN_DELETE \
+        | IN_DELETE_SELF | IN_MODIFY | IN_MOVE_SELF | IN_MOVED_FROM \
+        | IN_MOVED_TO)
+#endif
+
+/**
+ * Copies the given path into the given buffer, removing any trailing
+ * slashes such that equivalent paths produce identical cache keys.
+ *
+ * @param path
+ *     The path to normalize.
+ *
+ * @param normalized
+ *     The buffer to populate with the normalized path. This buffer MUST be at
+ *     least GUAC_RDP_FS_MAX_PATH bytes in size.
+ */
+static void guac_rdp_fs_cache_normalize(const char* path, char* normalized) {
+
+    size_t length = guac_strlcpy(normalized, path, GUAC_RDP_FS_MAX_PATH);
+    if (length >= GUAC_RDP_FS_MAX_PATH)
+        length = GUAC_RDP_FS_MAX_PATH - 1;
+
+    /* Strip trailing slashes, leaving the root directory intact */
+    while (length > 1 && normalized[length - 1] == '/')
+        normalized[--length] = '\0';
+
+}
+
+/**
+ * Comparator for qsort() and bsearch() which orders directory entries by
+ * name.
+ *
+ * @param a
+ *     The first guac_rdp_fs_dir_entry to compare.
+ *
+ * @param b
+ *     The second guac_rdp_fs_dir_entry to compare.
+ *
+ * @return
+ *     A value less than, equal to, or greater than zero if the name of the
+ *     first entry sorts before, the same as, or after the name of the second.
+ */
+static int guac_rdp_fs_dir_entry_compare(const void* a, const void* b) {
+    return strcmp(((const guac_rdp_fs_dir_entry*) a)->name,
+                  ((const guac_rdp_fs_dir_entry*) b)->name);
+}
+
+/**
+ * Reads the full contents of the directory at the given path, including the
+ * metadata of each entry.
+ *
+ * @param path
+ *     The real path of the directory on the local filesystem.
+ *
+ * @return
+ *     A newly-allocated listing having a reference count of one, or NULL if
+ *     the directory cannot be read.
+ */
+static guac_rdp_fs_listing* guac_rdp_fs_listing_read(const char* path) {
+
+    DIR* dir = opendir(path);
+    if (dir == NULL)
+        return NULL;
+
+    /* Identify the directory actually read, for later verification */
+    struct stat dir_stat;
+    if (fstat(dirfd(dir), &dir_stat)) {
+        closedir(dir);
+        return NULL;
+    }
+
+    int capacity = 64;
+    guac_rdp_fs_listing* listing = guac_mem_zalloc(sizeof(guac_rdp_fs_listing));
+    listing->entries = guac_mem_alloc(sizeof(guac_rdp_fs_dir_entry), capacity);
+    listing->dev = dir_stat.st_dev;
+    listing->ino = dir_stat.st_ino;
+
+    struct dirent* result;
+    while ((result = readdir(dir)) != NULL) {
+
+        /* Stat relative to directory, following links as open() would,
+         * skipping entries which cannot be opened (such as broken links) */
+        struct stat file_stat;
+        if (fstatat(dirfd(dir), result->d_name, &file_stat, 0))
+            continue;
+
+        /* Grow entry storage as needed */
+        if (listing->count == capacity) {
+            capacity *= 2;
+            listing->entries = guac_mem_realloc(listing->entries,
+                    sizeof(guac_rdp_fs_dir_entry), capacity);
+        }
+
+        guac_rdp_fs_dir_entry* entry = &listing->entries[listing->count++];
+        entry->name  = guac_strdup(result->d_name);
+        entry->size  = file_stat.st_size;
+        entry->ctime = WINDOWS_TIME(file_stat.st_ctime);
+        entry->mtime = WINDOWS_TIME(file_stat.st_mtime);
+        entry->atime = WINDOWS_TIME(file_stat.st_atime);
+
+        if (S_ISDIR(file_stat.st_mode))
+            entry->attributes = FILE_ATTRIBUTE_DIRECTORY;
+        else
+            entry->attributes = FILE_ATTRIBUTE_NORMAL;
+
+    }
+
+    closedir(dir);
+
+    /* Sort by name to allow lookups by bsearch() */
+    qsort(listing->entries, listing->count, sizeof(guac_rdp_fs_dir_entry),
+            guac_rdp_fs_dir_entry_compare);
+
+    listing->refcount = 1;
+    return listing;
+
+}
+
+/**
+ * Frees the given listing and all of its entries.
+ *
+ * @param listing
+ *     The listing to free.
+ */
+static void guac_rdp_fs_listing_free(guac_rdp_fs_listing* listing) {
+
+    for (int i = 0; i < listing->count; i++)
+        guac_mem_free(listing->entries[i].name);
+
+    guac_mem_free(listing->entries);
+    guac_mem_free(listing);
+
+}
+
+/**
+ * Removes the inotify watch having the given watch descriptor, unless that
+ * watch is still needed by a cached listing. The same directory may be cached
+ * under multiple paths, in which case inotify shares a single watch between
+ * them. The cache lock must be held.
+ *
+ * @param cache
+ *     The cache which added the watch.
+ *
+ * @param wd
+ *     The watch descriptor of the watch to remove.
+ */
+static void guac_rdp_fs_cache_remove_watch(guac_rdp_fs_cache* cache,
+        int wd) {
+
+#ifdef HAVE_SYS_INOTIFY_H
+    for (int i = 0; i < GUAC_RDP_FS_CACHE_SIZE; i++) {
+        guac_rdp_fs_cache_slot* slot = &cache->slots[i];
+        if (slot->path != NULL && slot->wd == wd)
+            return;
+    }
+
+    inotify_rm_watch(cache->inotify_fd, wd);
+#endif
+
+}
+
+/**
+ * Removes the listing within the given slot from the cache, releasing the
+ * reference held by the cache. The cache lock must be held.
+ *
+ * @param cache
+ *     The cache containing the slot.
+ *
+ * @param slot
+ *     The slot to clear.
+ *
+ * @param remove_watch
+ *     Non-zero if the inotify watch of the slot should be removed (unless
+ *     still needed by another slot), zero if the watch no longer exists.
+ */
+static void guac_rdp_fs_cache_evict(guac_rdp_fs_cache* cache,
+        guac_rdp_fs_cache_slot* slot, int remove_watch) {
+
+    if (--slot->listing->refcount == 0)
+        guac_rdp_fs_listing_free(slot->listing);
+
+    guac_mem_free(slot->path);
+    slot->listing = NULL;
+
+    if (remove_watch)
+        guac_rdp_fs_cache_remove_watch(cache, slot->wd);
+
+}
+
+/**
+ * Reads all pending inotify events, evicting the listings of any directories
+ * which have changed. The cache lock must be held.
+ *
+ * @param cache
+ *     The cache to update.
+ */
+static void guac_rdp_fs_cache_process_events(guac_rdp_fs_cache* cache) {
+
+#ifdef HAVE_SYS_INOTIFY_H
+    char buffer[4096]
+        __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+    ssize_t length;
+    while ((length = read(cache->inotify_fd, buffer, sizeof(buffer))) > 0) {
+
+        char* current = buffer;
+        while (current < buffer + length) {
+
+            struct inotify_event* event = (struct inotify_event*) current;
+            current += sizeof(struct inotify_event) + event->len;
+
+            /* Evict everything if events may have been lost */
+            int overflow = event->mask & IN_Q_OVERFLOW;
+
+            for (int i = 0; i < GUAC_RDP_FS_CACHE_SIZE; i++) {
+                guac_rdp_fs_cache_slot* slot = &cache->slots[i];
+                if (slot->path != NULL && (overflow || slot->wd == event->wd))
+                    guac_rdp_fs_cache_evict(cache, slot,
+                            !(event->mask & IN_IGNORED));
+            }
+
+        }
+
+    }
+#endif
+
+}
+
+/**
+ * Returns the slot containing the cached listing of the directory at the
+ * given normalized path, or NULL if that directory is not cached. If the
+ * directory at that path is no longer the directory that was listed (because
+ * an ancestor directory was renamed or replaced, which inotify does not
+ * report), the cached listing is evicted and NULL is returned. The cache lock
+ * must be held.
+ *
+ * @param cache
+ *     The cache to search.
+ *
+ * @param path
+ *     The normalized real path of the directory.
+ *
+ * @return
+ *     The slot containing the listing of the given directory, or NULL if no
+ *     such listing is cached.
+ */
+static guac_rdp_fs_cache_slot* guac_rdp_fs_cache_find(
+        guac_rdp_fs_cache* cache, const char* path) {
+
+    for (int i = 0; i < GUAC_RDP_FS_CACHE_SIZE; i++) {
+        guac_rdp_fs_cache_slot* slot = &cache->slots[i];
+        if (slot->path != NULL && strcmp(slot->path, path) == 0) {
+
+            /* Verify the path still refers to the listed directory */
+            struct stat dir_stat;
+            if (stat(path, &dir_stat)
+                    || dir_stat.st_dev != slot->listing->dev
+                    || dir_stat.st_ino != slot->listing->ino) {
+                guac_rdp_fs_cache_evict(cache, slot, 1);
+                return NULL;
+            }
+
+            slot->last_used = ++cache->use_counter;
+            return slot;
+
+        }
+    }
+
+    return NULL;
+
+}
+
+guac_rdp_fs_cache* guac_rdp_fs_cache_alloc(guac_client* client) {
+
+    guac_rdp_fs_cache* cache = guac_mem_zalloc(sizeof(guac_rdp_fs_cache));
+    cache->client = client;
+    cache->inotify_fd = -1;
+    pthread_mutex_init(&cache->lock, NULL);
+
+#ifdef HAVE_SYS_INOTIFY_H
+    cache->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (cache->inotify_fd == -1)
+        guac_client_log(client, GUAC_LOG_DEBUG, "Unable to initialize "
+                "inotify (%s). Drive directory listings will not be "
+                "cached.", strerror(errno));
+#endif
+
+    return cache;
+
+}
+
+void guac_rdp_fs_cache_free(guac_rdp_fs_cache* cache) {
+
+    for (int i = 0; i < GUAC_RDP_FS_CACHE_SIZE; i++) {
+        guac_rdp_fs_cache_slot* slot = &cache->slots[i];
+        if (slot->path != NULL)
+            guac_rdp_fs_cache_evict(cache, slot, 0);
+    }
+
+    if (cache->inotify_fd != -1)
+        close(cache->inotify_fd);
+
+    pthread_mutex_destroy(&cache->lock);
+    guac_mem_free(cache);
+
+}
+
+guac_rdp_fs_listing* guac_rdp_fs_cache_get_listing(guac_rdp_fs_cache* cache,
+        const char* path) {
+
+    char normalized[GUAC_RDP_FS_MAX_PATH];
+    guac_rdp_fs_cache_normalize(path, normalized);
+
+    /* Without inotify, changes cannot be detected and nothing is cached */
+    if (cache->inotify_fd == -1)
+        return guac_rdp_fs_listing_read(normalized);
+
+    pthread_mutex_lock(&cache->lock);
+    guac_rdp_fs_cache_process_events(cache);
+
+    /* Use cached listing if still valid */
+    guac_rdp_fs_cache_slot* slot = guac_rdp_fs_cache_find(cache, normalized);
+    if (slot != NULL) {
+        guac_rdp_fs_listing* listing = slot->listing;
+        listing->refcount++;
+        pthread_mutex_unlock(&cache->lock);
+        return listing;
+    }
+
+    /* Otherwise, claim an empty slot, evicting the least-recently used
+     * listing if necessary */
+    slot = &cache->slots[0];
+    for (int i = 0; i < GUAC_RDP_FS_CACHE_SIZE; i++) {
+        guac_rdp_fs_cache_slot* current = &cache->slots[i];
+        if (current->path == NULL) {
+            slot = current;
+            break;
+        }
+        if (current->last_used < slot->last_used)
+            slot = current;
+    }
+
+    if (slot->path != NULL)
+        guac_rdp_fs_cache_evict(cache, slot, 1);
+
+    guac_rdp_fs_listing* listing = NULL;
+
+#ifdef HAVE_SYS_INOTIFY_H
+    /* Watch before reading such that no change can be missed */
+    int wd = inotify_add_watch(cache->inotify_fd, normalized,
+            GUAC_RDP_FS_CACHE_EVENTS | IN_ONLYDIR);
+
+    listing = guac_rdp_fs_listing_read(normalized);
+
+    /* Cache listing only if it can be invalidated */
+    if (listing != NULL && wd != -1) {
+        slot->path = guac_strdup(normalized);
+        slot->wd = wd;
+        slot->listing = listing;
+        slot->last_used = ++cache->use_counter;
+        listing->refcount++;
+    }
+
+    /* Remove watch if unused */
+    else if (wd != -1)
+        guac_rdp_fs_cache_remove_watch(cache, wd);
+#endif
+
+    pthread_mutex_unlock(&cache->lock);
+    return listing;
+
+}
+
+void guac_rdp_fs_cache_release_listing(guac_rdp_fs_cache* cache,
+        guac_rdp_fs_listing* listing) {
+
+    pthread_mutex_lock(&cache->lock);
+    int refcount = --listing->refcount;
+    pthread_mutex_unlock(&cache->lock);
+
+    if (refcount == 0)
+        guac_rdp_fs_listing_free(listing);
+
+}
+
+int guac_rdp_fs_cache_exists(guac_rdp_fs_cache* cache, const char* path) {
+
+    if (cache->inotify_fd == -1)
+        return -1;
+
+    char normalized[GUAC_RDP_FS_MAX_PATH];
+    guac_rdp_fs_cache_normalize(path, normalized);
+
+    /* Split into containing directory and name */
+    char* separator = strrchr(normalized, '/');
+    if (separator == NULL || separator[1] == '\0')
+        return -1;
+
+    char name[GUAC_RDP_FS_MAX_PATH];
+    guac_strlcpy(name, separator + 1, sizeof(name));
+    separator[1] = '\0';
+
+    char parent[GUAC_RDP_FS_MAX_PATH];
+    guac_rdp_fs_cache_normalize(normalized, parent);
+
+    int result = -1;
+
+    pthread_mutex_lock(&cache->lock);
+    guac_rdp_fs_cache_process_events(cache);
+
+    /* Look up name only if listing of containing directory is known */
+    guac_rdp_fs_cache_slot* slot = guac_rdp_fs_cache_find(cache, parent);
+    if (slot != NULL) {
+        guac_rdp_fs_dir_entry key = { .name = name };
+        result = bsearch(&key, slot->listing->entries, slot->listing->count,
+                sizeof(guac_rdp_fs_dir_entry),
+                guac_rdp_fs_dir_entry_compare) != NULL;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+    return result;
+
+}
+
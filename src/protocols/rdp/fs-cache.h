@@ -0,0 +1,257 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_RDP_FS_CACHE_H
+#define GUAC_RDP_FS_CACHE_H
+
+/**
+ * Cache of the directory listings and file metadata of the virtual drive.
+ * Cached listings are invalidated via inotify whenever the corresponding
+ * directory or any of its entries changes, including through changes made
+ * outside of the RDP session. As inotify does not report changes to the
+ * ancestors of a watched directory, the identity of each cached directory is
+ * also verified whenever its listing is used, such that renaming or replacing
+ * any ancestor cannot result in a stale listing being used. If inotify is
+ * unavailable, nothing is cached and every listing is read from the local
+ * filesystem.
+ *
+ * @file fs-cache.h
+ */
+
+#include <guacamole/client.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * The maximum number of directory listings to cache per drive. If more
+ * directories are listed, the least-recently used listings are evicted.
+ */
+#define GUAC_RDP_FS_CACHE_SIZE 64
+
+/**
+ * A single entry within a directory listing, along with the metadata that
+ * would otherwise be obtained by opening that entry.
+ */
+typedef struct guac_rdp_fs_dir_entry {
+
+    /**
+     * The name of this entry within its directory.
+     */
+    char* name;
+
+    /**
+     * Bitwise OR of all associated Windows file attributes.
+     */
+    int attributes;
+
+    /**
+     * The size of this file, in bytes.
+     */
+    uint64_t size;
+
+    /**
+     * The time this file was created, as a Windows timestamp.
+     */
+    uint64_t ctime;
+
+    /**
+     * The time this file was last modified, as a Windows timestamp.
+     */
+    uint64_t mtime;
+
+    /**
+     * The time this file was last accessed, as a Windows timestamp.
+     */
+    uint64_t atime;
+
+} guac_rdp_fs_dir_entry;
+
+/**
+ * The full contents of a directory at the time it was read. Listings are
+ * immutable once read, and remain valid for as long as they are referenced,
+ * even if they have since been evicted from the cache.
+ */
+typedef struct guac_rdp_fs_listing {
+
+    /**
+     * The number of references to this listing, including the reference held
+     * by the cache itself. This count is guarded by the lock of the cache.
+     */
+    int refcount;
+
+    /**
+     * The device containing the listed directory.
+     */
+    dev_t dev;
+
+    /**
+     * The inode of the listed directory. Together with dev, this uniquely
+     * identifies the directory for as long as it exists.
+     */
+    ino_t ino;
+
+    /**
+     * The number of entries in this listing.
+     */
+    int count;
+
+    /**
+     * All entries in the directory, sorted by name.
+     */
+    guac_rdp_fs_dir_entry* entries;
+
+} guac_rdp_fs_listing;
+
+/**
+ * A cached listing, along with the inotify watch which invalidates it.
+ */
+typedef struct guac_rdp_fs_cache_slot {
+
+    /**
+     * The real path of the listed directory on the local filesystem, without
+     * any trailing slashes, or NULL if this slot is unused.
+     */
+    char* path;
+
+    /**
+     * The inotify watch descriptor of the listed directory.
+     */
+    int wd;
+
+    /**
+     * The cached listing.
+     */
+    guac_rdp_fs_listing* listing;
+
+    /**
+     * The value of the cache use counter when this listing was last
+     * accessed, for the sake of LRU eviction.
+     */
+    uint64_t last_used;
+
+} guac_rdp_fs_cache_slot;
+
+/**
+ * Cache of directory listings for a single virtual drive.
+ */
+typedef struct guac_rdp_fs_cache {
+
+    /**
+     * The guac_client associated with the RDP session.
+     */
+    guac_client* client;
+
+    /**
+     * Non-blocking inotify file descriptor receiving change events for all
+     * cached directories, or -1 if caching is disabled.
+     */
+    int inotify_fd;
+
+    /**
+     * Lock which guards all members of this cache, as well as the reference
+     * counts of all listings.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Counter incremented on every access, for the sake of LRU eviction.
+     */
+    uint64_t use_counter;
+
+    /**
+     * All cached listings.
+     */
+    guac_rdp_fs_cache_slot slots[GUAC_RDP_FS_CACHE_SIZE];
+
+} guac_rdp_fs_cache;
+
+/**
+ * Allocates a new, empty cache.
+ *
+ * @param client
+ *     The guac_client associated with the RDP session.
+ *
+ * @return
+ *     A newly-allocated cache, which must eventually be freed with
+ *     guac_rdp_fs_cache_free().
+ */
+guac_rdp_fs_cache* guac_rdp_fs_cache_alloc(guac_client* client);
+
+/**
+ * Frees the given cache and all listings not referenced elsewhere.
+ *
+ * @param cache
+ *     The cache to free.
+ */
+void guac_rdp_fs_cache_free(guac_rdp_fs_cache* cache);
+
+/**
+ * Returns the listing of the directory at the given real path, reading and
+ * caching that directory if no valid cached listing exists. The returned
+ * listing must be released with guac_rdp_fs_cache_release_listing() when no
+ * longer needed.
+ *
+ * @param cache
+ *     The cache to retrieve the listing from.
+ *
+ * @param path
+ *     The real path of the directory on the local filesystem.
+ *
+ * @return
+ *     The listing of the given directory, or NULL if the directory cannot be
+ *     read.
+ */
+guac_rdp_fs_listing* guac_rdp_fs_cache_get_listing(guac_rdp_fs_cache* cache,
+        const char* path);
+
+/**
+ * Releases a reference to the given listing, as returned by
+ * guac_rdp_fs_cache_get_listing(), freeing the listing if it is no longer
+ * referenced.
+ *
+ * @param cache
+ *     The cache that returned the listing.
+ *
+ * @param listing
+ *     The listing to release.
+ */
+void guac_rdp_fs_cache_release_listing(guac_rdp_fs_cache* cache,
+        guac_rdp_fs_listing* listing);
+
+/**
+ * Determines whether a file exists at the given real path using only cached
+ * listings. The file itself is never accessed, though the containing
+ * directory is checked to verify that its cached listing still applies.
+ *
+ * @param cache
+ *     The cache to check.
+ *
+ * @param path
+ *     The real path of the file on the local filesystem.
+ *
+ * @return
+ *     Positive if the file exists, zero if the file does not exist, or
+ *     negative if the listing of the containing directory is not cached.
+ */
+int guac_rdp_fs_cache_exists(guac_rdp_fs_cache* cache, const char* path);
+
+#endif
+
@@ -68,12 +68,16 @@ guac_rdp_fs* guac_rdp_fs_alloc(guac_client* client, const char* drive_path,
     fs->open_files = 0;
     fs->disable_download = disable_download;
     fs->disable_upload = disable_upload;
+    fs->cache = guac_rdp_fs_cache_alloc(client);
+    fs->uploads = guac_common_upload_list_alloc();
 
     return fs;
 
 }
 
 void guac_rdp_fs_free(guac_rdp_fs* fs) {
+    guac_common_upload_list_free(fs->uploads);
+    guac_rdp_fs_cache_free(fs->cache);
     guac_pool_free(fs->file_id_pool);
     guac_mem_free(fs->drive_path);
     guac_mem_free(fs);
@@ -283,6 +287,17 @@ int guac_rdp_fs_open(guac_rdp_fs* fs, const char* path,
             "%s: Translated path \"%s\" to \"%s\".",
             __func__, normalized_path, real_path);
 
+    /* Avoid touching the local filesystem for files which must already exist
+     * but are known not to (Windows routinely probes for files like
+     * desktop.ini) */
+    if ((create_disposition == FILE_OPEN
+                || create_disposition == FILE_OVERWRITE)
+            && guac_rdp_fs_cache_exists(fs->cache, real_path) == 0) {
+        guac_client_log(fs->client, GUAC_LOG_DEBUG,
+                "%s: \"%s\" does not exist (cached).", __func__, real_path);
+        return GUAC_RDP_FS_ENOENT;
+    }
+
     switch (create_disposition) {
 
         /* Create if not exist, fail otherwise */
@@ -365,7 +380,8 @@ int guac_rdp_fs_open(guac_rdp_fs* fs, const char* path,
     file = &(fs->files[file_id]);
     file->id = file_id;
     file->fd  = fd;
-    file->dir = NULL;
+    file->listing = NULL;
+    file->listing_index = 0;
     file->dir_pattern[0] = '\0';
     file->absolute_path = guac_strdup(normalized_path);
     file->real_path = guac_strdup(real_path);
@@ -422,9 +438,8 @@ int guac_rdp_fs_read(guac_rdp_fs* fs, int file_id, uint64_t offset,
         return GUAC_RDP_FS_EINVAL;
     }
 
-    /* Attempt read */
-    lseek(file->fd, offset, SEEK_SET);
-    bytes_read = read(file->fd, buffer, length);
+    /* Attempt read at given offset without disturbing file position */
+    bytes_read = pread(file->fd, buffer, length, offset);
 
     /* Translate errno on error */
     if (bytes_read < 0)
@@ -446,9 +461,8 @@ int guac_rdp_fs_write(guac_rdp_fs* fs, int file_id, uint64_t offset,
         return GUAC_RDP_FS_EINVAL;
     }
 
-    /* Attempt write */
-    lseek(file->fd, offset, SEEK_SET);
-    bytes_written = write(file->fd, buffer, length);
+    /* Attempt write at given offset without disturbing file position */
+    bytes_written = pwrite(file->fd, buffer, length, offset);
 
     /* Translate errno on error */
     if (bytes_written < 0)
@@ -567,9 +581,9 @@ void guac_rdp_fs_close(guac_rdp_fs* fs, int file_id) {
             "%s: Closed \"%s\" (file_id=%i)",
             __func__, file->absolute_path, file_id);
 
-    /* Close directory, if open */
-    if (file->dir != NULL)
-        closedir(file->dir);
+    /* Release directory listing, if any */
+    if (file->listing != NULL)
+        guac_rdp_fs_cache_release_listing(fs->cache, file->listing);
 
     /* Close file */
     close(file->fd);
@@ -584,31 +598,44 @@ void guac_rdp_fs_close(guac_rdp_fs* fs, int file_id) {
 
 }
 
-const char* guac_rdp_fs_read_dir(guac_rdp_fs* fs, int file_id) {
+const guac_rdp_fs_dir_entry* guac_rdp_fs_read_dir_entry(guac_rdp_fs* fs,
+        int file_id) {
 
     guac_rdp_fs_file* file;
 
-    struct dirent* result;
-
     /* Only read if file ID is valid */
     if (file_id < 0 || file_id >= GUAC_RDP_FS_MAX_FILES)
         return NULL;
 
     file = &(fs->files[file_id]);
 
-    /* Open directory if not yet open, stop if error */
-    if (file->dir == NULL) {
-        file->dir = fdopendir(file->fd);
-        if (file->dir == NULL)
+    /* Retrieve listing if not yet retrieved, stop if error */
+    if (file->listing == NULL) {
+        file->listing = guac_rdp_fs_cache_get_listing(fs->cache,
+                file->real_path);
+        if (file->listing == NULL)
             return NULL;
     }
 
-    /* Read next entry, stop if error or no more entries */
-    if ((result = readdir(file->dir)) == NULL)
+    /* Stop if no more entries */
+    if (file->listing_index >= file->listing->count)
         return NULL;
 
+    /* Return next entry */
+    return &(file->listing->entries[file->listing_index++]);
+
+}
+
+const char* guac_rdp_fs_read_dir(guac_rdp_fs* fs, int file_id) {
+
+    const guac_rdp_fs_dir_entry* entry = guac_rdp_fs_read_dir_entry(fs,
+            file_id);
+
     /* Return filename */
-    return result->d_name;
+    if (entry == NULL)
+        return NULL;
+
+    return entry->name;
 
 }
 
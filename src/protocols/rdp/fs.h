@@ -31,6 +31,9 @@
  * @file fs.h 
  */
 
+#include "common/upload.h"
+#include "fs-cache.h"
+
 #include <guacamole/client.h>
 #include <guacamole/object.h>
 #include <guacamole/pool.h>
@@ -140,10 +143,16 @@ typedef struct guac_rdp_fs_file {
     int fd;
 
     /**
-     * Associated directory stream, if any. This field only applies
-     * if the file is being used as a directory.
+     * The listing of this directory being enumerated, if any. This field only
+     * applies if the file is being used as a directory.
+     */
+    guac_rdp_fs_listing* listing;
+
+    /**
+     * The index of the next entry within listing to be returned by
+     * guac_rdp_fs_read_dir_entry().
      */
-    DIR* dir;
+    int listing_index;
 
     /**
      * The pattern the check directory contents against, if any.
@@ -211,6 +220,16 @@ typedef struct guac_rdp_fs {
      * All available file structures.
      */
     guac_rdp_fs_file files[GUAC_RDP_FS_MAX_FILES];
+
+    /**
+     * Cache of directory listings and file metadata.
+     */
+    guac_rdp_fs_cache* cache;
+
+    /**
+     * All uploads currently writing to files within this filesystem.
+     */
+    guac_common_upload_list* uploads;
     
     /**
      * If downloads from the remote server to the browser should be disabled.
@@ -276,7 +295,8 @@ guac_rdp_fs* guac_rdp_fs_alloc(guac_client* client, const char* drive_path,
         int create_drive_path, int disable_download, int disable_upload);
 
 /**
- * Frees the given filesystem.
+ * Frees the given filesystem. Any uploads still in progress are cancelled,
+ * and their files closed, before the filesystem itself is freed.
  *
  * @param fs
  *     The filesystem to free.
@@ -603,6 +623,27 @@ int guac_rdp_fs_convert_path(const char* parent, const char* rel_path,
  */
 const char* guac_rdp_fs_read_dir(guac_rdp_fs* fs, int file_id);
 
+/**
+ * Returns the next entry within the directory having the given file ID,
+ * including the metadata of that entry. Directory contents are read from
+ * the listing cache of the filesystem where possible, and remain consistent
+ * for the duration of the enumeration.
+ *
+ * @param fs
+ *     The filesystem containing the file.
+ *
+ * @param file_id
+ *     The ID of the file to read directory entries from, as returned by
+ *     guac_rdp_fs_open().
+ *
+ * @return
+ *     The next entry within the directory, or NULL if the last entry in the
+ *     directory has already been returned by a previous call. The returned
+ *     entry remains valid until the file is closed.
+ */
+const guac_rdp_fs_dir_entry* guac_rdp_fs_read_dir_entry(guac_rdp_fs* fs,
+        int file_id);
+
 /**
  * Returns the file having the given ID, or NULL if no such file exists.
  *
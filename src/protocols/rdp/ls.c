@@ -36,23 +36,47 @@
 int guac_rdp_ls_ack_handler(guac_user* user, guac_stream* stream,
         char* message, guac_protocol_status status) {
 
-    int blob_written = 0;
-    const char* filename;
+    const guac_rdp_fs_dir_entry* entry;
 
     guac_rdp_ls_status* ls_status = (guac_rdp_ls_status*) stream->data;
+    guac_common_transfer* transfer = &ls_status->transfer;
 
     /* If unsuccessful, free stream and abort */
     if (status != GUAC_PROTOCOL_STATUS_SUCCESS) {
-        guac_rdp_fs_close(ls_status->fs, ls_status->file_id);
+        if (!transfer->eof)
+            guac_rdp_fs_close(ls_status->fs, ls_status->file_id);
         guac_user_free_stream(user, stream);
         guac_mem_free(ls_status);
         return 0;
     }
 
-    /* While directory entries remain */
-    while ((filename = guac_rdp_fs_read_dir(ls_status->fs,
-                    ls_status->file_id)) != NULL
-            && !blob_written) {
+    guac_common_transfer_acked(transfer);
+
+    /* Write entries while the transfer window allows */
+    while (guac_common_transfer_available(transfer) > 0) {
+
+        entry = guac_rdp_fs_read_dir_entry(ls_status->fs, ls_status->file_id);
+
+        /* Complete JSON at end of directory */
+        if (entry == NULL) {
+
+            /* Complete JSON object */
+            int blobs_written = guac_common_json_end_object(user, stream,
+                    &ls_status->json_state);
+            blobs_written += guac_common_json_flush(user, stream,
+                    &ls_status->json_state);
+
+            while (blobs_written-- > 0)
+                guac_common_transfer_sent(transfer);
+
+            /* Directory is no longer needed */
+            guac_rdp_fs_close(ls_status->fs, ls_status->file_id);
+            transfer->eof = 1;
+            break;
+
+        }
+
+        const char* filename = entry->name;
 
         char absolute_path[GUAC_RDP_FS_MAX_PATH];
 
@@ -71,50 +95,27 @@ int guac_rdp_ls_ack_handler(guac_user* user, guac_stream* stream,
             continue;
         }
 
-        /* Attempt to open file to determine type */
-        int file_id = guac_rdp_fs_open(ls_status->fs, absolute_path,
-                GENERIC_READ, 0, FILE_OPEN, 0);
-        if (file_id < 0)
-            continue;
-
-        /* Get opened file */
-        guac_rdp_fs_file* file = guac_rdp_fs_get_file(ls_status->fs, file_id);
-        if (file == NULL) {
-            guac_user_log(user, GUAC_LOG_DEBUG, "%s: Successful open produced "
-                    "bad file_id: %i", __func__, file_id);
-            return 0;
-        }
-
         /* Determine mimetype */
         const char* mimetype;
-        if (file->attributes & FILE_ATTRIBUTE_DIRECTORY)
+        if (entry->attributes & FILE_ATTRIBUTE_DIRECTORY)
             mimetype = GUAC_USER_STREAM_INDEX_MIMETYPE;
         else
             mimetype = "application/octet-stream";
 
-        /* Write entry */
-        blob_written |= guac_common_json_write_property(user, stream,
+        /* Write entry, counting any blobs written against the window */
+        int blobs_written = guac_common_json_write_property(user, stream,
                 &ls_status->json_state, absolute_path, mimetype);
 
-        guac_rdp_fs_close(ls_status->fs, file_id);
+        while (blobs_written-- > 0)
+            guac_common_transfer_sent(transfer);
 
     }
 
-    /* Complete JSON and cleanup at end of directory */
-    if (filename == NULL) {
-
-        /* Complete JSON object */
-        guac_common_json_end_object(user, stream, &ls_status->json_state);
-        guac_common_json_flush(user, stream, &ls_status->json_state);
-
-        /* Clean up resources */
-        guac_rdp_fs_close(ls_status->fs, ls_status->file_id);
-        guac_mem_free(ls_status);
-
-        /* Signal of stream */
+    /* Signal end of stream once all blobs have been acknowledged */
+    if (guac_common_transfer_complete(transfer)) {
         guac_protocol_send_end(user->socket, stream);
         guac_user_free_stream(user, stream);
-
+        guac_mem_free(ls_status);
     }
 
     guac_socket_flush(user->socket);
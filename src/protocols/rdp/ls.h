@@ -21,6 +21,7 @@
 #define GUAC_RDP_LS_H
 
 #include "common/json.h"
+#include "common/transfer.h"
 #include "fs.h"
 
 #include <guacamole/protocol.h>
@@ -54,11 +55,17 @@ typedef struct guac_rdp_ls_status {
      */
     guac_common_json_state json_state;
 
+    /**
+     * The sliding window of blobs of JSON currently being sent to the user.
+     */
+    guac_common_transfer transfer;
+
 } guac_rdp_ls_status;
 
 /**
  * Handler for ack messages received due to receipt of a "body" or "blob"
- * instruction associated with a directory list operation.
+ * instruction associated with a directory list operation. As many blobs of
+ * JSON are sent as the transfer window of the listing allows.
  */
 guac_user_ack_handler guac_rdp_ls_ack_handler;
 
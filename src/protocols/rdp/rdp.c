@@ -34,6 +34,7 @@
 #include "color.h"
 #include "common/cursor.h"
 #include "common/display.h"
+#include "common/surface.h"
 #include "config.h"
 #include "error.h"
 #include "fs.h"
@@ -52,6 +53,10 @@
 #include "common-ssh/user.h"
 #endif
 
+#ifdef ENABLE_VIDEO_STREAMING
+#include "common/video.h"
+#endif
+
 #include <freerdp/addin.h>
 #include <freerdp/cache/bitmap.h>
 #include <freerdp/cache/brush.h>
@@ -490,6 +495,13 @@ static int guac_rdp_handle_connection(guac_client* client) {
      * heuristics) */
     guac_common_display_set_lossless(rdp_client->display, settings->lossless);
 
+#ifdef ENABLE_VIDEO_STREAMING
+    /* Stream rapidly-changing regions as video only if requested */
+    if (settings->video_streaming)
+        guac_common_surface_set_video(rdp_client->display->default_surface,
+                &guac_common_video_encoder);
+#endif
+
     rdp_client->current_surface = rdp_client->display->default_surface;
 
     rdp_client->available_svc = guac_common_list_alloc();
@@ -551,7 +563,7 @@ static int guac_rdp_handle_connection(guac_client* client) {
                 GUAC_RDP_FRAME_START_TIMEOUT);
         if (wait_result > 0) {
 
-            int processing_lag = guac_client_get_processing_lag(client);
+            int display_lag = guac_client_get_display_lag(client);
 
             /* Read server messages until frame is built */
             do {
@@ -586,7 +598,7 @@ static int guac_rdp_handle_connection(guac_client* client) {
 
                 /* Calculate time that client needs to catch up */
                 int time_elapsed = frame_end - frame_start;
-                int required_wait = processing_lag - time_elapsed;
+                int required_wait = display_lag - time_elapsed;
 
                 /* Increase the duration of this frame if client is lagging */
                 if (required_wait > GUAC_RDP_FRAME_TIMEOUT)
@@ -709,6 +721,15 @@ void* guac_rdp_client_thread(void* data) {
             guac_client_log(client, GUAC_LOG_INFO,
                     "No available audio encoding. Sound disabled.");
 
+        /* Otherwise, apply any configured reduction in audio quality */
+        else {
+            guac_audio_stream_set_limits(rdp_client->audio,
+                    settings->audio_max_rate, settings->audio_max_channels,
+                    settings->audio_max_bit_depth);
+            guac_audio_stream_set_adaptive(rdp_client->audio,
+                    settings->audio_adaptive);
+        }
+
     } /* end if audio enabled */
 
     /* Load filesystem if drive enabled */
@@ -824,7 +845,15 @@ void* guac_rdp_client_thread(void* data) {
                 !settings->recording_exclude_output,
                 !settings->recording_exclude_mouse,
                 !settings->recording_exclude_touch,
-                settings->recording_include_keys);
+                settings->recording_include_keys,
+                settings->recording_compress);
+
+        /* Drop instructions rather than stall if storage cannot keep up */
+        if (rdp_client->recording != NULL
+                && settings->recording_drop_on_overflow)
+            guac_recording_set_overflow_policy(rdp_client->recording,
+                    GUAC_RECORDING_DEFAULT_MAX_QUEUED,
+                    GUAC_RECORDING_OVERFLOW_DROP);
     }
 
     /* Continue handling connections until error or client disconnect */
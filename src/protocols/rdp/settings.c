@@ -64,6 +64,10 @@ const char* GUAC_RDP_CLIENT_ARGS[] = {
     "initial-program",
     "color-depth",
     "disable-audio",
+    "audio-max-rate",
+    "audio-max-channels",
+    "audio-max-bit-depth",
+    "audio-adaptive",
     "enable-printing",
     "printer-name",
     "enable-drive",
@@ -121,6 +125,8 @@ const char* GUAC_RDP_CLIENT_ARGS[] = {
     "recording-exclude-mouse",
     "recording-exclude-touch",
     "recording-include-keys",
+    "recording-compress",
+    "recording-drop-on-overflow",
     "create-recording-path",
     "resize-method",
     "enable-audio-input",
@@ -145,6 +151,7 @@ const char* GUAC_RDP_CLIENT_ARGS[] = {
     "wol-wait-time",
 
     "force-lossless",
+    "enable-video-streaming",
     "normalize-clipboard",
     NULL
 };
@@ -214,6 +221,34 @@ enum RDP_ARGS_IDX {
      */
     IDX_DISABLE_AUDIO,
 
+    /**
+     * The maximum sample rate of audio sent to the user, in Hz. Audio
+     * received from the RDP server at a higher rate is resampled. By
+     * default, audio is not resampled.
+     */
+    IDX_AUDIO_MAX_RATE,
+
+    /**
+     * The maximum number of audio channels sent to the user. Specifying "1"
+     * downmixes stereo audio received from the RDP server to mono. By
+     * default, audio is not downmixed.
+     */
+    IDX_AUDIO_MAX_CHANNELS,
+
+    /**
+     * The maximum number of bits per sample of audio sent to the user.
+     * Specifying "8" reduces 16-bit audio received from the RDP server to
+     * 8-bit, if supported by the user. By default, bit depth is not reduced.
+     */
+    IDX_AUDIO_MAX_BIT_DEPTH,
+
+    /**
+     * "true" if the quality of audio sent to the user should be
+     * automatically reduced while the connection is lagging, "false" or
+     * blank otherwise.
+     */
+    IDX_AUDIO_ADAPTIVE,
+
     /**
      * "true" if printing should be enabled, "false" or blank otherwise.
      */
@@ -558,6 +593,21 @@ enum RDP_ARGS_IDX {
      */
     IDX_RECORDING_INCLUDE_KEYS,
 
+    /**
+     * Whether the session recording should be compressed. Compressed
+     * recordings are smaller and seekable, and are read transparently by
+     * guacenc and guaclog. By default, recordings are not compressed.
+     */
+    IDX_RECORDING_COMPRESS,
+
+    /**
+     * Whether instructions should be dropped from the session recording,
+     * rather than stalling the connection, if the recording cannot be written
+     * to disk quickly enough. By default, the connection waits for the
+     * recording to be written.
+     */
+    IDX_RECORDING_DROP_ON_OVERFLOW,
+
     /**
      * Whether the specified screen recording path should automatically be
      * created if it does not yet exist.
@@ -685,6 +735,12 @@ enum RDP_ARGS_IDX {
      */
     IDX_FORCE_LOSSLESS,
 
+    /**
+     * "true" if rapidly-changing regions of the display may be streamed as
+     * video to users which support it, "false" or blank otherwise.
+     */
+    IDX_ENABLE_VIDEO_STREAMING,
+
     /**
      * Controls whether the text content of the clipboard should be
      * automatically normalized to use a particular line ending format. Valid
@@ -865,6 +921,11 @@ guac_rdp_settings* guac_rdp_parse_args(guac_user* user,
         guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
                 IDX_FORCE_LOSSLESS, 0);
 
+    /* Video streaming of rapidly-changing regions */
+    settings->video_streaming =
+        guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_ENABLE_VIDEO_STREAMING, 0);
+
     /* Domain */
     settings->domain =
         guac_user_parse_args_string(user, GUAC_RDP_CLIENT_ARGS, argv,
@@ -1003,6 +1064,26 @@ guac_rdp_settings* guac_rdp_parse_args(guac_user* user,
         !guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
                 IDX_DISABLE_AUDIO, 0);
 
+    /* Maximum audio sample rate (zero for no limit) */
+    settings->audio_max_rate =
+        guac_user_parse_args_int(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_AUDIO_MAX_RATE, 0);
+
+    /* Maximum number of audio channels (zero for no limit) */
+    settings->audio_max_channels =
+        guac_user_parse_args_int(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_AUDIO_MAX_CHANNELS, 0);
+
+    /* Maximum audio bit depth (zero for no limit) */
+    settings->audio_max_bit_depth =
+        guac_user_parse_args_int(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_AUDIO_MAX_BIT_DEPTH, 0);
+
+    /* Automatic reduction of audio quality enable/disable */
+    settings->audio_adaptive =
+        guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_AUDIO_ADAPTIVE, 0);
+
     /* Printing enable/disable */
     settings->printing_enabled =
         guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
@@ -1156,6 +1237,16 @@ guac_rdp_settings* guac_rdp_parse_args(guac_user* user,
         guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
                 IDX_RECORDING_INCLUDE_KEYS, 0);
 
+    /* Parse recording compression flag */
+    settings->recording_compress =
+        guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_RECORDING_COMPRESS, 0);
+
+    /* Parse recording overflow behavior */
+    settings->recording_drop_on_overflow =
+        guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_RECORDING_DROP_ON_OVERFLOW, 0);
+
     /* Parse path creation flag */
     settings->create_recording_path =
         guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
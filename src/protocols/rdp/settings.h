@@ -203,11 +203,41 @@ typedef struct guac_rdp_settings {
      */
     int lossless;
 
+    /**
+     * Whether rapidly-changing regions of the display may be streamed as
+     * video rather than as a series of images.
+     */
+    int video_streaming;
+
     /**
      * Whether audio is enabled.
      */
     int audio_enabled;
 
+    /**
+     * The maximum sample rate of audio sent to the user, in Hz, or zero if
+     * there is no limit.
+     */
+    int audio_max_rate;
+
+    /**
+     * The maximum number of audio channels sent to the user, or zero if
+     * there is no limit.
+     */
+    int audio_max_channels;
+
+    /**
+     * The maximum number of bits per sample of audio sent to the user, or
+     * zero if there is no limit.
+     */
+    int audio_max_bit_depth;
+
+    /**
+     * Whether the quality of audio sent to the user should be automatically
+     * reduced while the connection is lagging.
+     */
+    int audio_adaptive;
+
     /**
      * Whether printing is enabled.
      */
@@ -559,6 +589,19 @@ typedef struct guac_rdp_settings {
      */
     int recording_include_keys;
 
+    /**
+     * Whether the session recording should be compressed, such that the
+     * recording is smaller and can be sought by timestamp.
+     */
+    int recording_compress;
+
+    /**
+     * Whether instructions should be dropped from the session recording,
+     * rather than stalling the connection, if the recording cannot be written
+     * to disk quickly enough.
+     */
+    int recording_drop_on_overflow;
+
     /**
      * The method to apply when the user's display changes size.
      */
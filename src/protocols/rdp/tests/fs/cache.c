@@ -0,0 +1,141 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "fs-cache.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/client.h>
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Builds the path of the given file or directory within the given temporary
+ * directory.
+ *
+ * @param buffer
+ *     The buffer to populate with the resulting path. This buffer MUST be at
+ *     least PATH_MAX bytes in size.
+ *
+ * @param root
+ *     The path of the temporary directory.
+ *
+ * @param name
+ *     The path of the file or directory relative to the temporary directory.
+ *
+ * @return
+ *     The given buffer.
+ */
+static const char* test_cache_path(char* buffer, const char* root,
+        const char* name) {
+    snprintf(buffer, PATH_MAX, "%s/%s", root, name);
+    return buffer;
+}
+
+/**
+ * Returns the number of entries within the listing of the directory at the
+ * given path, as returned by the given cache.
+ *
+ * @param cache
+ *     The cache to retrieve the listing from.
+ *
+ * @param path
+ *     The real path of the directory.
+ *
+ * @return
+ *     The number of entries in the directory (including "." and ".."), or -1
+ *     if the directory cannot be read.
+ */
+static int test_cache_count(guac_rdp_fs_cache* cache, const char* path) {
+
+    guac_rdp_fs_listing* listing = guac_rdp_fs_cache_get_listing(cache, path);
+    if (listing == NULL)
+        return -1;
+
+    int count = listing->count;
+    guac_rdp_fs_cache_release_listing(cache, listing);
+    return count;
+
+}
+
+/**
+ * Test which verifies that the cached listing of a directory is not used
+ * after an ancestor of that directory is renamed and replaced, a change which
+ * inotify does not report for the cached directory itself.
+ */
+void test_fs__cache_renamed_ancestor() {
+
+    char root[] = "/tmp/guac-rdp-fs-cache-XXXXXX";
+    CU_ASSERT_PTR_NOT_NULL_FATAL(mkdtemp(root));
+
+    char path[PATH_MAX];
+    CU_ASSERT_EQUAL_FATAL(mkdir(test_cache_path(path, root, "a"), 0700), 0);
+    CU_ASSERT_EQUAL_FATAL(mkdir(test_cache_path(path, root, "a/b"), 0700), 0);
+
+    FILE* file = fopen(test_cache_path(path, root, "a/b/file"), "w");
+    CU_ASSERT_PTR_NOT_NULL_FATAL(file);
+    fclose(file);
+
+    guac_client* client = guac_client_alloc();
+    guac_rdp_fs_cache* cache = guac_rdp_fs_cache_alloc(client);
+
+    /* Caching requires inotify */
+    if (cache->inotify_fd == -1) {
+        guac_rdp_fs_cache_free(cache);
+        guac_client_free(client);
+        return;
+    }
+
+    /* Cache the listing of "a/b" (".", "..", and "file") */
+    CU_ASSERT_EQUAL(test_cache_count(cache,
+                test_cache_path(path, root, "a/b")), 3);
+    CU_ASSERT_EQUAL(guac_rdp_fs_cache_exists(cache,
+                test_cache_path(path, root, "a/b/file")), 1);
+
+    /* Replace "a" with a new directory also containing an empty "b" */
+    char renamed[PATH_MAX];
+    CU_ASSERT_EQUAL_FATAL(rename(test_cache_path(path, root, "a"),
+                test_cache_path(renamed, root, "c")), 0);
+    CU_ASSERT_EQUAL_FATAL(mkdir(test_cache_path(path, root, "a"), 0700), 0);
+    CU_ASSERT_EQUAL_FATAL(mkdir(test_cache_path(path, root, "a/b"), 0700), 0);
+
+    /* The listing of the old "a/b" must no longer be used */
+    CU_ASSERT_NOT_EQUAL(guac_rdp_fs_cache_exists(cache,
+                test_cache_path(path, root, "a/b/file")), 1);
+    CU_ASSERT_EQUAL(test_cache_count(cache,
+                test_cache_path(path, root, "a/b")), 2);
+    CU_ASSERT_EQUAL(guac_rdp_fs_cache_exists(cache,
+                test_cache_path(path, root, "a/b/file")), 0);
+
+    guac_rdp_fs_cache_free(cache);
+    guac_client_free(client);
+
+    unlink(test_cache_path(path, root, "c/b/file"));
+    rmdir(test_cache_path(path, root, "c/b"));
+    rmdir(test_cache_path(path, root, "c"));
+    rmdir(test_cache_path(path, root, "a/b"));
+    rmdir(test_cache_path(path, root, "a"));
+    rmdir(root);
+
+}
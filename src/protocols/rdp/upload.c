@@ -17,6 +17,7 @@
  * under the License.
  */
 
+#include "common/upload.h"
 #include "fs.h"
 #include "rdp.h"
 #include "upload.h"
@@ -70,6 +71,144 @@ static void __generate_upload_path(const char* filename, char* path) {
 
 }
 
+/**
+ * Writes a block of received data to the file being uploaded, as required by
+ * guac_common_upload_write_handler. This handler is invoked by the upload's
+ * writer thread, not by the user's input thread.
+ *
+ * @param upload
+ *     The upload receiving the data.
+ *
+ * @param buffer
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes of data to write.
+ *
+ * @return
+ *     Zero if all data was written successfully, non-zero otherwise.
+ */
+static int guac_rdp_upload_write(guac_common_upload* upload,
+        const char* buffer, int length) {
+
+    guac_rdp_client* rdp_client = (guac_rdp_client*) upload->client->data;
+    guac_rdp_upload_status* upload_status = (guac_rdp_upload_status*) upload->data;
+
+    /* Get filesystem, return error if no filesystem */
+    guac_rdp_fs* fs = rdp_client->filesystem;
+    if (fs == NULL) {
+        upload->message = "FAIL (NO FS)";
+        upload->status = GUAC_PROTOCOL_STATUS_SERVER_ERROR;
+        return 1;
+    }
+
+    /* Write entire block */
+    while (length > 0) {
+
+        /* Attempt write */
+        int bytes_written = guac_rdp_fs_write(fs, upload_status->file_id,
+                upload_status->offset, (void*) buffer, length);
+
+        /* On error, abort */
+        if (bytes_written < 0) {
+            upload->message = "FAIL (BAD WRITE)";
+            upload->status = GUAC_PROTOCOL_STATUS_CLIENT_FORBIDDEN;
+            return 1;
+        }
+
+        /* Update counters */
+        upload_status->offset += bytes_written;
+        buffer += bytes_written;
+        length -= bytes_written;
+
+    }
+
+    return 0;
+
+}
+
+/**
+ * Closes the file being uploaded and frees the associated
+ * guac_rdp_upload_status, as required by guac_common_upload_close_handler.
+ *
+ * @param upload
+ *     The upload which has finished.
+ *
+ * @return
+ *     Zero if the file was closed successfully, non-zero otherwise.
+ */
+static int guac_rdp_upload_close(guac_common_upload* upload) {
+
+    guac_rdp_client* rdp_client = (guac_rdp_client*) upload->client->data;
+    guac_rdp_upload_status* upload_status = (guac_rdp_upload_status*) upload->data;
+    int result = 0;
+
+    /* Close file, failing if the filesystem has been unloaded */
+    guac_rdp_fs* fs = rdp_client->filesystem;
+    if (fs != NULL)
+        guac_rdp_fs_close(fs, upload_status->file_id);
+
+    else {
+        upload->message = "FAIL (NO FS)";
+        upload->status = GUAC_PROTOCOL_STATUS_SERVER_ERROR;
+        result = 1;
+    }
+
+    guac_mem_free(upload_status);
+    return result;
+
+}
+
+/**
+ * Begins receiving data for the given file upload stream, writing that data
+ * to the given open file in the background, and acknowledges the stream.
+ *
+ * @param user
+ *     The user sending the upload.
+ *
+ * @param stream
+ *     The stream along which the upload will be received.
+ *
+ * @param fs
+ *     The filesystem containing the destination file.
+ *
+ * @param file_id
+ *     The ID of the open destination file.
+ */
+static void guac_rdp_upload_begin(guac_user* user, guac_stream* stream,
+        guac_rdp_fs* fs, int file_id) {
+
+    /* Init upload status */
+    guac_rdp_upload_status* upload_status = guac_mem_alloc(sizeof(guac_rdp_upload_status));
+    upload_status->offset = 0;
+    upload_status->file_id = file_id;
+
+    /* Start writing received data in the background */
+    upload_status->upload = guac_common_upload_alloc(fs->uploads, user,
+            stream, guac_rdp_upload_write, guac_rdp_upload_close,
+            upload_status);
+
+    if (upload_status->upload == NULL) {
+        guac_rdp_fs_close(fs, file_id);
+        guac_mem_free(upload_status);
+        guac_protocol_send_ack(user->socket, stream, "FAIL (NO WRITER)",
+                GUAC_PROTOCOL_STATUS_SERVER_ERROR);
+        guac_socket_flush(user->socket);
+        return;
+    }
+
+    /* Init stream for file upload */
+    stream->data = upload_status;
+    stream->blob_handler = guac_rdp_upload_blob_handler;
+    stream->end_handler = guac_rdp_upload_end_handler;
+
+    /* Acknowledge stream creation */
+    guac_protocol_send_ack(user->socket, stream, "OK (STREAM BEGIN)",
+            GUAC_PROTOCOL_STATUS_SUCCESS);
+    guac_socket_flush(user->socket);
+
+}
+
 int guac_rdp_upload_file_handler(guac_user* user, guac_stream* stream,
         char* mimetype, char* filename) {
 
@@ -113,17 +252,7 @@ int guac_rdp_upload_file_handler(guac_user* user, guac_stream* stream,
         return 0;
     }
 
-    /* Init upload status */
-    guac_rdp_upload_status* upload_status = guac_mem_alloc(sizeof(guac_rdp_upload_status));
-    upload_status->offset = 0;
-    upload_status->file_id = file_id;
-    stream->data = upload_status;
-    stream->blob_handler = guac_rdp_upload_blob_handler;
-    stream->end_handler = guac_rdp_upload_end_handler;
-
-    guac_protocol_send_ack(user->socket, stream, "OK (STREAM BEGIN)",
-            GUAC_PROTOCOL_STATUS_SUCCESS);
-    guac_socket_flush(user->socket);
+    guac_rdp_upload_begin(user, stream, fs, file_id);
     return 0;
 
 }
@@ -131,74 +260,21 @@ int guac_rdp_upload_file_handler(guac_user* user, guac_stream* stream,
 int guac_rdp_upload_blob_handler(guac_user* user, guac_stream* stream,
         void* data, int length) {
 
-    int bytes_written;
     guac_rdp_upload_status* upload_status = (guac_rdp_upload_status*) stream->data;
 
-    /* Get filesystem, return error if no filesystem */
-    guac_client* client = user->client;
-    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
-    guac_rdp_fs* fs = rdp_client->filesystem;
-    if (fs == NULL) {
-        guac_protocol_send_ack(user->socket, stream, "FAIL (NO FS)",
-                GUAC_PROTOCOL_STATUS_SERVER_ERROR);
-        guac_socket_flush(user->socket);
-        return 0;
-    }
-
-    /* Write entire block */
-    while (length > 0) {
-
-        /* Attempt write */
-        bytes_written = guac_rdp_fs_write(fs, upload_status->file_id,
-                upload_status->offset, data, length);
-
-        /* On error, abort */
-        if (bytes_written < 0) {
-            guac_protocol_send_ack(user->socket, stream,
-                    "FAIL (BAD WRITE)",
-                    GUAC_PROTOCOL_STATUS_CLIENT_FORBIDDEN);
-            guac_socket_flush(user->socket);
-            return 0;
-        }
-
-        /* Update counters */
-        upload_status->offset += bytes_written;
-        data += bytes_written;
-        length -= bytes_written;
-
-    }
-
-    guac_protocol_send_ack(user->socket, stream, "OK (DATA RECEIVED)",
-            GUAC_PROTOCOL_STATUS_SUCCESS);
-    guac_socket_flush(user->socket);
+    /* Buffer block for writing, acknowledging as space allows */
+    guac_common_upload_write(upload_status->upload, data, length);
     return 0;
 
 }
 
 int guac_rdp_upload_end_handler(guac_user* user, guac_stream* stream) {
 
-    guac_client* client = user->client;
-    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
     guac_rdp_upload_status* upload_status = (guac_rdp_upload_status*) stream->data;
 
-    /* Get filesystem, return error if no filesystem */
-    guac_rdp_fs* fs = rdp_client->filesystem;
-    if (fs == NULL) {
-        guac_protocol_send_ack(user->socket, stream, "FAIL (NO FS)",
-                GUAC_PROTOCOL_STATUS_SERVER_ERROR);
-        guac_socket_flush(user->socket);
-        return 0;
-    }
-
-    /* Close file */
-    guac_rdp_fs_close(fs, upload_status->file_id);
-
-    /* Acknowledge stream end */
-    guac_protocol_send_ack(user->socket, stream, "OK (STREAM END)",
-            GUAC_PROTOCOL_STATUS_SUCCESS);
-    guac_socket_flush(user->socket);
-
-    guac_mem_free(upload_status);
+    /* Finish writing, close file, and acknowledge stream end (this also
+     * frees upload_status) */
+    guac_common_upload_end(upload_status->upload);
     return 0;
 
 }
@@ -242,20 +318,7 @@ int guac_rdp_upload_put_handler(guac_user* user, guac_object* object,
         return 0;
     }
 
-    /* Init upload stream data */
-    guac_rdp_upload_status* upload_status = guac_mem_alloc(sizeof(guac_rdp_upload_status));
-    upload_status->offset = 0;
-    upload_status->file_id = file_id;
-
-    /* Allocate stream, init for file upload */
-    stream->data = upload_status;
-    stream->blob_handler = guac_rdp_upload_blob_handler;
-    stream->end_handler = guac_rdp_upload_end_handler;
-
-    /* Acknowledge stream creation */
-    guac_protocol_send_ack(user->socket, stream, "OK (STREAM BEGIN)",
-            GUAC_PROTOCOL_STATUS_SUCCESS);
-    guac_socket_flush(user->socket);
+    guac_rdp_upload_begin(user, stream, fs, file_id);
     return 0;
 }
 
@@ -21,6 +21,7 @@
 #define GUAC_RDP_UPLOAD_H
 
 #include "common/json.h"
+#include "common/upload.h"
 
 #include <guacamole/protocol.h>
 #include <guacamole/stream.h>
@@ -44,6 +45,11 @@ typedef struct guac_rdp_upload_status {
      */
     int file_id;
 
+    /**
+     * The upload writing received data to the file in the background.
+     */
+    guac_common_upload* upload;
+
 } guac_rdp_upload_status;
 
 /**
@@ -153,6 +153,13 @@ int guac_rdp_user_leave_handler(guac_user* user) {
     if (rdp_client->display != NULL)
         guac_common_cursor_remove_user(rdp_client->display->cursor, user);
 
+#ifdef ENABLE_COMMON_SSH
+    /* Stop any downloads which the user will no longer receive */
+    if (rdp_client->sftp_filesystem != NULL)
+        guac_common_ssh_sftp_abort_downloads(rdp_client->sftp_filesystem,
+                user);
+#endif
+
     /* Free settings if not owner (owner settings will be freed with client) */
     if (!user->owner) {
         guac_rdp_settings* settings = (guac_rdp_settings*) user->data;
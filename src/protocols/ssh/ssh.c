@@ -264,7 +264,15 @@ void* ssh_client_thread(void* data) {
                 !settings->recording_exclude_output,
                 !settings->recording_exclude_mouse,
                 0, /* Touch events not supported */
-                settings->recording_include_keys);
+                settings->recording_include_keys,
+                settings->recording_compress);
+
+        /* Drop instructions rather than stall if storage cannot keep up */
+        if (ssh_client->recording != NULL
+                && settings->recording_drop_on_overflow)
+            guac_recording_set_overflow_policy(ssh_client->recording,
+                    GUAC_RECORDING_DEFAULT_MAX_QUEUED,
+                    GUAC_RECORDING_OVERFLOW_DROP);
     }
 
     /* Create terminal options with required parameters */
@@ -300,7 +308,9 @@ void* ssh_client_thread(void* data) {
         guac_terminal_create_typescript(ssh_client->term,
                 settings->typescript_path,
                 settings->typescript_name,
-                settings->create_typescript_path);
+                settings->create_typescript_path,
+                settings->typescript_compress,
+                settings->typescript_sync_interval);
     }
 
     /* Get user and credentials */
@@ -110,6 +110,11 @@ int guac_ssh_user_leave_handler(guac_user* user) {
     /* Remove the user from the terminal */
     guac_terminal_remove_user(ssh_client->term, user);
 
+    /* Stop any downloads which the user will no longer receive */
+    if (ssh_client->sftp_filesystem != NULL)
+        guac_common_ssh_sftp_abort_downloads(ssh_client->sftp_filesystem,
+                user);
+
     /* Free settings if not owner (owner settings will be freed with client) */
     if (!user->owner) {
         guac_ssh_settings* settings = (guac_ssh_settings*) user->data;
@@ -49,11 +49,15 @@ const char* GUAC_TELNET_CLIENT_ARGS[] = {
     "typescript-path",
     "typescript-name",
     "create-typescript-path",
+    "typescript-compress",
+    "typescript-sync-interval",
     "recording-path",
     "recording-name",
     "recording-exclude-output",
     "recording-exclude-mouse",
     "recording-include-keys",
+    "recording-compress",
+    "recording-drop-on-overflow",
     "create-recording-path",
     "read-only",
     "backspace",
@@ -149,6 +153,21 @@ enum TELNET_ARGS_IDX {
      */
     IDX_CREATE_TYPESCRIPT_PATH,
 
+    /**
+     * Whether typescripts should be gzip-compressed. If set to "true", both
+     * files of each typescript will be compressed and will have ".gz"
+     * appended to their names. By default, typescripts are not compressed.
+     */
+    IDX_TYPESCRIPT_COMPRESS,
+
+    /**
+     * The minimum number of milliseconds between explicit syncs of the
+     * typescript files to disk. If "0", the files are synced only when the
+     * typescript is closed. By default, or if negative, typescripts are never
+     * explicitly synced.
+     */
+    IDX_TYPESCRIPT_SYNC_INTERVAL,
+
     /**
      * The full absolute path to the directory in which screen recordings
      * should be written.
@@ -187,6 +206,21 @@ enum TELNET_ARGS_IDX {
      */
     IDX_RECORDING_INCLUDE_KEYS,
 
+    /**
+     * Whether the session recording should be compressed. Compressed
+     * recordings are smaller and seekable, and are read transparently by
+     * guacenc and guaclog. By default, recordings are not compressed.
+     */
+    IDX_RECORDING_COMPRESS,
+
+    /**
+     * Whether instructions should be dropped from the session recording,
+     * rather than stalling the connection, if the recording cannot be written
+     * to disk quickly enough. By default, the connection waits for the
+     * recording to be written.
+     */
+    IDX_RECORDING_DROP_ON_OVERFLOW,
+
     /**
      * Whether the specified screen recording path should automatically be
      * created if it does not yet exist.
@@ -456,6 +490,17 @@ guac_telnet_settings* guac_telnet_parse_args(guac_user* user,
         guac_user_parse_args_boolean(user, GUAC_TELNET_CLIENT_ARGS, argv,
                 IDX_CREATE_TYPESCRIPT_PATH, false);
 
+    /* Parse typescript compression flag */
+    settings->typescript_compress =
+        guac_user_parse_args_boolean(user, GUAC_TELNET_CLIENT_ARGS, argv,
+                IDX_TYPESCRIPT_COMPRESS, false);
+
+    /* Parse typescript sync interval */
+    settings->typescript_sync_interval =
+        guac_user_parse_args_int(user, GUAC_TELNET_CLIENT_ARGS, argv,
+                IDX_TYPESCRIPT_SYNC_INTERVAL,
+                GUAC_TERMINAL_TYPESCRIPT_SYNC_NEVER);
+
     /* Read recording path */
     settings->recording_path =
         guac_user_parse_args_string(user, GUAC_TELNET_CLIENT_ARGS, argv,
@@ -481,6 +526,16 @@ guac_telnet_settings* guac_telnet_parse_args(guac_user* user,
         guac_user_parse_args_boolean(user, GUAC_TELNET_CLIENT_ARGS, argv,
                 IDX_RECORDING_INCLUDE_KEYS, false);
 
+    /* Parse recording compression flag */
+    settings->recording_compress =
+        guac_user_parse_args_boolean(user, GUAC_TELNET_CLIENT_ARGS, argv,
+                IDX_RECORDING_COMPRESS, false);
+
+    /* Parse recording overflow behavior */
+    settings->recording_drop_on_overflow =
+        guac_user_parse_args_boolean(user, GUAC_TELNET_CLIENT_ARGS, argv,
+                IDX_RECORDING_DROP_ON_OVERFLOW, false);
+
     /* Parse path creation flag */
     settings->create_recording_path =
         guac_user_parse_args_boolean(user, GUAC_TELNET_CLIENT_ARGS, argv,
@@ -196,6 +196,19 @@ typedef struct guac_telnet_settings {
      */
     bool create_typescript_path;
 
+    /**
+     * Whether the typescript should be gzip-compressed.
+     */
+    bool typescript_compress;
+
+    /**
+     * The minimum amount of time between explicit syncs of the typescript
+     * files to disk, in milliseconds, zero if the files should be synced only
+     * when the typescript is closed, or GUAC_TERMINAL_TYPESCRIPT_SYNC_NEVER if
+     * the files should never be explicitly synced.
+     */
+    int typescript_sync_interval;
+
     /**
      * The path in which the screen recording should be saved, if enabled. If
      * no screen recording should be saved, this will be NULL.
@@ -239,6 +252,19 @@ typedef struct guac_telnet_settings {
      */
     bool recording_include_keys;
 
+    /**
+     * Whether the session recording should be compressed, such that the
+     * recording is smaller and can be sought by timestamp.
+     */
+    bool recording_compress;
+
+    /**
+     * Whether instructions should be dropped from the session recording,
+     * rather than stalling the connection, if the recording cannot be written
+     * to disk quickly enough.
+     */
+    bool recording_drop_on_overflow;
+
     /**
      * The ASCII code, as an integer, that the telnet client will use when the
      * backspace key is pressed.  By default, this is 127, ASCII delete, if
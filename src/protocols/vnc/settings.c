@@ -83,6 +83,8 @@ const char* GUAC_VNC_CLIENT_ARGS[] = {
     "recording-exclude-output",
     "recording-exclude-mouse",
     "recording-include-keys",
+    "recording-compress",
+    "recording-drop-on-overflow",
     "create-recording-path",
     "disable-copy",
     "disable-paste",
@@ -94,6 +96,7 @@ const char* GUAC_VNC_CLIENT_ARGS[] = {
     "wol-wait-time",
 
     "force-lossless",
+    "enable-video-streaming",
     NULL
 };
 
@@ -325,6 +328,21 @@ enum VNC_ARGS_IDX {
      */
     IDX_RECORDING_INCLUDE_KEYS,
 
+    /**
+     * Whether the session recording should be compressed. Compressed
+     * recordings are smaller and seekable, and are read transparently by
+     * guacenc and guaclog. By default, recordings are not compressed.
+     */
+    IDX_RECORDING_COMPRESS,
+
+    /**
+     * Whether instructions should be dropped from the session recording,
+     * rather than stalling the connection, if the recording cannot be written
+     * to disk quickly enough. By default, the connection waits for the
+     * recording to be written.
+     */
+    IDX_RECORDING_DROP_ON_OVERFLOW,
+
     /**
      * Whether the specified screen recording path should automatically be
      * created if it does not yet exist.
@@ -382,6 +400,12 @@ enum VNC_ARGS_IDX {
      */
     IDX_FORCE_LOSSLESS,
 
+    /**
+     * "true" if rapidly-changing regions of the display may be streamed as
+     * video to users which support it, "false" or blank otherwise.
+     */
+    IDX_ENABLE_VIDEO_STREAMING,
+
     VNC_ARGS_COUNT
 };
 
@@ -446,6 +470,11 @@ guac_vnc_settings* guac_vnc_parse_args(guac_user* user,
         guac_user_parse_args_boolean(user, GUAC_VNC_CLIENT_ARGS, argv,
                 IDX_FORCE_LOSSLESS, false);
 
+    /* Video streaming of rapidly-changing regions */
+    settings->video_streaming =
+        guac_user_parse_args_boolean(user, GUAC_VNC_CLIENT_ARGS, argv,
+                IDX_ENABLE_VIDEO_STREAMING, false);
+
 #ifdef ENABLE_VNC_REPEATER
     /* Set repeater parameters if specified */
     settings->dest_host =
@@ -589,6 +618,16 @@ guac_vnc_settings* guac_vnc_parse_args(guac_user* user,
         guac_user_parse_args_boolean(user, GUAC_VNC_CLIENT_ARGS, argv,
                 IDX_RECORDING_INCLUDE_KEYS, false);
 
+    /* Parse recording compression flag */
+    settings->recording_compress =
+        guac_user_parse_args_boolean(user, GUAC_VNC_CLIENT_ARGS, argv,
+                IDX_RECORDING_COMPRESS, false);
+
+    /* Parse recording overflow behavior */
+    settings->recording_drop_on_overflow =
+        guac_user_parse_args_boolean(user, GUAC_VNC_CLIENT_ARGS, argv,
+                IDX_RECORDING_DROP_ON_OVERFLOW, false);
+
     /* Parse path creation flag */
     settings->create_recording_path =
         guac_user_parse_args_boolean(user, GUAC_VNC_CLIENT_ARGS, argv,
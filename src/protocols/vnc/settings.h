@@ -82,6 +82,12 @@ typedef struct guac_vnc_settings {
      */
     bool lossless;
 
+    /**
+     * Whether rapidly-changing regions of the display may be streamed as
+     * video rather than as a series of images.
+     */
+    bool video_streaming;
+
 #ifdef ENABLE_VNC_REPEATER
     /**
      * The VNC host to connect to, if using a repeater.
@@ -274,6 +280,19 @@ typedef struct guac_vnc_settings {
      * as passwords, credit card numbers, etc.
      */
     bool recording_include_keys;
+
+    /**
+     * Whether the session recording should be compressed, such that the
+     * recording is smaller and can be sought by timestamp.
+     */
+    bool recording_compress;
+
+    /**
+     * Whether instructions should be dropped from the session recording,
+     * rather than stalling the connection, if the recording cannot be written
+     * to disk quickly enough.
+     */
+    bool recording_drop_on_overflow;
     
     /**
      * Whether or not to send the magic Wake-on-LAN (WoL) packet prior to
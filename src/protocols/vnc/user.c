@@ -126,6 +126,13 @@ int guac_vnc_user_leave_handler(guac_user* user) {
         guac_common_cursor_remove_user(vnc_client->display->cursor, user);
     }
 
+#ifdef ENABLE_COMMON_SSH
+    /* Stop any downloads which the user will no longer receive */
+    if (vnc_client->sftp_filesystem != NULL)
+        guac_common_ssh_sftp_abort_downloads(vnc_client->sftp_filesystem,
+                user);
+#endif
+
     /* Free settings if not owner (owner settings will be freed with client) */
     if (!user->owner) {
         guac_vnc_settings* settings = (guac_vnc_settings*) user->data;
@@ -25,6 +25,7 @@
 #include "common/clipboard.h"
 #include "common/cursor.h"
 #include "common/display.h"
+#include "common/surface.h"
 #include "cursor.h"
 #include "display.h"
 #include "log.h"
@@ -35,6 +36,10 @@
 #include "pulse/pulse.h"
 #endif
 
+#ifdef ENABLE_VIDEO_STREAMING
+#include "common/video.h"
+#endif
+
 #ifdef ENABLE_COMMON_SSH
 #include "common-ssh/sftp.h"
 #include "common-ssh/ssh.h"
@@ -428,7 +433,15 @@ void* guac_vnc_client_thread(void* data) {
                 !settings->recording_exclude_output,
                 !settings->recording_exclude_mouse,
                 0, /* Touch events not supported */
-                settings->recording_include_keys);
+                settings->recording_include_keys,
+                settings->recording_compress);
+
+        /* Drop instructions rather than stall if storage cannot keep up */
+        if (vnc_client->recording != NULL
+                && settings->recording_drop_on_overflow)
+            guac_recording_set_overflow_policy(vnc_client->recording,
+                    GUAC_RECORDING_DEFAULT_MAX_QUEUED,
+                    GUAC_RECORDING_OVERFLOW_DROP);
     }
 
     /* Create display */
@@ -439,6 +452,13 @@ void* guac_vnc_client_thread(void* data) {
      * heuristics) */
     guac_common_display_set_lossless(vnc_client->display, settings->lossless);
 
+#ifdef ENABLE_VIDEO_STREAMING
+    /* Stream rapidly-changing regions as video only if requested */
+    if (settings->video_streaming)
+        guac_common_surface_set_video(vnc_client->display->default_surface,
+                &guac_common_video_encoder);
+#endif
+
     /* If not read-only, set an appropriate cursor */
     if (settings->read_only == 0) {
         if (settings->remote_cursor)
@@ -460,7 +480,7 @@ void* guac_vnc_client_thread(void* data) {
                 GUAC_VNC_FRAME_START_TIMEOUT);
         if (wait_result > 0) {
 
-            int processing_lag = guac_client_get_processing_lag(client);
+            int display_lag = guac_client_get_display_lag(client);
             guac_timestamp frame_start = guac_timestamp_current();
 
             /* Read server messages until frame is built */
@@ -484,7 +504,7 @@ void* guac_vnc_client_thread(void* data) {
 
                 /* Calculate time that client needs to catch up */
                 int time_elapsed = frame_end - last_frame_end;
-                int required_wait = processing_lag - time_elapsed;
+                int required_wait = display_lag - time_elapsed;
 
                 /* Increase the duration of this frame if client is lagging */
                 if (required_wait > GUAC_VNC_FRAME_TIMEOUT)
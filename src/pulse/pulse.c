@@ -24,9 +24,39 @@
 #include <guacamole/audio.h>
 #include <guacamole/mem.h>
 #include <guacamole/client.h>
+#include <guacamole/timestamp.h>
 #include <guacamole/user.h>
 #include <pulse/pulseaudio.h>
 
+#include <string.h>
+
+/**
+ * Writes the given number of bytes of silence to the given audio stream, as
+ * if an all-zero buffer of that length had been received.
+ *
+ * @param audio
+ *     The audio stream to write silence to.
+ *
+ * @param length
+ *     The number of bytes of silence to write.
+ */
+static void guac_pa_write_silence(guac_audio_stream* audio, size_t length) {
+
+    static const unsigned char silence[GUAC_PULSE_AUDIO_MIN_FRAGMENT_SIZE];
+
+    while (length > 0) {
+
+        size_t chunk = length;
+        if (chunk > sizeof(silence))
+            chunk = sizeof(silence);
+
+        guac_audio_stream_write_pcm(audio, silence, chunk);
+        length -= chunk;
+
+    }
+
+}
+
 /**
  * Returns whether the given buffer contains only silence (only null bytes).
  *
@@ -41,21 +71,88 @@
  */
 static int guac_pa_is_silence(const void* buffer, size_t length) {
 
-    int i;
-
     const unsigned char* current = (const unsigned char*) buffer;
 
-    /* For each byte in buffer */
-    for (i = 0; i < length; i++) {
+    /* An empty buffer is trivially silent */
+    if (length == 0)
+        return 1;
 
-        /* If current value non-zero, then not silence */
-        if (*(current++))
-            return 0;
+    /* The buffer is 100% silence if its first byte is null and every byte
+     * is equal to the byte following it (compared in bulk by memcmp()) */
+    return current[0] == 0 && memcmp(current, current + 1, length - 1) == 0;
 
-    }
+}
+
+/**
+ * Requests that PulseAudio deliver audio in fragments of the given size, if
+ * that size differs from the size most recently requested.
+ *
+ * @param guac_stream
+ *     The guac_pa_stream whose PulseAudio stream should be updated.
+ *
+ * @param fragment_size
+ *     The desired fragment size, in bytes.
+ */
+static void guac_pa_stream_set_fragment_size(guac_pa_stream* guac_stream,
+        int fragment_size) {
+
+    /* Do not update attributes unnecessarily */
+    if (guac_stream->pa_record_stream == NULL
+            || guac_stream->fragment_size == fragment_size)
+        return;
+
+    pa_buffer_attr attr;
+    attr.maxlength = -1;
+    attr.tlength   = -1;
+    attr.prebuf    = -1;
+    attr.minreq    = -1;
+    attr.fragsize  = fragment_size;
+
+    pa_operation* operation = pa_stream_set_buffer_attr(
+            guac_stream->pa_record_stream, &attr, NULL, NULL);
 
-    /* Otherwise, the buffer contains 100% silence */
-    return 1;
+    if (operation != NULL)
+        pa_operation_unref(operation);
+
+    guac_client_log(guac_stream->client, GUAC_LOG_DEBUG, "Requesting %i-byte "
+            "audio fragments from PulseAudio.", fragment_size);
+
+    guac_stream->fragment_size = fragment_size;
+
+}
+
+/**
+ * Checks the display lag of the client associated with the given
+ * guac_pa_stream (no more often than GUAC_PULSE_LAG_CHECK_INTERVAL),
+ * doubling the fragment size used for non-silent audio under sustained lag,
+ * such that fewer and larger packets of audio are handled, and halving the
+ * fragment size once lag has subsided, such that audio latency is reduced.
+ *
+ * @param guac_stream
+ *     The guac_pa_stream whose fragment size should be adjusted.
+ */
+static void guac_pa_stream_check_lag(guac_pa_stream* guac_stream) {
+
+    guac_timestamp now = guac_timestamp_current();
+
+    /* Avoid checking lag more often than necessary */
+    if (now - guac_stream->last_lag_check < GUAC_PULSE_LAG_CHECK_INTERVAL)
+        return;
+
+    guac_stream->last_lag_check = now;
+
+    int lag = guac_client_get_display_lag(guac_stream->client);
+    int fragment_size = guac_stream->active_fragment_size;
+
+    if (lag > GUAC_AUDIO_HIGH_LAG
+            && fragment_size < GUAC_PULSE_AUDIO_MAX_FRAGMENT_SIZE)
+        fragment_size *= 2;
+
+    else if (lag < GUAC_AUDIO_LOW_LAG
+            && fragment_size > GUAC_PULSE_AUDIO_MIN_FRAGMENT_SIZE)
+        fragment_size /= 2;
+
+    guac_stream->active_fragment_size = fragment_size;
 
 }
 
@@ -63,6 +160,13 @@ static int guac_pa_is_silence(const void* buffer, size_t length) {
  * Callback invoked by PulseAudio when PCM data is available for reading
  * from the given stream. The PCM data can be read using pa_stream_peek().
  *
+ * Received PCM data is written to the audio stream, which accumulates that
+ * data into packets, with the audio stream flushed only once audio has
+ * stopped. Short periods of silence within audio are written as-is, but
+ * once GUAC_PULSE_SILENCE_LENGTH bytes of contiguous silence have been
+ * received, all further silence is dropped without being sent until audio
+ * resumes.
+ *
  * @param stream
  *     The PulseAudio stream which has PCM data available.
  *
@@ -81,20 +185,54 @@ static void __stream_read_callback(pa_stream* stream, size_t length,
 
     const void* buffer;
 
-    /* Read data */
-    pa_stream_peek(stream, &buffer, &length);
+    /* Read data, stopping if no data is actually available */
+    if (pa_stream_peek(stream, &buffer, &length) || length == 0)
+        return;
 
-    /* Continuously write received PCM data */
-    if (!guac_pa_is_silence(buffer, length))
+    /* Holes within the recorded audio (NULL buffer) are silence */
+    int silence = (buffer == NULL) || guac_pa_is_silence(buffer, length);
+
+    if (!silence) {
+
+        /* Audio has (re)started */
+        guac_stream->silent = 0;
+        guac_stream->silence_length = 0;
         guac_audio_stream_write_pcm(audio, buffer, length);
 
-    /* Flush upon silence */
-    else
-        guac_audio_stream_flush(audio);
+    }
+
+    /* Stream short periods of silence as-is, preserving audio timing */
+    else if (!guac_stream->silent) {
+
+        guac_stream->silence_length += length;
+
+        /* Holes are filled with silence, such that audio following the hole
+         * is not played early */
+        if (buffer != NULL)
+            guac_audio_stream_write_pcm(audio, buffer, length);
+        else
+            guac_pa_write_silence(audio, length);
+
+        /* Flush once (and only once) when audio stops, switching to the
+         * largest possible fragments while silence continues */
+        if (guac_stream->silence_length >= GUAC_PULSE_SILENCE_LENGTH) {
+            guac_audio_stream_flush(audio);
+            guac_stream->silent = 1;
+            guac_pa_stream_set_fragment_size(guac_stream,
+                    GUAC_PULSE_AUDIO_MAX_FRAGMENT_SIZE);
+        }
+
+    }
 
     /* Advance buffer */
     pa_stream_drop(stream);
 
+    /* Adjust fragment size of non-silent audio to match client lag */
+    guac_pa_stream_check_lag(guac_stream);
+    if (!guac_stream->silent)
+        guac_pa_stream_set_fragment_size(guac_stream,
+                guac_stream->active_fragment_size);
+
 }
 
 /**
@@ -190,7 +328,7 @@ static void __context_get_sink_info_callback(pa_context* context,
     spec.channels = GUAC_PULSE_AUDIO_CHANNELS;
 
     attr.maxlength = -1;
-    attr.fragsize  = GUAC_PULSE_AUDIO_FRAGMENT_SIZE;
+    attr.fragsize  = guac_stream->fragment_size;
 
     /* Create stream */
     stream = pa_stream_new(context, "Guacamole Audio", &spec, NULL);
@@ -200,6 +338,7 @@ static void __context_get_sink_info_callback(pa_context* context,
     pa_stream_set_read_callback(stream, __stream_read_callback, guac_stream);
 
     /* Start stream */
+    guac_stream->pa_record_stream = stream;
     pa_stream_connect_record(stream, info->monitor_source_name, &attr,
                 PA_STREAM_DONT_INHIBIT_AUTO_SUSPEND
               | PA_STREAM_ADJUST_LATENCY);
@@ -317,6 +456,14 @@ guac_pa_stream* guac_pa_stream_alloc(guac_client* client,
     stream->client = client;
     stream->audio = audio;
     stream->pa_mainloop = pa_threaded_mainloop_new();
+    stream->pa_record_stream = NULL;
+
+    /* No audio has yet been received */
+    stream->fragment_size = GUAC_PULSE_AUDIO_MAX_FRAGMENT_SIZE;
+    stream->active_fragment_size = GUAC_PULSE_AUDIO_FRAGMENT_SIZE;
+    stream->last_lag_check = guac_timestamp_current();
+    stream->silent = 1;
+    stream->silence_length = 0;
 
     /* Create context */
     pa_context* context = pa_context_new(
@@ -24,21 +24,52 @@
 
 #include <guacamole/audio.h>
 #include <guacamole/client.h>
+#include <guacamole/timestamp.h>
 #include <guacamole/user.h>
 #include <pulse/pulseaudio.h>
 
 /**
- * The number of bytes to request for the audio fragments received from
- * PulseAudio.
+ * The number of bytes to initially request for the audio fragments received
+ * from PulseAudio while audio is not silent. The fragment size is adjusted
+ * while streaming, between GUAC_PULSE_AUDIO_MIN_FRAGMENT_SIZE and
+ * GUAC_PULSE_AUDIO_MAX_FRAGMENT_SIZE, depending on client lag.
  */
 #define GUAC_PULSE_AUDIO_FRAGMENT_SIZE 8192
 
+/**
+ * The smallest fragment size that will be requested from PulseAudio, in
+ * bytes. The current value is 4K, which works out to be around 23ms.
+ */
+#define GUAC_PULSE_AUDIO_MIN_FRAGMENT_SIZE 4096
+
+/**
+ * The largest fragment size that will be requested from PulseAudio, in bytes.
+ * This fragment size is always used while audio is silent, such that idle
+ * audio streams are woken as rarely as possible. The current value is 32K,
+ * which works out to be around 190ms.
+ */
+#define GUAC_PULSE_AUDIO_MAX_FRAGMENT_SIZE 32768
+
+/**
+ * The number of milliseconds to wait between checks of client lag for the
+ * sake of adjusting the fragment size.
+ */
+#define GUAC_PULSE_LAG_CHECK_INTERVAL 1000
+
 /**
  * The minimum number of PCM bytes to wait for before flushing an audio
  * packet. The current value is 48K, which works out to be around 280ms.
  */
 #define GUAC_PULSE_PCM_WRITE_RATE 49152
 
+/**
+ * The number of bytes of continuous silence (all-zero PCM data) that must be
+ * received before audio is considered to have stopped. Shorter periods of
+ * silence are streamed as-is so that the timing of the surrounding audio is
+ * preserved. The current value is 43K, which works out to be around 250ms.
+ */
+#define GUAC_PULSE_SILENCE_LENGTH 44100
+
 /**
  * Rate of audio to stream, in Hz.
  */
@@ -75,6 +106,40 @@ typedef struct guac_pa_stream {
      */
     pa_threaded_mainloop* pa_mainloop;
 
+    /**
+     * The PulseAudio stream from which audio is being recorded, or NULL if
+     * recording has not yet started.
+     */
+    pa_stream* pa_record_stream;
+
+    /**
+     * The fragment size most recently requested from PulseAudio, in bytes.
+     */
+    int fragment_size;
+
+    /**
+     * The fragment size to use while audio is not silent, in bytes, as
+     * determined by the most recent check of client lag.
+     */
+    int active_fragment_size;
+
+    /**
+     * The time that client lag was last checked.
+     */
+    guac_timestamp last_lag_check;
+
+    /**
+     * Whether audio is currently considered to have stopped. While silent,
+     * received PCM data containing only silence is dropped entirely.
+     */
+    int silent;
+
+    /**
+     * The number of contiguous bytes of silence received since the last PCM
+     * data that was not silent.
+     */
+    int silence_length;
+
 } guac_pa_stream;
 
 /**
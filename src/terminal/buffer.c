@@ -21,6 +21,7 @@
 #include "terminal/common.h"
 
 #include <guacamole/mem.h>
+#include <guacamole/unicode.h>
 
 #include <stdlib.h>
 #include <string.h>
@@ -50,6 +51,16 @@ guac_terminal_buffer* guac_terminal_buffer_alloc(int rows, guac_terminal_char* d
         row->length = 0;
         row->characters = guac_mem_alloc(sizeof(guac_terminal_char), row->available);
 
+        /* Text representation is generated only when first requested */
+        row->text = NULL;
+        row->text_length = 0;
+        row->text_available = 0;
+        row->text_offsets = guac_mem_alloc(sizeof(int), row->available + 1);
+        row->text_offsets[0] = 0;
+        row->text_columns = 0;
+        row->text_signature = 0;
+        row->text_signature_length = 0;
+
         /* Next row */
         row++;
 
@@ -67,6 +78,8 @@ void guac_terminal_buffer_free(guac_terminal_buffer* buffer) {
     /* Free all rows */
     for (i=0; i<buffer->available; i++) {
         guac_mem_free(row->characters);
+        guac_mem_free(row->text);
+        guac_mem_free(row->text_offsets);
         row++;
     }
 
@@ -76,6 +89,39 @@ void guac_terminal_buffer_free(guac_terminal_buffer* buffer) {
 
 }
 
+/**
+ * Discards the cached text of the given row from the given column onward,
+ * such that only that portion of the row is re-encoded when its text is next
+ * needed. The text of columns before the given column remains valid.
+ *
+ * @param buffer_row
+ *     The row being modified.
+ *
+ * @param column
+ *     The first column being modified.
+ */
+static void guac_terminal_buffer_invalidate_text(
+        guac_terminal_buffer_row* buffer_row, int column) {
+
+    if (column < 0)
+        column = 0;
+
+    /* Text before the modified column is unaffected */
+    if (column >= buffer_row->text_columns)
+        return;
+
+    buffer_row->text_columns = column;
+    buffer_row->text_length = buffer_row->text_offsets[column];
+
+    /* Bits cannot be removed from a signature, thus it must be rebuilt if
+     * any of the text it summarizes is discarded */
+    if (buffer_row->text_signature_length > buffer_row->text_length) {
+        buffer_row->text_signature = 0;
+        buffer_row->text_signature_length = 0;
+    }
+
+}
+
 guac_terminal_buffer_row* guac_terminal_buffer_get_row(guac_terminal_buffer* buffer, int row, int width) {
 
     int i;
@@ -98,6 +144,8 @@ guac_terminal_buffer_row* guac_terminal_buffer_get_row(guac_terminal_buffer* buf
             buffer_row->available = guac_mem_ckd_mul_or_die(width, 2);
             buffer_row->characters = guac_mem_realloc_or_die(buffer_row->characters,
                     sizeof(guac_terminal_char), buffer_row->available);
+            buffer_row->text_offsets = guac_mem_realloc_or_die(buffer_row->text_offsets,
+                    sizeof(int), guac_mem_ckd_add_or_die(buffer_row->available, 1));
         }
 
         /* Initialize new part of row */
@@ -135,6 +183,7 @@ void guac_terminal_buffer_copy_columns(guac_terminal_buffer* buffer, int row,
 
     /* Copy data */
     memmove(dst, src, sizeof(guac_terminal_char) * (end_column - start_column + 1));
+    guac_terminal_buffer_invalidate_text(buffer_row, start_column + offset);
 
 }
 
@@ -167,6 +216,26 @@ void guac_terminal_buffer_copy_rows(guac_terminal_buffer* buffer,
         memcpy(dst_row->characters, src_row->characters, sizeof(guac_terminal_char) * src_row->length);
         dst_row->length = src_row->length;
 
+        /* Copy whatever text has already been generated for the source row
+         * rather than re-encoding the same characters */
+        int text_length = src_row->text_length;
+        if (text_length > dst_row->text_available) {
+            dst_row->text_available = src_row->text_available;
+            dst_row->text = guac_mem_realloc_or_die(dst_row->text,
+                    dst_row->text_available);
+        }
+
+        if (text_length > 0)
+            memcpy(dst_row->text, src_row->text, text_length);
+
+        memcpy(dst_row->text_offsets, src_row->text_offsets,
+                sizeof(int) * (src_row->text_columns + 1));
+
+        dst_row->text_length = text_length;
+        dst_row->text_columns = src_row->text_columns;
+        dst_row->text_signature = src_row->text_signature;
+        dst_row->text_signature_length = src_row->text_signature_length;
+
         /* Next current_row */
         current_row += step;
 
@@ -194,6 +263,7 @@ void guac_terminal_buffer_set_columns(guac_terminal_buffer* buffer, int row,
     guac_terminal_buffer_row* buffer_row = guac_terminal_buffer_get_row(buffer, row, end_column+1);
 
     /* Set values */
+    guac_terminal_buffer_invalidate_text(buffer_row, start_column);
     current = &(buffer_row->characters[start_column]);
     for (i = start_column; i <= end_column; i += character->width) {
 
@@ -211,3 +281,205 @@ void guac_terminal_buffer_set_columns(guac_terminal_buffer* buffer, int row,
 
 }
 
+
+/**
+ * Folds the given byte to lowercase if it is an uppercase ASCII letter,
+ * returning all other bytes unchanged.
+ *
+ * @param c
+ *     The byte to fold.
+ *
+ * @return
+ *     The given byte, converted to lowercase if it is an uppercase ASCII
+ *     letter.
+ */
+static unsigned char guac_terminal_buffer_fold(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+/**
+ * Adds the pairs of adjacent bytes ending within the given range of the given
+ * text to the given signature.
+ *
+ * @param signature
+ *     The signature to add to.
+ *
+ * @param text
+ *     The text being summarized.
+ *
+ * @param start
+ *     The offset of the first byte to add, inclusive. The pair formed with
+ *     the preceding byte, if any, is also added.
+ *
+ * @param end
+ *     The offset of the last byte to add, exclusive.
+ *
+ * @return
+ *     The updated signature.
+ */
+static uint64_t guac_terminal_buffer_extend_signature(uint64_t signature,
+        const char* text, int start, int end) {
+
+    if (start < 1)
+        start = 1;
+
+    for (int i = start; i < end; i++) {
+        unsigned int pair =
+              guac_terminal_buffer_fold((unsigned char) text[i - 1]) * 31
+            + guac_terminal_buffer_fold((unsigned char) text[i]);
+        signature |= ((uint64_t) 1) << (pair & 0x3F);
+    }
+
+    return signature;
+
+}
+
+uint64_t guac_terminal_buffer_text_signature(const char* text, int length) {
+    return guac_terminal_buffer_extend_signature(0, text, 1, length);
+}
+
+/**
+ * Encodes any columns of the given row which are not yet reflected by its
+ * cached UTF-8 text, appending the result to that text along with the offset
+ * of each newly-encoded column, and extends the signature of the row to
+ * cover the new text. If the cached text is already up-to-date, this
+ * function has no effect.
+ *
+ * @param buffer_row
+ *     The row whose text representation should be updated.
+ */
+static void guac_terminal_buffer_update_text(
+        guac_terminal_buffer_row* buffer_row) {
+
+    /* Discard any text for columns no longer within the row */
+    if (buffer_row->text_columns > buffer_row->length)
+        guac_terminal_buffer_invalidate_text(buffer_row, buffer_row->length);
+
+    /* Ensure enough space exists for the worst case of four bytes per
+     * character, plus null terminator */
+    int required = guac_mem_ckd_add_or_die(
+            guac_mem_ckd_mul_or_die(buffer_row->length, 4), 1);
+
+    if (required > buffer_row->text_available) {
+        buffer_row->text_available = guac_mem_ckd_mul_or_die(required, 2);
+        buffer_row->text = guac_mem_realloc_or_die(buffer_row->text,
+                buffer_row->text_available);
+    }
+
+    /* Encode only those characters which were added or modified since the
+     * text was last updated, recording where each column begins */
+    if (buffer_row->text_columns < buffer_row->length) {
+
+        char* current = buffer_row->text + buffer_row->text_length;
+        int remaining = buffer_row->text_available - 1 - buffer_row->text_length;
+
+        guac_terminal_char* character =
+            &(buffer_row->characters[buffer_row->text_columns]);
+
+        for (int i = buffer_row->text_columns; i < buffer_row->length; i++) {
+
+            buffer_row->text_offsets[i] = current - buffer_row->text;
+
+            /* Ignore null (blank) characters */
+            int codepoint = (character++)->value;
+            if (codepoint == 0 || codepoint == GUAC_CHAR_CONTINUATION)
+                continue;
+
+            int bytes = guac_utf8_write(codepoint, current, remaining);
+            current += bytes;
+            remaining -= bytes;
+
+        }
+
+        buffer_row->text_length = current - buffer_row->text;
+        buffer_row->text_offsets[buffer_row->length] = buffer_row->text_length;
+        buffer_row->text_columns = buffer_row->length;
+
+    }
+
+    buffer_row->text[buffer_row->text_length] = '\0';
+
+    /* Summarize only the newly-encoded text */
+    buffer_row->text_signature = guac_terminal_buffer_extend_signature(
+            buffer_row->text_signature, buffer_row->text,
+            buffer_row->text_signature_length, buffer_row->text_length);
+    buffer_row->text_signature_length = buffer_row->text_length;
+
+}
+
+const char* guac_terminal_buffer_get_text(guac_terminal_buffer* buffer,
+        int row, int start_column, int end_column, int* length) {
+
+    guac_terminal_buffer_row* buffer_row =
+        guac_terminal_buffer_get_row(buffer, row, 0);
+
+    guac_terminal_buffer_update_text(buffer_row);
+
+    /* Clip given range to actual bounds of row */
+    if (start_column < 0)
+        start_column = 0;
+    else if (start_column > buffer_row->length)
+        start_column = buffer_row->length;
+
+    if (end_column < 0 || end_column > buffer_row->length - 1)
+        end_column = buffer_row->length - 1;
+
+    /* Translate columns into byte offsets */
+    int start = buffer_row->text_offsets[start_column];
+    int end = buffer_row->text_offsets[end_column + 1];
+
+    *length = (end > start) ? end - start : 0;
+    return buffer_row->text + start;
+
+}
+
+int guac_terminal_buffer_get_text_column(guac_terminal_buffer* buffer,
+        int row, int offset) {
+
+    guac_terminal_buffer_row* buffer_row =
+        guac_terminal_buffer_get_row(buffer, row, 0);
+
+    guac_terminal_buffer_update_text(buffer_row);
+
+    /* Binary search for the last column which begins at or before the given
+     * offset (blank and continuation columns share the offset of the
+     * following character and thus are never chosen over it) */
+    int low = 0;
+    int high = buffer_row->length - 1;
+    while (low < high) {
+
+        int mid = low + (high - low + 1) / 2;
+        if (buffer_row->text_offsets[mid] <= offset)
+            low = mid;
+        else
+            high = mid - 1;
+
+    }
+
+    /* Walk back to the start of any multi-column character */
+    while (low > 0 && buffer_row->characters[low].value == GUAC_CHAR_CONTINUATION)
+        low--;
+
+    return low;
+
+}
+
+uint64_t guac_terminal_buffer_get_signature(guac_terminal_buffer* buffer,
+        int row) {
+
+    guac_terminal_buffer_row* buffer_row =
+        guac_terminal_buffer_get_row(buffer, row, 0);
+
+    guac_terminal_buffer_update_text(buffer_row);
+    return buffer_row->text_signature;
+
+}
+
+void guac_terminal_buffer_commit_rows(guac_terminal_buffer* buffer,
+        int start_row, int end_row) {
+
+    for (int row = start_row; row <= end_row; row++)
+        guac_terminal_buffer_update_text(
+                guac_terminal_buffer_get_row(buffer, row, 0));
+
+}
@@ -29,7 +29,11 @@
 #include <guacamole/socket.h>
 #include <guacamole/unicode.h>
 
+#include <regex.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
 
 /**
  * Returns the coordinates for the currently-selected range of text within the
@@ -281,51 +285,19 @@ void guac_terminal_select_resume(guac_terminal* terminal, int row, int column) {
 static void guac_terminal_clipboard_append_row(guac_terminal* terminal,
         int row, int start, int end) {
 
-    char buffer[1024];
-    int i = start;
-
-    guac_terminal_buffer_row* buffer_row =
-        guac_terminal_buffer_get_row(terminal->buffer, row, 0);
-
     /* If selection is entirely outside the bounds of the row, then there is
      * nothing to append */
-    if (start < 0 || start > buffer_row->length - 1)
+    if (start < 0)
         return;
 
-    /* Clip given range to actual bounds of row */
-    if (end < 0 || end > buffer_row->length - 1)
-        end = buffer_row->length - 1;
-
-    /* Repeatedly convert chunks of terminal buffer rows until entire specified
-     * region has been appended to clipboard */
-    while (i <= end) {
-
-        int remaining = sizeof(buffer);
-        char* current = buffer;
-
-        /* Convert as many codepoints within the given range as possible */
-        for (i = start; i <= end; i++) {
-
-            int codepoint = buffer_row->characters[i].value;
-
-            /* Ignore null (blank) characters */
-            if (codepoint == 0 || codepoint == GUAC_CHAR_CONTINUATION)
-                continue;
-
-            /* Encode current codepoint as UTF-8 */
-            int bytes = guac_utf8_write(codepoint, current, remaining);
-            if (bytes == 0)
-                break;
+    /* Append the cached UTF-8 text of the requested range directly, without
+     * re-encoding the characters of the row */
+    int length;
+    const char* text = guac_terminal_buffer_get_text(terminal->buffer,
+            row, start, end, &length);
 
-            current += bytes;
-            remaining -= bytes;
-
-        }
-
-        /* Append converted buffer to clipboard */
-        guac_common_clipboard_append(terminal->clipboard, buffer, current - buffer);
-
-    }
+    if (length > 0)
+        guac_common_clipboard_append(terminal->clipboard, text, length);
 
 }
 
@@ -439,3 +411,309 @@ void guac_terminal_select_touch(guac_terminal* terminal,
 
 }
 
+
+/**
+ * The state of a search through the text of a terminal, as performed by
+ * guac_terminal_select_search().
+ */
+typedef struct guac_terminal_search_state {
+
+    /**
+     * The literal text being searched for, if not searching by regular
+     * expression.
+     */
+    const char* pattern;
+
+    /**
+     * The length of the literal text being searched for, in bytes.
+     */
+    int pattern_length;
+
+    /**
+     * Whether the pattern is a regular expression, in which case regex
+     * contains the compiled form of that expression.
+     */
+    bool is_regex;
+
+    /**
+     * The compiled regular expression being searched for, if is_regex is
+     * true.
+     */
+    regex_t regex;
+
+    /**
+     * Whether the search should ignore case.
+     */
+    bool ignore_case;
+
+    /**
+     * The signature of the literal text being searched for, as produced by
+     * guac_terminal_buffer_text_signature(). Rows whose signatures lack any
+     * bit of this signature cannot contain the text and are skipped without
+     * being searched. This is always zero for regular expressions.
+     */
+    uint64_t signature;
+
+} guac_terminal_search_state;
+
+/**
+ * Locates the first match of the given search within the given text which
+ * begins at or after the given byte offset.
+ *
+ * @param search
+ *     The search being performed.
+ *
+ * @param text
+ *     The null-terminated text to search.
+ *
+ * @param offset
+ *     The byte offset within the text at which the search should begin.
+ *
+ * @param match_length
+ *     A pointer to an int which will receive the length of the match, in
+ *     bytes, if a match is found.
+ *
+ * @return
+ *     The byte offset of the start of the match, or -1 if there is no such
+ *     match.
+ */
+static int guac_terminal_search_next(guac_terminal_search_state* search,
+        const char* text, int offset, int* match_length) {
+
+    const char* start = text + offset;
+
+    /* Regular expression matches may be of any length, but empty matches
+     * are never useful as search results */
+    if (search->is_regex) {
+
+        regmatch_t match;
+        while (*start != '\0') {
+
+            if (regexec(&search->regex, start, 1, &match,
+                        start != text ? REG_NOTBOL : 0))
+                return -1;
+
+            if (match.rm_eo > match.rm_so) {
+                *match_length = match.rm_eo - match.rm_so;
+                return start - text + match.rm_so;
+            }
+
+            start += match.rm_so + 1;
+
+        }
+
+        return -1;
+
+    }
+
+    /* Literal matches are always the length of the pattern */
+    *match_length = search->pattern_length;
+
+    if (!search->ignore_case) {
+        const char* match = strstr(start, search->pattern);
+        return match != NULL ? match - text : -1;
+    }
+
+    for (; *start != '\0'; start++) {
+        if (strncasecmp(start, search->pattern, search->pattern_length) == 0)
+            return start - text;
+    }
+
+    return -1;
+
+}
+
+/**
+ * Searches the given row of the terminal for a match of the given search,
+ * restricting results to matches which begin within the given range of
+ * byte offsets within the text of that row.
+ *
+ * @param terminal
+ *     The terminal containing the row to search.
+ *
+ * @param search
+ *     The search being performed.
+ *
+ * @param row
+ *     The row to search, where the first (top-most) row in the terminal is
+ *     row 0. Rows within the scrollback buffer (above the top-most row of the
+ *     terminal) will be negative.
+ *
+ * @param min_offset
+ *     The minimum byte offset at which a match may begin, inclusive.
+ *
+ * @param max_offset
+ *     The maximum byte offset at which a match may begin, exclusive, or a
+ *     negative value if there is no maximum.
+ *
+ * @param last
+ *     true if the last match within the given range should be returned,
+ *     false if the first match should be returned.
+ *
+ * @param match_length
+ *     A pointer to an int which will receive the length of the match, in
+ *     bytes, if a match is found.
+ *
+ * @return
+ *     The byte offset of the start of the match, or -1 if there is no such
+ *     match.
+ */
+static int guac_terminal_search_row(guac_terminal* terminal,
+        guac_terminal_search_state* search, int row, int min_offset, int max_offset,
+        bool last, int* match_length) {
+
+    /* Skip rows which cannot contain the text being searched for */
+    uint64_t signature = guac_terminal_buffer_get_signature(terminal->buffer,
+            row);
+    if ((signature & search->signature) != search->signature)
+        return -1;
+
+    int length;
+    const char* text = guac_terminal_buffer_get_text(terminal->buffer,
+            row, 0, -1, &length);
+
+    if (max_offset < 0 || max_offset > length)
+        max_offset = length;
+
+    int found = -1;
+    int offset = min_offset;
+    int current_length;
+
+    while (offset < max_offset) {
+
+        int match = guac_terminal_search_next(search, text, offset,
+                &current_length);
+
+        /* Stop once no further matches exist within range */
+        if (match < 0 || match >= max_offset)
+            break;
+
+        found = match;
+        *match_length = current_length;
+
+        if (!last)
+            break;
+
+        offset = match + guac_utf8_charsize((unsigned char) text[match]);
+
+    }
+
+    return found;
+
+}
+
+bool guac_terminal_select_search(guac_terminal* terminal,
+        const char* pattern, int flags) {
+
+    guac_terminal_search_state search = {
+        .pattern = pattern,
+        .pattern_length = strlen(pattern),
+        .is_regex = flags & GUAC_TERMINAL_SEARCH_REGEX,
+        .ignore_case = flags & GUAC_TERMINAL_SEARCH_IGNORE_CASE
+    };
+
+    bool forward = flags & GUAC_TERMINAL_SEARCH_FORWARD;
+
+    /* Empty searches never match */
+    if (search.pattern_length == 0)
+        return false;
+
+    if (!search.is_regex)
+        search.signature = guac_terminal_buffer_text_signature(pattern,
+                search.pattern_length);
+
+    if (search.is_regex && regcomp(&search.regex, pattern, REG_EXTENDED
+                | (search.ignore_case ? REG_ICASE : 0))) {
+        guac_client_log(terminal->client, GUAC_LOG_DEBUG, "Ignoring search "
+                "for invalid regular expression \"%s\".", pattern);
+        return false;
+    }
+
+    /* Search all rows currently within the scrollback buffer */
+    int first_row = -guac_terminal_get_available_scroll(terminal);
+    if (first_row > 0)
+        first_row = 0;
+
+    int last_row = terminal->term_height - 1;
+    int total_rows = last_row - first_row + 1;
+
+    /* Begin searching relative to the current selection, if any, such that
+     * repeated searches step through successive matches */
+    int row, min_offset = 0, max_offset = -1;
+    if (terminal->text_selected) {
+
+        int start_row, start_col, end_row, end_col;
+        guac_terminal_select_normalized_range(terminal,
+                &start_row, &start_col, &end_row, &end_col);
+
+        int length;
+        const char* text = guac_terminal_buffer_get_text(terminal->buffer,
+                start_row, 0, -1, &length);
+        int offset = guac_terminal_buffer_get_text(terminal->buffer,
+                start_row, start_col, -1, &length) - text;
+
+        row = start_row;
+        if (forward)
+            min_offset = offset + 1;
+        else
+            max_offset = offset;
+
+    }
+
+    /* Otherwise, search from the appropriate end of the buffer */
+    else
+        row = forward ? first_row : last_row;
+
+    int match = -1;
+    int match_length = 0;
+
+    /* Visit each row once, wrapping around at either end of the buffer and
+     * ending with the unsearched remainder of the starting row */
+    for (int i = 0; i <= total_rows; i++) {
+
+        match = guac_terminal_search_row(terminal, &search, row,
+                min_offset, max_offset, !forward, &match_length);
+
+        if (match >= 0)
+            break;
+
+        min_offset = 0;
+        max_offset = -1;
+
+        if (forward)
+            row = (row < last_row) ? row + 1 : first_row;
+        else
+            row = (row > first_row) ? row - 1 : last_row;
+
+    }
+
+    if (search.is_regex)
+        regfree(&search.regex);
+
+    if (match < 0)
+        return false;
+
+    /* Select the located text */
+    int start_column = guac_terminal_buffer_get_text_column(terminal->buffer,
+            row, match);
+    int end_column = guac_terminal_buffer_get_text_column(terminal->buffer,
+            row, match + match_length - 1);
+
+    guac_terminal_select_start(terminal, row, start_column);
+    guac_terminal_select_update(terminal, row, end_column);
+    terminal->text_selected = true;
+    terminal->selection_committed = true;
+
+    /* Scroll the display such that the located text is visible */
+    if (row < -terminal->scroll_offset)
+        guac_terminal_scroll_display_up(terminal,
+                -terminal->scroll_offset - row);
+
+    else if (row >= terminal->term_height - terminal->scroll_offset)
+        guac_terminal_scroll_display_down(terminal,
+                row - terminal->term_height + terminal->scroll_offset + 1);
+
+    guac_terminal_notify(terminal);
+    return true;
+
+}
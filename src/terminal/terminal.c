@@ -980,6 +980,10 @@ int guac_terminal_scroll_up(guac_terminal* term,
         if (term->buffer->length > term->buffer->available)
             term->buffer->length = term->buffer->available;
 
+        /* Index the text of rows now entering the scrollback buffer, which
+         * will not change unless the terminal is resized or reset */
+        guac_terminal_buffer_commit_rows(term->buffer, -amount, -1);
+
         /* Reset scrollbar bounds */
         guac_terminal_scrollbar_set_bounds(term->scrollbar,
                 -guac_terminal_get_available_scroll(term), 0);
@@ -1558,6 +1562,49 @@ int guac_terminal_send_string(guac_terminal* term, const char* data) {
 
 }
 
+/**
+ * Searches the scrollback buffer of the given terminal for the first line of
+ * text currently within the clipboard, ignoring case, selecting the next
+ * match relative to the current selection. Clipboard contents which are not
+ * text are ignored. The terminal must already be locked.
+ *
+ * @param term
+ *     The terminal to search.
+ *
+ * @param flags
+ *     Any additional flags to pass to guac_terminal_select_search(), such as
+ *     GUAC_TERMINAL_SEARCH_FORWARD.
+ *
+ * @return
+ *     Zero, always. A failed search is not an error.
+ */
+static int __guac_terminal_search_clipboard(guac_terminal* term, int flags) {
+
+    guac_common_clipboard* clipboard = term->clipboard;
+    if (strncmp(clipboard->mimetype, "text/", 5) != 0)
+        return 0;
+
+    /* Search only for the first line of the clipboard */
+    char pattern[GUAC_TERMINAL_MAX_SEARCH_LENGTH + 1];
+    int length = 0;
+    while (length < clipboard->length && length < GUAC_TERMINAL_MAX_SEARCH_LENGTH
+            && clipboard->buffer[length] != '\n'
+            && clipboard->buffer[length] != '\r') {
+        pattern[length] = clipboard->buffer[length];
+        length++;
+    }
+
+    pattern[length] = '\0';
+
+    if (!guac_terminal_select_search(term, pattern,
+                flags | GUAC_TERMINAL_SEARCH_IGNORE_CASE))
+        guac_client_log(term->client, GUAC_LOG_DEBUG, "No match found for "
+                "terminal search.");
+
+    return 0;
+
+}
+
 static int __guac_terminal_send_key(guac_terminal* term, int keysym, int pressed) {
 
     /* Ignore user input if terminal is not started */
@@ -1600,6 +1647,17 @@ static int __guac_terminal_send_key(guac_terminal* term, int keysym, int pressed
         if ((keysym == 'C' && term->mod_ctrl) || (keysym == 'c' && term->mod_meta))
             return 0;
 
+        /* Ctrl+Shift+F or Cmd+f search backward through the scrollback
+         * buffer for the contents of the clipboard, while Ctrl+Shift+G or
+         * Cmd+g search forward. Repeating either steps through successive
+         * matches. */
+        if ((keysym == 'F' && term->mod_ctrl) || (keysym == 'f' && term->mod_meta))
+            return __guac_terminal_search_clipboard(term, 0);
+
+        if ((keysym == 'G' && term->mod_ctrl) || (keysym == 'g' && term->mod_meta))
+            return __guac_terminal_search_clipboard(term,
+                    GUAC_TERMINAL_SEARCH_FORWARD);
+
         /* Shift+PgUp / Shift+PgDown shortcuts for scrolling */
         if (term->mod_shift) {
 
@@ -2029,10 +2087,11 @@ void guac_terminal_pipe_stream_close(guac_terminal* term) {
 }
 
 int guac_terminal_create_typescript(guac_terminal* term, const char* path,
-        const char* name, int create_path) {
+        const char* name, int create_path, bool compress, int sync_interval) {
 
     /* Create typescript */
-    term->typescript = guac_terminal_typescript_alloc(path, name, create_path);
+    term->typescript = guac_terminal_typescript_alloc(path, name, create_path,
+            compress, sync_interval);
 
     /* Log failure */
     if (term->typescript == NULL) {
@@ -2195,6 +2254,17 @@ int guac_terminal_get_font_size(guac_terminal* terminal) {
     return terminal->font_size;
 }
 
+bool guac_terminal_search(guac_terminal* terminal, const char* pattern,
+        int flags) {
+
+    guac_terminal_lock(terminal);
+    bool found = guac_terminal_select_search(terminal, pattern, flags);
+    guac_terminal_unlock(terminal);
+
+    return found;
+
+}
+
 int guac_terminal_get_mod_ctrl(guac_terminal* terminal) {
     return terminal->mod_ctrl;
 }
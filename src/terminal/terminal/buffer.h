@@ -28,6 +28,9 @@
 
 #include "types.h"
 
+#include <stdbool.h>
+#include <stdint.h>
+
 /**
  * A single variable-length row of terminal data.
  */
@@ -51,6 +54,60 @@ typedef struct guac_terminal_buffer_row {
      */
     int available;
 
+    /**
+     * The UTF-8 representation of the contents of this row, excluding any
+     * blank or continuation characters, terminated with a null byte. This
+     * text is maintained incrementally: modifying the row discards only the
+     * text of the modified column and those following it (see text_columns),
+     * and only that portion is re-encoded when the text is next needed. The
+     * text is used both to extract selected text and to search the contents
+     * of the buffer.
+     */
+    char* text;
+
+    /**
+     * The length of the text representation of this row, in bytes, not
+     * including the null terminator.
+     */
+    int text_length;
+
+    /**
+     * The number of bytes allocated for the text array.
+     */
+    int text_available;
+
+    /**
+     * Array of byte offsets into text, where the Nth entry is the offset of
+     * the first byte of the character in column N, and the entry immediately
+     * following the last column is equal to text_length. This array always
+     * has room for available + 1 entries.
+     */
+    int* text_offsets;
+
+    /**
+     * The number of leading columns of this row whose characters are
+     * currently reflected by text. Entries of text_offsets are valid only up
+     * to and including this column. Modifying any column of the row through
+     * the functions of this buffer reduces this value to the first modified
+     * column.
+     */
+    int text_columns;
+
+    /**
+     * A bitmask summarizing the pairs of adjacent bytes present within the
+     * first text_signature_length bytes of text, as produced by
+     * guac_terminal_buffer_text_signature(). A search for literal text can
+     * skip any row whose signature lacks a bit present in the signature of
+     * that text.
+     */
+    uint64_t text_signature;
+
+    /**
+     * The number of leading bytes of text which are summarized by
+     * text_signature.
+     */
+    int text_signature_length;
+
 } guac_terminal_buffer_row;
 
 /**
@@ -131,5 +188,123 @@ void guac_terminal_buffer_copy_rows(guac_terminal_buffer* buffer,
 void guac_terminal_buffer_set_columns(guac_terminal_buffer* buffer, int row,
         int start_column, int end_column, guac_terminal_char* character);
 
+/**
+ * Returns the UTF-8 text within the given range of columns of the given row,
+ * excluding any blank or continuation characters. The text representation of
+ * each row is cached within the row and only the modified portion of a row is
+ * re-encoded, thus repeatedly retrieving the text of an unchanged row costs
+ * only a lookup. Any out-of-bounds columns are automatically clipped within
+ * the bounds of the row.
+ *
+ * @param buffer
+ *     The buffer containing the row whose text should be retrieved.
+ *
+ * @param row
+ *     The row number of the row whose text should be retrieved, where the
+ *     first (top-most) row in the terminal is row 0. Rows within the
+ *     scrollback buffer (above the top-most row of the terminal) will be
+ *     negative.
+ *
+ * @param start_column
+ *     The first column of the text to retrieve, inclusive.
+ *
+ * @param end_column
+ *     The last column of the text to retrieve, inclusive, or a negative value
+ *     to denote that the last column in the row should be used.
+ *
+ * @param length
+ *     A pointer to an int which will receive the length of the returned text,
+ *     in bytes.
+ *
+ * @return
+ *     A pointer to the first byte of the requested text. This text is owned
+ *     by the buffer, is NOT necessarily null-terminated at the end of the
+ *     requested range, and remains valid only until the buffer is next
+ *     modified.
+ */
+const char* guac_terminal_buffer_get_text(guac_terminal_buffer* buffer,
+        int row, int start_column, int end_column, int* length);
+
+/**
+ * Returns a bitmask summarizing the pairs of adjacent bytes within the given
+ * text, with ASCII letters compared without regard to case. If one string
+ * contains another, every bit set within the signature of the contained string
+ * is also set within the signature of the containing string, thus signatures
+ * can be used to rule out matches without examining the text itself.
+ *
+ * @param text
+ *     The text to summarize. This text need not be null-terminated.
+ *
+ * @param length
+ *     The length of the text, in bytes.
+ *
+ * @return
+ *     A bitmask summarizing the pairs of adjacent bytes within the given
+ *     text, or zero if the text is shorter than two bytes.
+ */
+uint64_t guac_terminal_buffer_text_signature(const char* text, int length);
+
+/**
+ * Returns the signature of the full text of the given row, as would be
+ * produced by passing that text to guac_terminal_buffer_text_signature().
+ * The signature is maintained alongside the cached text of the row and is
+ * updated only for those parts of the row which have changed.
+ *
+ * @param buffer
+ *     The buffer containing the row in question.
+ *
+ * @param row
+ *     The row number of the row in question, where the first (top-most) row
+ *     in the terminal is row 0. Rows within the scrollback buffer (above the
+ *     top-most row of the terminal) will be negative.
+ *
+ * @return
+ *     The signature of the full text of the given row.
+ */
+uint64_t guac_terminal_buffer_get_signature(guac_terminal_buffer* buffer,
+        int row);
+
+/**
+ * Brings the cached text of each row within the given range up to date. This
+ * function is invoked as rows scroll out of the terminal display and into
+ * the scrollback buffer, such that the text of the scrollback buffer is
+ * indexed as it is committed rather than when it is first searched.
+ *
+ * @param buffer
+ *     The buffer containing the rows to update.
+ *
+ * @param start_row
+ *     The first row to update, inclusive.
+ *
+ * @param end_row
+ *     The last row to update, inclusive.
+ */
+void guac_terminal_buffer_commit_rows(guac_terminal_buffer* buffer,
+        int start_row, int end_row);
+
+/**
+ * Returns the column within the given row containing the byte at the given
+ * offset within that row's text representation, as returned by
+ * guac_terminal_buffer_get_text() for the entire row. If the offset refers
+ * to a multi-column character, the first column of that character is
+ * returned.
+ *
+ * @param buffer
+ *     The buffer containing the row in question.
+ *
+ * @param row
+ *     The row number of the row in question, where the first (top-most) row
+ *     in the terminal is row 0. Rows within the scrollback buffer (above the
+ *     top-most row of the terminal) will be negative.
+ *
+ * @param offset
+ *     The byte offset within the text of the row.
+ *
+ * @return
+ *     The column containing the byte at the given offset.
+ */
+int guac_terminal_buffer_get_text_column(guac_terminal_buffer* buffer,
+        int row, int offset);
+
 #endif
 
@@ -179,5 +179,32 @@ bool guac_terminal_select_contains(guac_terminal* terminal,
 void guac_terminal_select_touch(guac_terminal* terminal,
         int start_row, int start_column, int end_row, int end_column);
 
+/**
+ * Searches the text of the given terminal, including the scrollback buffer,
+ * for the given pattern, selecting the first match found and scrolling the
+ * display such that the match is visible. If text is already selected, the
+ * search begins immediately after (or before, if searching backward) the
+ * start of that selection, such that repeated searches step through
+ * successive matches. The search wraps around at either end of the buffer.
+ * This function should only be invoked while the guac_terminal is locked
+ * through a call to guac_terminal_lock().
+ *
+ * @param terminal
+ *     The guac_terminal instance to search.
+ *
+ * @param pattern
+ *     The text to search for, or a POSIX extended regular expression if
+ *     the GUAC_TERMINAL_SEARCH_REGEX flag is set.
+ *
+ * @param flags
+ *     A bitwise OR of zero or more of GUAC_TERMINAL_SEARCH_REGEX,
+ *     GUAC_TERMINAL_SEARCH_IGNORE_CASE, and GUAC_TERMINAL_SEARCH_FORWARD.
+ *
+ * @return
+ *     true if a match was found and selected, false otherwise.
+ */
+bool guac_terminal_select_search(guac_terminal* terminal,
+        const char* pattern, int flags);
+
 #endif
 
@@ -111,6 +111,40 @@
  */
 #define GUAC_TERMINAL_PIPE_AUTOFLUSH 2
 
+/**
+ * The typescript sync interval which specifies that the typescript files
+ * should never be explicitly synced to disk via fsync(), leaving the timing
+ * of writes entirely to the operating system.
+ */
+#define GUAC_TERMINAL_TYPESCRIPT_SYNC_NEVER -1
+
+/**
+ * Flag which specifies that a search pattern passed to guac_terminal_search()
+ * is a POSIX extended regular expression. By default, search patterns are
+ * matched literally.
+ */
+#define GUAC_TERMINAL_SEARCH_REGEX 1
+
+/**
+ * Flag which specifies that guac_terminal_search() should ignore differences
+ * in case. By default, searches are case-sensitive.
+ */
+#define GUAC_TERMINAL_SEARCH_IGNORE_CASE 2
+
+/**
+ * Flag which specifies that guac_terminal_search() should search toward the
+ * bottom of the terminal. By default, searches proceed backward through the
+ * scrollback buffer, toward older output.
+ */
+#define GUAC_TERMINAL_SEARCH_FORWARD 4
+
+/**
+ * The maximum length of the text searched for through the Ctrl+Shift+F and
+ * Ctrl+Shift+G keyboard shortcuts, in bytes. Only the first line of the
+ * clipboard contents, truncated to this length, is searched for.
+ */
+#define GUAC_TERMINAL_MAX_SEARCH_LENGTH 256
+
 /**
  * Represents a terminal emulator which uses a given Guacamole client to
  * render itself.
@@ -754,6 +788,8 @@ void guac_terminal_remove_user(guac_terminal* terminal, guac_user* user);
  * yet exist. If creation of the typescript files or path fails, error messages
  * will automatically be logged, and no typescript will be written. The
  * typescript will automatically be closed once the terminal is freed.
+ * Typescript files are written by a background thread, such that slow storage
+ * does not stall the terminal.
  *
  * @param term
  *     The terminal whose output should be written to a typescript.
@@ -771,12 +807,24 @@ void guac_terminal_remove_user(guac_terminal* terminal, guac_user* user);
  *     written, or non-zero if the path should be created if it does not yet
  *     exist.
  *
+ * @param compress
+ *     Whether the typescript files should be gzip-compressed, in which case
+ *     ".gz" is appended to the names of both files. If guacamole-server was
+ *     built without zlib, the typescript is written uncompressed.
+ *
+ * @param sync_interval
+ *     The minimum amount of time between explicit syncs of the typescript
+ *     files to disk via fsync(), in milliseconds, zero if the files should be
+ *     synced only when the typescript is closed, or
+ *     GUAC_TERMINAL_TYPESCRIPT_SYNC_NEVER if the files should never be
+ *     explicitly synced.
+ *
  * @return
  *     Zero if the typescript files have been successfully created and a
  *     typescript will be written, non-zero otherwise.
  */
 int guac_terminal_create_typescript(guac_terminal* term, const char* path,
-        const char* name, int create_path);
+        const char* name, int create_path, bool compress, int sync_interval);
 
 /**
  * Immediately applies the given color scheme to the given terminal, overriding
@@ -860,4 +908,28 @@ int guac_terminal_get_font_size(guac_terminal* terminal);
  */
 int guac_terminal_get_mod_ctrl(guac_terminal* terminal);
 
+/**
+ * Searches the text of the given terminal, including its scrollback buffer,
+ * for the given pattern. The first match found is selected and highlighted,
+ * and the display is scrolled as necessary to make that match visible. If
+ * text is already selected, the search continues from that selection, such
+ * that repeated calls step through successive matches.
+ *
+ * @param terminal
+ *     The terminal to search.
+ *
+ * @param pattern
+ *     The text to search for, or a POSIX extended regular expression if the
+ *     GUAC_TERMINAL_SEARCH_REGEX flag is set.
+ *
+ * @param flags
+ *     A bitwise OR of zero or more of GUAC_TERMINAL_SEARCH_REGEX,
+ *     GUAC_TERMINAL_SEARCH_IGNORE_CASE, and GUAC_TERMINAL_SEARCH_FORWARD.
+ *
+ * @return
+ *     true if a match was found, false otherwise.
+ */
+bool guac_terminal_search(guac_terminal* terminal, const char* pattern,
+        int flags);
+
 #endif
@@ -27,8 +27,17 @@
  * @file typescript.h
  */
 
+#include "config.h"
+
 #include <guacamole/timestamp.h>
 
+#include <pthread.h>
+#include <stdbool.h>
+
+#ifdef ENABLE_ZLIB
+#include <zlib.h>
+#endif
+
 /**
  * A NULL-terminated string of raw bytes which should be written at the
  * beginning of any typescript.
@@ -74,9 +83,88 @@
  */
 #define GUAC_TERMINAL_TYPESCRIPT_TIMING_SUFFIX "timing"
 
+/**
+ * The suffix which will be appended to the names of both the typescript data
+ * file and timing file if the typescript is compressed.
+ */
+#define GUAC_TERMINAL_TYPESCRIPT_COMPRESSED_SUFFIX "gz"
+
+/**
+ * The size of the ring buffer holding raw terminal output which has been
+ * flushed by the terminal but not yet written to the data file by the
+ * typescript's writer thread, in bytes. If the writer thread falls this far
+ * behind, flushing the typescript will block until space is available.
+ */
+#define GUAC_TERMINAL_TYPESCRIPT_RING_SIZE 1048576
+
+/**
+ * The size of the ring buffer holding timing information which has been
+ * flushed by the terminal but not yet written to the timing file by the
+ * typescript's writer thread, in bytes.
+ */
+#define GUAC_TERMINAL_TYPESCRIPT_TIMING_RING_SIZE 65536
+
+/**
+ * A fixed-size ring buffer of bytes awaiting a write to one of the files of a
+ * typescript. Access to the ring buffer is synchronized by the lock of the
+ * typescript which owns it.
+ */
+typedef struct guac_terminal_typescript_ring {
+
+    /**
+     * The underlying storage of this ring buffer.
+     */
+    char* buffer;
+
+    /**
+     * The total number of bytes available within the buffer.
+     */
+    int size;
+
+    /**
+     * The offset of the first unwritten byte within the buffer.
+     */
+    int start;
+
+    /**
+     * The number of unwritten bytes currently stored within the buffer.
+     */
+    int length;
+
+} guac_terminal_typescript_ring;
+
+/**
+ * A single file of a typescript, as written by the typescript's writer
+ * thread.
+ */
+typedef struct guac_terminal_typescript_file {
+
+    /**
+     * The file descriptor of the file.
+     */
+    int fd;
+
+#ifdef ENABLE_ZLIB
+    /**
+     * The zlib stream compressing all data written to the file, or NULL if
+     * the file is not compressed.
+     */
+    gzFile gz;
+#endif
+
+    /**
+     * Bytes which have been flushed by the terminal but not yet written to
+     * the file.
+     */
+    guac_terminal_typescript_ring ring;
+
+} guac_terminal_typescript_file;
+
 /**
  * An active typescript, consisting of a data file (raw terminal output) and
- * timing file (related timestamps and byte counts).
+ * timing file (related timestamps and byte counts). Data flushed by the
+ * terminal is queued within ring buffers and written to disk by a dedicated
+ * writer thread, such that slow storage does not stall the terminal.
  */
 typedef struct guac_terminal_typescript {
 
@@ -104,17 +192,66 @@ typedef struct guac_terminal_typescript {
     char timing_filename[GUAC_TERMINAL_TYPESCRIPT_MAX_NAME_LENGTH];
 
     /**
-     * The file descriptor of the file into which raw terminal output should be
-     * written.
+     * The file into which raw terminal output should be written.
+     */
+    guac_terminal_typescript_file data;
+
+    /**
+     * The file into which timing information (timestamps and byte counts)
+     * related to the raw terminal output in the data file should be written.
+     */
+    guac_terminal_typescript_file timing;
+
+    /**
+     * The minimum amount of time between explicit calls to fsync() for the
+     * typescript files, in milliseconds. If zero, the files are synced only
+     * when the typescript is freed. If negative, the files are never
+     * explicitly synced.
+     */
+    int sync_interval;
+
+    /**
+     * The last time that the files of this typescript were synced via
+     * fsync(), or the time the typescript was created if never synced.
      */
-    int data_fd;
+    guac_timestamp last_sync;
 
     /**
-     * The file descriptor of the file into which timing information
-     * (timestamps and byte counts) related to the raw terminal output in the
-     * data file should be written.
+     * Whether any data has been written to the files of this typescript
+     * since they were last synced via fsync(). Files are never synced if
+     * nothing has been written to them.
      */
-    int timing_fd;
+    bool unsynced;
+
+    /**
+     * The thread which writes the contents of the ring buffers of the data
+     * and timing files to disk.
+     */
+    pthread_t writer_thread;
+
+    /**
+     * Lock which is acquired when the ring buffers of the data and timing
+     * files or the stopping flag are being accessed.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition which is signalled when data has been added to the ring
+     * buffers or the writer thread has been asked to stop.
+     */
+    pthread_cond_t data_available;
+
+    /**
+     * Condition which is signalled when the writer thread has removed data
+     * from the ring buffers.
+     */
+    pthread_cond_t space_available;
+
+    /**
+     * Whether the writer thread should write any remaining data and then
+     * terminate.
+     */
+    bool stopping;
 
     /**
      * The last time that this typescript was flushed. If this typescript was
@@ -129,7 +266,8 @@ typedef struct guac_terminal_typescript {
  * given base name, returning an abstraction which represents those files.
  * Terminal output will be written to these new files, along with timing
  * information. If the create_path flag is non-zero, the given path will be
- * created if it does not yet exist.
+ * created if it does not yet exist. All writes to the typescript files are
+ * performed by a background thread.
  *
  * @param path
  *     The full absolute path to a directory in which the typescript files
@@ -144,12 +282,24 @@ typedef struct guac_terminal_typescript {
  *     written, or non-zero if the path should be created if it does not yet
  *     exist.
  *
+ * @param compress
+ *     Whether the typescript files should be gzip-compressed. If compression
+ *     is requested, both files will have the
+ *     GUAC_TERMINAL_TYPESCRIPT_COMPRESSED_SUFFIX appended to their names. If
+ *     guacamole-server was built without zlib, this flag is ignored.
+ *
+ * @param sync_interval
+ *     The minimum amount of time between explicit calls to fsync() for the
+ *     typescript files, in milliseconds, zero if the files should be synced
+ *     only when the typescript is freed, or a negative value if the files
+ *     should never be explicitly synced.
+ *
  * @return
  *     A new guac_terminal_typescript representing the typescript files
  *     requested, or NULL if creation of the typescript files failed.
  */
 guac_terminal_typescript* guac_terminal_typescript_alloc(const char* path,
-        const char* name, int create_path);
+        const char* name, int create_path, bool compress, int sync_interval);
 
 /**
  * Writes a single byte of terminal data to the typescript, flushing and
@@ -167,7 +317,10 @@ void guac_terminal_typescript_write(guac_terminal_typescript* typescript,
 
 /**
  * Flushes any pending data to the typescript, writing a new timestamp to the
- * timing file if any data was flushed.
+ * timing file if any data was flushed. The data and timestamp are only
+ * queued for writing by the typescript's writer thread, thus this function
+ * blocks only if the writer thread has fallen behind by more than the size
+ * of its ring buffers.
  *
  * @param typescript
  *     The typescript which should be flushed.
@@ -176,8 +329,9 @@ void guac_terminal_typescript_flush(guac_terminal_typescript* typescript);
 
 /**
  * Frees all resources associated with the given typescript, flushing and
- * closing the data and timing files and freeing all related memory. If the
- * provided typescript is NULL, this function has no effect.
+ * closing the data and timing files and freeing all related memory. This
+ * function blocks until the writer thread has written all queued data. If
+ * the provided typescript is NULL, this function has no effect.
  *
  * @param typescript
  *     The typescript to free.
@@ -0,0 +1,110 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "terminal/buffer.h"
+
+#include <CUnit/CUnit.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Returns whether every bit of the signature of the given needle is also
+ * present within the signature of the given haystack.
+ *
+ * @param haystack
+ *     The containing text.
+ *
+ * @param needle
+ *     The contained text.
+ *
+ * @return
+ *     Non-zero if the signature of the haystack covers that of the needle,
+ *     zero otherwise.
+ */
+static int signature_covers(const char* haystack, const char* needle) {
+
+    uint64_t outer = guac_terminal_buffer_text_signature(haystack,
+            strlen(haystack));
+    uint64_t inner = guac_terminal_buffer_text_signature(needle,
+            strlen(needle));
+
+    return (outer & inner) == inner;
+
+}
+
+/**
+ * Test which verifies that the signature of any substring of a string is
+ * covered by the signature of that string, regardless of case, and that text
+ * shorter than two bytes has an empty signature.
+ */
+void test_buffer__text_signature() {
+
+    const char* text = "The quick brown fox jumps over the lazy dog";
+
+    CU_ASSERT(signature_covers(text, "quick"));
+    CU_ASSERT(signature_covers(text, "LAZY DOG"));
+    CU_ASSERT(signature_covers(text, "n fox j"));
+    CU_ASSERT(signature_covers(text, text));
+
+    CU_ASSERT_EQUAL(guac_terminal_buffer_text_signature("q", 1), 0);
+    CU_ASSERT_EQUAL(guac_terminal_buffer_text_signature("", 0), 0);
+
+    /* Text sharing no byte pairs with the original is ruled out */
+    CU_ASSERT_FALSE(signature_covers("aaaa", "zz"));
+
+}
+
+/**
+ * Test which verifies that the signature maintained for a row matches the
+ * signature of the full text of that row as the row is modified.
+ */
+void test_buffer__row_signature() {
+
+    guac_terminal_char blank = { .value = 0, .width = 1 };
+    guac_terminal_buffer* buffer = guac_terminal_buffer_alloc(4, &blank);
+
+    guac_terminal_char prompt = { .value = '$', .width = 1 };
+    guac_terminal_buffer_set_columns(buffer, 0, 0, 0, &prompt);
+
+    const char* contents[] = { "grep -r needle", "grep -r haystack", "ls" };
+
+    for (int i = 0; i < 3; i++) {
+
+        /* Overwrite the row with the current contents, leaving any longer
+         * previous contents partially intact */
+        guac_terminal_char character = { .width = 1 };
+        for (int column = 0; contents[i][column] != '\0'; column++) {
+            character.value = contents[i][column];
+            guac_terminal_buffer_set_columns(buffer, 0, column + 8,
+                    column + 8, &character);
+        }
+
+        int length;
+        const char* text = guac_terminal_buffer_get_text(buffer, 0, 0, -1,
+                &length);
+
+        CU_ASSERT_EQUAL(guac_terminal_buffer_get_signature(buffer, 0),
+                guac_terminal_buffer_text_signature(text, length));
+
+    }
+
+    guac_terminal_buffer_free(buffer);
+
+}
@@ -0,0 +1,179 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "terminal/buffer.h"
+
+#include <CUnit/CUnit.h>
+#include <string.h>
+
+/**
+ * Writes the given codepoints to the given row of the given buffer, starting
+ * at the given column, with each codepoint occupying a single column.
+ *
+ * @param buffer
+ *     The buffer to write to.
+ *
+ * @param row
+ *     The row to write to.
+ *
+ * @param column
+ *     The column of the first codepoint.
+ *
+ * @param codepoints
+ *     The codepoints to write, terminated by zero.
+ */
+static void write_codepoints(guac_terminal_buffer* buffer, int row,
+        int column, const int* codepoints) {
+
+    guac_terminal_char character = { .width = 1 };
+
+    for (; *codepoints != 0; codepoints++, column++) {
+        character.value = *codepoints;
+        guac_terminal_buffer_set_columns(buffer, row, column, column,
+                &character);
+    }
+
+}
+
+/**
+ * Verifies that the given range of columns of the given row has exactly the
+ * given text.
+ *
+ * @param buffer
+ *     The buffer containing the row.
+ *
+ * @param row
+ *     The row to verify.
+ *
+ * @param start_column
+ *     The first column of the range, inclusive.
+ *
+ * @param end_column
+ *     The last column of the range, inclusive, or -1 for the end of the row.
+ *
+ * @param expected
+ *     The expected text.
+ */
+static void assert_text(guac_terminal_buffer* buffer, int row,
+        int start_column, int end_column, const char* expected) {
+
+    int length;
+    const char* text = guac_terminal_buffer_get_text(buffer, row,
+            start_column, end_column, &length);
+
+    CU_ASSERT_EQUAL_FATAL(length, strlen(expected));
+    CU_ASSERT_NSTRING_EQUAL(text, expected, length);
+
+}
+
+/**
+ * Test which verifies that guac_terminal_buffer_get_text() encodes the
+ * characters of a row as UTF-8, skipping blank columns and clipping the
+ * requested range to the bounds of the row.
+ */
+void test_buffer__get_text() {
+
+    guac_terminal_char blank = { .value = 0, .width = 1 };
+    guac_terminal_buffer* buffer = guac_terminal_buffer_alloc(8, &blank);
+
+    /* "h\u00E9llo", a blank column, then "\u4E16" (two columns wide) */
+    write_codepoints(buffer, 0, 0, (int[]) { 'h', 0xE9, 'l', 'l', 'o', 0 });
+    guac_terminal_char wide = { .value = 0x4E16, .width = 2 };
+    guac_terminal_buffer_set_columns(buffer, 0, 6, 7, &wide);
+
+    assert_text(buffer, 0, 0, -1, "h\xC3\xA9llo\xE4\xB8\x96");
+    assert_text(buffer, 0, 1, 2, "\xC3\xA9l");
+    assert_text(buffer, 0, 5, 5, "");
+    assert_text(buffer, 0, 4, 100, "o\xE4\xB8\x96");
+
+    /* Bytes within multi-byte and multi-column characters map back to the
+     * first column of that character */
+    CU_ASSERT_EQUAL(guac_terminal_buffer_get_text_column(buffer, 0, 0), 0);
+    CU_ASSERT_EQUAL(guac_terminal_buffer_get_text_column(buffer, 0, 2), 1);
+    CU_ASSERT_EQUAL(guac_terminal_buffer_get_text_column(buffer, 0, 3), 2);
+    CU_ASSERT_EQUAL(guac_terminal_buffer_get_text_column(buffer, 0, 8), 6);
+
+    guac_terminal_buffer_free(buffer);
+
+}
+
+/**
+ * Test which verifies that modifying a row discards only the cached text of
+ * the modified column and those following it, and that the re-encoded text
+ * matches the contents of the row.
+ */
+void test_buffer__incremental_text() {
+
+    guac_terminal_char blank = { .value = 0, .width = 1 };
+    guac_terminal_buffer* buffer = guac_terminal_buffer_alloc(8, &blank);
+
+    write_codepoints(buffer, 0, 0, (int[]) { 'a', 'b', 'c', 'd', 0 });
+    assert_text(buffer, 0, 0, -1, "abcd");
+
+    guac_terminal_buffer_row* row = guac_terminal_buffer_get_row(buffer, 0, 0);
+    CU_ASSERT_EQUAL(row->text_columns, 4);
+
+    /* Overwriting a column retains the text of preceding columns */
+    write_codepoints(buffer, 0, 2, (int[]) { 0xE9, 0 });
+    CU_ASSERT_EQUAL(row->text_columns, 2);
+    CU_ASSERT_EQUAL(row->text_length, 2);
+    assert_text(buffer, 0, 0, -1, "ab\xC3\xA9" "d");
+
+    /* Appending beyond the end of the row retains all existing text */
+    write_codepoints(buffer, 0, 4, (int[]) { 'e', 'f', 0 });
+    CU_ASSERT_EQUAL(row->text_columns, 4);
+    assert_text(buffer, 0, 0, -1, "ab\xC3\xA9" "def");
+
+    /* Shifting columns discards text only from the destination onward */
+    guac_terminal_buffer_copy_columns(buffer, 0, 4, 5, -3);
+    CU_ASSERT_EQUAL(row->text_columns, 1);
+    assert_text(buffer, 0, 0, -1, "aef" "def");
+
+    guac_terminal_buffer_free(buffer);
+
+}
+
+/**
+ * Test which verifies that rows copied by guac_terminal_buffer_copy_rows()
+ * carry their cached text with them, and that committing rows brings their
+ * text up to date.
+ */
+void test_buffer__copy_rows() {
+
+    guac_terminal_char blank = { .value = 0, .width = 1 };
+    guac_terminal_buffer* buffer = guac_terminal_buffer_alloc(8, &blank);
+
+    write_codepoints(buffer, 0, 0, (int[]) { 'x', 'y', 'z', 0 });
+    write_codepoints(buffer, 1, 0, (int[]) { 'l', 'o', 'n', 'g', 'e', 'r', 0 });
+    guac_terminal_buffer_commit_rows(buffer, 0, 1);
+
+    guac_terminal_buffer_row* row = guac_terminal_buffer_get_row(buffer, 0, 0);
+    CU_ASSERT_EQUAL(row->text_columns, 3);
+
+    /* Copied row is immediately up to date */
+    guac_terminal_buffer_copy_rows(buffer, 0, 0, 1);
+    row = guac_terminal_buffer_get_row(buffer, 1, 0);
+    CU_ASSERT_EQUAL(row->length, 3);
+    CU_ASSERT_EQUAL(row->text_columns, 3);
+    assert_text(buffer, 1, 0, -1, "xyz");
+
+    guac_terminal_buffer_free(buffer);
+
+}
@@ -17,6 +17,8 @@
  * under the License.
  */
 
+#include "config.h"
+
 #include "common/io.h"
 #include "terminal/typescript.h"
 
@@ -24,14 +26,61 @@
 #include <guacamole/timestamp.h>
 
 #include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 
+/**
+ * Attempts to create and open a new typescript file having the given base
+ * name plus the given extension, failing if such a file already exists. If
+ * the file cannot be opened, -1 is returned and errno is set appropriately.
+ *
+ * @param basename
+ *     The full path to the file, excluding any extension.
+ *
+ * @param extension
+ *     The extension to append to the given path, without leading period, or
+ *     NULL if the path should be used as-is.
+ *
+ * @param filename
+ *     A buffer in which the full path of the file, including extension and
+ *     NULL terminator, should be stored. If insufficient space is available,
+ *     -1 will be returned, and errno will be set to ENAMETOOLONG.
+ *
+ * @param filename_size
+ *     The number of bytes available within the provided filename buffer.
+ *
+ * @return
+ *     The file descriptor of the open file if open succeeded, or -1 on
+ *     failure.
+ */
+static int guac_terminal_typescript_open_file(const char* basename,
+        const char* extension, char* filename, int filename_size) {
+
+    int length;
+    if (extension != NULL)
+        length = snprintf(filename, filename_size, "%s.%s", basename, extension);
+    else
+        length = snprintf(filename, filename_size, "%s", basename);
+
+    /* Abort if maximum length reached */
+    if (length >= filename_size) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    return open(filename, O_CREAT | O_EXCL | O_WRONLY,
+            S_IRUSR | S_IWUSR | S_IRGRP);
+
+}
+
 /**
  * Attempts to open a new typescript data file within the given path and having
  * the given name. If such a file already exists, sequential numeric suffixes
@@ -46,6 +95,12 @@
  * @param name
  *     The name of the data file which should be crated within the given path.
  *
+ * @param extension
+ *     An additional extension to append to the end of the filename after any
+ *     necessary numeric suffix, without leading period, or NULL if no such
+ *     extension should be appended. This extension is NOT included in the
+ *     value stored within the basename buffer.
+ *
  * @param basename
  *     A buffer in which the path, a path separator, the filename, any
  *     necessary suffix, and a NULL terminator will be stored. If insufficient
@@ -60,9 +115,11 @@
  *     failure.
  */
 static int guac_terminal_typescript_open_data_file(const char* path,
-        const char* name, char* basename, int basename_size) {
+        const char* name, const char* extension, char* basename,
+        int basename_size) {
 
     int i;
+    char filename[GUAC_TERMINAL_TYPESCRIPT_MAX_NAME_LENGTH];
 
     /* Concatenate path and name (separated by a single slash) */
     int basename_length = snprintf(basename,
@@ -77,9 +134,8 @@ static int guac_terminal_typescript_open_data_file(const char* path,
     }
 
     /* Attempt to open typescript data file */
-    int data_fd = open(basename,
-            O_CREAT | O_EXCL | O_WRONLY,
-            S_IRUSR | S_IWUSR | S_IRGRP);
+    int data_fd = guac_terminal_typescript_open_file(basename, extension,
+            filename, sizeof(filename));
 
     /* Continuously retry with alternate names on failure */
     if (data_fd == -1) {
@@ -96,9 +152,8 @@ static int guac_terminal_typescript_open_data_file(const char* path,
             sprintf(suffix, "%i", i);
 
             /* Retry with newly-suffixed filename */
-            data_fd = open(basename,
-                    O_CREAT | O_EXCL | O_WRONLY,
-                    S_IRUSR | S_IWUSR | S_IRGRP);
+            data_fd = guac_terminal_typescript_open_file(basename, extension,
+                    filename, sizeof(filename));
 
         }
 
@@ -108,43 +163,401 @@ static int guac_terminal_typescript_open_data_file(const char* path,
 
 }
 
+/**
+ * Initializes the given typescript file, allocating its ring buffer and, if
+ * requested and supported, associating a zlib stream with its file
+ * descriptor.
+ *
+ * @param file
+ *     The typescript file to initialize.
+ *
+ * @param fd
+ *     The file descriptor of the open file.
+ *
+ * @param ring_size
+ *     The size of the ring buffer to allocate for the file, in bytes.
+ *
+ * @param compress
+ *     Whether data written to the file should be gzip-compressed.
+ *
+ * @return
+ *     Zero if initialization succeeded, non-zero otherwise.
+ */
+static int guac_terminal_typescript_file_init(
+        guac_terminal_typescript_file* file, int fd, int ring_size,
+        bool compress) {
+
+    file->fd = fd;
+
+#ifdef ENABLE_ZLIB
+    file->gz = NULL;
+    if (compress) {
+
+        /* The zlib stream takes ownership of its own duplicate of the file
+         * descriptor, as gzclose() will always close the descriptor given */
+        int gz_fd = dup(fd);
+        if (gz_fd == -1)
+            return 1;
+
+        file->gz = gzdopen(gz_fd, "wb");
+        if (file->gz == NULL) {
+            close(gz_fd);
+            return 1;
+        }
+
+    }
+#endif
+
+    file->ring.buffer = guac_mem_alloc(ring_size);
+    file->ring.size = ring_size;
+    file->ring.start = 0;
+    file->ring.length = 0;
+
+    return 0;
+
+}
+
+/**
+ * Writes the given data to the given typescript file, compressing the data
+ * first if the file is compressed.
+ *
+ * @param file
+ *     The typescript file to write to.
+ *
+ * @param buffer
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes to write.
+ */
+static void guac_terminal_typescript_file_write(
+        guac_terminal_typescript_file* file, void* buffer, int length) {
+
+#ifdef ENABLE_ZLIB
+    if (file->gz != NULL) {
+        gzwrite(file->gz, buffer, length);
+        return;
+    }
+#endif
+
+    guac_common_write(file->fd, buffer, length);
+
+}
+
+/**
+ * Forces any data written to the given typescript file to be committed to
+ * disk via fsync(). If the file is compressed, any data buffered within the
+ * zlib stream is flushed first, such that all data written thus far can be
+ * decompressed.
+ *
+ * @param file
+ *     The typescript file to sync.
+ */
+static void guac_terminal_typescript_file_sync(
+        guac_terminal_typescript_file* file) {
+
+#ifdef ENABLE_ZLIB
+    if (file->gz != NULL)
+        gzflush(file->gz, Z_SYNC_FLUSH);
+#endif
+
+    fsync(file->fd);
+
+}
+
+/**
+ * Closes the given typescript file, finishing any compressed stream, and
+ * freeing its ring buffer. If requested, the file is synced via fsync()
+ * prior to closing.
+ *
+ * @param file
+ *     The typescript file to close.
+ *
+ * @param sync
+ *     Whether the file should be synced prior to closing.
+ */
+static void guac_terminal_typescript_file_close(
+        guac_terminal_typescript_file* file, bool sync) {
+
+#ifdef ENABLE_ZLIB
+    if (file->gz != NULL)
+        gzclose(file->gz);
+#endif
+
+    if (sync)
+        fsync(file->fd);
+
+    close(file->fd);
+    guac_mem_free(file->ring.buffer);
+
+}
+
+/**
+ * Copies the given data into the given ring buffer. The ring buffer MUST
+ * have sufficient space for the data, and the lock of the typescript owning
+ * the ring buffer must be held.
+ *
+ * @param ring
+ *     The ring buffer to copy data into.
+ *
+ * @param buffer
+ *     The data to copy.
+ *
+ * @param length
+ *     The number of bytes to copy.
+ */
+static void guac_terminal_typescript_ring_push(
+        guac_terminal_typescript_ring* ring, const char* buffer, int length) {
+
+    /* Determine location of first free byte */
+    int end = (ring->start + ring->length) % ring->size;
+
+    /* Copy as much as possible before the end of the underlying buffer,
+     * wrapping around to the beginning for the remainder */
+    int first = ring->size - end;
+    if (first > length)
+        first = length;
+
+    memcpy(ring->buffer + end, buffer, first);
+    memcpy(ring->buffer, buffer + first, length - first);
+
+    ring->length += length;
+
+}
+
+/**
+ * Queues the given data for writing to the given typescript file by the
+ * writer thread, waiting for space within the ring buffer of that file as
+ * necessary. The lock of the typescript must be held.
+ *
+ * @param typescript
+ *     The typescript owning the given file.
+ *
+ * @param file
+ *     The file to which the given data should be written.
+ *
+ * @param buffer
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes to write.
+ */
+static void guac_terminal_typescript_enqueue(
+        guac_terminal_typescript* typescript,
+        guac_terminal_typescript_file* file, const char* buffer, int length) {
+
+    guac_terminal_typescript_ring* ring = &file->ring;
+
+    while (length > 0) {
+
+        /* Wait for the writer thread if the ring buffer is full */
+        while (ring->length == ring->size)
+            pthread_cond_wait(&typescript->space_available, &typescript->lock);
+
+        int available = ring->size - ring->length;
+        if (available > length)
+            available = length;
+
+        guac_terminal_typescript_ring_push(ring, buffer, available);
+        pthread_cond_signal(&typescript->data_available);
+
+        buffer += available;
+        length -= available;
+
+    }
+
+}
+
+/**
+ * Writes the contiguous block of data at the beginning of the given file's
+ * ring buffer to that file. The lock of the typescript must be held when this
+ * function is invoked, and will be released while the data is being written.
+ *
+ * @param typescript
+ *     The typescript owning the given file.
+ *
+ * @param file
+ *     The file whose queued data should be written.
+ *
+ * @return
+ *     The number of bytes written, which may be zero if no data was queued.
+ */
+static int guac_terminal_typescript_drain(guac_terminal_typescript* typescript,
+        guac_terminal_typescript_file* file) {
+
+    guac_terminal_typescript_ring* ring = &file->ring;
+
+    /* Only the contiguous block ending at the end of the underlying buffer
+     * can be written at once */
+    int length = ring->size - ring->start;
+    if (length > ring->length)
+        length = ring->length;
+
+    if (length == 0)
+        return 0;
+
+    /* The writer thread is the only consumer of the ring buffer, thus the
+     * queued data will not move while the lock is released */
+    pthread_mutex_unlock(&typescript->lock);
+    guac_terminal_typescript_file_write(file, ring->buffer + ring->start, length);
+    pthread_mutex_lock(&typescript->lock);
+
+    ring->start = (ring->start + length) % ring->size;
+    ring->length -= length;
+    pthread_cond_broadcast(&typescript->space_available);
+
+    return length;
+
+}
+
+/**
+ * The body of the writer thread of a typescript, repeatedly writing the
+ * contents of the ring buffers of the data and timing files until the
+ * typescript is being freed and no queued data remains.
+ *
+ * @param data
+ *     The guac_terminal_typescript whose files should be written.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_terminal_typescript_writer_thread(void* data) {
+
+    guac_terminal_typescript* typescript = (guac_terminal_typescript*) data;
+
+    pthread_mutex_lock(&typescript->lock);
+
+    for (;;) {
+
+        /* Write raw output before the timing entries which describe it,
+         * such that the timing file never refers to data which has not yet
+         * been written */
+        int written = guac_terminal_typescript_drain(typescript, &typescript->data);
+        if (written == 0)
+            written = guac_terminal_typescript_drain(typescript, &typescript->timing);
+
+        if (written > 0)
+            typescript->unsynced = true;
+
+        /* Periodically sync both files to disk, if requested and only if
+         * anything has actually been written since the last sync */
+        guac_timestamp now = guac_timestamp_current();
+        if (typescript->sync_interval > 0 && typescript->unsynced
+                && now - typescript->last_sync >= typescript->sync_interval) {
+
+            typescript->unsynced = false;
+
+            pthread_mutex_unlock(&typescript->lock);
+            guac_terminal_typescript_file_sync(&typescript->data);
+            guac_terminal_typescript_file_sync(&typescript->timing);
+            pthread_mutex_lock(&typescript->lock);
+
+            typescript->last_sync = now;
+
+        }
+
+        if (written > 0)
+            continue;
+
+        /* Stop only after all queued data has been written */
+        if (typescript->stopping)
+            break;
+
+        /* Wait for more data, waking for the next sync only if there is
+         * unsynced data */
+        if (typescript->sync_interval > 0 && typescript->unsynced) {
+            struct timespec timeout;
+            clock_gettime(CLOCK_REALTIME, &timeout);
+            timeout.tv_sec += typescript->sync_interval / 1000;
+            timeout.tv_nsec += (typescript->sync_interval % 1000) * 1000000;
+            if (timeout.tv_nsec >= 1000000000) {
+                timeout.tv_sec++;
+                timeout.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&typescript->data_available,
+                    &typescript->lock, &timeout);
+        }
+        else
+            pthread_cond_wait(&typescript->data_available, &typescript->lock);
+
+    }
+
+    pthread_mutex_unlock(&typescript->lock);
+    return NULL;
+
+}
+
 guac_terminal_typescript* guac_terminal_typescript_alloc(const char* path,
-        const char* name, int create_path) {
+        const char* name, int create_path, bool compress, int sync_interval) {
 
     /* Create path if it does not exist, fail if impossible */
     if (create_path && mkdir(path, S_IRWXU | S_IRGRP | S_IXGRP)
             && errno != EEXIST)
         return NULL;
 
+#ifndef ENABLE_ZLIB
+    /* Compression is impossible without zlib */
+    compress = false;
+#endif
+
+    const char* extension = compress
+        ? GUAC_TERMINAL_TYPESCRIPT_COMPRESSED_SUFFIX : NULL;
+
     /* Allocate space for new typescript */
     guac_terminal_typescript* typescript =
         guac_mem_alloc(sizeof(guac_terminal_typescript));
 
     /* Attempt to open typescript data file */
-    typescript->data_fd = guac_terminal_typescript_open_data_file(
-            path, name, typescript->data_filename,
-            sizeof(typescript->data_filename)
-                - sizeof(GUAC_TERMINAL_TYPESCRIPT_TIMING_SUFFIX));
-    if (typescript->data_fd == -1) {
+    char basename[GUAC_TERMINAL_TYPESCRIPT_MAX_NAME_LENGTH];
+    int data_fd = guac_terminal_typescript_open_data_file(
+            path, name, extension, basename,
+            sizeof(basename)
+                - sizeof(GUAC_TERMINAL_TYPESCRIPT_TIMING_SUFFIX)
+                - sizeof(GUAC_TERMINAL_TYPESCRIPT_COMPRESSED_SUFFIX));
+    if (data_fd == -1) {
         guac_mem_free(typescript);
         return NULL;
     }
 
-    /* Append suffix to basename */
-    if (snprintf(typescript->timing_filename, sizeof(typescript->timing_filename),
-                "%s.%s", typescript->data_filename, GUAC_TERMINAL_TYPESCRIPT_TIMING_SUFFIX)
+    /* Record full names of both files, appending suffixes to basename */
+    const char* compressed_suffix = compress
+        ? "." GUAC_TERMINAL_TYPESCRIPT_COMPRESSED_SUFFIX : "";
+
+    if (snprintf(typescript->data_filename, sizeof(typescript->data_filename),
+                "%s%s", basename, compressed_suffix)
+            >= sizeof(typescript->data_filename)
+        || snprintf(typescript->timing_filename, sizeof(typescript->timing_filename),
+                "%s.%s%s", basename, GUAC_TERMINAL_TYPESCRIPT_TIMING_SUFFIX,
+                compressed_suffix)
             >= sizeof(typescript->timing_filename)) {
-        close(typescript->data_fd);
+        close(data_fd);
         guac_mem_free(typescript);
         return NULL;
     }
 
     /* Attempt to open typescript timing file */
-    typescript->timing_fd = open(typescript->timing_filename,
+    int timing_fd = open(typescript->timing_filename,
             O_CREAT | O_EXCL | O_WRONLY,
             S_IRUSR | S_IWUSR | S_IRGRP);
-    if (typescript->timing_fd == -1) {
-        close(typescript->data_fd);
+    if (timing_fd == -1) {
+        close(data_fd);
+        guac_mem_free(typescript);
+        return NULL;
+    }
+
+    /* Prepare both files for writing by the writer thread */
+    if (guac_terminal_typescript_file_init(&typescript->data, data_fd,
+                GUAC_TERMINAL_TYPESCRIPT_RING_SIZE, compress)) {
+        close(data_fd);
+        close(timing_fd);
+        guac_mem_free(typescript);
+        return NULL;
+    }
+
+    if (guac_terminal_typescript_file_init(&typescript->timing, timing_fd,
+                GUAC_TERMINAL_TYPESCRIPT_TIMING_RING_SIZE, compress)) {
+        guac_terminal_typescript_file_close(&typescript->data, false);
+        close(timing_fd);
         guac_mem_free(typescript);
         return NULL;
     }
@@ -152,11 +565,32 @@ guac_terminal_typescript* guac_terminal_typescript_alloc(const char* path,
     /* Typescript starts out flushed */
     typescript->length = 0;
     typescript->last_flush = guac_timestamp_current();
-
-    /* Write header */
-    guac_common_write(typescript->data_fd, GUAC_TERMINAL_TYPESCRIPT_HEADER,
+    typescript->last_sync = typescript->last_flush;
+    typescript->unsynced = false;
+    typescript->sync_interval = sync_interval;
+    typescript->stopping = false;
+
+    pthread_mutex_init(&typescript->lock, NULL);
+    pthread_cond_init(&typescript->data_available, NULL);
+    pthread_cond_init(&typescript->space_available, NULL);
+
+    /* Queue header, to be written once the writer thread starts */
+    guac_terminal_typescript_ring_push(&typescript->data.ring,
+            GUAC_TERMINAL_TYPESCRIPT_HEADER,
             sizeof(GUAC_TERMINAL_TYPESCRIPT_HEADER) - 1);
 
+    /* Start writer thread */
+    if (pthread_create(&typescript->writer_thread, NULL,
+                guac_terminal_typescript_writer_thread, typescript)) {
+        pthread_cond_destroy(&typescript->space_available);
+        pthread_cond_destroy(&typescript->data_available);
+        pthread_mutex_destroy(&typescript->lock);
+        guac_terminal_typescript_file_close(&typescript->data, false);
+        guac_terminal_typescript_file_close(&typescript->timing, false);
+        guac_mem_free(typescript);
+        return NULL;
+    }
+
     return typescript;
 
 }
@@ -197,13 +631,13 @@ void guac_terminal_typescript_flush(guac_terminal_typescript* typescript) {
     if (timestamp_length > sizeof(timestamp_buffer))
         timestamp_length = sizeof(timestamp_buffer);
 
-    /* Write timestamp to timing file */
-    guac_common_write(typescript->timing_fd,
-            timestamp_buffer, timestamp_length);
-
-    /* Empty buffer into data file */
-    guac_common_write(typescript->data_fd,
+    /* Queue buffer contents and timestamp for the writer thread */
+    pthread_mutex_lock(&typescript->lock);
+    guac_terminal_typescript_enqueue(typescript, &typescript->data,
             typescript->buffer, typescript->length);
+    guac_terminal_typescript_enqueue(typescript, &typescript->timing,
+            timestamp_buffer, timestamp_length);
+    pthread_mutex_unlock(&typescript->lock);
 
     /* Buffer is now flushed */
     typescript->length = 0;
@@ -220,16 +654,27 @@ void guac_terminal_typescript_free(guac_terminal_typescript* typescript) {
     /* Flush any pending data */
     guac_terminal_typescript_flush(typescript);
 
-    /* Write footer */
-    guac_common_write(typescript->data_fd, GUAC_TERMINAL_TYPESCRIPT_FOOTER,
+    /* Queue footer and wait for writer thread to write everything */
+    pthread_mutex_lock(&typescript->lock);
+    guac_terminal_typescript_enqueue(typescript, &typescript->data,
+            GUAC_TERMINAL_TYPESCRIPT_FOOTER,
             sizeof(GUAC_TERMINAL_TYPESCRIPT_FOOTER) - 1);
+    typescript->stopping = true;
+    pthread_cond_signal(&typescript->data_available);
+    pthread_mutex_unlock(&typescript->lock);
+
+    pthread_join(typescript->writer_thread, NULL);
 
-    /* Close file descriptors */
-    close(typescript->data_fd);
-    close(typescript->timing_fd);
+    /* Close files, syncing unless syncing was disabled entirely */
+    bool sync = typescript->sync_interval >= 0;
+    guac_terminal_typescript_file_close(&typescript->data, sync);
+    guac_terminal_typescript_file_close(&typescript->timing, sync);
+
+    pthread_cond_destroy(&typescript->space_available);
+    pthread_cond_destroy(&typescript->data_available);
+    pthread_mutex_destroy(&typescript->lock);
 
     /* Free allocated typescript data */
     guac_mem_free(typescript);
 
 }
-